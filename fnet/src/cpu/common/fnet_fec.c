@@ -428,7 +428,7 @@ void fnet_fec_input(fnet_netif_t *netif)
                                         (int)(fnet_ntohs(ethif->rx_buf_desc_cur->length) - sizeof(fnet_eth_header_t)), FNET_TRUE );
             
             /* Network-layer input.*/
-            fnet_eth_prot_input( netif, nb, ethheader->type );
+            fnet_eth_prot_input( netif, nb, ethheader->type, ethheader->source_addr );
             
          }
 NEXT_FRAME: 
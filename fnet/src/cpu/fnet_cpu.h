@@ -275,6 +275,27 @@ fnet_cpu_irq_desc_t fnet_cpu_irq_disable(void);
  ******************************************************************************/
 void fnet_cpu_irq_enable(fnet_cpu_irq_desc_t desc);
 
+#if FNET_CFG_CPU_IDLE || defined(__DOXYGEN__)
+/***************************************************************************/ /*!
+ *
+ * @brief    Stops the core until an interrupt is pending.
+ *
+ * @see fnet_poll_services_idle()
+ *
+ ******************************************************************************
+ *
+ * This function puts the core into the sleep mode. It returns when 
+ * any interrupt becomes pending, also if the interrupts are disabled 
+ * by @ref fnet_cpu_irq_disable(). @n
+ * So the caller can check its wake-up condition with the interrupts 
+ * disabled, without losing an interrupt that comes between the check 
+ * and the sleep.@n
+ * It is available only if @ref FNET_CFG_CPU_IDLE is set to @c 1.
+ *
+ ******************************************************************************/
+void fnet_cpu_idle(void);
+#endif
+
 /***************************************************************************/ /*!
  *
  * @brief    Writes character to the serial port.
@@ -275,6 +275,18 @@
 #endif
 #endif
 
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_CPU_VECTOR_NUMBER_MAX
+ * @brief    Number of hardware interrupt vectors, that can be registered
+ *           by the FNET ISR dispatcher. @n
+ *           All vector numbers passed to the dispatcher must be lower than it.
+ *           It defines the size of the vector lookup table (one byte per vector).
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_CPU_VECTOR_NUMBER_MAX
+    #define FNET_CFG_CPU_VECTOR_NUMBER_MAX      (256)
+#endif
+
 /**************************************************************************/ /*!
  * @def      FNET_CFG_CPU_TIMER_NUMBER_MAX
  * @brief    Maximum Timer number that is avaiable on the used platform.
@@ -328,6 +340,34 @@
     #error "FNET_CFG_CPU_TIMER_VECTOR_PRIORITY must be from 1 to 7."
 #endif
 
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_CPU_TIMER_US
+ * @brief    The platform timer driver provides the microsecond clock 
+ *           (fnet_cpu_timer_us()), read from the counter of the hardware timer:
+ *               - @c 1 = fnet_timer_us() has microsecond resolution.
+ *               - @c 0 = fnet_timer_us() has resolution of the timer tick 
+ *                 (@ref FNET_TIMER_PERIOD_MS).
+ *           @n @n NOTE: User application should not change this parameter. 
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_CPU_TIMER_US
+    #define FNET_CFG_CPU_TIMER_US               (0)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_CPU_IDLE
+ * @brief    The platform provides fnet_cpu_idle(), which stops the core 
+ *           until the next interrupt:
+ *               - @c 1 = fnet_poll_services_idle() puts the core to sleep, 
+ *                 when no service is ready.
+ *               - @c 0 = fnet_poll_services_idle() returns immediately.
+ *           @n @n NOTE: User application should not change this parameter. 
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_CPU_IDLE
+    #define FNET_CFG_CPU_IDLE                   (0)
+#endif
+
 /**************************************************************************/ /*!
  * @def      FNET_CFG_CPU_ETH_VECTOR_NUMBER
  * @brief    Vector number of the Ethernet Receive Frame interrupt.
@@ -8,25 +8,44 @@
 #include "fnet.h"
 
 #if FNET_LPC
+
+#ifdef __USE_CMSIS
+#include "LPC17xx.h"
+#endif
+
 /************************************************************************
 * NAME: fnet_cpu_irq_disable
 *
-* DESCRIPTION: Disable IRQs
+* DESCRIPTION: Disable IRQs. Returns the previous PRIMASK.
 *************************************************************************/
 fnet_cpu_irq_desc_t fnet_cpu_irq_disable(void)
 {
-     return 0;
+	fnet_cpu_irq_desc_t irq_desc = __get_PRIMASK();
+
+	__disable_irq();
+	return irq_desc;
 }
 
 /************************************************************************
 * NAME: fnet_cpu_irq_enable
 *
-* DESCRIPTION: Enables IRQs.
+* DESCRIPTION: Enables IRQs (restores the PRIMASK).
 *************************************************************************/
 void fnet_cpu_irq_enable(fnet_cpu_irq_desc_t irq_desc)
 {
-	char x;
-	x++; // stub
+	__set_PRIMASK(irq_desc);
+}
+
+/************************************************************************
+* NAME: fnet_cpu_idle
+*
+* DESCRIPTION: Sleeps until an interrupt is pending. WFI wakes up also 
+*              when PRIMASK is set, the interrupt is taken after 
+*              fnet_cpu_irq_enable().
+*************************************************************************/
+void fnet_cpu_idle(void)
+{
+	__WFI();
 }
 
 // stub function, we use CMSIS for now
@@ -10,7 +10,102 @@
 #define FNET_CFG_CPU_ETH_VECTOR_NUMBER	1 // ????
 #endif
 
+/* NVIC external interrupts (IRQn 0..34). */
+#ifndef FNET_CFG_CPU_VECTOR_NUMBER_MAX
+	#define FNET_CFG_CPU_VECTOR_NUMBER_MAX	(35)
+#endif
+
 #ifndef FNET_CFG_CPU_LITTLE_ENDIAN
 	#define FNET_CFG_CPU_LITTLE_ENDIAN 1
 #endif
 
+/* Transmit frames straight out of the netbuf fragments (one EMAC descriptor
+ * per fragment) instead of copying the whole chain into the TX buffer.
+ * The EMAC DMA can only reach AHB SRAM, so fragments living anywhere else
+ * are still copied. */
+#ifndef FNET_CFG_CPU_ETH_ZEROCOPY_TX
+	#define FNET_CFG_CPU_ETH_ZEROCOPY_TX 1
+#endif
+
+/* Fragments shorter than this are cheaper to copy than to give their own
+ * descriptor (e.g. TCP/IP headers). */
+#ifndef FNET_CFG_CPU_ETH_ZEROCOPY_TX_MIN
+	#define FNET_CFG_CPU_ETH_ZEROCOPY_TX_MIN 64
+#endif
+
+/* Hand received frames to the stack in place, wrapped in an external-buffer
+ * netbuf, and give the RX descriptor a spare DMA buffer instead. */
+#ifndef FNET_CFG_CPU_ETH_ZEROCOPY_RX
+	#define FNET_CFG_CPU_ETH_ZEROCOPY_RX 1
+#endif
+
+/* Number of spare RX DMA buffers that can be on loan to the stack at a time.
+ * When all are in use, received frames are copied as usual. */
+#ifndef FNET_CFG_CPU_ETH_RX_SPARE_BUFS
+	#define FNET_CFG_CPU_ETH_RX_SPARE_BUFS 3
+#endif
+
+/* Full-size frames that fit in the TX staging area. Frames sent zero-copy
+ * only stage their headers, so many more of those can be queued. */
+#ifndef FNET_CFG_CPU_ETH_TX_BUFS_MAX
+	#define FNET_CFG_CPU_ETH_TX_BUFS_MAX 2
+#endif
+
+/* Number of TX descriptors. A frame takes one per zero-copy fragment
+ * plus one per run of copied data. */
+#ifndef FNET_CFG_CPU_ETH_TX_DESCRIPTORS
+	#define FNET_CFG_CPU_ETH_TX_DESCRIPTORS 16
+#endif
+
+/* Frames queued in software while the TX ring is full. They are moved to the
+ * ring as the EMAC completes frames; beyond this limit frames are dropped. */
+#ifndef FNET_CFG_CPU_ETH_TX_BACKLOG_MAX
+	#define FNET_CFG_CPU_ETH_TX_BACKLOG_MAX 8
+#endif
+
+/* Interrupt coalescing for received frames. Under load the EMAC only
+ * interrupts every FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES frames and a timer
+ * polls the RX ring for the rest; when traffic drops, every frame
+ * interrupts again. Uses TIMER3. */
+#ifndef FNET_CFG_CPU_ETH_RX_COALESCE
+	#define FNET_CFG_CPU_ETH_RX_COALESCE 1
+#endif
+
+/* Frames drained in one pass that switch the driver to polling */
+#ifndef FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD
+	#define FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD 3
+#endif
+
+/* While polling, frames received before the EMAC raises an interrupt */
+#ifndef FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES
+	#define FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES 2
+#endif
+
+/* RX poll period in microseconds. This bounds the extra latency of a
+ * frame that does not raise an interrupt. */
+#ifndef FNET_CFG_CPU_ETH_RX_POLL_PERIOD_US
+	#define FNET_CFG_CPU_ETH_RX_POLL_PERIOD_US 500
+#endif
+
+/* Microsecond clock from the TIMER2 counter, see fnet_lpc1768_timer.c */
+#ifndef FNET_CFG_CPU_TIMER_US
+	#define FNET_CFG_CPU_TIMER_US 1
+#endif
+
+/* WFI based fnet_cpu_idle(), see fnet_lpc.c */
+#ifndef FNET_CFG_CPU_IDLE
+	#define FNET_CFG_CPU_IDLE 1
+#endif
+
+/* Cortex-M3 fnet_checksum_low(), see fnet_lpc_checksum.c */
+#ifndef FNET_CFG_OVERLOAD_CHECKSUM_LOW
+	#define FNET_CFG_OVERLOAD_CHECKSUM_LOW 1
+#endif
+
+/* Network heap address. AHB SRAM bank 1 is not used by the EMAC rings, and
+ * placing the heap there lets the EMAC DMA read netbuf data directly. */
+#ifndef FNET_CFG_CPU_HEAP_ADDR
+	#if FNET_CFG_CPU_ETH_ZEROCOPY_TX
+		#define FNET_CFG_CPU_HEAP_ADDR 0x20080000
+	#endif
+#endif
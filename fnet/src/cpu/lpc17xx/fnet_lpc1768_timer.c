@@ -28,6 +28,12 @@
 #define timer2_set_enable() LPC_TIM2->TCR = 1
 #define timer2_set_disable() LPC_TIM2->TCR = 0
 
+#define timer2_get_counter() LPC_TIM2->TC
+#define timer2_match_pending() (LPC_TIM2->IR & 1)
+
+/* Counter ticks per microsecond, for fnet_cpu_timer_us().*/
+static uint32_t fnet_cpu_timer_counts_per_us;
+
 void fnet_cpu_timer_handler_top() {
 	LPC_TIM2->IR = 1;
 	fnet_timer_ticks_inc();
@@ -43,9 +49,8 @@ void TIMER2_IRQHandler(void) {
 }
 int fnet_cpu_timer_init(unsigned int period_ms) {
 	uint32_t pClk4 = SystemCoreClock / 4;
-	float tickTime = 1.0 / ((float) pClk4);
-	float seconds = (float) period_ms * 0.001;
-	uint32_t counts = seconds / tickTime;
+	// Counts per period, integer only (no FPU on Cortex-M3)
+	uint32_t counts = (pClk4 / 1000) * period_ms;
 
 	// Turn on the power
 	enable_timer2_power();
@@ -60,6 +65,7 @@ int fnet_cpu_timer_init(unsigned int period_ms) {
 	timer2_interrupt_reset_match();
 	// Set the match register
 	timer2_set_interval0(counts);
+	fnet_cpu_timer_counts_per_us = pClk4 / 1000000;
 	//LPC_TIM3->CTCR = 0; // use counter mode
 	// Enable interrupt
 	NVIC_EnableIRQ(TIMER2_IRQn);
@@ -70,6 +76,39 @@ int fnet_cpu_timer_init(unsigned int period_ms) {
 	return FNET_OK;
 }
 
+/************************************************************************
+* NAME: fnet_cpu_timer_us
+*
+* DESCRIPTION: Returns the microsecond clock. The counter of TIMER2 
+*              counts the time inside the current timer tick.
+*
+*************************************************************************/
+unsigned long fnet_cpu_timer_us( void )
+{
+	unsigned long ticks;
+	uint32_t counter;
+	uint32_t pending;
+
+	/* The tick must not change, while the counter is read.*/
+	do
+	{
+		ticks = fnet_timer_ticks();
+		counter = timer2_get_counter();
+		pending = timer2_match_pending();
+	}
+	while(ticks != fnet_timer_ticks());
+
+	/* The counter is reset, but the tick is not incremented yet
+	 * (interrupts are disabled or the tick interrupt is pended).*/
+	if(pending)
+	{
+		ticks++;
+		counter = timer2_get_counter();
+	}
+
+	return ticks * (FNET_TIMER_PERIOD_MS * 1000) + counter / fnet_cpu_timer_counts_per_us;
+}
+
 /************************************************************************
 * NAME: fnet_cpu_timer_release
 *
@@ -0,0 +1,85 @@
+/*
+ * fnet_lpc_checksum.c
+ *
+ * Cortex-M3 Internet checksum.
+ */
+
+#include "fnet.h"
+
+#if FNET_LPC && FNET_CFG_OVERLOAD_CHECKSUM_LOW
+
+/* Adds a value to the sum, counting the carry out of bit 31 */
+#define fnet_lpc_checksum_add(sum, carries, value) \
+	do { unsigned long _v = (value); (sum) += _v; (carries) += ((sum) < _v); } while(0)
+
+/************************************************************************
+* NAME: fnet_checksum_low
+*
+* DESCRIPTION: Adds the 16-bit words of d_ptr[0..current_length-1] to sum.
+*              Blocks of 16 bytes are loaded into four registers and 
+*              summed through the ADCS carry chain. The result is folded 
+*              to 17 bits.
+*************************************************************************/
+unsigned long fnet_checksum_low(unsigned long sum, int current_length, unsigned short *d_ptr)
+{
+	unsigned long *l_ptr;
+	unsigned long blocks;
+	unsigned long carries = 0;
+	unsigned long w0, w1, w2, w3;
+
+	if (((unsigned long)d_ptr & 1) == 0) {
+		if (((unsigned long)d_ptr & 2) && (current_length >= 2)) {
+			fnet_lpc_checksum_add(sum, carries, *d_ptr++);
+			current_length -= 2;
+		}
+
+		l_ptr = (unsigned long *)d_ptr;
+		blocks = (unsigned long)current_length >> 4;
+		if (blocks) {
+			/* The carry of each block goes to 'carries', so the loop
+			 * counter may clobber the flags. The compiler picks the
+			 * word registers, r7 is the frame pointer in Thumb code */
+			__asm__ __volatile__(
+				".syntax unified                     \n"
+				"1:  ldr    %[w0], [%[ptr]], #4      \n"
+				"    ldr    %[w1], [%[ptr]], #4      \n"
+				"    ldr    %[w2], [%[ptr]], #4      \n"
+				"    ldr    %[w3], [%[ptr]], #4      \n"
+				"    adds   %[sum], %[sum], %[w0]    \n"
+				"    adcs   %[sum], %[sum], %[w1]    \n"
+				"    adcs   %[sum], %[sum], %[w2]    \n"
+				"    adcs   %[sum], %[sum], %[w3]    \n"
+				"    adc    %[carries], %[carries], #0\n"
+				"    subs   %[blocks], %[blocks], #1 \n"
+				"    bne    1b                       \n"
+				: [sum] "+r" (sum), [ptr] "+r" (l_ptr), [blocks] "+r" (blocks), [carries] "+r" (carries),
+				  [w0] "=&r" (w0), [w1] "=&r" (w1), [w2] "=&r" (w2), [w3] "=&r" (w3)
+				:
+				: "cc", "memory");
+			current_length &= 15;
+		}
+
+		while ((current_length -= 4) >= 0) {
+			fnet_lpc_checksum_add(sum, carries, *l_ptr++);
+		}
+		current_length += 4;
+		d_ptr = (unsigned short *)l_ptr;
+	}
+
+	/* Odd address (after an odd-length net_buf) and the tail.
+	 * The Cortex-M3 loads halfwords from any address. */
+	while ((current_length -= 2) >= 0) {
+		fnet_lpc_checksum_add(sum, carries, *d_ptr++);
+	}
+	if (current_length += 2) {
+		fnet_lpc_checksum_add(sum, carries, *(unsigned char *)d_ptr); /* Little endian, low byte */
+	}
+
+	/* A carry out of bit 31 is worth 1 in one's complement arithmetic */
+	sum = (sum >> 16) + (sum & 0xffff) + carries;
+	sum = (sum >> 16) + (sum & 0xffff);
+
+	return sum;
+}
+
+#endif
@@ -53,15 +53,67 @@
 char loop;
 
 uint8_t *rxFragmentPtr;
-uint8_t *txFragmentPtr;
+uint8_t *txStagePtr;
 
 uint32_t recvPackets=0,sentPackets=0;
 
-uint8_t usedTxDescr = 0;
-uint8_t transmitLock = 0;
-uint8_t recvPacketsWaiting = 0;
+/* RxDone interrupts and poll timer ticks. (recvInterrupts+recvPolls)/recvPackets
+ * is the number of interrupts taken per received frame. */
+uint32_t recvInterrupts = 0, recvPolls = 0;
+/* Largest number of frames drained in one pass */
+uint32_t recvBatchMax = 0;
+
+#if FNET_CFG_CPU_ETH_RX_COALESCE
+#define PCONP_ENABLE_PCTIM3 (1<<23)
+
+#define enable_timer3_power() LPC_SC->PCONP |= PCONP_ENABLE_PCTIM3
+#define timer3_set_pclk4() LPC_SC->PCLKSEL1 &= ~(3<<14)
+#define timer3_counter_reset() LPC_TIM3->TCR = 0x2
+#define timer3_set_timer_mode() LPC_TIM3->CTCR = 0
+#define timer3_interrupt_reset_match() LPC_TIM3->MCR=0x3
+#define timer3_set_interval0(interval) LPC_TIM3->MR0 = interval
+#define timer3_set_enable() LPC_TIM3->TCR = 1
+#define timer3_set_disable() LPC_TIM3->TCR = 0
+#define timer3_clear_match0() LPC_TIM3->IR = 1
+
+uint8_t rxPollMode = 0;
+/* Frames drained since the last poll timer tick */
+uint32_t rxFramesSincePoll = 0;
+uint32_t recvPollModeEntries = 0;
+
+static void fnet_lpceth_rx_poll_init(void);
+static void fnet_lpceth_rx_poll_top(void);
+static void fnet_lpceth_rx_poll_bottom(void);
+#endif
+
+/* Stored against the last descriptor of each frame until fnet_lpceth_tx_reclaim() */
+fnet_netbuf_t *txDescriptorNetbuf[NUM_OF_TX_FRAGMENTS]; // netbuf chain still referenced by the EMAC
+uint32_t txDescriptorStaged[NUM_OF_TX_FRAGMENTS]; // staging area bytes to give back
+/* First descriptor not yet returned to the driver by fnet_lpceth_tx_reclaim() */
+uint8_t txReclaimIndex = 0;
+
+/* The staging area is a byte ring, allocated and released in descriptor order */
+uint32_t txStageHead = 0, txStageTail = 0, txStageUsed = 0;
+
+/* Frames waiting for the TX ring, linked by next_chain, Ethernet header in the first netbuf */
+fnet_netbuf_t *txBacklogHead = 0, *txBacklogTail = 0;
+uint32_t txBacklogLength = 0;
+
+uint32_t sentPacketsBacklogged = 0, sentPacketsDropped = 0;
+#if FNET_CFG_CPU_ETH_ZEROCOPY_TX
+uint32_t sentPacketsZeroCopy = 0;
+#endif
+
+#if FNET_CFG_CPU_ETH_ZEROCOPY_RX
+fnet_lpceth_rx_buffer_t rxBuffers[NUM_OF_RX_FRAGMENTS + NUM_OF_RX_SPARE_BUFFERS];
+/* Buffer currently attached to each RX descriptor */
+fnet_lpceth_rx_buffer_t *rxDescriptorBuffer[NUM_OF_RX_FRAGMENTS];
+/* Spare buffers, not attached to a descriptor nor loaned to the stack */
+fnet_lpceth_rx_buffer_t *rxFreeBuffers = 0;
+uint32_t recvPacketsCopied = 0;
 
-char txDescriptorStatus[NUM_OF_TX_FRAGMENTS];
+static void fnet_lpceth_rx_buffer_free(fnet_netbuf_ext_t *ext);
+#endif
 
 fnet_lpceth_if_t fnet_lpceth0_if;
 
@@ -253,6 +305,9 @@ int fnet_lpceth_init(fnet_netif_t *netif)
 
 	NVIC_EnableIRQ(ENET_IRQn);
 	fnet_isr_vector_init(ENET_IRQn,fnet_lpceth_interrupt_handler_top,fnet_lpceth_interrupt_handler_bottom,0);
+#if FNET_CFG_CPU_ETH_RX_COALESCE
+	fnet_lpceth_rx_poll_init();
+#endif
 
 	return FNET_OK;
 }
@@ -266,16 +321,18 @@ void fnet_lpceth_init_dma() {
 	rxFragmentPtr = (uint8_t *)(LPC_EMAC->RxStatus + sizeof(fnet_lpceth_rx_status) * NUM_OF_RX_FRAGMENTS);
 	LPC_EMAC->TxDescriptor = (uint8_t *) (rxFragmentPtr + LPC_ETH_MAX_FRAME_SIZE*NUM_OF_RX_FRAGMENTS);
 	LPC_EMAC->TxStatus = LPC_EMAC->TxDescriptor + sizeof(fnet_lpceth_tx_descriptor) * NUM_OF_TX_FRAGMENTS;
-    txFragmentPtr = (uint8_t *)(LPC_EMAC->TxStatus + sizeof(fnet_lpceth_tx_status) * NUM_OF_TX_FRAGMENTS);
+    txStagePtr = (uint8_t *)(LPC_EMAC->TxStatus + sizeof(fnet_lpceth_tx_status) * NUM_OF_TX_FRAGMENTS);
     LPC_EMAC->RxDescriptorNumber = NUM_OF_RX_FRAGMENTS - 1;
     LPC_EMAC->TxDescriptorNumber = NUM_OF_TX_FRAGMENTS - 1;
 
     LPC_EMAC->RxConsumeIndex = 0;
     LPC_EMAC->TxProduceIndex = 0;
+    txReclaimIndex = 0;
+    txStageHead = txStageTail = txStageUsed = 0;
 
 
     for(loop=0; loop<NUM_OF_RX_FRAGMENTS; loop++) {
-    	fnet_lpceth_rx_descriptor *rxDesc = (fnet_lpceth_rx_descriptor *) (LPC_EMAC->RxDescriptor + loop*sizeof(fnet_lpceth_rx_descriptor));
+    	fnet_lpceth_rx_descriptor *rxDesc = fnet_lpceth_rx_descriptor_at(loop);
     	rxDesc->controlWord = FNET_LPCETH_RX_DESCRIPTOR_CNTRL_INT_ENABLE | (LPC_ETH_MAX_FRAME_SIZE-1);
     	rxDesc->packetPtr = rxFragmentPtr + loop*LPC_ETH_MAX_FRAME_SIZE;
     	fnet_lpceth_rx_status *rxStatus = (fnet_lpceth_rx_status *) (LPC_EMAC->RxStatus + loop*sizeof(fnet_lpceth_rx_status));
@@ -285,14 +342,28 @@ void fnet_lpceth_init_dma() {
     }
 
     for(loop=0; loop<NUM_OF_TX_FRAGMENTS; loop++) {
-    	fnet_lpceth_tx_descriptor *txDesc = (fnet_lpceth_tx_descriptor * )(LPC_EMAC->TxDescriptor + loop*sizeof(fnet_lpceth_tx_descriptor));
-    	txDesc->packetPtr = txFragmentPtr + loop*LPC_ETH_MAX_FRAME_SIZE;
-    	// No need to touch this at the moment
-    	//fnet_lpceth_tx_status *txStatus = (fnet_lpceth_tx_status *) (LPC_EMAC->TxStatus + loop*sizeof(fnet_lpceth_tx_status));
-    	//txStatus->controlWord = 0;
-    	txDescriptorStatus[loop] = 0;
+    	// Buffer pointers are set up per frame by fnet_lpceth_transmit()
+    	txDescriptorNetbuf[loop] = 0;
+    	txDescriptorStaged[loop] = 0;
     }
 
+#if FNET_CFG_CPU_ETH_ZEROCOPY_RX
+    /* The first buffers back the RX descriptors, the spare ones follow the TX buffers */
+    rxFreeBuffers = 0;
+    for(loop=0; loop<NUM_OF_RX_FRAGMENTS+NUM_OF_RX_SPARE_BUFFERS; loop++) {
+    	fnet_lpceth_rx_buffer_t *buffer = &rxBuffers[loop];
+    	buffer->ext.free = fnet_lpceth_rx_buffer_free;
+    	if (loop < NUM_OF_RX_FRAGMENTS) {
+    		buffer->packetPtr = rxFragmentPtr + loop*LPC_ETH_MAX_FRAME_SIZE;
+    		buffer->next = 0;
+    		rxDescriptorBuffer[loop] = buffer;
+    	} else {
+    		buffer->packetPtr = txStagePtr + FNET_LPCETH_TX_STAGE_SIZE + (loop - NUM_OF_RX_FRAGMENTS)*LPC_ETH_MAX_FRAME_SIZE;
+    		buffer->next = rxFreeBuffers;
+    		rxFreeBuffers = buffer;
+    	}
+    }
+#endif
 }
 
 void fnet_lpceth_release(fnet_netif_t *netif)
@@ -303,55 +374,296 @@ void fnet_lpceth_input(fnet_netif_t *netif)
 {
 }
 
-void fnet_lpceth_output(fnet_netif_t *netif, unsigned short type, const fnet_mac_addr_t dest_addr, fnet_netbuf_t* nb) {
-#if LPC_DEBUG_LEDS
-	led2_on();
+/** Number of TX descriptors the driver may fill before the ring is full.
+ * One descriptor is always left unused so that a full ring can be told
+ * apart from an empty one (TxProduceIndex == TxConsumeIndex).
+ * Descriptors only count as free once fnet_lpceth_tx_reclaim() has released them.
+ */
+static uint32_t fnet_lpceth_tx_free_descriptors(void) {
+	return (txReclaimIndex + NUM_OF_TX_FRAGMENTS - LPC_EMAC->TxProduceIndex - 1) % NUM_OF_TX_FRAGMENTS;
+}
+
+/** Take 'size' contiguous bytes from the TX staging area.
+ * @param consumed set to the number of bytes to give back to fnet_lpceth_tx_stage_release(),
+ * including space skipped at the end of the ring to keep the allocation contiguous.
+ * @return 0 if there is not enough room.
+ */
+static uint8_t *fnet_lpceth_tx_stage_alloc(uint32_t size, uint32_t *consumed) {
+	uint8_t *stage;
+
+	size = (size + 3) & ~3; // keep the copied data word aligned
+	if (txStageUsed == 0) {
+		txStageHead = txStageTail = 0;
+	}
+
+	if ((txStageHead >= txStageTail) && (txStageUsed < FNET_LPCETH_TX_STAGE_SIZE)) {
+		// Free space runs from head to the end, then from the start to tail
+		if (size <= FNET_LPCETH_TX_STAGE_SIZE - txStageHead) {
+			*consumed = size;
+		} else if (size <= txStageTail) {
+			*consumed = FNET_LPCETH_TX_STAGE_SIZE - txStageHead + size;
+			txStageHead = 0;
+		} else {
+			return 0;
+		}
+	} else if (size <= txStageTail - txStageHead) {
+		*consumed = size;
+	} else {
+		return 0;
+	}
+
+	stage = txStagePtr + txStageHead;
+	txStageHead += size;
+	if (txStageHead == FNET_LPCETH_TX_STAGE_SIZE) {
+		txStageHead = 0;
+	}
+	txStageUsed += *consumed;
+	return stage;
+}
+
+static void fnet_lpceth_tx_stage_release(uint32_t consumed) {
+	txStageTail = (txStageTail + consumed) % FNET_LPCETH_TX_STAGE_SIZE;
+	txStageUsed -= consumed;
+}
+
+#if FNET_CFG_CPU_ETH_ZEROCOPY_TX
+/* Whether a fragment goes out on its own descriptor rather than being copied */
+#define fnet_lpceth_tx_fragment_is_direct(nb, zeroCopy) ((zeroCopy) && ((nb)->length >= FNET_CFG_CPU_ETH_ZEROCOPY_TX_MIN) && fnet_lpceth_is_dma_accessible((nb)->data_ptr))
+#else
+#define fnet_lpceth_tx_fragment_is_direct(nb, zeroCopy) (0)
 #endif
-	uint8_t currentIndex = LPC_EMAC->TxProduceIndex;
-	uint8_t nextIndex = currentIndex+1;
 
-	if (nb->total_length == 0) {
-		return;
+/** Work out how a frame maps onto the TX ring.
+ * @param stageSize set to the number of bytes that have to be copied.
+ * @return number of descriptors needed.
+ */
+static uint32_t fnet_lpceth_tx_layout(uint32_t headerSize, fnet_netbuf_t *nb, uint8_t zeroCopy, uint32_t *stageSize) {
+	fnet_netbuf_t *fragment;
+	uint32_t numDescriptors = 0;
+	uint8_t copying = 0;
+
+	*stageSize = headerSize;
+	if (headerSize) {
+		numDescriptors = 1;
+		copying = 1;
+	}
+	for (fragment = nb; fragment != 0; fragment = fragment->next) {
+		if (fragment->length == 0) {
+			continue;
+		}
+		if (fnet_lpceth_tx_fragment_is_direct(fragment, zeroCopy)) {
+			numDescriptors++;
+			copying = 0;
+		} else {
+			if (!copying) {
+				numDescriptors++;
+				copying = 1;
+			}
+			*stageSize += fragment->length;
+		}
+	}
+	return numDescriptors;
+}
+
+/** Place a frame on the TX ring.
+ * 'header' and the netbuf fragments that are copied go to the staging area, consecutive
+ * copied fragments sharing a descriptor. With FNET_CFG_CPU_ETH_ZEROCOPY_TX, large fragments
+ * in AHB SRAM get a descriptor pointing straight at the netbuf data instead, and
+ * TX_DESCRIPTOR_LAST_FRAME is only set on the final descriptor.
+ * On success the driver owns 'nb': it is freed at once if nothing points into it,
+ * otherwise by fnet_lpceth_tx_reclaim() once the EMAC is done with it.
+ * @return FNET_ERR if the ring or the staging area is full, 'nb' is then left untouched.
+ */
+static int fnet_lpceth_transmit(const void *header, uint32_t headerSize, fnet_netbuf_t *nb) {
+	fnet_netbuf_t *fragment;
+	fnet_lpceth_tx_descriptor *descriptor = 0;
+	uint32_t numDescriptors, stageSize, stageConsumed = 0;
+	uint32_t index, lastIndex;
+	uint32_t fill = 0; // bytes copied onto the current descriptor
+	uint8_t *stage = 0;
+	uint8_t zeroCopy = FNET_CFG_CPU_ETH_ZEROCOPY_TX;
+	uint8_t referenced = 0; // some descriptor points into the netbuf
+
+	numDescriptors = fnet_lpceth_tx_layout(headerSize, nb, zeroCopy, &stageSize);
+	if (numDescriptors > NUM_OF_TX_FRAGMENTS - 1) {
+		// Too fragmented to ever fit, send it as a single copy
+		zeroCopy = 0;
+		numDescriptors = fnet_lpceth_tx_layout(headerSize, nb, zeroCopy, &stageSize);
+	}
+	if ((numDescriptors == 0) || (numDescriptors > fnet_lpceth_tx_free_descriptors())) {
+		return FNET_ERR;
+	}
+	if (stageSize) {
+		stage = fnet_lpceth_tx_stage_alloc(stageSize, &stageConsumed);
+		if (stage == 0) {
+			return FNET_ERR;
+		}
+	}
+
+	index = LPC_EMAC->TxProduceIndex;
+	lastIndex = index;
+	if (headerSize) {
+		descriptor = fnet_lpceth_tx_descriptor_at(index);
+		descriptor->packetPtr = stage;
+		fnet_memcpy(stage, header, headerSize);
+		stage += headerSize;
+		fill = headerSize;
+	}
+
+	for (fragment = nb; fragment != 0; fragment = fragment->next) {
+		if (fragment->length == 0) {
+			continue;
+		}
+		if (fnet_lpceth_tx_fragment_is_direct(fragment, zeroCopy)) {
+			if (fill) {
+				// Close the descriptor holding the copied data
+				descriptor->controlWord = fill - 1;
+				index = fnet_lpceth_tx_next_index(index);
+				fill = 0;
+			}
+			descriptor = fnet_lpceth_tx_descriptor_at(index);
+			descriptor->packetPtr = fragment->data_ptr;
+			descriptor->controlWord = fragment->length - 1;
+			lastIndex = index;
+			index = fnet_lpceth_tx_next_index(index);
+			referenced = 1;
+		} else {
+			if (fill == 0) {
+				descriptor = fnet_lpceth_tx_descriptor_at(index);
+				descriptor->packetPtr = stage;
+			}
+			fnet_memcpy(stage, fragment->data_ptr, fragment->length);
+			stage += fragment->length;
+			fill += fragment->length;
+		}
+	}
+	if (fill) {
+		descriptor->controlWord = fill - 1;
+		lastIndex = index;
+		index = fnet_lpceth_tx_next_index(index);
+	}
+
+	descriptor = fnet_lpceth_tx_descriptor_at(lastIndex);
+	descriptor->controlWord |= TX_DESCRIPTOR_LAST_FRAME | FNET_LPCETH_TX_DESCRIPTOR_CNTRL_INT_ENABLE;
+	txDescriptorStaged[lastIndex] = stageConsumed;
+	if (referenced) {
+		txDescriptorNetbuf[lastIndex] = nb;
+#if FNET_CFG_CPU_ETH_ZEROCOPY_TX
+		sentPacketsZeroCopy++;
+#endif
+	} else {
+		txDescriptorNetbuf[lastIndex] = 0;
+		fnet_netbuf_free_chain(nb);
+	}
+
+	LPC_EMAC->TxProduceIndex = index;
+	sentPackets++;
+	return FNET_OK;
+}
+
+/** Release the netbufs and staging space of all frames the EMAC has finished with */
+void fnet_lpceth_tx_reclaim(void) {
+	uint32_t consumeIndex = LPC_EMAC->TxConsumeIndex;
+
+	while (txReclaimIndex != consumeIndex) {
+		if (txDescriptorNetbuf[txReclaimIndex] != 0) {
+			fnet_netbuf_free_chain(txDescriptorNetbuf[txReclaimIndex]);
+			txDescriptorNetbuf[txReclaimIndex] = 0;
+		}
+		if (txDescriptorStaged[txReclaimIndex] != 0) {
+			fnet_lpceth_tx_stage_release(txDescriptorStaged[txReclaimIndex]);
+			txDescriptorStaged[txReclaimIndex] = 0;
+		}
+		txReclaimIndex = fnet_lpceth_tx_next_index(txReclaimIndex);
+	}
+}
+
+/** Move backlogged frames onto the TX ring, in order, for as long as they fit */
+static void fnet_lpceth_tx_drain_backlog(void) {
+	fnet_netbuf_t *frame, *nextFrame;
+
+	while ((frame = txBacklogHead) != 0) {
+		nextFrame = frame->next_chain;
+		frame->next_chain = 0;
+		if (fnet_lpceth_transmit(0, 0, frame) == FNET_ERR) {
+			frame->next_chain = nextFrame;
+			break;
+		}
+		txBacklogHead = nextFrame;
+		txBacklogLength--;
 	}
-	if (usedTxDescr == (NUM_OF_TX_FRAGMENTS)) {
-			fnet_println("Out of TX descriptors!");
-			return; // memory full
+	if (txBacklogHead == 0) {
+		txBacklogTail = 0;
 	}
+}
 
-	//led2_on();
-	if (nextIndex > LPC_EMAC->TxDescriptorNumber) {
-		nextIndex = 0; // loop around once we reach the maximum number of descriptors
+/** Queue a frame that does not fit on the TX ring.
+ * If 'header' is given, it is prepended to the payload first, in the headroom if there is enough.
+ */
+static void fnet_lpceth_tx_backlog(fnet_eth_header_t *header, fnet_netbuf_t *nb) {
+	fnet_netbuf_t *frame = 0;
+
+	if (txBacklogLength < FNET_CFG_CPU_ETH_TX_BACKLOG_MAX) {
+		if (header != 0) {
+			frame = fnet_netbuf_push(nb, sizeof(fnet_eth_header_t), FNET_FALSE);
+			if (frame != 0) {
+				fnet_memcpy(frame->data_ptr, header, sizeof(fnet_eth_header_t));
+			}
+		} else {
+			frame = nb;
+		}
+	}
+	if (frame == 0) {
+		sentPacketsDropped++;
+		fnet_netbuf_free_chain(nb);
+		return;
 	}
 
-	if (txDescriptorStatus[currentIndex]) {
-		fnet_println("TX Descriptor %d busy",currentIndex);
+	if (txBacklogTail != 0) {
+		txBacklogTail->next_chain = frame;
+	} else {
+		txBacklogHead = frame;
 	}
-	txDescriptorStatus[currentIndex] = 1;
-	//fnet_printf("td:%d\n",LPC_EMAC->TxProduceIndex);
-	fnet_lpceth_tx_descriptor *descriptor = (fnet_lpceth_tx_descriptor *)(LPC_EMAC->TxDescriptor + currentIndex*sizeof(fnet_lpceth_tx_descriptor));
-	fnet_lpceth_tx_status *status = (fnet_lpceth_tx_status *)(LPC_EMAC->TxStatus + currentIndex*sizeof(fnet_lpceth_tx_status));
-	fnet_memset(descriptor->packetPtr,0,1536);
-	/* Construct the ethernet header directly onto the TX packet buffer */
-	fnet_eth_header_t *ethHeader = (fnet_eth_header_t *)descriptor->packetPtr;
+	txBacklogTail = frame;
+	txBacklogLength++;
+	sentPacketsBacklogged++;
+}
+
+static void fnet_lpceth_build_header(fnet_netif_t *netif, unsigned short type, const fnet_mac_addr_t dest_addr, fnet_eth_header_t *ethHeader) {
 	fnet_memcpy (ethHeader->destination_addr, dest_addr, sizeof(fnet_mac_addr_t));
 	fnet_lpceth_get_hw_addr(netif, ethHeader->source_addr);
 
 	ethHeader->type=fnet_htons(type);
+}
 
-	void *packetData = descriptor->packetPtr + FNET_ETH_HDR_SIZE;
-	fnet_netbuf_to_buf(nb, 0, FNET_NETBUF_COPYALL, packetData);
-
-	uint16_t frameSize = nb->total_length + FNET_ETH_HDR_SIZE;
+void fnet_lpceth_output(fnet_netif_t *netif, unsigned short type, const fnet_mac_addr_t dest_addr, fnet_netbuf_t* nb) {
+#if LPC_DEBUG_LEDS
+	led2_on();
+#endif
+	fnet_eth_header_t ethHeader;
+	fnet_eth_header_t *header = &ethHeader;
+	uint32_t headerSize = sizeof(ethHeader);
 
-	//descriptor->controlWord &= ~TX_DESCRIPTOR_SIZE_BITS;
-	descriptor->controlWord = (frameSize-1) | TX_DESCRIPTOR_LAST_FRAME | FNET_LPCETH_TX_DESCRIPTOR_CNTRL_INT_ENABLE ; // don't override any defaults
+	if ((nb->total_length == 0) || (nb->total_length > netif->mtu)) {
+		fnet_netbuf_free_chain(nb);
+		return;
+	}
+	if (fnet_netbuf_headroom(nb) >= (int)sizeof(fnet_eth_header_t)) {
+		// Build the header in front of the payload, it then travels with the frame
+		nb = fnet_netbuf_push(nb, sizeof(fnet_eth_header_t), FNET_FALSE);
+		fnet_lpceth_build_header(netif, type, dest_addr, (fnet_eth_header_t *)nb->data_ptr);
+		header = 0;
+		headerSize = 0;
+	} else {
+		fnet_lpceth_build_header(netif, type, dest_addr, &ethHeader);
+	}
 
-	LPC_EMAC->TxProduceIndex = nextIndex;
-	usedTxDescr++;
-	sentPackets++;
-	//transmitLock = 0;
-	fnet_netbuf_free_chain(nb);
-	txDescriptorStatus[currentIndex] = 0;
+	fnet_lpceth_tx_reclaim();
+	fnet_lpceth_tx_drain_backlog();
+	/* Frames must leave in order, so anything behind a backlog joins it */
+	if ((txBacklogHead != 0) || (fnet_lpceth_transmit(header, headerSize, nb) == FNET_ERR)) {
+		fnet_lpceth_tx_backlog(header, nb);
+	}
 #if LPC_DEBUG_LEDS
 	led2_off();
 #endif
@@ -379,6 +691,15 @@ int fnet_lpceth_get_statistics(struct fnet_netif *netif, struct fnet_netif_stati
 {
 	statistics->tx_packet = sentPackets;
 	statistics->rx_packet = recvPackets;
+#if FNET_CFG_CPU_ETH_ZEROCOPY_RX
+	statistics->rx_copied = recvPacketsCopied;
+#endif
+	statistics->rx_interrupts = recvInterrupts;
+	statistics->rx_polls = recvPolls;
+	statistics->rx_batch_max = recvBatchMax;
+#if FNET_CFG_CPU_ETH_RX_COALESCE
+	statistics->rx_poll_mode = recvPollModeEntries;
+#endif
 	return FNET_OK;
 }
 int fnet_lpceth_is_connected(fnet_netif_t *netif) {
@@ -395,10 +716,8 @@ void fnet_lpceth_interrupt_handler_top() {
 		LPC_EMAC->IntClear = 0x2;
 	} */
 	if ((LPC_EMAC->IntStatus & ETH_INTSTATUS_RX_DONE) == ETH_INTSTATUS_RX_DONE) {
-		//mask_ethernet_interrupt(ETH_INTSTATUS_RX_DONE);
-		//LPC_EMAC->IntClear = ETH_INTSTATUS_RX_DONE;
-		recvPacketsWaiting++;
-		//unmask_ethernet_interrupt(ETH_INTSTATUS_RX_DONE);
+		/* The bottom half drains the whole ring, several RxDone events may be merged into one call */
+		recvInterrupts++;
 	}
 	 if ((LPC_EMAC->IntStatus & ETH_INTSTATUS_RX_OVERRUN) == ETH_INTSTATUS_RX_OVERRUN) {
 		//LPC_EMAC->IntClear = ETH_INTSTATUS_RX_OVERRUN;
@@ -408,33 +727,60 @@ void fnet_lpceth_interrupt_handler_top() {
 		//LPC_EMAC->IntClear = ETH_INTSTATUS_TX_UNDERRUN;
 		fnet_printf("TxUnderrun!\n");
 	}
-	if ((LPC_EMAC->IntStatus & ETH_INTSTATUS_TX_DONE) == ETH_INTSTATUS_TX_DONE) {
-		usedTxDescr--;
-		if (usedTxDescr == 255) {
-			usedTxDescr = 0; // assume a screw up
-		}
-		//led2_off();
-		//LPC_EMAC->IntClear = ETH_INTSTATUS_TX_DONE;
-	}
+	/* TX_DONE needs no work here, sent descriptors are reclaimed from TxConsumeIndex */
 	clear_ethernet_interrupts();
 
 }
-void fnet_lpceth_interrupt_handler_bottom() {
-	while (recvPacketsWaiting > 0) {
-		//uint8_t x;
-		//while(processingRxPacket) {
-		//	x++;
-		//}
-		//processingRxPacket = 1;
-		if (LPC_EMAC->RxConsumeIndex == LPC_EMAC->RxProduceIndex) {
-			return; // buffer is full
-		}
+#if FNET_CFG_CPU_ETH_ZEROCOPY_RX
+/** Return a loaned RX buffer to the spare pool, once the stack has freed all netbufs using it */
+static void fnet_lpceth_rx_buffer_free(fnet_netbuf_ext_t *ext) {
+	fnet_lpceth_rx_buffer_t *buffer = (fnet_lpceth_rx_buffer_t *)ext;
+
+	fnet_isr_lock();
+	buffer->next = rxFreeBuffers;
+	rxFreeBuffers = buffer;
+	fnet_isr_unlock();
+}
+
+/** Wrap the frame held by RX descriptor 'index' in a netbuf without copying it.
+ * The descriptor gets a spare buffer in exchange. If no spare is left (the stack
+ * is holding on to all of them) the frame is copied instead, so the ring never
+ * runs dry.
+ */
+static fnet_netbuf_t *fnet_lpceth_rx_loan(uint32_t index, void *data, uint16_t size) {
+	fnet_lpceth_rx_buffer_t *spare = rxFreeBuffers;
+	fnet_lpceth_rx_descriptor *rxDescriptor;
+	fnet_netbuf_t *nb;
+
+	if (spare == 0) {
+		recvPacketsCopied++;
+		return fnet_netbuf_from_buf(data,size,FNET_TRUE);
+	}
+
+	nb = fnet_netbuf_from_ext(&rxDescriptorBuffer[index]->ext, data, size, FNET_TRUE);
+	if (nb != 0) {
+		rxFreeBuffers = spare->next;
+		rxDescriptorBuffer[index] = spare;
+		rxDescriptor = fnet_lpceth_rx_descriptor_at(index);
+		rxDescriptor->packetPtr = spare->packetPtr;
+	}
+	return nb;
+}
+#endif
+
+/** Pass every received frame between RxConsumeIndex and RxProduceIndex to the stack.
+ * Returns the number of frames processed.
+ */
+static uint32_t fnet_lpceth_rx_drain(void) {
+	uint32_t batch = 0;
+
+	while (LPC_EMAC->RxConsumeIndex != LPC_EMAC->RxProduceIndex) {
 #if LPC_DEBUG_LEDS
 		led1_on();
 #endif
 		fnet_netbuf_t *nb;
 		fnet_eth_header_t *ethheader;
-		fnet_lpceth_rx_descriptor *rxDescriptor = (fnet_lpceth_rx_descriptor *)(LPC_EMAC->RxDescriptor + LPC_EMAC->RxConsumeIndex*sizeof(fnet_lpceth_rx_descriptor));
+		fnet_lpceth_rx_descriptor *rxDescriptor = fnet_lpceth_rx_descriptor_at(LPC_EMAC->RxConsumeIndex);
 		fnet_lpceth_rx_status *rxStatus = (fnet_lpceth_rx_status *)(LPC_EMAC->RxStatus + LPC_EMAC->RxConsumeIndex*sizeof(fnet_lpceth_rx_status));
 		uint16_t pktSize = (rxStatus->statusInfo & RX_STATUS_SIZE_BITS) -1;
 
@@ -448,9 +794,13 @@ void fnet_lpceth_interrupt_handler_bottom() {
 		void *layer3Ptr = rxDescriptor->packetPtr + sizeof(fnet_eth_header_t);
 		uint16_t sizeOfLayer3 = pktSize - sizeof(fnet_eth_header_t);
 
+#if FNET_CFG_CPU_ETH_ZEROCOPY_RX
+		nb = fnet_lpceth_rx_loan(LPC_EMAC->RxConsumeIndex, layer3Ptr, sizeOfLayer3);
+#else
 		nb = fnet_netbuf_from_buf(layer3Ptr,sizeOfLayer3,FNET_TRUE);
+#endif
 		if (nb != 0) {
-			fnet_eth_prot_input(&fnet_eth0_if,nb,ethheader->type);
+			fnet_eth_prot_input(&fnet_eth0_if,nb,ethheader->type,ethheader->source_addr);
 			recvPackets++;
 		}
 		// Reset the status and descriptor
@@ -466,12 +816,114 @@ void fnet_lpceth_interrupt_handler_bottom() {
 		} else {
 			LPC_EMAC->RxConsumeIndex = nextDescriptor;
 		}
-		//processingRxPacket = 0;
-		recvPacketsWaiting--;
+		batch++;
 #if LPC_DEBUG_LEDS
 		led1_off();
 #endif
 	}
+
+	if (batch > recvBatchMax) {
+		recvBatchMax = batch;
+	}
+#if FNET_CFG_CPU_ETH_RX_COALESCE
+	rxFramesSincePoll += batch;
+#endif
+	return batch;
+}
+
+#if FNET_CFG_CPU_ETH_RX_COALESCE
+/** Set the interrupt bit on every 'spacing'-th RX descriptor and clear it on the others.
+ * A descriptor the EMAC is filling may still use the old setting, which only
+ * moves its frame to the next interrupt or poll.
+ */
+static void fnet_lpceth_rx_set_interrupt_spacing(uint32_t spacing) {
+	uint32_t index;
+
+	for (index = 0; index < NUM_OF_RX_FRAGMENTS; index++) {
+		fnet_lpceth_rx_descriptor *rxDescriptor = fnet_lpceth_rx_descriptor_at(index);
+		if ((index % spacing) == (spacing - 1)) {
+			rxDescriptor->controlWord |= FNET_LPCETH_RX_DESCRIPTOR_CNTRL_INT_ENABLE;
+		} else {
+			rxDescriptor->controlWord &= ~FNET_LPCETH_RX_DESCRIPTOR_CNTRL_INT_ENABLE;
+		}
+	}
+}
+
+static void fnet_lpceth_rx_poll_init(void) {
+	/* Integer maths, PCLK is CCLK/4 */
+	uint32_t counts = (SystemCoreClock / 4 / 1000) * FNET_CFG_CPU_ETH_RX_POLL_PERIOD_US / 1000;
+
+	rxPollMode = 0;
+	rxFramesSincePoll = 0;
+	enable_timer3_power();
+	timer3_set_pclk4();
+	timer3_counter_reset();
+	timer3_set_timer_mode();
+	timer3_interrupt_reset_match();
+	timer3_set_interval0(counts);
+	NVIC_EnableIRQ(TIMER3_IRQn);
+	fnet_isr_vector_init(TIMER3_IRQn,fnet_lpceth_rx_poll_top,fnet_lpceth_rx_poll_bottom,0);
+}
+
+/** Heavy traffic: only interrupt every FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES frames
+ * and pick up the others from the poll timer.
+ */
+static void fnet_lpceth_rx_poll_start(void) {
+	rxPollMode = 1;
+	rxFramesSincePoll = 0;
+	recvPollModeEntries++;
+	fnet_lpceth_rx_set_interrupt_spacing(FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES);
+	timer3_counter_reset();
+	timer3_set_enable();
+}
+
+static void fnet_lpceth_rx_poll_stop(void) {
+	timer3_set_disable();
+	timer3_clear_match0();
+	fnet_lpceth_rx_set_interrupt_spacing(1);
+	rxPollMode = 0;
+	/* Frames received with the interrupt bit cleared raised no RxDone */
+	fnet_lpceth_rx_drain();
+}
+
+static void fnet_lpceth_rx_poll_top(void) {
+	timer3_clear_match0();
+	recvPolls++;
+}
+
+static void fnet_lpceth_rx_poll_bottom(void) {
+	if (!rxPollMode) {
+		return; // tick pended before polling stopped
+	}
+	/* TX_DONE raises no work of its own, free sent frames while here */
+	fnet_lpceth_tx_reclaim();
+	fnet_lpceth_tx_drain_backlog();
+	fnet_lpceth_rx_drain();
+	if (rxFramesSincePoll < FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD) {
+		fnet_lpceth_rx_poll_stop();
+	}
+	rxFramesSincePoll = 0;
+}
+
+void TIMER3_IRQHandler(void) {
+	fnet_isr_handler(TIMER3_IRQn);
+}
+#endif
+
+void fnet_lpceth_interrupt_handler_bottom() {
+	uint32_t batch;
+
+	/* Netbufs can only be freed here, the top half may have interrupted the allocator */
+	fnet_lpceth_tx_reclaim();
+	fnet_lpceth_tx_drain_backlog();
+	batch = fnet_lpceth_rx_drain();
+#if FNET_CFG_CPU_ETH_RX_COALESCE
+	if (!rxPollMode && (batch >= FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD)) {
+		fnet_lpceth_rx_poll_start();
+	}
+#else
+	(void)batch;
+#endif
 }
 /*
  * This acts as the receive handler, trigged by an interrupt on reception of an Ethernet frame
@@ -481,26 +933,12 @@ void ENET_IRQHandler(void) {
 }
 
 uint8_t fnet_lpceth_transmit_packet(uint8_t *packet, uint16_t size) {
-	uint8_t currentIndex = LPC_EMAC->TxProduceIndex;
-	uint8_t nextIndex = currentIndex+1;
 	if (size == 0)
 		return 0;
-	//if (LPC_EMAC->TxProduceIndex == LPC_EMAC->TxConsumeIndex) {
-	//	return 0; // memory full
-	//}
-	if (nextIndex > LPC_EMAC->TxDescriptorNumber) {
-		nextIndex = 0; // loop around once we reach the maximum number of descriptors
-	}
-
-	// Copy the packet to the reserved memory location
-	fnet_lpceth_tx_descriptor *descriptor = (fnet_lpceth_tx_descriptor *)(LPC_EMAC->TxDescriptor + currentIndex*sizeof(fnet_lpceth_tx_descriptor));
-	fnet_memcpy(descriptor->packetPtr,packet,size);
-	descriptor->controlWord &= ~TX_DESCRIPTOR_SIZE_BITS;
-	descriptor->controlWord = (size-1) | TX_DESCRIPTOR_LAST_FRAME; // don't override any defaults
-
-	LPC_EMAC->TxProduceIndex = nextIndex;
 
-	return 1;
+	// Copy the packet to the staging area
+	fnet_lpceth_tx_reclaim();
+	return (fnet_lpceth_transmit(packet, size, 0) == FNET_OK);
 }
 
 uint32_t fnet_lpceth_read_packet(void *buffer) {
@@ -222,13 +222,52 @@ typedef struct
 
 } fnet_lpceth_if_t;
 
-/** Set up TX and RX DMA memory space */
+/** Set up TX and RX DMA memory space
+ * The block holds, in order: RX descriptors, RX statuses, RX buffers,
+ * TX descriptors, TX statuses, the TX staging area and the spare RX buffers.
+ * The TX side is sized by the configuration, the RX ring gets whatever is left.
+ */
+#define FNET_LPCETH_DMA_BLOCK_START 0x2007C000 // AHB Block 1 on the LPC
+#define FNET_LPCETH_DMA_BLOCK_LEN 0x4000 // 16k
 
-#define NUM_OF_RX_FRAGMENTS 4
-#define NUM_OF_TX_FRAGMENTS 3
+#define FNET_LPCETH_RX_SLOT_SIZE (8 + 8 + LPC_ETH_MAX_FRAME_SIZE) // descriptor, status, buffer
+#define FNET_LPCETH_TX_SLOT_SIZE (8 + 4) // descriptor, status
 
-#define FNET_LPCETH_DMA_BLOCK_START 0x2007C000 // AHB Block 1 on the LPC
-#define FNET_LPCETH_DMA_BLOCK_LEN 0x3FFF // 16k
+/* Copied part of queued frames: headers, small fragments, whole frames when not zero-copy */
+#define FNET_LPCETH_TX_STAGE_SIZE (FNET_CFG_CPU_ETH_TX_BUFS_MAX * LPC_ETH_MAX_FRAME_SIZE)
+
+#if FNET_CFG_CPU_ETH_ZEROCOPY_RX
+#define NUM_OF_RX_SPARE_BUFFERS FNET_CFG_CPU_ETH_RX_SPARE_BUFS
+#else
+#define NUM_OF_RX_SPARE_BUFFERS 0
+#endif
+
+#define NUM_OF_TX_FRAGMENTS FNET_CFG_CPU_ETH_TX_DESCRIPTORS
+#define FNET_LPCETH_DMA_TX_SIZE (NUM_OF_TX_FRAGMENTS * FNET_LPCETH_TX_SLOT_SIZE + FNET_LPCETH_TX_STAGE_SIZE)
+#define FNET_LPCETH_DMA_SPARE_SIZE (NUM_OF_RX_SPARE_BUFFERS * LPC_ETH_MAX_FRAME_SIZE)
+#define NUM_OF_RX_FRAGMENTS ((FNET_LPCETH_DMA_BLOCK_LEN - FNET_LPCETH_DMA_TX_SIZE - FNET_LPCETH_DMA_SPARE_SIZE) / FNET_LPCETH_RX_SLOT_SIZE)
+
+#if (FNET_LPCETH_DMA_TX_SIZE + FNET_LPCETH_DMA_SPARE_SIZE) > FNET_LPCETH_DMA_BLOCK_LEN - 2 * FNET_LPCETH_RX_SLOT_SIZE
+	#error "EMAC TX ring and spare buffers leave less than two RX descriptors in the DMA block"
+#endif
+#if NUM_OF_TX_FRAGMENTS < 2
+	#error "FNET_CFG_CPU_ETH_TX_DESCRIPTORS must be at least 2"
+#endif
+#if FNET_CFG_CPU_ETH_TX_BUFS_MAX < 1
+	#error "FNET_CFG_CPU_ETH_TX_BUFS_MAX must be at least 1"
+#endif
+#if FNET_CFG_CPU_ETH_RX_COALESCE && ((FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES < 1) || (FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES >= NUM_OF_RX_FRAGMENTS))
+	#error "FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES must be less than the number of RX descriptors"
+#endif
+
+/* The EMAC DMA engine can only reach the two AHB SRAM banks */
+#define FNET_LPCETH_AHB_SRAM_START 0x2007C000
+#define FNET_LPCETH_AHB_SRAM_END 0x20084000
+#define fnet_lpceth_is_dma_accessible(ptr) (((uint32_t)(ptr) >= FNET_LPCETH_AHB_SRAM_START) && ((uint32_t)(ptr) < FNET_LPCETH_AHB_SRAM_END))
+
+#if defined(FNET_CFG_CPU_HEAP_ADDR) && ((FNET_CFG_CPU_HEAP_ADDR + FNET_CFG_HEAP_SIZE) > FNET_LPCETH_AHB_SRAM_END)
+	#error "FNET_CFG_HEAP_SIZE does not fit in AHB SRAM at FNET_CFG_CPU_HEAP_ADDR"
+#endif
 
 FNET_COMP_PACKED_BEGIN;
 typedef struct {
@@ -248,6 +287,19 @@ typedef fnet_lpceth_rx_descriptor fnet_lpceth_tx_descriptor;
 typedef struct {
 	uint32_t statusInfo;
 } fnet_lpceth_tx_status;
+
+#if FNET_CFG_CPU_ETH_ZEROCOPY_RX
+/* RX DMA buffer, either attached to a descriptor, on loan to the stack or free */
+typedef struct fnet_lpceth_rx_buffer {
+	fnet_netbuf_ext_t ext; /* Must be first */
+	uint8_t *packetPtr;
+	struct fnet_lpceth_rx_buffer *next; /* Next free buffer */
+} fnet_lpceth_rx_buffer_t;
+#endif
+
+#define fnet_lpceth_rx_descriptor_at(index) ((fnet_lpceth_rx_descriptor *)(LPC_EMAC->RxDescriptor + (index)*sizeof(fnet_lpceth_rx_descriptor)))
+#define fnet_lpceth_tx_descriptor_at(index) ((fnet_lpceth_tx_descriptor *)(LPC_EMAC->TxDescriptor + (index)*sizeof(fnet_lpceth_tx_descriptor)))
+#define fnet_lpceth_tx_next_index(index) (((index) >= (NUM_OF_TX_FRAGMENTS - 1)) ? 0 : ((index)+1))
 int fnet_lpceth_init(fnet_netif_t *netif);
 
 void fnet_lpceth_release(fnet_netif_t *netif);
@@ -261,6 +313,7 @@ int fnet_lpceth_get_statistics(struct fnet_netif *netif, struct fnet_netif_stati
 int fnet_lpceth_is_connected(fnet_netif_t *netif);
 void fnet_lpceth_init_dma(void);
 uint8_t fnet_lpceth_transmit_packet(uint8_t *packet, uint16_t size);
+void fnet_lpceth_tx_reclaim(void);
 uint32_t fnet_lpceth_read_packet(void *buffer);
 #define TX_DESCRIPTOR_LAST_FRAME (1<<30)
 #define TX_DESCRIPTOR_SIZE_BITS 0x7FF
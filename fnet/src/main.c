@@ -131,11 +131,10 @@ int main(void) {
 #if FNET_CFG_HTTP
 	init_http();
 #endif
-	// Enter an infinite loop, just incrementing a counter
-	volatile static int x;
+	// Run the ready services, sleep until an interrupt when all of them wait
 	while(1) {
 		fnet_poll_services();
-		x++;
+		fnet_poll_services_idle();
 	}
 	return 0 ;
 }
@@ -88,6 +88,7 @@
 #define FNET_DHCP_STATE_RENEWING_SEND_TIMEOUT       (60*1000)                                   /*(ms) timeout for ACK => request retransmission.*/
 #define FNET_DHCP_STATE_REBINDING_SEND_TIMEOUT      (60*1000)                                   /*(ms) timeout for ACK => request retransmission.*/
 #define FNET_DHCP_STATE_SELECTING_SEND_TIMEOUT      (FNET_CFG_DHCP_RESPONSE_TIMEOUT*1000)     /*(ms) timeout for OFFER => INIT.*/
+#define FNET_DHCP_BOUND_CHECK_TICKS                 (1000/FNET_TIMER_PERIOD_MS)                 /*(ticks) period of the interface parameters check in BOUND state.*/
 
 #define FNET_DHCP_ERR_SOCKET_CREATION   "ERROR: Socket creation error."
 #define FNET_DHCP_ERR_SOCKET_BIND       "ERROR: Socket Error during bind."
@@ -1077,6 +1078,18 @@ static void fnet_dhcp_state_machine( void *fnet_dhcp_if_p )
               {
                   fnet_dhcp_change_state(dhcp, dhcp->state_timeout_next_state); /* => INIT */
               }
+              else
+              {
+                  /* Sleep until T1 or an input message. 
+                   * Wake up periodically to check the interface parameters.*/
+                  unsigned long timeout = dhcp->state_timeout - fnet_timer_get_interval(dhcp->lease_obtained_time, fnet_timer_ticks());
+                  
+                  if(timeout > FNET_DHCP_BOUND_CHECK_TICKS)
+                      timeout = FNET_DHCP_BOUND_CHECK_TICKS;
+                  
+                  fnet_poll_service_wait_socket(dhcp->service_descriptor, dhcp->socket_client, FNET_POLLIN);
+                  fnet_poll_service_wait_timeout(dhcp->service_descriptor, timeout);
+              }
           }
           else
           {
@@ -161,6 +161,7 @@ static void fnet_http_state_machine( void *http_if_p );
     static void fnet_http_version_parse(char * in_str, struct fnet_http_version * version);
     static int fnet_http_tx_status_line (struct fnet_http_if * http);
     static int fnet_http_status_ok(int status);
+    static void fnet_http_rx_shift(struct fnet_http_if * http, unsigned long offset);
 #endif /* FNET_CFG_HTTP_VERSION_MAJOR */
 
 /************************************************************************
@@ -176,6 +177,9 @@ static void fnet_http_state_machine( void *http_if_p )
     struct fnet_http_if *http = (struct fnet_http_if *)http_if_p;
     int iteration;
     char *ch;
+#if FNET_CFG_HTTP_VERSION_MAJOR /* HTTP/1.x*/
+    unsigned long rx_next;
+#endif
 
     for(iteration = 0; iteration < FNET_HTTP_ITERATION_NUMBER; iteration++)
     {
@@ -219,25 +223,40 @@ static void fnet_http_state_machine( void *http_if_p )
                 
                 do
                 {
-                    /* Read character by character.*/
-                    ch = &http->buffer[http->buffer_actual_size];
+                    /* Read all available data, when the buffered data has no whole line.*/
+                    if(http->request.rx_checked_size < http->buffer_actual_size)
+                    {
+                        res = (int)(http->buffer_actual_size - http->request.rx_checked_size);
+                    }
+                    else if((res = recv(http->socket_foreign, &http->buffer[http->buffer_actual_size], 
+                                        (int)(FNET_HTTP_BUF_SIZE - http->buffer_actual_size), 0)) > 0)
+                    {
+                        http->state_time = fnet_timer_ticks();  /* Reset timeout.*/
+                        http->buffer_actual_size += res;
+                    }
                     
-                    if((res = recv(http->socket_foreign, ch, 1, 0) )!= SOCKET_ERROR)
+                    if(res != SOCKET_ERROR)
                     {
                         if(res > 0) /* Received a data.*/
                         {
-                            http->state_time = fnet_timer_ticks();  /* Reset timeout.*/
+                            /* Look for the end of the line.*/
+                            for(ch = &http->buffer[http->request.rx_checked_size]; (ch < &http->buffer[http->buffer_actual_size]) && (*ch != '\n'); ch++)
+                            {
+                                if(*ch == '\r')
+                                    *ch = '\0';
+                            }
                             
-                            http->buffer_actual_size ++;
+                            http->request.rx_checked_size = (unsigned long)(ch - &http->buffer[0]);
                         
-                            if(*ch == '\r')
-                                *ch = '\0';
-                            else if(*ch == '\n')
+                            if(http->request.rx_checked_size < http->buffer_actual_size)
                             /* Line received.*/
                             {
                                 char * req_buf = &http->buffer[0];
 
                                 *ch = '\0'; 
+    #if FNET_CFG_HTTP_VERSION_MAJOR /* HTTP/1.x*/                                
+                                rx_next = http->request.rx_checked_size + 1; /* Start of the next line or of the Entity-Body.*/
+    #endif
                                 
                                 if(http->request.method == 0)
                                 /* Parse Request line.*/
@@ -301,7 +320,7 @@ static void fnet_http_state_machine( void *http_if_p )
                                            
                                         {
     #if FNET_CFG_HTTP_VERSION_MAJOR /* HTTP/1.x*/
-                                            http->buffer_actual_size = 0;
+                                            fnet_http_rx_shift(http, rx_next);
                                                 /* => Parse Header line.*/ 
     #else /* HTTP/0.9 */
                     			            http->response.tx_data = http->request.method->send;
@@ -362,7 +381,13 @@ static void fnet_http_state_machine( void *http_if_p )
                                             if(http->request.content_length > 0)
                                             /* RX Entity-Body.*/
                                             {
-                                                http->buffer_actual_size = 0;
+                                                /* The data following the header is the beginning of the Entity-Body.*/
+                                                fnet_http_rx_shift(http, rx_next);
+                                                
+                                                if(http->buffer_actual_size > (unsigned long)http->request.content_length)
+                                                    http->buffer_actual_size = (unsigned long)http->request.content_length; /* Ignore pipelined data.*/
+                                                
+                                                http->request.content_length -= http->buffer_actual_size;
                                                 http->state = FNET_HTTP_STATE_RX; 
                                             }
                                             else
@@ -411,7 +436,7 @@ static void fnet_http_state_machine( void *http_if_p )
                                     else
                                         http->request.skip_line = 0; /* Reset the Skip flag.*/
                                     
-                                    http->buffer_actual_size = 0; /* => Parse Next Header line.*/ 
+                                    fnet_http_rx_shift(http, rx_next); /* => Parse Next Header line.*/ 
                                 }
     #endif/* FNET_CFG_HTTP_VERSION_MAJOR */                            
                             }
@@ -426,6 +451,7 @@ static void fnet_http_state_machine( void *http_if_p )
                                     /* Skip line.*/
                                     http->request.skip_line = 1;
                                     http->buffer_actual_size = 0;
+                                    http->request.rx_checked_size = 0;
                                 }
                                 else /* Error.*/
                                 {
@@ -458,13 +484,18 @@ static void fnet_http_state_machine( void *http_if_p )
     #if FNET_CFG_HTTP_POST
             /*---- RX --------------------------------------------------*/
             case FNET_HTTP_STATE_RX: /* Receive data (Entity-Body). */
-                if((res = recv(http->socket_foreign, &http->buffer[http->buffer_actual_size], (int)(FNET_HTTP_BUF_SIZE-http->buffer_actual_size), 0) )!= SOCKET_ERROR)
+                /* Do not read past the Entity-Body.*/
+                len = (int)(FNET_HTTP_BUF_SIZE-http->buffer_actual_size);
+                if(len > http->request.content_length)
+                    len = (int)http->request.content_length;
+                
+                if((res = ((len > 0) ? recv(http->socket_foreign, &http->buffer[http->buffer_actual_size], len, 0) : 0)) != SOCKET_ERROR)
                 {
                     http->buffer_actual_size += res;
                     http->request.content_length -= res;
                     
-                    if(res > 0)
-                    /* Some Data.*/
+                    if(http->buffer_actual_size > 0)
+                    /* Some Data (received or left after the request header).*/
                     {
                         http->state_time = fnet_timer_ticks();  /* Reset timeout.*/
                         
@@ -563,6 +594,10 @@ static void fnet_http_state_machine( void *http_if_p )
                 break;                
         }
     }
+    
+    /* No session, sleep until a new connection.*/
+    if(http->state == FNET_HTTP_STATE_LISTENING)
+        fnet_poll_service_wait_socket(http->service_descriptor, http->socket_listen, FNET_POLLIN);
 }
 
 /************************************************************************
@@ -1156,6 +1191,30 @@ EXIT:
     return;  
 }
 
+/************************************************************************
+* NAME: fnet_http_rx_shift
+*
+* DESCRIPTION: Moves the buffered data, following the parsed line, 
+*              to the beginning of the buffer.
+************************************************************************/
+static void fnet_http_rx_shift(struct fnet_http_if * http, unsigned long offset)
+{
+    unsigned long i;
+    
+    if(offset < http->buffer_actual_size)
+    {
+        /* The areas overlap, so copy forward byte by byte.*/
+        for(i = 0; offset < http->buffer_actual_size; i++, offset++)
+            http->buffer[i] = http->buffer[offset];
+        
+        http->buffer_actual_size = i;
+    }
+    else
+        http->buffer_actual_size = 0;
+        
+    http->request.rx_checked_size = 0;    
+}
+
 /************************************************************************
 * NAME: fnet_http_status_ok
 *
@@ -145,8 +145,10 @@ static int fnet_http_post_send(struct fnet_http_if * http)
     const struct fnet_http_post *post_ptr = (const struct fnet_http_post *) http->send_param.data_ptr;
     
     if(post_ptr && post_ptr->send)
-        if(post_ptr->send(http->buffer, sizeof(http->buffer), &http->response.send_eof, &http->response.cookie) > 0)
-                result = FNET_OK;
+    {
+        if((http->buffer_actual_size = post_ptr->send(http->buffer, sizeof(http->buffer), &http->response.send_eof, &http->response.cookie)) > 0)
+            result = FNET_OK;
+    }
         
     return result;
 }
@@ -176,7 +176,8 @@ struct fnet_http_request
     long content_length;
 #if FNET_CFG_HTTP_VERSION_MAJOR /* HTTP/1.x*/ 
     int skip_line; 
-#endif           
+#endif
+    unsigned long rx_checked_size;  /* Size of the buffered data, checked for the end of line.*/           
 };
 
 /************************************************************************
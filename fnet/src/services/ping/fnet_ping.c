@@ -69,6 +69,7 @@
  
 
 #define FNET_PING_BUFFER_SIZE   (sizeof(fnet_icmp_echo_header_t) + FNET_CFG_PING_PACKET_MAX)
+#define FNET_PING_TIMEOUT_MAX   (0x7FFFFFFFUL)  /* Maximal timeout (us), half of the microsecond clock range.*/
 
 static void fnet_ping_state_machine(void *fnet_ping_if_p);
 
@@ -87,8 +88,9 @@ typedef struct
     fnet_ping_handler_t     handler;            /* Callback function. */
     long                    handler_cookie;                 /* Callback-handler specific parameter. */
     char                    buffer[FNET_PING_BUFFER_SIZE];  /* Message buffer. */
-    unsigned long           timeout_clk;        /* Timeout value in clocks, that ping request waits for reply.*/
-    unsigned long           send_time;          /* Last send time, used for timeout detection. */
+    unsigned long           timeout_us;         /* Timeout value in microseconds, that ping request waits for reply.*/
+    unsigned long           send_time;          /* Last send time (us), used for timeout detection. */
+    unsigned long           rtt_us;             /* Round trip time of the last correct reply (us). */
     unsigned int            packet_count;       /* Number of packets to be sent.*/
     unsigned long           packet_size;
     unsigned char           pattern;
@@ -129,9 +131,12 @@ int fnet_ping_request( struct fnet_ping_params *params )
     /* Save input parmeters.*/
     fnet_ping_if.handler = params->handler;
     fnet_ping_if.handler_cookie = params->cookie;
-    fnet_ping_if.timeout_clk = params->timeout/FNET_TIMER_PERIOD_MS;
-    if(fnet_ping_if.timeout_clk == 0)
-        fnet_ping_if.timeout_clk = 1;
+    /* The microsecond clock wraps after about 71 minutes.*/
+    if(params->timeout > (FNET_PING_TIMEOUT_MAX/1000))
+        fnet_ping_if.timeout_us = FNET_PING_TIMEOUT_MAX;
+    else
+        fnet_ping_if.timeout_us = params->timeout*1000;
+    fnet_ping_if.rtt_us = 0;
     fnet_ping_if.family = params->target_addr.sa_family;
     fnet_ping_if.packet_count = params->packet_count;
     fnet_ping_if.pattern = params->pattern;
@@ -249,7 +254,7 @@ static void fnet_ping_state_machine(void *fnet_ping_if_p)
             send(fnet_ping_if.socket_foreign, (char*)(&fnet_ping_if.buffer[0]), (int)(sizeof(*hdr) + ping_if->packet_size), 0);
             ping_if->packet_count--;
            
-            fnet_ping_if.send_time = fnet_timer_ticks();        
+            fnet_ping_if.send_time = fnet_timer_us();        
             
             ping_if->state = FNET_PING_STATE_WAITING_REPLY;
             break;
@@ -296,6 +301,8 @@ static void fnet_ping_state_machine(void *fnet_ping_if_p)
                     goto NO_DATA;
                 }     
                 
+                ping_if->rtt_us = fnet_timer_get_interval(ping_if->send_time, fnet_timer_us());
+                
                 /* Call handler.*/
                 if(ping_if->handler)                 
                     ping_if->handler(FNET_OK, ping_if->packet_count, &addr, ping_if->handler_cookie);
@@ -330,7 +337,7 @@ static void fnet_ping_state_machine(void *fnet_ping_if_p)
             else /* No data. Check timeout */
             {
 NO_DATA:            
-                if(fnet_timer_get_interval(fnet_ping_if.send_time, fnet_timer_ticks()) > fnet_ping_if.timeout_clk)
+                if(fnet_timer_get_interval(fnet_ping_if.send_time, fnet_timer_us()) > fnet_ping_if.timeout_us)
                 {
                     /* Call handler.*/
                     if(ping_if->handler)                 
@@ -345,7 +352,7 @@ NO_DATA:
             break;
         /*===================================*/             
         case FNET_PING_STATE_WAITING_TIMEOUT:
-            if(fnet_timer_get_interval(fnet_ping_if.send_time, fnet_timer_ticks()) > fnet_ping_if.timeout_clk)
+            if(fnet_timer_get_interval(fnet_ping_if.send_time, fnet_timer_us()) > fnet_ping_if.timeout_us)
             {
                 ping_if->state = FNET_PING_STATE_SENDING_REQUEST;
             }
@@ -383,5 +390,16 @@ fnet_ping_state_t fnet_ping_state( void )
     return fnet_ping_if.state;
 }
 
+/************************************************************************
+* NAME: fnet_ping_rtt
+*
+* DESCRIPTION: This function returns the round trip time of the last 
+*              correct echo reply, in microseconds.
+************************************************************************/
+unsigned long fnet_ping_rtt( void )
+{
+    return fnet_ping_if.rtt_us;
+}
+
 
 #endif /* FNET_CFG_PING */
@@ -211,6 +211,23 @@ void fnet_ping_release(void);
  ******************************************************************************/
 fnet_ping_state_t fnet_ping_state(void);
 
+/***************************************************************************/ /*!
+ *
+ * @brief    Retrieves the round trip time of the last received echo reply.
+ *
+ * @return This function returns the round trip time in microseconds, 
+ *         or @c 0 if no correct reply has been received yet.
+ *
+ ******************************************************************************
+ *
+ * This function returns the time between sending the last echo request and 
+ * receiving its correct reply, measured by the @ref fnet_timer_us() clock.@n
+ * It is intended to be called from the @ref fnet_ping_handler_t callback 
+ * function, when its @c result is @ref FNET_OK.
+ *
+ ******************************************************************************/
+unsigned long fnet_ping_rtt(void);
+
 
 /*! @} */
 
@@ -54,12 +54,20 @@
 *     Definitions
 *************************************************************************/
 
+/* Wait conditions declared by a service for its next call.*/
+#define FNET_POLL_WAIT_SOCKET   (0x01)  /* Socket readiness.*/
+#define FNET_POLL_WAIT_TIMEOUT  (0x02)  /* Deadline.*/
+#define FNET_POLL_WAIT_SIGNAL   (0x04)  /* fnet_poll_service_signal().*/
+
 /* Polling list element type definition */
 
 typedef struct
 {
     fnet_poll_service_t service;
     void *service_param;
+    int wait;                   /* Wait conditions (FNET_POLL_WAIT_*). 0 = call always.*/
+    volatile int pending;       /* Socket event or signal, set from interrupts.*/
+    unsigned long deadline;     /* Deadline in timer ticks.*/
 } fnet_poll_list_entry_t;
 
 /* Polling interface structure */
@@ -69,21 +77,115 @@ static struct
     fnet_poll_desc_t last;                      /* Index of the last valid entry plus 1, in the polling list.*/
 } fnet_poll_if;
 
+static int fnet_poll_service_ready( fnet_poll_list_entry_t *entry );
+static void fnet_poll_socket_callback( SOCKET s, int revents, long cookie );
+
+/************************************************************************
+* NAME: fnet_poll_service_ready
+*
+* DESCRIPTION: Checks if the service has to be called.
+*************************************************************************/
+static int fnet_poll_service_ready( fnet_poll_list_entry_t *entry )
+{
+    int result;
+
+    if(entry->service == 0)
+        result = FNET_FALSE;
+    else if((entry->wait == 0) || entry->pending)
+        result = FNET_TRUE;
+    else if((entry->wait & FNET_POLL_WAIT_TIMEOUT)
+            && ((long)(fnet_timer_ticks() - entry->deadline) >= 0))
+        result = FNET_TRUE;
+    else
+        result = FNET_FALSE;
+
+    return result;
+}
+
+/************************************************************************
+* NAME: fnet_poll_socket_callback
+*
+* DESCRIPTION: Socket event callback. Marks the waiting service as ready.
+*              It is called in the interrupt context.
+*************************************************************************/
+static void fnet_poll_socket_callback( SOCKET s, int revents, long cookie )
+{
+    FNET_COMP_UNUSED_ARG(s);
+    FNET_COMP_UNUSED_ARG(revents);
+
+    fnet_poll_service_signal((fnet_poll_desc_t)cookie);
+}
+
 /************************************************************************
 * NAME: fnet_poll_services
 *
-* DESCRIPTION: This function calls all registered service routines in 
+* DESCRIPTION: This function calls all ready service routines in 
 *              the polling list.
 *************************************************************************/
 void fnet_poll_services( void )
 {
     fnet_poll_desc_t i;
+    fnet_poll_list_entry_t *entry;
+
+    for (i = 0; i < fnet_poll_if.last; i++)
+    {
+        entry = &fnet_poll_if.list[i];
+        
+        if(fnet_poll_service_ready(entry) == FNET_TRUE)
+        {
+            /* The wait conditions are valid for one call only.
+             * The service declares them again, if it has nothing to do.*/
+            entry->wait = 0;
+            entry->pending = 0;
+            
+            entry->service(entry->service_param);
+        }
+    }
+}
+
+/************************************************************************
+* NAME: fnet_poll_services_ready
+*
+* DESCRIPTION: Checks if any of the registered services is ready to run.
+*************************************************************************/
+int fnet_poll_services_ready( void )
+{
+    fnet_poll_desc_t i;
+    int result = FNET_FALSE;
 
     for (i = 0; i < fnet_poll_if.last; i++)
     {
-        if(fnet_poll_if.list[i].service)
-            fnet_poll_if.list[i].service(fnet_poll_if.list[i].service_param);
+        if(fnet_poll_service_ready(&fnet_poll_if.list[i]) == FNET_TRUE)
+        {
+            result = FNET_TRUE;
+            break;
+        }
     }
+
+    return result;
+}
+
+/************************************************************************
+* NAME: fnet_poll_services_idle
+*
+* DESCRIPTION: Sleeps until an interrupt, if no service is ready.
+*************************************************************************/
+void fnet_poll_services_idle( void )
+{
+#if FNET_CFG_CPU_IDLE
+    fnet_cpu_irq_desc_t irq_desc;
+    
+    /* The interrupts are disabled between the check and the sleep,
+     * a pending interrupt wakes the core up anyway.
+     * The timer tick interrupt bounds the sleep time, so the 
+     * deadlines are checked at least once per FNET_TIMER_PERIOD_MS.*/
+    irq_desc = fnet_cpu_irq_disable();
+    
+    if(fnet_poll_services_ready() == FNET_FALSE)
+        fnet_cpu_idle();
+    
+    fnet_cpu_irq_enable(irq_desc);
+#endif
 }
 
 /************************************************************************
@@ -118,6 +220,8 @@ fnet_poll_desc_t fnet_poll_service_register( fnet_poll_service_t service, void *
         {
             fnet_poll_if.list[i].service = service;
             fnet_poll_if.list[i].service_param = service_param;
+            fnet_poll_if.list[i].wait = 0;
+            fnet_poll_if.list[i].pending = 0;
             result = i;
 
             if(result >= fnet_poll_if.last)
@@ -140,6 +244,8 @@ int fnet_poll_service_unregister( fnet_poll_desc_t descriptor )
     if(descriptor < FNET_CFG_POLL_MAX)
     {
         fnet_poll_if.list[descriptor].service = 0;
+        fnet_poll_if.list[descriptor].wait = 0;
+        fnet_poll_if.list[descriptor].pending = 0;
         result = FNET_OK;
     }
     else
@@ -148,3 +254,87 @@ int fnet_poll_service_unregister( fnet_poll_desc_t descriptor )
     return result;
 }
 
+/************************************************************************
+* NAME: fnet_poll_service_wait_socket
+*
+* DESCRIPTION: The service is called when the socket becomes ready.
+*************************************************************************/
+int fnet_poll_service_wait_socket( fnet_poll_desc_t descriptor, SOCKET s, int events )
+{
+    struct fnet_pollfd pollfd;
+    int result = FNET_ERR;
+
+    if((descriptor < FNET_CFG_POLL_MAX) && fnet_poll_if.list[descriptor].service
+        && (fnet_socket_set_callback(s, events, fnet_poll_socket_callback, (long)descriptor) == FNET_OK))
+    {
+        fnet_poll_if.list[descriptor].wait |= FNET_POLL_WAIT_SOCKET;
+        
+        /* The socket may be ready already.*/
+        pollfd.fd = s;
+        pollfd.events = events;
+        
+        if(fnet_poll(&pollfd, 1) > 0)
+            fnet_poll_if.list[descriptor].pending = 1;
+        
+        result = FNET_OK;
+    }
+
+    return result;
+}
+
+/************************************************************************
+* NAME: fnet_poll_service_wait_timeout
+*
+* DESCRIPTION: The service is called after the timeout.
+*************************************************************************/
+int fnet_poll_service_wait_timeout( fnet_poll_desc_t descriptor, unsigned long timeout_ticks )
+{
+    fnet_poll_list_entry_t *entry;
+    unsigned long deadline;
+    int result = FNET_ERR;
+
+    if((descriptor < FNET_CFG_POLL_MAX) && fnet_poll_if.list[descriptor].service)
+    {
+        entry = &fnet_poll_if.list[descriptor];
+        deadline = fnet_timer_ticks() + timeout_ticks;
+        
+        /* Keep the earliest deadline.*/
+        if(!(entry->wait & FNET_POLL_WAIT_TIMEOUT) || ((long)(deadline - entry->deadline) < 0))
+            entry->deadline = deadline;
+            
+        entry->wait |= FNET_POLL_WAIT_TIMEOUT;
+        result = FNET_OK;
+    }
+
+    return result;
+}
+
+/************************************************************************
+* NAME: fnet_poll_service_wait_signal
+*
+* DESCRIPTION: The service is called after fnet_poll_service_signal().
+*************************************************************************/
+int fnet_poll_service_wait_signal( fnet_poll_desc_t descriptor )
+{
+    int result = FNET_ERR;
+
+    if((descriptor < FNET_CFG_POLL_MAX) && fnet_poll_if.list[descriptor].service)
+    {
+        fnet_poll_if.list[descriptor].wait |= FNET_POLL_WAIT_SIGNAL;
+        result = FNET_OK;
+    }
+
+    return result;
+}
+
+/************************************************************************
+* NAME: fnet_poll_service_signal
+*
+* DESCRIPTION: Marks the service as ready. Can be called from interrupts.
+*************************************************************************/
+void fnet_poll_service_signal( fnet_poll_desc_t descriptor )
+{
+    if(descriptor < FNET_CFG_POLL_MAX)
+        fnet_poll_if.list[descriptor].pending = 1;
+}
+
@@ -57,6 +57,23 @@
 * In order to make the polling mechanism work, the user application should 
 * call the @ref fnet_poll_services() API function periodically, during the idle time.@n
 * @n
+* A service can declare what it waits for before its next call: 
+* socket readiness (@ref fnet_poll_service_wait_socket()), a deadline 
+* (@ref fnet_poll_service_wait_timeout()) or an explicit signal 
+* (@ref fnet_poll_service_wait_signal()). Such a service is skipped by 
+* @ref fnet_poll_services() until any of the declared conditions occurs.
+* The declaration is valid for one call, the service repeats it every 
+* time it has nothing to do. A service that declares nothing is called 
+* on every @ref fnet_poll_services() call.@n
+* The application main loop can sleep, when no service is ready:
+* @code
+*       while(1)
+*       {
+*           fnet_poll_services();
+*           fnet_poll_services_idle();
+*       }
+* @endcode
+* @n
 * Configuration parameters:
 * - @ref FNET_CFG_POLL_MAX  
 */
@@ -152,6 +169,129 @@ fnet_poll_desc_t fnet_poll_service_register( fnet_poll_service_t service, void *
  ******************************************************************************/
 int fnet_poll_service_unregister( fnet_poll_desc_t desc );
 
+/***************************************************************************/ /*!
+ *
+ * @brief    Checks if any registered service is ready to run.
+ *
+ * @return This function returns:
+ *   - @ref FNET_TRUE, if a service is ready.
+ *   - @ref FNET_FALSE, if all services are waiting.
+ *
+ * @see fnet_poll_services_idle()
+ *
+ ******************************************************************************
+ *
+ * A service is ready if it has not declared any wait condition, or if 
+ * any of its declared conditions has occurred.
+ *
+ ******************************************************************************/
+int fnet_poll_services_ready(void);
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Sleeps until the next interrupt, if no service is ready.
+ *
+ * @see fnet_poll_services_ready(), fnet_cpu_idle()
+ *
+ ******************************************************************************
+ *
+ * This function puts the core to sleep by @ref fnet_cpu_idle(), if 
+ * @ref fnet_poll_services_ready() returns @ref FNET_FALSE. 
+ * Any interrupt wakes it up. The timer tick interrupt bounds the sleep 
+ * time to @ref FNET_TIMER_PERIOD_MS.@n
+ * If @ref FNET_CFG_CPU_IDLE is @c 0, this function returns immediately.@n
+ * The application calls it in the main loop, after @ref fnet_poll_services().
+ *
+ ******************************************************************************/
+void fnet_poll_services_idle(void);
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Waits for the socket readiness before the next service call.
+ *
+ * @param desc       Service descriptor.
+ *
+ * @param s          Socket descriptor.
+ *
+ * @param events     Socket events to wait for (@ref fnet_poll_event_t).
+ *
+ * @return This function returns:
+ *   - @ref FNET_OK, if no error occurs.
+ *   - @ref FNET_ERR, if an error occurs.
+ *
+ * @see fnet_poll_service_wait_timeout(), fnet_socket_set_callback()
+ *
+ ******************************************************************************
+ *
+ * This function registers the socket event callback 
+ * (@ref fnet_socket_set_callback()) that marks the service as ready. 
+ * It replaces any other callback of the socket.@n
+ * The service is called when any of the @c events, an error or a hang-up 
+ * occurs on the socket. If the socket is ready already, the service is 
+ * called on the next @ref fnet_poll_services() call.@n
+ * It can be called for several sockets of the service.
+ *
+ ******************************************************************************/
+int fnet_poll_service_wait_socket( fnet_poll_desc_t desc, SOCKET s, int events );
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Waits for the timeout before the next service call.
+ *
+ * @param desc          Service descriptor.
+ *
+ * @param timeout_ticks Timeout in timer ticks.
+ *
+ * @return This function returns:
+ *   - @ref FNET_OK, if no error occurs.
+ *   - @ref FNET_ERR, if an error occurs.
+ *
+ * @see fnet_poll_service_wait_socket(), fnet_timer_ms2ticks()
+ *
+ ******************************************************************************
+ *
+ * This function sets the deadline of the next service call. If it is 
+ * called several times, the earliest deadline is used.
+ *
+ ******************************************************************************/
+int fnet_poll_service_wait_timeout( fnet_poll_desc_t desc, unsigned long timeout_ticks );
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Waits for the signal before the next service call.
+ *
+ * @param desc       Service descriptor.
+ *
+ * @return This function returns:
+ *   - @ref FNET_OK, if no error occurs.
+ *   - @ref FNET_ERR, if an error occurs.
+ *
+ * @see fnet_poll_service_signal()
+ *
+ ******************************************************************************
+ *
+ * The service is not called until @ref fnet_poll_service_signal() is 
+ * called for it (or until another declared condition occurs).
+ *
+ ******************************************************************************/
+int fnet_poll_service_wait_signal( fnet_poll_desc_t desc );
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Marks the service as ready.
+ *
+ * @param desc       Service descriptor.
+ *
+ * @see fnet_poll_service_wait_signal()
+ *
+ ******************************************************************************
+ *
+ * The service is called on the next @ref fnet_poll_services() call.@n
+ * This function can be called from an interrupt handler.
+ *
+ ******************************************************************************/
+void fnet_poll_service_signal( fnet_poll_desc_t desc );
+
 /*! @} */
 
 #endif
@@ -57,6 +57,7 @@
 #include "fnet_error.h"
 #include "fnet_debug.h"
 #include "fnet_isr.h"
+#include "fnet_ip_prv.h"
 
 
 
@@ -75,6 +76,12 @@ static fnet_arp_entry_t *fnet_arp_add_entry( fnet_netif_t *netif, fnet_ip4_addr_
                                             const fnet_mac_addr_t ethaddr );
 static fnet_arp_entry_t *fnet_arp_update_entry( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr,
                                             fnet_mac_addr_t ethaddr );
+static unsigned int fnet_arp_hash( fnet_ip4_addr_t ipaddr );
+static fnet_arp_entry_t *fnet_arp_find_entry( fnet_arp_if_t *arpif, fnet_ip4_addr_t ipaddr );
+static void fnet_arp_del_entry( fnet_arp_if_t *arpif, fnet_arp_entry_t *entry );
+static void fnet_arp_hold_free( fnet_arp_entry_t *entry );
+static void fnet_arp_hold_send( fnet_netif_t *netif, fnet_arp_entry_t *entry );
+static void fnet_arp_send_request( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr, const fnet_mac_addr_t dest_addr );
 static void fnet_arp_ip_duplicated(void);
 static fnet_netif_desc_t netif_dupip; /* The last netif that has Duplicated IP. */
 
@@ -93,11 +100,18 @@ static fnet_netif_desc_t netif_dupip; /* The last netif that has Duplicated IP.
 int fnet_arp_init( fnet_netif_t *netif )
 {
     fnet_arp_if_t *arpif = &(((fnet_eth_if_t *)(netif->if_ptr))->arp_if); 
-    int i;
     int result;
 
-    for (i = 0; i < FNET_ARP_TABLE_SIZE; i++)
-      fnet_memset_zero(&(arpif->arp_table[i]), sizeof(fnet_arp_entry_t));
+    fnet_isr_lock();
+
+    /* Initialized already (by fnet_eth_init()), start from scratch.*/
+    if(arpif->arp_tmr)
+        fnet_arp_release(netif);
+
+    fnet_memset_zero(arpif, sizeof(fnet_arp_if_t));
+    arpif->netif = netif;
+
+    fnet_isr_unlock();
 
     arpif->arp_tmr = fnet_timer_new((FNET_ARP_TIMER_PERIOD / FNET_TIMER_PERIOD_MS), 
                         fnet_arp_timer, arpif);
@@ -121,10 +135,21 @@ int fnet_arp_init( fnet_netif_t *netif )
 void fnet_arp_release( fnet_netif_t *netif )
 {
     fnet_arp_if_t *arpif = &(((fnet_eth_if_t *)(netif->if_ptr))->arp_if);
+    int i;
 
     fnet_timer_free(arpif->arp_tmr);
 
     arpif->arp_tmr = 0;
+
+    fnet_isr_lock();
+
+    for (i = 0; i < FNET_ARP_TABLE_SIZE; i++)
+    {
+        if(arpif->arp_table[i].prot_addr)
+            fnet_arp_del_entry(arpif, &arpif->arp_table[i]);
+    }
+    
+    fnet_isr_unlock();
 }
 
 /************************************************************************
@@ -135,21 +160,114 @@ void fnet_arp_release( fnet_netif_t *netif )
 static void fnet_arp_timer( void *cookie )
 {
     fnet_arp_if_t *arpif =  (fnet_arp_if_t *)cookie;
+    fnet_arp_entry_t *entry;
+    unsigned long age;
     int i;
 
     for (i = 0; i < FNET_ARP_TABLE_SIZE; i++)
     {
-        if((arpif->arp_table[i].prot_addr)
-             && ((fnet_timer_ticks() - arpif->arp_table[i].cr_time))
-                              > (unsigned long)(FNET_ARP_TIMEOUT / FNET_TIMER_PERIOD_MS))
+        entry = &arpif->arp_table[i];
+        
+        if(entry->prot_addr == 0)
+            continue;
+        
+        age = fnet_timer_ticks() - entry->cr_time;
+            
+        if(age > (unsigned long)(FNET_ARP_TIMEOUT / FNET_TIMER_PERIOD_MS))
+        {
+            fnet_arp_del_entry(arpif, entry);
+        }
+#if FNET_CFG_ARP_REFRESH
+        /* Refresh the used entry before it expires, by an unicast request.
+         * The reply updates cr_time.*/
+        else if((age > (unsigned long)(FNET_ARP_REFRESH_TIME / FNET_TIMER_PERIOD_MS)) && entry->used 
+                && fnet_memcmp(entry->hard_addr, fnet_eth_null_addr, sizeof(fnet_mac_addr_t)))
         {
-            if(arpif->arp_table[i].hold)
-                fnet_netbuf_free_chain(arpif->arp_table[i].hold);
+            fnet_arp_send_request(arpif->netif, entry->prot_addr, entry->hard_addr);
+            arpif->statistics.refresh++;
+        }
+#endif
+        entry->used = 0;
+    }
+
+}
+
+/************************************************************************
+* NAME: fnet_arp_hash
+*
+* DESCRIPTION: Returns the hash bucket of the protocol address.
+*************************************************************************/
+static unsigned int fnet_arp_hash( fnet_ip4_addr_t ipaddr )
+{
+    unsigned long key = ipaddr;
+
+    /* Fold all bytes, the host part is the last byte in network order.*/
+    key ^= key >> 16;
+    key ^= key >> 8;
+
+    return (unsigned int)(key & (FNET_CFG_ARP_HASH_SIZE - 1));
+}
+
+/************************************************************************
+* NAME: fnet_arp_find_entry
+*
+* DESCRIPTION: Finds the ARP table entry of the protocol address.
+*************************************************************************/
+static fnet_arp_entry_t *fnet_arp_find_entry( fnet_arp_if_t *arpif, fnet_ip4_addr_t ipaddr )
+{
+    fnet_arp_entry_t *entry;
 
-            fnet_memset_zero(&(arpif->arp_table[i]), sizeof(fnet_arp_entry_t));
+    /* Fast path, the same destination (usually the gateway) as last time.*/
+    if(arpif->arp_last && (arpif->arp_last->prot_addr == ipaddr))
+        return arpif->arp_last;
+
+    for(entry = arpif->arp_hash[fnet_arp_hash(ipaddr)]; entry; entry = entry->hash_next)
+    {
+        if(entry->prot_addr == ipaddr)
+            break;
+    }
+
+    return entry;
+}
+
+/************************************************************************
+* NAME: fnet_arp_del_entry
+*
+* DESCRIPTION: Frees the ARP table entry and its queued packets.
+*************************************************************************/
+static void fnet_arp_del_entry( fnet_arp_if_t *arpif, fnet_arp_entry_t *entry )
+{
+    fnet_arp_entry_t **bucket;
+
+    for(bucket = &arpif->arp_hash[fnet_arp_hash(entry->prot_addr)]; *bucket; bucket = &(*bucket)->hash_next)
+    {
+        if(*bucket == entry)
+        {
+            *bucket = entry->hash_next;
+            break;
         }
     }
 
+    if(arpif->arp_last == entry)
+        arpif->arp_last = 0;
+
+    fnet_arp_hold_free(entry);
+
+    fnet_memset_zero(entry, sizeof(fnet_arp_entry_t));
+}
+
+/************************************************************************
+* NAME: fnet_arp_hold_free
+*
+* DESCRIPTION: Frees the packets queued for the entry.
+*************************************************************************/
+static void fnet_arp_hold_free( fnet_arp_entry_t *entry )
+{
+    while(entry->hold)
+        fnet_netbuf_del_chain(&entry->hold, entry->hold);
+
+    entry->hold_count = 0;
+    entry->hold_time = 0;
 }
 
 /************************************************************************
@@ -163,19 +281,15 @@ static fnet_arp_entry_t *fnet_arp_add_entry( fnet_netif_t *netif, fnet_ip4_addr_
     fnet_arp_if_t *arpif = &(((fnet_eth_if_t *)(netif->if_ptr))->arp_if);
     int i, j;
     unsigned long max_time;
+    fnet_arp_entry_t *entry;
 
     /* Find an entry to update. */
-    for (i = 0; i < FNET_ARP_TABLE_SIZE; ++i)
+    if((entry = fnet_arp_find_entry(arpif, ipaddr)) != 0)
     {
-        /* Check if the source IP address of the incoming packet matches
-         * the IP address in this ARP table entry.*/
-        if(ipaddr == arpif->arp_table[i].prot_addr)
-        {
-            /* Update this and return. */
-            fnet_memcpy(arpif->arp_table[i].hard_addr, ethaddr, sizeof(fnet_mac_addr_t));
-            arpif->arp_table[i].cr_time = fnet_timer_ticks();
-            goto ADDED;
-        }
+        /* Update this and return. */
+        fnet_memcpy(entry->hard_addr, ethaddr, sizeof(fnet_mac_addr_t));
+        entry->cr_time = fnet_timer_ticks();
+        return entry;
     }
 
     /* If we get here, no existing ARP table entry was found. */
@@ -208,19 +322,20 @@ static fnet_arp_entry_t *fnet_arp_add_entry( fnet_netif_t *netif, fnet_ip4_addr_
     }
 
     /* Now, it is the ARP table entry which we will fill with the new information. */
-    if(arpif->arp_table[i].hold)
-    {
-        fnet_netbuf_free_chain(arpif->arp_table[i].hold);
-        arpif->arp_table[i].hold = 0;
-        arpif->arp_table[i].hold_time = 0;
-    }
+    entry = &arpif->arp_table[i];
+    
+    if(entry->prot_addr)
+        fnet_arp_del_entry(arpif, entry);
 
-    arpif->arp_table[i].prot_addr = ipaddr;
-    fnet_memcpy(arpif->arp_table[i].hard_addr, ethaddr, sizeof(fnet_mac_addr_t));
+    entry->prot_addr = ipaddr;
+    fnet_memcpy(entry->hard_addr, ethaddr, sizeof(fnet_mac_addr_t));
     
-    arpif->arp_table[i].cr_time = fnet_timer_ticks();
-ADDED:
-    return ( &arpif->arp_table[i]);
+    entry->cr_time = fnet_timer_ticks();
+    
+    entry->hash_next = arpif->arp_hash[fnet_arp_hash(ipaddr)];
+    arpif->arp_hash[fnet_arp_hash(ipaddr)] = entry;
+
+    return entry;
 }
 
 
@@ -233,52 +348,47 @@ static fnet_arp_entry_t *fnet_arp_update_entry( fnet_netif_t *netif, fnet_ip4_ad
                                             fnet_mac_addr_t ethaddr )
 {
     fnet_arp_if_t *arpif = &(((fnet_eth_if_t *)(netif->if_ptr))->arp_if); //PFI
-    int i;
+    fnet_arp_entry_t *entry;
 
     /* Find an entry to update. */
-    for (i = 0; i < FNET_ARP_TABLE_SIZE; ++i)
+    if((entry = fnet_arp_find_entry(arpif, ipaddr)) != 0)
     {
-        /* Check if the source IP address of the incoming packet matches
-         * the IP address in this ARP table entry.*/
-        if(ipaddr == arpif->arp_table[i].prot_addr)
-        {
-            /* Update this and return. */
-            fnet_memcpy(arpif->arp_table[i].hard_addr, ethaddr, sizeof(fnet_mac_addr_t));
-            arpif->arp_table[i].cr_time = fnet_timer_ticks();
-            return ( &arpif->arp_table[i]);
-        }
+        /* Update this and return. */
+        fnet_memcpy(entry->hard_addr, ethaddr, sizeof(fnet_mac_addr_t));
+        entry->cr_time = fnet_timer_ticks();
     }
 
-    return FNET_NULL;
+    return entry;
 }
 
 /************************************************************************
 * NAME: fnet_arp_lookup
 *
 * DESCRIPTION: This function looks up an entry corresponding to
-*              the destination IP address
+*              the destination IP address.
+*              It must be called with fnet_isr_lock() held, the result 
+*              points into the cache.
 *************************************************************************/
 fnet_mac_addr_t *fnet_arp_lookup( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr )
 {
     fnet_arp_if_t   *arpif = &(((fnet_eth_if_t *)(netif->if_ptr))->arp_if); //PFI
-    int             i;
+    fnet_arp_entry_t *entry;
     fnet_mac_addr_t *result = FNET_NULL;
 
     /* Find an entry. */
-    for (i = 0; i < FNET_ARP_TABLE_SIZE; ++i)
+    if(((entry = fnet_arp_find_entry(arpif, ipaddr)) != 0)
+        && fnet_memcmp(entry->hard_addr, fnet_eth_null_addr, sizeof(fnet_mac_addr_t)))
     {
-        if(ipaddr == arpif->arp_table[i].prot_addr)
-        {
-            if(fnet_memcmp(arpif->arp_table[i].hard_addr, 
-                            fnet_eth_null_addr, sizeof(fnet_mac_addr_t)))
-            {
-                result = &arpif->arp_table[i].hard_addr;
-            }
-            /* Else => not found */
-            break;
-        }
+        arpif->arp_last = entry;
+        entry->used = 1;
+        arpif->statistics.hit++;
+        result = &entry->hard_addr;
+    }
+    else /* Not found or not resolved yet.*/
+    {
+        arpif->statistics.miss++;
     }
-//NOTFOUND:
+
     return result;
 }
 
@@ -288,42 +398,45 @@ fnet_mac_addr_t *fnet_arp_lookup( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr )
 * DESCRIPTION: This function finds the first unused or the oldest
 *              ARP table entry and makes a new entry
 *              to prepare it for an ARP reply.
+*              It must be called with fnet_isr_lock() held.
 *************************************************************************/
 void fnet_arp_resolve( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr, fnet_netbuf_t *nb )
 {
     fnet_arp_if_t *arpif = &(((fnet_eth_if_t *)(netif->if_ptr))->arp_if); //PFI
-    int i;
     fnet_arp_entry_t *entry;
+    int request;
 
-    for (i = 0; i < FNET_ARP_TABLE_SIZE; i++)
+    /* If no entry is found, create it. */
+    if((entry = fnet_arp_find_entry(arpif, ipaddr)) == 0)
     {
-        if(ipaddr == arpif->arp_table[i].prot_addr)
-        {
-            break;
-        }
-    }
-
-    /* If no unused entry is found, create it. */
-    if(i == FNET_ARP_TABLE_SIZE)
         entry = fnet_arp_add_entry(netif, ipaddr, fnet_eth_null_addr);
+        request = FNET_TRUE;
+    }
     else
-        entry = &arpif->arp_table[i];
+    {
+        /* Repeat the request not more often than once per second.*/
+        request = ((entry->hold == 0) 
+                    || (fnet_timer_get_interval(entry->hold_time, fnet_timer_us()) > 1000000));
+    }
 
-    if(entry->hold)
+    /* Queue the packet, drop the oldest one if the queue is full.*/
+    if(entry->hold_count >= FNET_CFG_ARP_HOLD_MAX)
     {
-        fnet_netbuf_free_chain(entry->hold);
+        fnet_netbuf_del_chain(&entry->hold, entry->hold);
+        entry->hold_count--;
+        arpif->statistics.hold_drop++;
     }
 
-    if((i == FNET_ARP_TABLE_SIZE)||
-        ((entry->hold)&&(((fnet_timer_ticks()-entry->hold_time)*FNET_TIMER_PERIOD_MS)>1000))||
-        (!entry->hold))
+    nb->next_chain = 0;
+    fnet_netbuf_add_chain(&entry->hold, nb);
+    entry->hold_count++;
+    arpif->statistics.resolve_wait++;
+
+    if(request)
     {
-        entry->hold_time = fnet_timer_ticks();
-        entry->hold = nb;
+        entry->hold_time = fnet_timer_us();
         fnet_arp_request(netif, ipaddr);
     }
-    else
-        entry->hold = nb;
 }
 
 /************************************************************************
@@ -360,19 +473,19 @@ void fnet_arp_input( fnet_netif_t *netif, fnet_netbuf_t *nb )
                 {
                     entry = fnet_arp_add_entry(netif, sender_prot_addr, arp_hdr->sender_hard_addr);
                 }
+#if FNET_CFG_ARP_LEARN_GRATUITOUS
+                else if(targer_prot_addr == sender_prot_addr) /* Gratuitous ARP.*/
+                {
+                    entry = fnet_arp_add_entry(netif, sender_prot_addr, arp_hdr->sender_hard_addr);
+                }
+#endif
                 else
                 {
                     entry = fnet_arp_update_entry(netif, sender_prot_addr, arp_hdr->sender_hard_addr);
                 }
 
-                if(entry && entry->hold)
-                {
-                    /* Send waiting data.*/
-                    ((fnet_eth_if_t *)(netif->if_ptr))->output(netif, FNET_ETH_TYPE_IP4, entry->hard_addr, entry->hold);
-
-                    entry->hold = 0;
-                    entry->hold_time = 0;
-                }
+                if(entry)
+                    fnet_arp_hold_send(netif, entry);
             }
             else
             {
@@ -401,12 +514,77 @@ void fnet_arp_input( fnet_netif_t *netif, fnet_netbuf_t *nb )
     fnet_netbuf_free_chain(nb);
 }
 
+/************************************************************************
+* NAME: fnet_arp_hold_send
+*
+* DESCRIPTION: Sends the packets queued for the resolved entry,
+*              in the order of queueing.
+*************************************************************************/
+static void fnet_arp_hold_send( fnet_netif_t *netif, fnet_arp_entry_t *entry )
+{
+    fnet_netbuf_t *hold = entry->hold;
+    fnet_netbuf_t *hold_next;
+    
+    entry->hold = 0;
+    entry->hold_count = 0;
+    entry->hold_time = 0;
+    
+    while(hold)
+    {
+        hold_next = hold->next_chain;
+        hold->next_chain = 0;
+        ((fnet_eth_if_t *)(netif->if_ptr))->output(netif, FNET_ETH_TYPE_IP4, entry->hard_addr, hold);
+        hold = hold_next;
+    }
+}
+
+#if FNET_CFG_ARP_LEARN_IP
+/************************************************************************
+* NAME: fnet_arp_ip_learn
+*
+* DESCRIPTION: Creates or refreshes the entry of the on-link sender
+*              of the received IPv4 packet.
+*************************************************************************/
+void fnet_arp_ip_learn( fnet_netif_t *netif, fnet_netbuf_t *nb, const fnet_mac_addr_t hwaddr )
+{
+    fnet_ip_header_t    *hdr = nb->data_ptr;
+    fnet_ip4_addr_t     source_addr;
+    fnet_arp_entry_t    *entry;
+    
+    if((nb->length >= sizeof(fnet_ip_header_t)) && (FNET_IP_HEADER_GET_VERSION(hdr) == 4)
+        && ((hwaddr[0] & 0x01) == 0)) /* Not a multicast/broadcast MAC.*/
+    {
+        source_addr = hdr->source_addr;
+        
+        /* Only on-link senders, the others come through a router.*/
+        if(source_addr && (source_addr != netif->ip4_addr.address)
+            && ((source_addr & netif->ip4_addr.subnetmask) == (netif->ip4_addr.address & netif->ip4_addr.subnetmask))
+            && (fnet_ip_addr_is_broadcast(source_addr, netif) == FNET_FALSE))
+        {
+            if((entry = fnet_arp_add_entry(netif, source_addr, hwaddr)) != 0)
+                fnet_arp_hold_send(netif, entry);
+        }
+    }
+}
+#endif /* FNET_CFG_ARP_LEARN_IP */
+
 /************************************************************************
 * NAME: fnet_arp_request
 *
 * DESCRIPTION: Sends ARP request.
 *************************************************************************/
 void fnet_arp_request( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr )
+{
+    fnet_arp_send_request(netif, ipaddr, fnet_eth_broadcast);
+}
+
+/************************************************************************
+* NAME: fnet_arp_send_request
+*
+* DESCRIPTION: Sends ARP request to the destination MAC address.
+*              It is broadcast, or unicast to refresh a cache entry.
+*************************************************************************/
+static void fnet_arp_send_request( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr, const fnet_mac_addr_t dest_addr )
 {
     fnet_arp_header_t *arp_hdr;
     fnet_mac_addr_t sender_addr;
@@ -430,7 +608,7 @@ void fnet_arp_request( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr )
         arp_hdr->targer_prot_addr = ipaddr;              /* Protocol address of target of this packet.*/
         arp_hdr->sender_prot_addr = netif->ip4_addr.address; /* Protocol address of sender of this packet.*/
 
-        ((fnet_eth_if_t *)(netif->if_ptr))->output(netif, FNET_ETH_TYPE_ARP, fnet_eth_broadcast, nb);
+        ((fnet_eth_if_t *)(netif->if_ptr))->output(netif, FNET_ETH_TYPE_ARP, dest_addr, nb);
     }
 }
 
@@ -465,9 +643,7 @@ void fnet_arp_drain(fnet_netif_t *netif)
    {
       if(arpif->arp_table[i].hold)
       {
-         fnet_netbuf_free_chain(arpif->arp_table[i].hold);
-         arpif->arp_table[i].hold=0;
-         arpif->arp_table[i].hold_time=0;
+         fnet_arp_hold_free(&arpif->arp_table[i]);
       }
    }
   
@@ -475,6 +651,29 @@ void fnet_arp_drain(fnet_netif_t *netif)
 }
 
 
+/************************************************************************
+* NAME: fnet_netif_get_arp_statistics
+*
+* DESCRIPTION: This function returns ARP cache statistics.
+*************************************************************************/
+int fnet_netif_get_arp_statistics( fnet_netif_desc_t netif_desc, struct fnet_arp_statistics *statistics )
+{
+    fnet_netif_t *netif = (fnet_netif_t *)netif_desc;
+    int result;
+
+    if(netif && statistics && (netif->api->type == FNET_NETIF_TYPE_ETHERNET))
+    {
+        fnet_isr_lock();
+        *statistics = ((fnet_eth_if_t *)(netif->if_ptr))->arp_if.statistics;
+        fnet_isr_unlock();
+        result = FNET_OK;
+    }
+    else
+        result = FNET_ERR;
+
+    return result;
+}
+
 /************************************************************************
 * NAME: fnet_arp_trace
 *
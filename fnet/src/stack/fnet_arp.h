@@ -69,6 +69,7 @@
 
 #define FNET_ARP_TIMER_PERIOD   (300000)    /* in ms (=5min).*/
 #define FNET_ARP_TIMEOUT    	(1200000)   /* in ms (=20min).*/
+#define FNET_ARP_REFRESH_TIME   (FNET_ARP_TIMEOUT - 2*FNET_ARP_TIMER_PERIOD) /* in ms, age when a used entry is refreshed (two tries).*/
 
 /**************************************************************************/ /*!
  * @internal
@@ -89,25 +90,35 @@ typedef struct
 } fnet_arp_header_t;
 FNET_COMP_PACKED_END
 
-#define FNET_ARP_TABLE_SIZE     (10)    /* The number of entries in the ARP table.*/
+#define FNET_ARP_TABLE_SIZE     FNET_CFG_ARP_TABLE_SIZE /* The number of entries in the ARP table.*/
 
+#if (FNET_CFG_ARP_HASH_SIZE & (FNET_CFG_ARP_HASH_SIZE - 1))
+    #error "FNET_CFG_ARP_HASH_SIZE must be a power of two."
+#endif
 
 /**************************************************************************/ /*!
  * @internal
  * @brief    ARP table entry structure.
  ******************************************************************************/
-typedef struct
+typedef struct fnet_arp_entry
 {
     fnet_mac_addr_t hard_addr;  /**< Hardware address.*/
-    fnet_ip4_addr_t prot_addr;   /**< Protocol address.*/
+    fnet_ip4_addr_t prot_addr;   /**< Protocol address. 0 = unused entry.*/
     unsigned long cr_time;      /**< Time of entry creation.*/
-    fnet_netbuf_t *hold;        /**< Last packet until resolved/timeout.*/
-    unsigned long hold_time;    /**< Time of the last request.*/
+    fnet_netbuf_t *hold;        /**< Packets until resolved/timeout, linked by next_chain.*/
+    unsigned long hold_count;   /**< Number of packets in the hold queue.*/
+    unsigned long hold_time;    /**< Time of the last request (us).*/
+    int used;                   /**< Used since the last ARP timer run.*/
+    struct fnet_arp_entry *hash_next; /**< Next entry in the hash bucket.*/
 } fnet_arp_entry_t;
 
 typedef struct
 {
     fnet_arp_entry_t arp_table[FNET_ARP_TABLE_SIZE]; /**< ARP cach.*/
+    fnet_arp_entry_t *arp_hash[FNET_CFG_ARP_HASH_SIZE]; /**< Used entries, hashed by the protocol address.*/
+    fnet_arp_entry_t *arp_last;                      /**< Last resolved entry (usually the gateway).*/
+    struct fnet_arp_statistics statistics;           /**< Cache statistics.*/
+    fnet_netif_t *netif;                             /**< Interface of the cache.*/
     fnet_timer_desc_t arp_tmr;                       /**< ARP timer.*/
 } fnet_arp_if_t;
 
@@ -121,6 +132,9 @@ fnet_mac_addr_t *fnet_arp_lookup( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr );
 void fnet_arp_resolve( fnet_netif_t *netif, fnet_ip4_addr_t ipaddr, fnet_netbuf_t *nb );
 void fnet_arp_input( fnet_netif_t *netif, fnet_netbuf_t *nb );
 void fnet_arp_drain( fnet_netif_t *netif );
+#if FNET_CFG_ARP_LEARN_IP
+void fnet_arp_ip_learn( fnet_netif_t *netif, fnet_netbuf_t *nb, const fnet_mac_addr_t hwaddr );
+#endif
 
 #endif
 
@@ -48,6 +48,10 @@
 
 static unsigned long fnet_checksum_nb(fnet_netbuf_t * nb, int len);
 
+/* Adds a 32-bit or 16-bit value to the sum, counting the carry. */
+#define FNET_CHECKSUM_ADD(sum, carries, value)   \
+    do{ unsigned long _v = (value); (sum) += _v; (carries) += ((sum) < _v); }while(0)
+
 /*RFC:
     The checksum field is the 16 bit one's complement of the one's
     complement sum of all 16 bit words in the header and text.  If a
@@ -69,48 +73,53 @@ static unsigned long fnet_checksum_nb(fnet_netbuf_t * nb, int len);
 
 static unsigned long fnet_checksum_low(unsigned long sum, int current_length, unsigned short *d_ptr)
 {
-        unsigned short p_byte1;
-        
-        while((current_length -= 32) >= 0)
+    unsigned long   *l_ptr;
+    unsigned long   carries = 0;
+    unsigned short  p_byte1;
+    
+    if(((unsigned long)d_ptr & 1) == 0)
+    {
+        /* Sum 32-bit words, counting carries out of bit 31. */
+        if(((unsigned long)d_ptr & 2) && (current_length >= 2))
         {
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
+            FNET_CHECKSUM_ADD(sum, carries, *d_ptr++);
+            current_length -= 2;
         }
-        current_length += 32;
-
-        while((current_length -= 8) >= 0)
+        
+        l_ptr = (unsigned long *)d_ptr;
+        
+        while((current_length -= 16) >= 0)
         {
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
-            sum += *d_ptr++;
+            FNET_CHECKSUM_ADD(sum, carries, *l_ptr++);
+            FNET_CHECKSUM_ADD(sum, carries, *l_ptr++);
+            FNET_CHECKSUM_ADD(sum, carries, *l_ptr++);
+            FNET_CHECKSUM_ADD(sum, carries, *l_ptr++);
         }
-        current_length += 8;
-
-        while((current_length -= 2) >= 0)
-            sum += *d_ptr++;  
+        current_length += 16;
+        
+        while((current_length -= 4) >= 0)
+            FNET_CHECKSUM_ADD(sum, carries, *l_ptr++);
+        current_length += 4;
+        
+        d_ptr = (unsigned short *)l_ptr;
+    }
+    
+    /* Odd address (after an odd-length net_buf) and the tail. */
+    while((current_length -= 2) >= 0)
+        FNET_CHECKSUM_ADD(sum, carries, *d_ptr++);  
             
-        if(current_length += 2)
-        {
-            p_byte1 = (unsigned short)((*((unsigned short *)d_ptr)) & FNET_NTOHS(0xFF00));
-           
-            sum += (unsigned short)p_byte1;
-        }
-        return sum;
+    if(current_length += 2)
+    {
+        p_byte1 = (unsigned short)((*((unsigned short *)d_ptr)) & FNET_NTOHS(0xFF00));
+       
+        FNET_CHECKSUM_ADD(sum, carries, p_byte1);
+    }
+    
+    /* A carry out of bit 31 is worth 1 in one's complement arithmetic. */
+    sum = (sum >> 16) + (sum & 0xffff) + carries;
+    sum = (sum >> 16) + (sum & 0xffff);
+    
+    return sum;
 } 
 #else
 
@@ -141,8 +150,15 @@ static unsigned long fnet_checksum_nb(fnet_netbuf_t * nb, int len)
 
         sum = fnet_checksum_low(sum, current_length, d_ptr); 
         
+        if(len == 0)
+            break;                   /* The last net_buf may have no next one.*/
         
-        tmp_nb = tmp_nb->next;
+        /* Skip empty net_bufs, the odd byte pairs with the next data byte.*/
+        do
+        {
+            tmp_nb = tmp_nb->next;
+        }
+        while(tmp_nb->length == 0);
         d_ptr = tmp_nb->data_ptr;
         
         if(current_length & 1)
@@ -230,6 +246,55 @@ unsigned short fnet_checksum_pseudo_buf(char *buf, unsigned short buf_len, unsig
     return (unsigned short)(0xffff & ~sum);
 }
 
+/************************************************************************
+* NAME: fnet_checksum_copy
+*
+* DESCRIPTION: Copies 'len' bytes from 'src' to 'dest' and returns their 
+*              one's complement sum (not complemented), in one pass 
+*              when both buffers are word aligned.
+*
+*************************************************************************/
+unsigned short fnet_checksum_copy(void *dest, const void *src, int len)
+{
+    unsigned long   sum = 0;
+    unsigned long   carries = 0;
+    unsigned long   *d_ptr = (unsigned long *)dest;
+    const unsigned long *s_ptr = (const unsigned long *)src;
+    unsigned long   word;
+    
+    if((((unsigned long)dest | (unsigned long)src) & 3) == 0)
+    {
+        while((len -= 16) >= 0)
+        {
+            word = *s_ptr++; *d_ptr++ = word; FNET_CHECKSUM_ADD(sum, carries, word);
+            word = *s_ptr++; *d_ptr++ = word; FNET_CHECKSUM_ADD(sum, carries, word);
+            word = *s_ptr++; *d_ptr++ = word; FNET_CHECKSUM_ADD(sum, carries, word);
+            word = *s_ptr++; *d_ptr++ = word; FNET_CHECKSUM_ADD(sum, carries, word);
+        }
+        len += 16;
+        
+        while((len -= 4) >= 0)
+        {
+            word = *s_ptr++; *d_ptr++ = word; FNET_CHECKSUM_ADD(sum, carries, word);
+        }
+        len += 4;
+        
+        sum = (sum >> 16) + (sum & 0xffff) + carries;
+    }
+    
+    /* Unaligned buffers and the tail, starting at an even offset. */
+    if(len)
+    {
+        fnet_memcpy(d_ptr, s_ptr, (unsigned int)len);
+        sum = fnet_checksum_low(sum, len, (unsigned short *)d_ptr); 
+    }
+
+    sum = (sum >> 16) + (sum & 0xffff); /* Add in accumulated carries */
+    sum += sum >> 16;                   /* Add potential last carry   */
+
+    return (unsigned short)(sum);
+}
+
 /************************************************************************
 * NAME: fnet_checksum_pseudo_start
 *
@@ -240,7 +305,23 @@ unsigned short fnet_checksum_pseudo_buf(char *buf, unsigned short buf_len, unsig
 unsigned short fnet_checksum_pseudo_start( fnet_netbuf_t *nb,
                                            unsigned short protocol, unsigned short protocol_len )
 {
-    unsigned long sum = fnet_checksum_nb(nb, protocol_len);
+    return fnet_checksum_pseudo_start_partial(nb, protocol_len, 0, protocol, protocol_len);
+}
+
+/************************************************************************
+* NAME: fnet_checksum_pseudo_start_partial
+*
+* DESCRIPTION: Same as fnet_checksum_pseudo_start(), but sums only 
+*              the first 'len' (even) bytes of nb and adds 'sum_s', 
+*              the sum of the rest calculated before 
+*              (e.g. by fnet_checksum_copy()).
+*
+*************************************************************************/
+unsigned short fnet_checksum_pseudo_start_partial( fnet_netbuf_t *nb, int len, unsigned short sum_s,
+                                                   unsigned short protocol, unsigned short protocol_len )
+{
+    unsigned long sum = fnet_checksum_nb(nb, len);
+    sum += sum_s;
     sum += protocol + fnet_htons(protocol_len);
 
     sum = (sum >> 16) + (sum & 0xffff); /* Add in accumulated carries */
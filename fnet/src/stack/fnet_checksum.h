@@ -58,6 +58,10 @@ unsigned short fnet_checksum(fnet_netbuf_t * nb, int len);
 
 unsigned short fnet_checksum_pseudo_start( fnet_netbuf_t *nb,
                                            unsigned short protocol, unsigned short protocol_len );
+unsigned short fnet_checksum_pseudo_start_partial( fnet_netbuf_t *nb, int len, unsigned short sum_s,
+                                                   unsigned short protocol, unsigned short protocol_len );
+
+unsigned short fnet_checksum_copy(void *dest, const void *src, int len);
 
 unsigned short fnet_checksum_pseudo_end( unsigned short sum_s, char *ip_src, char *ip_dest, int addr_size );
 
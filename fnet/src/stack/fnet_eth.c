@@ -48,6 +48,7 @@
 #include "fnet_stdlib.h"
 #include "fnet.h"
 #include "fnet_prot.h"
+#include "fnet_isr.h"
 
 /************************************************************************
 *     Global Data Structures
@@ -215,12 +216,20 @@ ERROR:
 *
 * DESCRIPTION: Eth. network-layer input function.
 *************************************************************************/
-void fnet_eth_prot_input( fnet_netif_t *netif, fnet_netbuf_t *nb, unsigned short protocol )
+void fnet_eth_prot_input( fnet_netif_t *netif, fnet_netbuf_t *nb, unsigned short protocol, const fnet_mac_addr_t source_addr )
 {
     int i;
     
     if(netif && nb)
     {
+#if FNET_CFG_IP4 && FNET_CFG_ARP_LEARN_IP
+        /* Learn the MAC address of the IPv4 sender.*/
+        if(protocol == FNET_HTONS(FNET_ETH_TYPE_IP4))
+            fnet_arp_ip_learn(netif, nb, source_addr);
+#else
+        FNET_COMP_UNUSED_ARG(source_addr);
+#endif
+
         /* Find Network-layer protocol.*/
         for(i=0; i<FNET_ETH_PROT_IF_LIST_SIZE; i++)
         {
@@ -426,13 +435,18 @@ void fnet_eth_output_ip4(fnet_netif_t *netif, fnet_ip4_addr_t dest_ip_addr, fnet
     else
     /* Unicast address. */
     {
+        /* The ARP cache is updated by the Ethernet bottom half as well.*/
+        fnet_isr_lock();
+        
         if((dest_ptr = fnet_arp_lookup(netif, dest_ip_addr))!=0)
         {
             fnet_memcpy (destination_addr, *dest_ptr, sizeof(fnet_mac_addr_t));
+            fnet_isr_unlock();
         }
         else
         {
             fnet_arp_resolve(netif, dest_ip_addr, nb);
+            fnet_isr_unlock();
             goto EXIT;
         }
     }
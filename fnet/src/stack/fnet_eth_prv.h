@@ -143,7 +143,7 @@ void fnet_eth_change_addr_notify(fnet_netif_t *netif);
 
 void fnet_eth_output_low( fnet_netif_t *netif, unsigned short type, const fnet_mac_addr_t dest_addr,
                           fnet_netbuf_t *nb );
-void fnet_eth_prot_input( fnet_netif_t *netif, fnet_netbuf_t *nb, unsigned short protocol ); 
+void fnet_eth_prot_input( fnet_netif_t *netif, fnet_netbuf_t *nb, unsigned short protocol, const fnet_mac_addr_t source_addr ); 
 
 #if FNET_CFG_MULTICAST
     #if FNET_CFG_IP4 
@@ -210,12 +210,16 @@ int fnet_ip_output( fnet_netif_t *netif,    fnet_ip4_addr_t src_ip, fnet_ip4_add
         goto DROP;
     }
 
-    /* Construct IP header */
-    if((nb_header = fnet_netbuf_new(sizeof(fnet_ip_header_t), FNET_TRUE)) == 0)
+    total_length = (unsigned short)(nb->total_length + sizeof(fnet_ip_header_t)); /* total length*/
+
+    /* Construct IP header, in the headroom of the upper layer header if possible.*/
+    if((nb_header = fnet_netbuf_push(nb, sizeof(fnet_ip_header_t), FNET_TRUE)) == 0)
     {
         error_code = FNET_ERR_NOMEM;   
         goto DROP;
     }
+
+    nb = nb_header;
     
     /* Pseudo checksum. */
     if(checksum)
@@ -227,7 +231,6 @@ int fnet_ip_output( fnet_netif_t *netif,    fnet_ip4_addr_t src_ip, fnet_ip4_add
     ipheader->id = fnet_htons(ip_id++);              /* Id */
 
     ipheader->tos = tos;                 /* Type of service */
-    total_length = (unsigned short)(nb->total_length + sizeof(fnet_ip_header_t)); /* total length*/
     FNET_IP_HEADER_SET_HEADER_LENGTH(ipheader, sizeof(fnet_ip_header_t) >> 2);
     ipheader->flags_fragment_offset = 0x0000; /* flags & fragment offset field */
 
@@ -240,8 +243,6 @@ int fnet_ip_output( fnet_netif_t *netif,    fnet_ip4_addr_t src_ip, fnet_ip4_add
     ipheader->desination_addr = dest_ip; /* destination address */
 
     ipheader->total_length = fnet_htons((unsigned short)total_length);
-    
-    nb = fnet_netbuf_concat(nb_header, nb);
 
     if(total_length > netif->mtu) /* IP Fragmentation. */ 
     {
@@ -461,10 +462,15 @@ void fnet_ip_input_low( void )
     fnet_ip4_addr_t     destination_addr;
     unsigned long       total_length;
     unsigned long       header_length;
+    unsigned long       batch;
 
     fnet_isr_lock();
  
-    while((nb = fnet_ip_queue_read(&ip_queue, &netif)) != 0)
+    /* Process the datagrams queued so far. 
+     * Later datagrams raise the event again.*/
+    batch = fnet_ip_queue_length(&ip_queue);
+ 
+    while(batch-- && ((nb = fnet_ip_queue_read(&ip_queue, &netif)) != 0))
     {
         nb->next_chain = 0;
 
@@ -572,6 +578,7 @@ fnet_netbuf_t *fnet_ip_reassembly( fnet_netbuf_t ** nb_ptr )
     fnet_ip_frag_list_t     *frag_list_ptr;
     fnet_ip_frag_header_t   *frag_ptr, *cur_frag_ptr;
     fnet_netbuf_t           *nb = *nb_ptr;
+    fnet_netbuf_t           *nb_tail;
     fnet_netbuf_t           *tmp_nb;
     fnet_ip_header_t        *iphdr;
     int                     i;
@@ -705,15 +712,14 @@ fnet_netbuf_t *fnet_ip_reassembly( fnet_netbuf_t ** nb_ptr )
 
     /* Reconstruct datagram.*/
     frag_ptr = frag_list_ptr->frag_ptr;
-    nb = frag_ptr->nb;
-    frag_ptr = frag_ptr->next;
+    nb = 0;
 
-    while(frag_ptr != frag_list_ptr->frag_ptr)
+    do
     {
-        nb = fnet_netbuf_concat(nb, frag_ptr->nb);
+        fnet_netbuf_concat_tail(&nb, &nb_tail, frag_ptr->nb);
 
         frag_ptr = frag_ptr->next;
-    }
+    } while(frag_ptr != frag_list_ptr->frag_ptr);
 
     /* Reconstruct datagram header.*/
     iphdr = (fnet_ip_header_t *)frag_list_ptr->frag_ptr;
@@ -795,12 +801,7 @@ void fnet_ip_drain( void )
 
 #endif
 
-    while(((volatile fnet_netbuf_t *)ip_queue.head) != 0)
-    {
-        fnet_netbuf_del_chain(&ip_queue.head, ip_queue.head);
-    }
-
-    ip_queue.count = 0;
+    fnet_ip_queue_free(&ip_queue);
 
     fnet_isr_unlock();
 }
@@ -1424,32 +1425,27 @@ ERROR_SOCK:
 }
 
 /************************************************************************
-* NAME: ip_append_queue
+* NAME: fnet_ip_queue_append
 *
-* DESCRIPTION: Appends IP input queue.
+* DESCRIPTION: Appends IP input queue. The receiving interface is kept
+*              in the netbuf, no memory is allocated.
 *************************************************************************/
 int fnet_ip_queue_append( fnet_ip_queue_t *queue, fnet_netif_t *netif, fnet_netbuf_t *nb )
 {
-    fnet_netbuf_t *nb_netif;
-
     fnet_isr_lock();
 
-    if((nb->total_length + queue->count) > FNET_IP_QUEUE_COUNT_MAX)
+    if(((nb->total_length + queue->count) > FNET_IP_QUEUE_COUNT_MAX)
+        || ((queue->tail - queue->head) >= FNET_CFG_IP_QUEUE_SIZE))
     {
+        netif->rx_queue_drop++;
         goto ERROR;
     }
 
-    if((nb_netif = fnet_netbuf_new(sizeof(fnet_netif_t *), FNET_FALSE)) == 0)
-    {
-        goto ERROR;
-    }
-
-    nb_netif->data_ptr = (void *)netif;
+    nb->netif = netif;
 
     queue->count += nb->total_length;
-
-    nb = fnet_netbuf_concat(nb_netif, nb);
-    fnet_netbuf_add_chain(&queue->head, nb);
+    queue->ring[queue->tail & (FNET_CFG_IP_QUEUE_SIZE - 1)] = nb;
+    queue->tail++;
     fnet_isr_unlock();
 
     return FNET_OK;
@@ -1460,34 +1456,60 @@ ERROR:
 }
 
 /************************************************************************
-* NAME: ip_read_queue
+* NAME: fnet_ip_queue_read
 *
 * DESCRIPTION: Reads a IP datagram from IP input queue.
 *************************************************************************/
 fnet_netbuf_t *fnet_ip_queue_read( fnet_ip_queue_t *queue, fnet_netif_t ** netif )
 {
     fnet_netbuf_t *nb;
-    fnet_netbuf_t *nb_netif;
 
-    if((nb_netif = queue->head) != 0)
-    {
-        nb = nb_netif->next;
-
-        *netif = ((fnet_netif_t *)(nb_netif->data_ptr));
-
-        fnet_isr_lock();
+    fnet_isr_lock();
 
-        if(nb)
-            queue->count -= nb->total_length;
+    if(queue->head != queue->tail)
+    {
+        nb = queue->ring[queue->head & (FNET_CFG_IP_QUEUE_SIZE - 1)];
+        queue->head++;
+        queue->count -= nb->total_length;
 
-        nb_netif->next = 0;
-        fnet_netbuf_del_chain(&queue->head, nb_netif);
-        fnet_isr_unlock();
+        *netif = nb->netif;
     }
     else
         nb = 0;
 
+    fnet_isr_unlock();
+
     return nb;
 }
 
+/************************************************************************
+* NAME: fnet_ip_queue_length
+*
+* DESCRIPTION: Returns number of datagrams in IP input queue.
+*************************************************************************/
+unsigned long fnet_ip_queue_length( fnet_ip_queue_t *queue )
+{
+    return (queue->tail - queue->head);
+}
+
+/************************************************************************
+* NAME: fnet_ip_queue_free
+*
+* DESCRIPTION: Frees all datagrams in IP input queue.
+*************************************************************************/
+void fnet_ip_queue_free( fnet_ip_queue_t *queue )
+{
+    fnet_netbuf_t *nb;
+    fnet_netif_t *netif;
+
+    fnet_isr_lock();
+
+    while((nb = fnet_ip_queue_read(queue, &netif)) != 0)
+    {
+        fnet_netbuf_free_chain(nb);
+    }
+
+    fnet_isr_unlock();
+}
+
 
@@ -509,10 +509,15 @@ static void fnet_ip6_input_low( void )
     fnet_ip6_addr_t     *source_addr;
     fnet_ip6_addr_t     *destination_addr;
     unsigned short      payload_length;    
+    unsigned long       batch;
 
     fnet_isr_lock();
  
-    while((nb = fnet_ip_queue_read(&ip6_queue, &netif)) != 0)
+    /* Process the datagrams queued so far. 
+     * Later datagrams raise the event again.*/
+    batch = fnet_ip_queue_length(&ip6_queue);
+ 
+    while(batch-- && ((nb = fnet_ip_queue_read(&ip6_queue, &netif)) != 0))
     {
         fnet_netbuf_t   *ip6_nb = FNET_NULL;
         
@@ -935,6 +940,7 @@ int fnet_ip6_output( fnet_netif_t *netif /*optional*/, fnet_ip6_addr_t *src_ip /
     fnet_netbuf_t       *nb_header;
     fnet_ip6_header_t   *ip6_header;
     unsigned long       mtu;
+    unsigned long       payload_length;
 
 
     /* Validate destination address. */
@@ -999,8 +1005,16 @@ int fnet_ip6_output( fnet_netif_t *netif /*optional*/, fnet_ip6_addr_t *src_ip /
     if(checksum)
         *checksum = fnet_checksum_pseudo_end( *checksum, (char *)src_ip, (char *)dest_ip, sizeof(fnet_ip6_addr_t) );    
     
+    mtu = netif->nd6_if_ptr  ? netif->nd6_if_ptr->mtu : netif->mtu;
+    payload_length = nb->total_length;
+    
     /****** Construct IP header. ******/
-    if((nb_header = fnet_netbuf_new(sizeof(fnet_ip6_header_t), FNET_TRUE)) == 0)
+    if(payload_length + sizeof(fnet_ip6_header_t) > mtu)
+        nb_header = fnet_netbuf_new(sizeof(fnet_ip6_header_t), FNET_TRUE); /* Copied into each fragment.*/
+    else
+        nb_header = fnet_netbuf_push(nb, sizeof(fnet_ip6_header_t), FNET_TRUE); /* In the headroom if possible.*/
+    
+    if(nb_header == 0)
     {
         error_code = FNET_ERR_NOMEM;   
         goto DROP;
@@ -1011,7 +1025,7 @@ int fnet_ip6_output( fnet_netif_t *netif /*optional*/, fnet_ip6_addr_t *src_ip /
     ip6_header->version__tclass = FNET_IP6_VERSION<<4;
     ip6_header->tclass__flowl = 0;
     ip6_header->flowl = 0;
-    ip6_header->length = fnet_htons((unsigned short)nb->total_length);
+    ip6_header->length = fnet_htons((unsigned short)payload_length);
     ip6_header->next_header = protocol;
     
     /* Set Hop Limit.*/
@@ -1023,11 +1037,7 @@ int fnet_ip6_output( fnet_netif_t *netif /*optional*/, fnet_ip6_addr_t *src_ip /
     FNET_IP6_ADDR_COPY(src_ip, &ip6_header->source_addr);
     FNET_IP6_ADDR_COPY(dest_ip, &ip6_header->destination_addr);
     
-    //nb = fnet_netbuf_concat(nb_header, nb);
-    
-    mtu = netif->nd6_if_ptr  ? netif->nd6_if_ptr->mtu : netif->mtu;
-    
-    if(nb->total_length + nb_header->total_length > mtu) /* IP Fragmentation. */ 
+    if(payload_length + sizeof(fnet_ip6_header_t) > mtu) /* IP Fragmentation. */ 
     {
 
 #if FNET_CFG_IP6_FRAGMENTATION
@@ -1178,7 +1188,7 @@ FRAG_END:
     }
     else
     {
-        nb = fnet_netbuf_concat(nb_header, nb);
+        nb = nb_header;
         fnet_ip6_netif_output(netif, src_ip, dest_ip, nb);
     }
     
@@ -1387,6 +1397,7 @@ static fnet_netbuf_t *fnet_ip6_reassembly(fnet_netif_t *netif, fnet_netbuf_t **
     fnet_ip6_frag_header_t      *frag_ptr;
     fnet_ip6_frag_header_t      *cur_frag_ptr;
     fnet_netbuf_t               *nb = *nb_p;
+    fnet_netbuf_t               *nb_tail;
     fnet_netbuf_t               *tmp_nb;
     fnet_ip6_header_t           *iphdr = (fnet_ip6_header_t *)ip6_nb->data_ptr;
     int                         i;
@@ -1553,15 +1564,14 @@ static fnet_netbuf_t *fnet_ip6_reassembly(fnet_netif_t *netif, fnet_netbuf_t **
 
     /* Reconstruct datagram.*/
     frag_ptr = frag_list_ptr->frag_ptr;
-    nb = frag_ptr->nb;
-    frag_ptr = frag_ptr->next;
+    nb = 0;
 
-    while(frag_ptr != frag_list_ptr->frag_ptr)
+    do
     {
-        nb = fnet_netbuf_concat(nb, frag_ptr->nb);
+        fnet_netbuf_concat_tail(&nb, &nb_tail, frag_ptr->nb);
 
         frag_ptr = frag_ptr->next;
-    }
+    } while(frag_ptr != frag_list_ptr->frag_ptr);
 
     /* Reconstruct datagram header.*/
     iphdr = (fnet_ip6_header_t *)ip6_nb->data_ptr;
@@ -1701,12 +1711,7 @@ void fnet_ip6_drain( void )
 
 #endif
 
-    while(((volatile fnet_netbuf_t *)ip6_queue.head) != 0)
-    {
-        fnet_netbuf_del_chain(&ip6_queue.head, ip6_queue.head);
-    }
-
-    ip6_queue.count = 0;
+    fnet_ip_queue_free(&ip6_queue);
 
     fnet_isr_unlock();
 }
@@ -231,7 +231,9 @@ FNET_COMP_PACKED_END
 
 typedef struct                            /* IP input queue.*/
 {
-    fnet_netbuf_t *head;                  /* Pointer to the queue head.*/
+    fnet_netbuf_t *ring[FNET_CFG_IP_QUEUE_SIZE]; /* Queued datagrams.*/
+    unsigned long head;                   /* Read index (free running).*/
+    unsigned long tail;                   /* Write index (free running).*/
     unsigned long count;                  /* Number of data in buffer.*/
 } fnet_ip_queue_t;
 
@@ -252,6 +254,8 @@ void fnet_ip_drain( void );
 
 int fnet_ip_queue_append( fnet_ip_queue_t *queue, fnet_netif_t *netif, fnet_netbuf_t *nb );
 fnet_netbuf_t *fnet_ip_queue_read( fnet_ip_queue_t *queue, fnet_netif_t ** netif );
+unsigned long fnet_ip_queue_length( fnet_ip_queue_t *queue );
+void fnet_ip_queue_free( fnet_ip_queue_t *queue );
 
 #if FNET_CFG_MULTICAST
     fnet_ip_multicast_list_entry_t *fnet_ip_multicast_join( fnet_netif_t *netif, fnet_ip4_addr_t group_addr );
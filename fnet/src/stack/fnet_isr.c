@@ -55,7 +55,6 @@
 *************************************************************************/
 typedef struct fnet_isr_entry
 {
-    struct fnet_isr_entry   *next;                      /* Next isr in chain */
     unsigned int            vector_number;              /* Vector number */
     void                    (*handler_top)( void );     /* "Critical handler" - it will 
                                                         * be called every time on interrupt event, 
@@ -64,21 +63,123 @@ typedef struct fnet_isr_entry
     void                    (*handler_bottom)( void ); /* "Bottom half handler" - it will be called after 
                                                         *  isr_handler_top() in case NO SW lock 
                                                         *  or on SW unlock.*/
-    unsigned int            pended;                    /* indicates interrupt pending */
+    unsigned int            priority;                   /* Priority of the vector, 
+                                                        *  FNET_ISR_EVENT_PRIORITY for events.*/
 } fnet_isr_entry_t;
 
+/* Maximum number of registered vectors and events (< 32, one bit per entry).*/
+#define FNET_ISR_ENTRY_MAX      (16)
+
+/* Size of the vector-to-entry map: HW vectors followed by the events.*/
+#define FNET_ISR_INDEX_SIZE     (FNET_CFG_CPU_VECTOR_NUMBER_MAX + FNET_EVENT_NUMBER)
+
+#if FNET_ISR_ENTRY_MAX > 31
+    #error "FNET_ISR_ENTRY_MAX must be lower than 32."
+#endif
+
+#if FNET_CFG_CPU_VECTOR_NUMBER_MAX > FNET_EVENT_VECTOR_NUMBER
+    #error "FNET_CFG_CPU_VECTOR_NUMBER_MAX must not be higher than FNET_EVENT_VECTOR_NUMBER."
+#endif
+
+/* Events have no interrupt priority, their bottom halves run after 
+ * the ones of the HW vectors.*/
+#define FNET_ISR_EVENT_PRIORITY     (0)
+
+/* Pending bit of the entry. The entry 0 is the MSB, 
+ * so the count-leading-zeros of a mask gives the first entry.*/
+#define FNET_ISR_ENTRY_BIT(entry)   (0x80000000UL >> (entry))
+
+/* Pending bits of the entry and of all entries after it.*/
+#define FNET_ISR_ENTRY_BITS(entry)  (0xFFFFFFFFUL >> (entry))
+
+#if FNET_CFG_COMP_GCC
+    #define FNET_ISR_CLZ(x)     ((unsigned int)__builtin_clz((unsigned int)(x)))
+#else
+    #define FNET_ISR_CLZ(x)     fnet_isr_clz(x)
+#endif
+
 /************************************************************************
 *     Function Prototypes
 *************************************************************************/
-static int fnet_isr_register( unsigned int vector_number, void (*handler_top)(void), void (*handler_bottom)( void ));
+static int fnet_isr_register( unsigned int vector_number, void (*handler_top)(void), void (*handler_bottom)( void ), unsigned int priority );
+static int fnet_isr_index( unsigned int vector_number );
+static void fnet_isr_remove( unsigned int entry );
+#if !FNET_CFG_COMP_GCC
+static unsigned int fnet_isr_clz( unsigned long x );
+#endif
 
 
 /************************************************************************
 *     Variables,
 *************************************************************************/
 static unsigned long fnet_locked = 0;
-static fnet_isr_entry_t *fnet_isr_table = 0;
+static fnet_isr_entry_t fnet_isr_table[FNET_ISR_ENTRY_MAX]; /* Sorted by priority, highest first.*/
+static unsigned char fnet_isr_map[FNET_ISR_INDEX_SIZE];   /* Entry number + 1, 0 if not registered.*/
+static unsigned int fnet_isr_count = 0;                     /* Number of registered entries.*/
+static volatile unsigned long fnet_isr_pended = 0;          /* Bitmask of pended bottom halves.*/
 
+#if !FNET_CFG_COMP_GCC
+/************************************************************************
+* NAME: fnet_isr_clz
+*
+* DESCRIPTION: Counts leading zeros of the non-zero 32-bit value.
+*************************************************************************/
+static unsigned int fnet_isr_clz( unsigned long x )
+{
+    unsigned int n = 0;
+
+    if(!(x & 0xFFFF0000UL)) { n += 16; x <<= 16; }
+    if(!(x & 0xFF000000UL)) { n += 8; x <<= 8; }
+    if(!(x & 0xF0000000UL)) { n += 4; x <<= 4; }
+    if(!(x & 0xC0000000UL)) { n += 2; x <<= 2; }
+    if(!(x & 0x80000000UL)) { n += 1; }
+
+    return n;
+}
+#endif
+
+/************************************************************************
+* NAME: fnet_isr_index
+*
+* DESCRIPTION: Returns position of the vector in fnet_isr_map, 
+*              or -1 if the vector number is out of range.
+*************************************************************************/
+static int fnet_isr_index( unsigned int vector_number )
+{
+    int index;
+
+    if(vector_number < FNET_CFG_CPU_VECTOR_NUMBER_MAX)
+    {
+        index = (int)vector_number;
+    }
+    else if((vector_number >= FNET_EVENT_VECTOR_NUMBER) 
+            && (vector_number < (FNET_EVENT_VECTOR_NUMBER + FNET_EVENT_NUMBER)))
+    {
+        index = (int)(FNET_CFG_CPU_VECTOR_NUMBER_MAX + (vector_number - FNET_EVENT_VECTOR_NUMBER));
+    }
+    else
+    {
+        index = -1;
+    }
+
+    return index;
+}
+
+/************************************************************************
+* NAME: fnet_isr_pend
+*
+* DESCRIPTION: Sets/clears pending bits. The mask is shared by  
+*              interrupts of different priorities, so it is changed 
+*              with IRQs disabled.
+*************************************************************************/
+static void fnet_isr_pend( unsigned long set, unsigned long clear )
+{
+    fnet_cpu_irq_desc_t irq_desc;
+
+    irq_desc = fnet_cpu_irq_disable();
+    fnet_isr_pended = (fnet_isr_pended & ~clear) | set;
+    fnet_cpu_irq_enable(irq_desc);
+}
 
 /************************************************************************
 * NAME: fnet_isr_handler
@@ -89,37 +190,40 @@ static fnet_isr_entry_t *fnet_isr_table = 0;
 *************************************************************************/
 void fnet_isr_handler( int vector_number )
 {
-    fnet_isr_entry_t *isr_cur;
+    int                 index;
+    unsigned int        entry;
+    fnet_isr_entry_t    *isr_cur;
 
     /* This function operates as follows:
-     * Searches through linked list of ISR Descriptor Table entries until
-     * match is found with vector_number. Calls handler_top().
+     * Looks up the ISR Descriptor Table entry of vector_number in fnet_isr_map.
+     * Calls handler_top().
      * If local global "fnet_locked" is set, flags this interrupt as "pended" and exits.
      * Else, clears this interrupt's "pended" flag, executes handler_bottom() and exits.
      * NOTE: fnet_locked is incremented by fnet_isr_lock() and
      * decremented by fnet_isr_unlock().
      */
 
-    for (isr_cur = fnet_isr_table; isr_cur; isr_cur = isr_cur->next)
+    index = fnet_isr_index((unsigned int)vector_number);
+
+    if((index >= 0) && fnet_isr_map[index]) /* we got it. */
     {
-        if(isr_cur->vector_number == vector_number) /* we got it. */
-        {
-            if(isr_cur->handler_top)
-                isr_cur->handler_top();         /* Call "top half" handler; */
+        entry = (unsigned int)(fnet_isr_map[index] - 1);
+        isr_cur = &fnet_isr_table[entry];
 
-            if(fnet_locked)
-            {
-                isr_cur->pended = 1;
-            }
-            else
-            {
-                isr_cur->pended = 0;
+        if(isr_cur->handler_top)
+            isr_cur->handler_top();         /* Call "top half" handler; */
 
-                if(isr_cur->handler_bottom)
-                    isr_cur->handler_bottom(); /* Call "bottom half" handler;*/
-            }
+        if(fnet_locked)
+        {
+            fnet_isr_pend(FNET_ISR_ENTRY_BIT(entry), 0);
+        }
+        else
+        {
+            if(fnet_isr_pended & FNET_ISR_ENTRY_BIT(entry))
+                fnet_isr_pend(0, FNET_ISR_ENTRY_BIT(entry));
 
-            break;
+            if(isr_cur->handler_bottom)
+                isr_cur->handler_bottom(); /* Call "bottom half" handler;*/
         }
     }
 }
@@ -141,7 +245,7 @@ int fnet_isr_vector_init( unsigned int vector_number, void (*handler_top)( void
 
     if(result == FNET_OK)
     {
-        result = fnet_isr_register(vector_number, handler_top, handler_bottom);
+        result = fnet_isr_register(vector_number, handler_top, handler_bottom, priority);
     }
 
     return result;
@@ -157,7 +261,7 @@ int fnet_event_init( fnet_event_t event_number, void (*event_handler)( void ))
     int             result;
     unsigned int    vector_number = (unsigned int)(FNET_EVENT_VECTOR_NUMBER + event_number);
 
-    result = fnet_isr_register(vector_number, 0, event_handler);
+    result = fnet_isr_register(vector_number, 0, event_handler, FNET_ISR_EVENT_PRIORITY);
 
     return result;
 }
@@ -166,31 +270,86 @@ int fnet_event_init( fnet_event_t event_number, void (*event_handler)( void ))
 * NAME: fnet_isr_register
 *
 * DESCRIPTION: Register 'handler' at the isr table.
+*              The table is kept sorted by priority, so that the pended 
+*              bottom halves of higher priority vectors are executed 
+*              first. Entries of the same priority are executed in 
+*              registration order.
 *************************************************************************/
-static int fnet_isr_register( unsigned int vector_number, void (*handler_top)( void ), void (*handler_bottom)( void ) )
+static int fnet_isr_register( unsigned int vector_number, void (*handler_top)( void ), void (*handler_bottom)( void ), unsigned int priority )
 {
-    int                 result;
+    int                 result = FNET_ERR;
+    int                 index;
+    unsigned int        entry;
+    unsigned int        i;
     fnet_isr_entry_t    *isr_temp;
+    fnet_cpu_irq_desc_t irq_desc;
 
-    isr_temp = (fnet_isr_entry_t *)fnet_malloc(sizeof(fnet_isr_entry_t));
+    index = fnet_isr_index(vector_number);
 
-    if(isr_temp)
+    if(index >= 0)
     {
-        isr_temp->vector_number = vector_number;
-        isr_temp->handler_top = (void (*)(void))handler_top;
-        isr_temp->handler_bottom = (void (*)(void))handler_bottom;
-        isr_temp->next = fnet_isr_table;
-        isr_temp->pended = 0;
-        fnet_isr_table = isr_temp;
-        
-        result = FNET_OK;
+        /* The entries move, while the vectors may fire.*/
+        irq_desc = fnet_cpu_irq_disable();
+
+        /* Re-registration replaces the handlers and the priority.*/
+        if(fnet_isr_map[index])
+            fnet_isr_remove((unsigned int)(fnet_isr_map[index] - 1));
+
+        if(fnet_isr_count < FNET_ISR_ENTRY_MAX)
+        {
+            /* After the entries of the same or higher priority.*/
+            for(entry = 0; (entry < fnet_isr_count) && (fnet_isr_table[entry].priority >= priority); entry++)
+            {}
+
+            for(i = fnet_isr_count; i > entry; i--)
+            {
+                fnet_isr_table[i] = fnet_isr_table[i - 1];
+                fnet_isr_map[fnet_isr_index(fnet_isr_table[i].vector_number)] = (unsigned char)(i + 1);
+            }
+            fnet_isr_pended = (fnet_isr_pended & ~FNET_ISR_ENTRY_BITS(entry)) 
+                              | ((fnet_isr_pended & FNET_ISR_ENTRY_BITS(entry)) >> 1);
+            fnet_isr_count++;
+
+            isr_temp = &fnet_isr_table[entry];
+            
+            isr_temp->vector_number = vector_number;
+            isr_temp->handler_top = (void (*)(void))handler_top;
+            isr_temp->handler_bottom = (void (*)(void))handler_bottom;
+            isr_temp->priority = priority;
+            
+            fnet_isr_map[index] = (unsigned char)(entry + 1);
+            
+            result = FNET_OK;
+        }
+
+        fnet_cpu_irq_enable(irq_desc);
     }
-    else
-        result = FNET_ERR;
 
     return result;
 }
 
+/************************************************************************
+* NAME: fnet_isr_remove
+*
+* DESCRIPTION: Removes the entry from the isr table, the following 
+*              entries move up. It must be called with IRQs disabled.
+*************************************************************************/
+static void fnet_isr_remove( unsigned int entry )
+{
+    unsigned int i;
+
+    fnet_isr_map[fnet_isr_index(fnet_isr_table[entry].vector_number)] = 0;
+
+    for(i = entry + 1; i < fnet_isr_count; i++)
+    {
+        fnet_isr_table[i - 1] = fnet_isr_table[i];
+        fnet_isr_map[fnet_isr_index(fnet_isr_table[i - 1].vector_number)] = (unsigned char)i;
+    }
+    fnet_isr_pended = (fnet_isr_pended & ~FNET_ISR_ENTRY_BITS(entry)) 
+                      | ((fnet_isr_pended & FNET_ISR_ENTRY_BITS(entry + 1)) << 1);
+    fnet_isr_count--;
+}
+
 /************************************************************************
 * NAME: fnet_isr_vector_release
 *
@@ -201,42 +360,19 @@ static int fnet_isr_register( unsigned int vector_number, void (*handler_top)( v
 *************************************************************************/
 void fnet_isr_vector_release( unsigned int vector_number)
 {
-    fnet_isr_entry_t *isr_temp;
-
-    isr_temp = fnet_isr_table;
+    int                 index;
+    fnet_cpu_irq_desc_t irq_desc;
 
-    while(isr_temp != 0)
-    {
-        if(isr_temp->vector_number == vector_number)
-            break;
-
-        isr_temp = isr_temp->next;
-    }
+    index = fnet_isr_index(vector_number);
 
-    if(isr_temp != 0)       /* if handler wasn't registered in queue */
+    if(index >= 0)
     {
+        irq_desc = fnet_cpu_irq_disable();
 
-        fnet_free(isr_temp);
+        if(fnet_isr_map[index])       /* if handler was registered in table */
+            fnet_isr_remove((unsigned int)(fnet_isr_map[index] - 1));
 
-        if(fnet_isr_table->vector_number == vector_number)
-        {
-            fnet_isr_table = fnet_isr_table->next;
-        }
-        else
-        {
-            isr_temp = fnet_isr_table;
-
-            while(isr_temp->next != 0)
-            {
-                if(isr_temp->next->vector_number == vector_number)
-                {
-                    isr_temp->next = isr_temp->next->next;
-                    break;
-                }
-
-                isr_temp = isr_temp->next;
-            }
-        }
+        fnet_cpu_irq_enable(irq_desc);
     }
 }
 
@@ -259,12 +395,14 @@ void fnet_isr_lock( void )
 *************************************************************************/
 void fnet_isr_unlock( void )
 {
-    fnet_isr_entry_t *isr_temp;
+    unsigned int        entry;
+    fnet_isr_entry_t    *isr_temp;
 	
 	/* This function operates as follows:
     * If local global "fnet_locked" == 0 then it simply returns.
     * Else, if fnet_locked == 1 (at topmost lock level), 
-    * index through ISR Descriptor Table until 1st pended interrupt is found.
+    * takes the first pended entry from the pending bitmask, that is 
+    * the one of the highest priority.
     * Clear pended status and call associated handler_bottom().
     * Continue to do this until all pended interrupts have been handled.
     *Always exits by decrementing fnet_locked so as to bump up a lock level.
@@ -272,19 +410,15 @@ void fnet_isr_unlock( void )
 
     if(fnet_locked == 1)
     {
-        isr_temp = fnet_isr_table;
-
-        while(isr_temp != 0)
+        while(fnet_isr_pended)
         {
-            if(isr_temp->pended)
-            {
-                isr_temp->pended = 0;
+            entry = FNET_ISR_CLZ(fnet_isr_pended);
+            fnet_isr_pend(0, FNET_ISR_ENTRY_BIT(entry));
 
-                if(isr_temp->handler_bottom)
-                    isr_temp->handler_bottom();
-            }
+            isr_temp = &fnet_isr_table[entry];
 
-            isr_temp = isr_temp->next;
+            if(isr_temp->handler_bottom)
+                isr_temp->handler_bottom();
         }
     }
 
@@ -299,33 +433,32 @@ void fnet_isr_unlock( void )
 void fnet_event_raise( fnet_event_t event_number )
 {
     unsigned int        vector_number = (unsigned int)(FNET_EVENT_VECTOR_NUMBER + event_number);
+    int                 index;
+    unsigned int        entry;
     fnet_isr_entry_t    *isr_temp;
 
-    isr_temp = fnet_isr_table;
+    index = fnet_isr_index(vector_number);
 
     fnet_isr_lock();
 
-    while(isr_temp != 0)
+    if((index >= 0) && fnet_isr_map[index])
     {
-        if(isr_temp->vector_number == vector_number)
-        {
-            if(isr_temp->handler_top)
-                isr_temp->handler_top();
+        entry = (unsigned int)(fnet_isr_map[index] - 1);
+        isr_temp = &fnet_isr_table[entry];
 
-            if(fnet_locked == 1)
-            {
-                isr_temp->pended = 0;
+        if(isr_temp->handler_top)
+            isr_temp->handler_top();
 
-                if(isr_temp->handler_bottom)
-                    isr_temp->handler_bottom();
-            }
-            else
-                isr_temp->pended = 1;
+        if(fnet_locked == 1)
+        {
+            if(fnet_isr_pended & FNET_ISR_ENTRY_BIT(entry))
+                fnet_isr_pend(0, FNET_ISR_ENTRY_BIT(entry));
 
-            break;
+            if(isr_temp->handler_bottom)
+                isr_temp->handler_bottom();
         }
-
-        isr_temp = isr_temp->next;
+        else
+            fnet_isr_pend(FNET_ISR_ENTRY_BIT(entry), 0);
     }
 
     fnet_isr_unlock();
@@ -340,5 +473,7 @@ void fnet_event_raise( fnet_event_t event_number )
 void fnet_isr_init()
 {
     fnet_locked = 0;
-    fnet_isr_table = 0;
+    fnet_isr_count = 0;
+    fnet_isr_pended = 0;
+    fnet_memset_zero(fnet_isr_map, sizeof(fnet_isr_map));
 }
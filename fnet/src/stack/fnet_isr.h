@@ -57,10 +57,11 @@ typedef enum
 {
     FNET_EVENT_ARP,
     FNET_EVENT_IP,
-    FNET_EVENT_IP6
+    FNET_EVENT_IP6,
     /*
     * Add your events here.
     */
+    FNET_EVENT_NUMBER   /* Number of events. It must be the last.*/
 }
 fnet_event_t;
 
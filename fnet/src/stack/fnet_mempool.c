@@ -42,6 +42,9 @@
 ***************************************************************************/
 
 #include "fnet.h"
+
+#if !FNET_CFG_MEMPOOL_TLSF /* The TLSF version is in fnet_mempool_tlsf.c */
+
 #include "fnet_mempool.h"
 #include "fnet_isr.h"
 
@@ -164,6 +167,15 @@ void fnet_mempool_free( fnet_mempool_desc_t mpool, void *ap )
     }
 #endif
 
+        if(mempool->free_ptr == 0)
+        {
+            /* The free list is empty, the block makes a new one.*/
+            bp->ptr = bp;
+            mempool->free_ptr = bp;
+            fnet_isr_unlock();
+            return;
+        }
+
         for (p = mempool->free_ptr; !((bp > p) && (bp < p->ptr)); p = p->ptr)
         {
             
@@ -185,8 +197,18 @@ void fnet_mempool_free( fnet_mempool_desc_t mpool, void *ap )
 
         if((fnet_mempool_unit_header_t *)((unsigned long)bp + bp->size*mempool->unit_size) == p->ptr)
         {
-            bp->size += p->ptr->size;
-            bp->ptr = p->ptr->ptr;
+            if(p->ptr == p)
+            {
+                /* The only free block follows the freed one, it becomes part of it.*/
+                bp->size += p->size;
+                bp->ptr = bp;
+                p = bp;
+            }
+            else
+            {
+                bp->size += p->ptr->size;
+                bp->ptr = p->ptr->ptr;
+            }
         }
         else
         {
@@ -235,7 +257,7 @@ void *fnet_mempool_malloc(fnet_mempool_desc_t mpool, unsigned nbytes )
     best_p_prev = prevp;
     
     /* Find the best one. */
-    for(p = prevp->ptr; ; prevp = p, p = p->ptr)
+    for(p = (prevp ? prevp->ptr : 0); p; prevp = p, p = p->ptr)
     {
         if( (p->size >= nunits) && ( (best_p==0) || ((best_p)&&(best_p->size > p->size)) ) )
         {
@@ -251,7 +273,10 @@ void *fnet_mempool_malloc(fnet_mempool_desc_t mpool, unsigned nbytes )
     {
         if(best_p->size == nunits)
         {
-            best_p_prev->ptr = best_p->ptr;
+            if(best_p_prev == best_p)
+                best_p_prev = 0; /* It was the last free block. */
+            else
+                best_p_prev->ptr = best_p->ptr;
         }
         else
         {
@@ -313,13 +338,16 @@ void *fnet_mempool_malloc(fnet_mempool_desc_t mpool, unsigned nbytes )
 
     prevp = mempool->free_ptr;
 
-    for (p = prevp->ptr; ; prevp = p, p = p->ptr)
+    for (p = (prevp ? prevp->ptr : 0); p; prevp = p, p = p->ptr)
     {
         if(p->size >= nunits)
         {
             if(p->size == nunits)
             {
-                prevp->ptr = p->ptr;
+                if(prevp == p)
+                    prevp = 0; /* It was the last free block. */
+                else
+                    prevp->ptr = p->ptr;
             }
             else
             {
@@ -366,7 +394,10 @@ unsigned long fnet_mempool_free_mem_status( fnet_mempool_desc_t mpool)
     t_mem = mempool->free_ptr;
 
     if(t_mem == 0)
+    {
+        fnet_isr_unlock();
         return 0;
+    }
 
     total_size += t_mem->size;
     /* FNET_DEBUG("%d,",t_mem->size*sizeof(FNET_ALLOC_HDR_T));*/
@@ -402,7 +433,10 @@ unsigned long fnet_mempool_malloc_max( fnet_mempool_desc_t mpool )
     t_mem = mempool->free_ptr;
 
     if(t_mem == 0)
+    {
+        fnet_isr_unlock();
         return 0;
+    }
 
     max = t_mem->size;
     /*FNET_DEBUG("%d,", t_mem->size * sizeof(FNET_ALLOC_HDR_T));*/
@@ -421,7 +455,8 @@ unsigned long fnet_mempool_malloc_max( fnet_mempool_desc_t mpool )
 
     fnet_isr_unlock();
 
-    return (max * mempool->unit_size);
+    /* The first unit of a block is its header.*/
+    return ((max - 1) * mempool->unit_size);
 }
 
 #if 0 /* For Debug needs.*/
@@ -467,3 +502,5 @@ int fnet_mempool_check( fnet_mempool_desc_t mpool )
 }
 #endif
  
+
+#endif /* !FNET_CFG_MEMPOOL_TLSF */
@@ -0,0 +1,470 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file fnet_mempool_tlsf.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief FNET memory pool functions, TLSF version.
+*
+***************************************************************************/
+
+#include "fnet.h"
+
+#if FNET_CFG_MEMPOOL_TLSF
+
+#include "fnet_mempool.h"
+#include "fnet_isr.h"
+
+/* Two-Level Segregated Fit allocator.
+ * Free blocks are kept on lists indexed by a power of two (first level)
+ * subdivided linearly into FNET_MEMPOOL_SL_COUNT ranges (second level).
+ * Two bitmaps tell which lists are not empty, so both malloc and free
+ * take constant time. Freed blocks are merged with free neighbours at once.
+ * Only a request that no list is sure to fit looks through the blocks
+ * of its own list, before it fails. */
+
+#define FNET_MEMPOOL_ALIGN_SIZE         (8)         /* Block alignment.*/
+#define FNET_MEMPOOL_SL_COUNT_LOG2      (2)         /* Second level lists per power of two. */
+#define FNET_MEMPOOL_SL_COUNT           (1 << FNET_MEMPOOL_SL_COUNT_LOG2)
+#define FNET_MEMPOOL_FL_SHIFT           (FNET_MEMPOOL_SL_COUNT_LOG2 + 3)
+#define FNET_MEMPOOL_SMALL_BLOCK_SIZE   (1 << FNET_MEMPOOL_FL_SHIFT)
+#define FNET_MEMPOOL_FL_MAX             (16)        /* Largest block is below 2^(FL_MAX+1). */
+#define FNET_MEMPOOL_FL_COUNT           (FNET_MEMPOOL_FL_MAX - FNET_MEMPOOL_FL_SHIFT + 2)
+
+#define FNET_MEMPOOL_BLOCK_FREE         (0x1)       /* Flag in the size field. */
+#define FNET_MEMPOOL_BLOCK_SIZE_MASK    (~(unsigned long)(FNET_MEMPOOL_ALIGN_SIZE - 1))
+
+/* Block header. The free list links exist in free blocks only,
+ * in allocated blocks the user data starts there. */
+typedef struct fnet_mempool_block
+{
+    struct fnet_mempool_block   *prev_phys;     /* Previous block in memory. */
+    unsigned long               size;           /* Block size, with header, and flags. */
+    struct fnet_mempool_block   *next_free;
+    struct fnet_mempool_block   *prev_free;
+} fnet_mempool_block_t;
+
+#define FNET_MEMPOOL_BLOCK_OVERHEAD     ((unsigned long)&((fnet_mempool_block_t *)0)->next_free)
+#define FNET_MEMPOOL_BLOCK_SIZE_MIN     ((sizeof(fnet_mempool_block_t) + FNET_MEMPOOL_ALIGN_SIZE - 1) & FNET_MEMPOOL_BLOCK_SIZE_MASK)
+#define FNET_MEMPOOL_BLOCK_SIZE_MAX     ((1UL << (FNET_MEMPOOL_FL_MAX + 1)) - FNET_MEMPOOL_ALIGN_SIZE)
+
+#define fnet_mempool_block_size(block)  ((block)->size & FNET_MEMPOOL_BLOCK_SIZE_MASK)
+#define fnet_mempool_block_is_free(block)  ((block)->size & FNET_MEMPOOL_BLOCK_FREE)
+#define fnet_mempool_block_next(block)  ((fnet_mempool_block_t *)((unsigned long)(block) + fnet_mempool_block_size(block)))
+#define fnet_mempool_block_to_ptr(block) ((void *)((unsigned long)(block) + FNET_MEMPOOL_BLOCK_OVERHEAD))
+#define fnet_mempool_block_from_ptr(ptr) ((fnet_mempool_block_t *)((unsigned long)(ptr) - FNET_MEMPOOL_BLOCK_OVERHEAD))
+
+struct fnet_mempool
+{
+    unsigned long           fl_bitmap;
+    unsigned long           sl_bitmap[FNET_MEMPOOL_FL_COUNT];
+    fnet_mempool_block_t    *blocks[FNET_MEMPOOL_FL_COUNT][FNET_MEMPOOL_SL_COUNT];
+    fnet_mempool_block_t    *first;             /* First block in memory. */
+};
+
+/************************************************************************
+* NAME: fnet_mempool_fls
+*
+* DESCRIPTION: Returns the index of the most significant set bit.
+*************************************************************************/
+static int fnet_mempool_fls( unsigned long word )
+{
+#if FNET_CFG_COMP_GCC
+    return 31 - __builtin_clz(word);
+#else
+    int bit = 31;
+
+    while(((word >> bit) & 1) == 0)
+        bit--;
+
+    return bit;
+#endif
+}
+
+/* Index of the least significant set bit. */
+#define fnet_mempool_ffs(word)  fnet_mempool_fls((word) & (~(word) + 1))
+
+/************************************************************************
+* NAME: fnet_mempool_mapping
+*
+* DESCRIPTION: Returns the free list indexes of a block of 'size' bytes.
+*************************************************************************/
+static void fnet_mempool_mapping( unsigned long size, int *fl, int *sl )
+{
+    if(size < FNET_MEMPOOL_SMALL_BLOCK_SIZE)
+    {
+        *fl = 0;
+        *sl = (int)(size / (FNET_MEMPOOL_SMALL_BLOCK_SIZE / FNET_MEMPOOL_SL_COUNT));
+    }
+    else
+    {
+        int bit = fnet_mempool_fls(size);
+
+        *sl = (int)(size >> (bit - FNET_MEMPOOL_SL_COUNT_LOG2)) ^ FNET_MEMPOOL_SL_COUNT;
+        *fl = bit - FNET_MEMPOOL_FL_SHIFT + 1;
+    }
+}
+
+/************************************************************************
+* NAME: fnet_mempool_insert
+*
+* DESCRIPTION: Puts the free block on its list.
+*************************************************************************/
+static void fnet_mempool_insert( struct fnet_mempool *mempool, fnet_mempool_block_t *block )
+{
+    int fl, sl;
+    fnet_mempool_block_t *head;
+
+    fnet_mempool_mapping(fnet_mempool_block_size(block), &fl, &sl);
+
+    head = mempool->blocks[fl][sl];
+    block->next_free = head;
+    block->prev_free = 0;
+    if(head)
+        head->prev_free = block;
+    mempool->blocks[fl][sl] = block;
+
+    mempool->fl_bitmap |= (1UL << fl);
+    mempool->sl_bitmap[fl] |= (1UL << sl);
+}
+
+/************************************************************************
+* NAME: fnet_mempool_remove
+*
+* DESCRIPTION: Takes the free block off its list.
+*************************************************************************/
+static void fnet_mempool_remove( struct fnet_mempool *mempool, fnet_mempool_block_t *block )
+{
+    int fl, sl;
+
+    fnet_mempool_mapping(fnet_mempool_block_size(block), &fl, &sl);
+
+    if(block->next_free)
+        block->next_free->prev_free = block->prev_free;
+
+    if(block->prev_free)
+    {
+        block->prev_free->next_free = block->next_free;
+    }
+    else
+    {
+        mempool->blocks[fl][sl] = block->next_free;
+
+        if(block->next_free == 0)
+        {
+            mempool->sl_bitmap[fl] &= ~(1UL << sl);
+
+            if(mempool->sl_bitmap[fl] == 0)
+                mempool->fl_bitmap &= ~(1UL << fl);
+        }
+    }
+}
+
+/************************************************************************
+* NAME: fnet_mempool_find
+*
+* DESCRIPTION: Finds a free block of at least 'size' bytes.
+*              Any block on the returned list is large enough.
+*              If there is no such list, the blocks on the list of 'size'
+*              are tried, so that a fitting block is not missed.
+*************************************************************************/
+static fnet_mempool_block_t *fnet_mempool_find( struct fnet_mempool *mempool, unsigned long size )
+{
+    int fl, sl;
+    unsigned long map = 0;
+    unsigned long rounded = size;
+    fnet_mempool_block_t *block;
+
+    if(size > FNET_MEMPOOL_BLOCK_SIZE_MAX)
+        return 0;
+
+    /* Round up to the next list, so that its first block fits. */
+    if(size >= FNET_MEMPOOL_SMALL_BLOCK_SIZE)
+        rounded += (1UL << (fnet_mempool_fls(size) - FNET_MEMPOOL_SL_COUNT_LOG2)) - 1;
+
+    if(rounded <= FNET_MEMPOOL_BLOCK_SIZE_MAX)
+    {
+        fnet_mempool_mapping(rounded, &fl, &sl);
+
+        map = mempool->sl_bitmap[fl] & (~0UL << sl);
+
+        if(map == 0)
+        {
+            map = mempool->fl_bitmap & (~0UL << (fl + 1));
+
+            if(map)
+            {
+                fl = fnet_mempool_ffs(map);
+                map = mempool->sl_bitmap[fl];
+            }
+        }
+    }
+
+    if(map)
+    {
+        sl = fnet_mempool_ffs(map);
+        return mempool->blocks[fl][sl];
+    }
+
+    /* The heap is nearly exhausted, look for a fit on the list of 'size'. */
+    fnet_mempool_mapping(size, &fl, &sl);
+
+    for(block = mempool->blocks[fl][sl]; block; block = block->next_free)
+    {
+        if(fnet_mempool_block_size(block) >= size)
+            break;
+    }
+
+    return block;
+}
+
+/************************************************************************
+* NAME: fnet_mempool_init
+*
+* DESCRIPTION: Blocks are always aligned to 8 bytes, 
+*              'alignment' only applies to the start of the pool.
+*************************************************************************/
+fnet_mempool_desc_t fnet_mempool_init( void *pool_ptr, unsigned long pool_size, fnet_mempool_align_t alignment )
+{
+    struct fnet_mempool     *mempool = 0;
+    fnet_mempool_block_t    *block;
+    fnet_mempool_block_t    *sentinel;
+
+    if(alignment < FNET_MEMPOOL_ALIGN_8)
+          alignment = FNET_MEMPOOL_ALIGN_8; /* Set default alignment. */ 
+
+    if(pool_ptr && (pool_size > (alignment + sizeof(struct fnet_mempool) + FNET_MEMPOOL_BLOCK_OVERHEAD + FNET_MEMPOOL_BLOCK_SIZE_MIN)))
+    {
+        unsigned char *heap_ptr = (unsigned char *)(((unsigned long)(pool_ptr) + sizeof(struct fnet_mempool) + alignment)
+                                                            & ~(unsigned long)alignment);
+        unsigned long heap_size = (pool_size - ((unsigned long)heap_ptr - (unsigned long)pool_ptr) - FNET_MEMPOOL_BLOCK_OVERHEAD)
+                                                            & FNET_MEMPOOL_BLOCK_SIZE_MASK;
+
+        if(heap_size > FNET_MEMPOOL_BLOCK_SIZE_MAX)
+            heap_size = FNET_MEMPOOL_BLOCK_SIZE_MAX; /* The rest can not be mapped. */
+
+        mempool = (struct fnet_mempool *) pool_ptr;
+        fnet_memset_zero(mempool, sizeof(struct fnet_mempool));
+
+        /* One free block over the whole heap.*/
+        block = (fnet_mempool_block_t *)heap_ptr;
+        block->prev_phys = 0;
+        block->size = heap_size | FNET_MEMPOOL_BLOCK_FREE;
+
+        /* Allocated zero-size block at the end, so that every block has a next one. */
+        sentinel = fnet_mempool_block_next(block);
+        sentinel->prev_phys = block;
+        sentinel->size = 0;
+
+        mempool->first = block;
+        fnet_mempool_insert(mempool, block);
+    }
+
+    return (fnet_mempool_desc_t)mempool;
+}
+
+/************************************************************************
+* NAME: fnet_mempool_release
+*
+* DESCRIPTION: Release the mempool.
+*              
+*************************************************************************/
+void fnet_mempool_release( fnet_mempool_desc_t mpool )
+{
+    struct fnet_mempool * mempool = (struct fnet_mempool *)mpool;
+
+    fnet_memset_zero(mempool, sizeof(struct fnet_mempool));
+}
+
+/************************************************************************
+* NAME: fnet_mempool_free
+*
+* DESCRIPTION: Frees memory in the mempool.
+*              
+*************************************************************************/
+void fnet_mempool_free( fnet_mempool_desc_t mpool, void *ap )
+{
+    struct fnet_mempool     *mempool = (struct fnet_mempool *)mpool;
+    fnet_mempool_block_t    *block;
+    fnet_mempool_block_t    *neighbour;
+
+    if(ap != 0)
+    {
+        fnet_isr_lock();
+
+        block = fnet_mempool_block_from_ptr(ap);
+
+        /* Merge with the previous block. */
+        neighbour = block->prev_phys;
+        if(neighbour && fnet_mempool_block_is_free(neighbour))
+        {
+            fnet_mempool_remove(mempool, neighbour);
+            neighbour->size += fnet_mempool_block_size(block);
+            block = neighbour;
+        }
+        else
+        {
+            block->size |= FNET_MEMPOOL_BLOCK_FREE;
+        }
+
+        /* Merge with the next block. */
+        neighbour = fnet_mempool_block_next(block);
+        if(fnet_mempool_block_is_free(neighbour))
+        {
+            fnet_mempool_remove(mempool, neighbour);
+            block->size += fnet_mempool_block_size(neighbour);
+            neighbour = fnet_mempool_block_next(block);
+        }
+        neighbour->prev_phys = block;
+
+        fnet_mempool_insert(mempool, block);
+
+        fnet_isr_unlock();
+    }
+}
+
+/************************************************************************
+* NAME: fnet_mempool_malloc
+*
+* DESCRIPTION: Allocates memory in the memory pool.
+*              
+*************************************************************************/
+void *fnet_mempool_malloc( fnet_mempool_desc_t mpool, unsigned nbytes )
+{
+    struct fnet_mempool     *mempool = (struct fnet_mempool *)mpool;
+    fnet_mempool_block_t    *block;
+    fnet_mempool_block_t    *rest;
+    unsigned long           size;
+    void                    *res = 0;
+
+    size = ((unsigned long)nbytes + FNET_MEMPOOL_BLOCK_OVERHEAD + FNET_MEMPOOL_ALIGN_SIZE - 1) & FNET_MEMPOOL_BLOCK_SIZE_MASK;
+    if(size < FNET_MEMPOOL_BLOCK_SIZE_MIN)
+        size = FNET_MEMPOOL_BLOCK_SIZE_MIN;
+
+    fnet_isr_lock();
+
+    block = fnet_mempool_find(mempool, size);
+
+    if(block)
+    {
+        fnet_mempool_remove(mempool, block);
+
+        /* Split, if the rest can make a block.*/
+        if(fnet_mempool_block_size(block) - size >= FNET_MEMPOOL_BLOCK_SIZE_MIN)
+        {
+            rest = (fnet_mempool_block_t *)((unsigned long)block + size);
+            rest->prev_phys = block;
+            rest->size = (fnet_mempool_block_size(block) - size) | FNET_MEMPOOL_BLOCK_FREE;
+            fnet_mempool_block_next(rest)->prev_phys = rest;
+            fnet_mempool_insert(mempool, rest);
+
+            block->size = size;
+        }
+        else
+        {
+            block->size &= ~(unsigned long)FNET_MEMPOOL_BLOCK_FREE;
+        }
+
+        res = fnet_mempool_block_to_ptr(block);
+    }
+
+    fnet_isr_unlock();
+
+    return res;
+}
+
+/************************************************************************
+* NAME: fnet_mempool_free_mem_status
+*
+* DESCRIPTION: Returns a quantity of free memory (for debug needs)
+*              
+*************************************************************************/
+unsigned long fnet_mempool_free_mem_status( fnet_mempool_desc_t mpool )
+{
+    struct fnet_mempool     *mempool = (struct fnet_mempool *)mpool;
+    fnet_mempool_block_t    *block;
+    unsigned long           total_size = 0;
+
+    fnet_isr_lock();
+
+    for(block = mempool->first; block && fnet_mempool_block_size(block); block = fnet_mempool_block_next(block))
+    {
+        if(fnet_mempool_block_is_free(block))
+            total_size += fnet_mempool_block_size(block);
+    }
+
+    fnet_isr_unlock();
+
+    return total_size;
+}
+
+/************************************************************************
+* NAME: fnet_mempool_malloc_max
+*
+* DESCRIPTION: Returns a maximum size of posible allocated memory chunk.
+*              
+*************************************************************************/
+unsigned long fnet_mempool_malloc_max( fnet_mempool_desc_t mpool )
+{
+    struct fnet_mempool     *mempool = (struct fnet_mempool *)mpool;
+    fnet_mempool_block_t    *block;
+    unsigned long           max = 0;
+    int                     fl, sl;
+
+    fnet_isr_lock();
+
+    /* The largest block is on the highest non-empty list. */
+    if(mempool->fl_bitmap)
+    {
+        fl = fnet_mempool_fls(mempool->fl_bitmap);
+        sl = fnet_mempool_fls(mempool->sl_bitmap[fl]);
+
+        for(block = mempool->blocks[fl][sl]; block; block = block->next_free)
+        {
+            if(fnet_mempool_block_size(block) > max)
+                max = fnet_mempool_block_size(block);
+        }
+
+        max -= FNET_MEMPOOL_BLOCK_OVERHEAD;
+    }
+
+    fnet_isr_unlock();
+
+    return max;
+}
+
+#endif /* FNET_CFG_MEMPOOL_TLSF */
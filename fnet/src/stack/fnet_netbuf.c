@@ -65,8 +65,72 @@ static fnet_mempool_desc_t fnet_mempool_main = 0; /* Main memory pool. */
     #define fnet_mempool_netbuf fnet_mempool_main
 #endif
 
+#if FNET_CFG_NETBUF_POOL
+
+/* Fixed-size block pool. The blocks are allocated from the heap by 
+ * fnet_heap_init() and linked into a free list through their first word. */
+typedef struct
+{
+    unsigned char   *start;         /* First block. */
+    unsigned char   *end;           /* End of the last block. */
+    unsigned long   block_size;
+    void            *free_ptr;      /* First free block. */
+} fnet_netbuf_pool_t;
+
+#define FNET_NETBUF_POOL_ALIGN(size)    (((size) + 7) & ~7)
+
+/* Pools, in order of increasing block size. */
+#define FNET_NETBUF_POOL_NUMBER         (3)
+
+static fnet_netbuf_pool_t fnet_netbuf_pool[FNET_NETBUF_POOL_NUMBER];
+
+static void fnet_netbuf_pool_init( fnet_netbuf_pool_t *pool, unsigned long block_size, unsigned long block_number, unsigned long *budget );
+static void *fnet_netbuf_pool_malloc( unsigned nbytes );
+static int fnet_netbuf_pool_free( void *ap );
+
+#endif /* FNET_CFG_NETBUF_POOL */
+
 fnet_netbuf_t *dm_nb;
 
+/* Reference counter flag, set for external data buffers (fnet_netbuf_ext_t). */
+#define FNET_NETBUF_REF_EXT         (0x40000000)
+
+static void fnet_netbuf_data_release( void *data );
+static void fnet_netbuf_const_free( fnet_netbuf_ext_t *ext );
+
+/* Shared by all net_bufs, that point at constant data. The reference 
+ * held by the netbuf module itself keeps it from being "freed". */
+static fnet_netbuf_ext_t fnet_netbuf_const_ext = { FNET_NETBUF_REF_EXT | 1, fnet_netbuf_const_free };
+
+/************************************************************************
+* NAME: fnet_netbuf_data_release
+*
+* DESCRIPTION: Drops one reference to the data buffer 'data' and frees 
+*              it, or returns it to its owner, if nobody uses it anymore.
+*************************************************************************/
+static void fnet_netbuf_data_release( void *data )
+{
+    int reference_counter;
+
+    /* The application may free the net_bufs it got by fnet_recv_nb(), 
+     * while the stack still uses copies of them.*/
+    fnet_isr_lock();
+
+    reference_counter = ((int *)data)[0];
+
+    if((reference_counter & ~FNET_NETBUF_REF_EXT) == 1)  /* If nobody uses this data buffer. */
+    {
+        if(reference_counter & FNET_NETBUF_REF_EXT)
+            ((fnet_netbuf_ext_t *)data)->free((fnet_netbuf_ext_t *)data);
+        else
+            fnet_free_netbuf(data);
+    }
+    else                                /* Else decrement reference counter */
+        ((int *)data)[0] = reference_counter - 1;
+
+    fnet_isr_unlock();
+}
+
 /************************************************************************
 * NAME: fnet_netbuf_new
 *
@@ -74,11 +138,23 @@ fnet_netbuf_t *dm_nb;
 *              for a new data buffer. 
 *************************************************************************/
 fnet_netbuf_t *fnet_netbuf_new( int len, int drain )
+{
+    return fnet_netbuf_new_headroom(0, len, drain);
+}
+
+/************************************************************************
+* NAME: fnet_netbuf_new_headroom
+*
+* DESCRIPTION: Creates a new net_buf whose data starts 'headroom' bytes
+*              into the data buffer, so that headers can be prepended 
+*              later by fnet_netbuf_push() without an allocation.
+*************************************************************************/
+fnet_netbuf_t *fnet_netbuf_new_headroom( int headroom, int len, int drain )
 {
     fnet_netbuf_t *nb;
     void *nb_d;
 
-    if(len < 0)
+    if((len < 0) || (headroom < 0))
         return (fnet_netbuf_t *)0;
 
 
@@ -96,12 +172,12 @@ fnet_netbuf_t *fnet_netbuf_new( int len, int drain )
     }
 
 
-    nb_d = fnet_malloc_netbuf((unsigned int)len + sizeof(int)/* For reference_counter */);
+    nb_d = fnet_malloc_netbuf((unsigned int)(headroom + len) + sizeof(int)/* For reference_counter */);
 
     if((nb_d == 0) && drain )
     {
         fnet_prot_drain();
-        nb_d = fnet_malloc_netbuf((unsigned int)len + sizeof(int)/* For reference_counter */);
+        nb_d = fnet_malloc_netbuf((unsigned int)(headroom + len) + sizeof(int)/* For reference_counter */);
     }
 
 
@@ -118,13 +194,64 @@ fnet_netbuf_t *fnet_netbuf_new( int len, int drain )
     
     ((int *)nb_d)[0] = 1; /* First element is used by the reference_counter.*/
     nb->data = &((int *)nb_d)[0];
-    nb->data_ptr = &((int *)nb_d)[1];
+    nb->data_ptr = (char *)&((int *)nb_d)[1] + headroom;
     nb->length = (unsigned long)len;
     nb->total_length = (unsigned long)len;
 
     return (nb);
 }
 
+/************************************************************************
+* NAME: fnet_netbuf_headroom
+*
+* DESCRIPTION: Returns the number of bytes that can be prepended to 
+*              the net_buf in place. Only a heap data buffer that nobody
+*              else references may be written in front of its data.
+*************************************************************************/
+int fnet_netbuf_headroom( fnet_netbuf_t *nb )
+{
+    if(((int *)nb->data)[0] != 1) /* Shared or external data buffer.*/
+        return 0;
+
+    return (int)((char *)nb->data_ptr - (char *)&((int *)nb->data)[1]);
+}
+
+/************************************************************************
+* NAME: fnet_netbuf_push
+*
+* DESCRIPTION: Prepends 'len' bytes to the net_buf chain 'nb' and returns
+*              the new head, whose first 'len' bytes are left for the
+*              caller to fill in. The headroom of 'nb' is used if it is 
+*              large enough, otherwise a new net_buf is put in front,  
+*              leaving FNET_CFG_NETBUF_HEADROOM bytes for the lower layers.
+*              On failure, 0 is returned and 'nb' is left untouched.
+*************************************************************************/
+fnet_netbuf_t *fnet_netbuf_push( fnet_netbuf_t *nb, int len, int drain )
+{
+    fnet_netbuf_t *nb_header;
+    int headroom;
+
+    if(fnet_netbuf_headroom(nb) >= len)
+    {
+        nb->data_ptr = (char *)nb->data_ptr - len;
+        nb->length += (unsigned long)len;
+        nb->total_length += (unsigned long)len;
+        return nb;
+    }
+
+    headroom = FNET_CFG_NETBUF_HEADROOM;
+#if FNET_CFG_NETBUF_POOL
+    /* Do not let the headroom push a header out of the small block pool.*/
+    if((len <= FNET_CFG_NETBUF_POOL_SMALL_SIZE) && (headroom + len > FNET_CFG_NETBUF_POOL_SMALL_SIZE))
+        headroom = (FNET_CFG_NETBUF_POOL_SMALL_SIZE - len) & ~3;
+#endif
+
+    if((nb_header = fnet_netbuf_new_headroom(headroom, len, drain)) == 0)
+        return (fnet_netbuf_t *)0;
+
+    return fnet_netbuf_concat(nb_header, nb);
+}
+
 /************************************************************************
 * NAME: fnet_netbuf_copy
 *
@@ -280,6 +407,94 @@ fnet_netbuf_t *fnet_netbuf_from_buf( void *data_ptr, int len, int drain )
     return (nb);
 }
 
+/************************************************************************
+* NAME: fnet_netbuf_from_ext
+*
+* DESCRIPTION: Creates a new net_buf, which points to the data of  
+*              the external buffer 'ext' in place. 
+*              ext->free() is called when the net_buf and all its 
+*              copies are freed.
+*************************************************************************/
+fnet_netbuf_t *fnet_netbuf_from_ext( fnet_netbuf_ext_t *ext, void *data_ptr, int len, int drain )
+{
+    fnet_netbuf_t *nb;
+
+    if(len < 0)
+        return (fnet_netbuf_t *)0;
+
+    nb = (fnet_netbuf_t *)fnet_malloc_netbuf(sizeof(fnet_netbuf_t));
+
+    if((nb == 0) && drain)
+    {
+        fnet_prot_drain();
+        nb = (fnet_netbuf_t *)fnet_malloc_netbuf(sizeof(fnet_netbuf_t));
+    }
+
+    if(nb)
+    {
+        ext->reference_counter = FNET_NETBUF_REF_EXT | 1;
+
+        nb->next = (fnet_netbuf_t *)0;
+        nb->next_chain = (fnet_netbuf_t *)0;
+        nb->data = ext;
+        nb->data_ptr = data_ptr;
+        nb->length = (unsigned long)len;
+        nb->total_length = (unsigned long)len;
+    }
+
+    return (nb);
+}
+
+/************************************************************************
+* NAME: fnet_netbuf_from_const
+*
+* DESCRIPTION: Creates a new net_buf, which points to constant data
+*              (e.g. in flash) in place. The data must stay unchanged
+*              as long as the net_buf or any of its copies exists.
+*************************************************************************/
+fnet_netbuf_t *fnet_netbuf_from_const( const void *data_ptr, int len, int drain )
+{
+    fnet_netbuf_t *nb;
+
+    if(len < 0)
+        return (fnet_netbuf_t *)0;
+
+    nb = (fnet_netbuf_t *)fnet_malloc_netbuf(sizeof(fnet_netbuf_t));
+
+    if((nb == 0) && drain)
+    {
+        fnet_prot_drain();
+        nb = (fnet_netbuf_t *)fnet_malloc_netbuf(sizeof(fnet_netbuf_t));
+    }
+
+    if(nb)
+    {
+        fnet_isr_lock();
+        fnet_netbuf_const_ext.reference_counter++;
+        fnet_isr_unlock();
+
+        nb->next = (fnet_netbuf_t *)0;
+        nb->next_chain = (fnet_netbuf_t *)0;
+        nb->data = &fnet_netbuf_const_ext;
+        nb->data_ptr = (void *)data_ptr;
+        nb->length = (unsigned long)len;
+        nb->total_length = (unsigned long)len;
+    }
+
+    return (nb);
+}
+
+/************************************************************************
+* NAME: fnet_netbuf_const_free
+*
+* DESCRIPTION: Never called, as the netbuf module keeps a reference
+*              to fnet_netbuf_const_ext.
+*************************************************************************/
+static void fnet_netbuf_const_free( fnet_netbuf_ext_t *ext )
+{
+    FNET_COMP_UNUSED_ARG(ext);
+}
+
 /************************************************************************
 * NAME: fnet_netbuf_to_buf
 *
@@ -368,11 +583,7 @@ fnet_netbuf_t *fnet_netbuf_free( fnet_netbuf_t *nb )
    
     if(nb != 0)
     {
-        
-        if(((int *)nb->data)[0] == 1)   /* If nobody uses this data buffer. */
-            fnet_free_netbuf(nb->data);
-        else                           /* else decrement reference counter */
-            ((int *)nb->data)[0] = ((int *)nb->data)[0] - 1;
+        fnet_netbuf_data_release(nb->data);
 
         tmp_nb = nb->next;
 
@@ -401,11 +612,7 @@ void fnet_netbuf_free_chain( fnet_netbuf_t *nb )
     {
         tmp_nb = nb->next;
         
-        if(((int *)nb->data)[0] == 1)   /* If nobody uses this data buffer. */
-            fnet_free_netbuf(nb->data);
-        else                            /* Else decrement reference counter */
-            ((int *)nb->data)[0] = ((int *)nb->data)[0] - 1;
-
+        fnet_netbuf_data_release(nb->data);
 
         fnet_free_netbuf(nb);
 
@@ -460,10 +667,7 @@ fnet_netbuf_t *fnet_netbuf_pullup( fnet_netbuf_t *nb, int len)
     offset = nb->length;
 
     /* Free old data buffer (for the first net_buf) */
-    if(((int *)nb->data)[0] == 1)   /* If nobody uses this data buffer. */
-        fnet_free_netbuf(nb->data);
-    else                            /* Else decrement reference counter */
-        ((int *)nb->data)[0] = ((int *)nb->data)[0] - 1;
+    fnet_netbuf_data_release(nb->data);
 
     /* Currently data buffer contains the contents of the first buffer */
     nb->data = &((int *)new_buf)[0];
@@ -540,7 +744,9 @@ void fnet_netbuf_trim( fnet_netbuf_t **nb_ptr, int len )
             *nb_ptr = nb->next;
             
             nb = fnet_netbuf_free(nb); /* In some cases we delete some net_bufs.*/
-            tot_len += nb->length;
+
+            if(nb != 0) /* The whole chain may be trimmed.*/
+                tot_len += nb->length;
             
             
         }
@@ -723,6 +929,39 @@ fnet_netbuf_t *fnet_netbuf_concat( fnet_netbuf_t *nb1, fnet_netbuf_t *nb2 )
     return head_nb;
 }
 
+/************************************************************************
+* NAME: fnet_netbuf_concat_tail
+*
+* DESCRIPTION: Appends net_buf chain nb to the chain pointed by nb_ptr,
+*              in constant time. *tail_ptr must point to the last 
+*              net_buf of *nb_ptr, it is ignored if *nb_ptr is 0, and 
+*              is updated to the last net_buf of nb.
+*              Freeing net_bufs from the front of the chain (e.g. by
+*              fnet_netbuf_trim()) keeps the tail valid.
+*************************************************************************/
+void fnet_netbuf_concat_tail( fnet_netbuf_t ** nb_ptr, fnet_netbuf_t ** tail_ptr, fnet_netbuf_t *nb )
+{
+    fnet_netbuf_t *tail;
+
+    if(nb == 0)
+        return;
+
+    if(*nb_ptr == 0)
+    {
+        *nb_ptr = nb;
+    }
+    else
+    {
+        (*tail_ptr)->next = nb;
+        (*nb_ptr)->total_length += nb->total_length;
+    }
+
+    for(tail = nb; tail->next; tail = tail->next)
+    {}
+
+    *tail_ptr = tail;
+}
+
 /************************************************************************
 * NAME: fnet_netbuf_add_chain
 *
@@ -750,6 +989,24 @@ void fnet_netbuf_add_chain( fnet_netbuf_t ** nb_ptr, fnet_netbuf_t *nb_chain )
 
 }
 
+/************************************************************************
+* NAME: fnet_netbuf_add_chain_tail
+*
+* DESCRIPTION: Adds chain nb_chain into the queue of chains pointed by 
+*              nb_ptr, in constant time. *tail_ptr must point to the last
+*              chain of the queue, it is ignored if *nb_ptr is 0, and 
+*              is set to nb_chain.
+*************************************************************************/
+void fnet_netbuf_add_chain_tail( fnet_netbuf_t ** nb_ptr, fnet_netbuf_t ** tail_ptr, fnet_netbuf_t *nb_chain )
+{
+    if(*nb_ptr == 0)
+        *nb_ptr = nb_chain;
+    else
+        (*tail_ptr)->next_chain = nb_chain;
+
+    *tail_ptr = nb_chain;
+}
+
 /************************************************************************
 * NAME: fnet_netbuf_del_chain
 *
@@ -812,10 +1069,147 @@ int fnet_heap_init( unsigned char *heap_ptr, unsigned long heap_size )
      else
         result = FNET_ERR;  
                                                              
+#if FNET_CFG_NETBUF_POOL
+    if(result == FNET_OK)
+    {
+        /* The pools take at most half of the heap. A pool that does not fit
+         * is left empty and its size class is served by the heap, so a small
+         * heap still initializes and keeps room for the other allocations.*/
+        unsigned long budget = heap_size / 2;
+        
+        fnet_netbuf_pool_init(&fnet_netbuf_pool[0], sizeof(fnet_netbuf_t), FNET_CFG_NETBUF_POOL_HEADERS, &budget);
+        fnet_netbuf_pool_init(&fnet_netbuf_pool[1], FNET_CFG_NETBUF_POOL_SMALL_SIZE + sizeof(int), FNET_CFG_NETBUF_POOL_SMALL, &budget);
+        fnet_netbuf_pool_init(&fnet_netbuf_pool[2], FNET_CFG_NETBUF_POOL_LARGE_SIZE + sizeof(int), FNET_CFG_NETBUF_POOL_LARGE, &budget);
+    }
+#endif
    
     return result;
 }
 
+#if FNET_CFG_NETBUF_POOL
+/************************************************************************
+* NAME: fnet_netbuf_pool_init
+*
+* DESCRIPTION: Allocates 'block_number' blocks of 'block_size' bytes
+*              from the netbuf heap and puts them on the pool free list.
+*              The pool is left empty if its blocks exceed 'budget' 
+*              or cannot be allocated.
+*************************************************************************/
+static void fnet_netbuf_pool_init( fnet_netbuf_pool_t *pool, unsigned long block_size, unsigned long block_number, unsigned long *budget )
+{
+    unsigned char   *block;
+    
+    block_size = FNET_NETBUF_POOL_ALIGN(block_size);
+    
+    pool->block_size = block_size;
+    pool->free_ptr = 0;
+    pool->start = pool->end = 0;
+    
+    if(block_number && (block_size * block_number <= *budget))
+    {
+        pool->start = (unsigned char *)fnet_mempool_malloc(fnet_mempool_netbuf, block_size * block_number);
+        
+        if(pool->start)
+        {
+            *budget -= block_size * block_number;
+            pool->end = pool->start + block_size * block_number;
+        
+            for(block = pool->end - block_size; block >= pool->start; block -= block_size)
+            {
+                *(void **)block = pool->free_ptr;
+                pool->free_ptr = block;
+            }
+        }
+    }
+}
+
+/************************************************************************
+* NAME: fnet_netbuf_pool_malloc
+*
+* DESCRIPTION: Takes a block from the smallest pool that fits 'nbytes'.
+*              Returns 0 if that pool is empty.
+*************************************************************************/
+static void *fnet_netbuf_pool_malloc( unsigned nbytes )
+{
+    fnet_netbuf_pool_t  *pool;
+    void                *block = 0;
+    
+    for(pool = &fnet_netbuf_pool[0]; pool < &fnet_netbuf_pool[FNET_NETBUF_POOL_NUMBER]; pool++)
+    {
+        if(nbytes <= pool->block_size)
+        {
+            fnet_isr_lock();
+            
+            block = pool->free_ptr;
+            if(block)
+                pool->free_ptr = *(void **)block;
+                
+            fnet_isr_unlock();
+            break;
+        }
+    }
+    
+    return block;
+}
+
+/************************************************************************
+* NAME: fnet_netbuf_pool_free
+*
+* DESCRIPTION: Returns the block 'ap' to its pool.
+*              Returns FNET_ERR if 'ap' does not belong to any pool.
+*************************************************************************/
+static int fnet_netbuf_pool_free( void *ap )
+{
+    fnet_netbuf_pool_t  *pool;
+    
+    for(pool = &fnet_netbuf_pool[0]; pool < &fnet_netbuf_pool[FNET_NETBUF_POOL_NUMBER]; pool++)
+    {
+        if(((unsigned char *)ap >= pool->start) && ((unsigned char *)ap < pool->end))
+        {
+            fnet_isr_lock();
+            
+            *(void **)ap = pool->free_ptr;
+            pool->free_ptr = ap;
+            
+            fnet_isr_unlock();
+            return FNET_OK;
+        }
+    }
+    
+    return FNET_ERR;
+}
+
+/************************************************************************
+* NAME: fnet_netbuf_pool_free_mem
+*
+* DESCRIPTION: Returns the number of free bytes in the pools, and the 
+*              largest free block size in 'max'.
+*************************************************************************/
+static unsigned long fnet_netbuf_pool_free_mem( unsigned long *max )
+{
+    fnet_netbuf_pool_t  *pool;
+    void                *block;
+    unsigned long       total = 0;
+    
+    fnet_isr_lock();
+    
+    for(pool = &fnet_netbuf_pool[0]; pool < &fnet_netbuf_pool[FNET_NETBUF_POOL_NUMBER]; pool++)
+    {
+        for(block = pool->free_ptr; block; block = *(void **)block)
+        {
+            total += pool->block_size;
+            
+            if(pool->block_size > *max)
+                *max = pool->block_size;
+        }
+    }
+    
+    fnet_isr_unlock();
+    
+    return total;
+}
+#endif /* FNET_CFG_NETBUF_POOL */
+
 
 /************************************************************************
 * NAME: fnet_free
@@ -825,6 +1219,10 @@ int fnet_heap_init( unsigned char *heap_ptr, unsigned long heap_size )
 *************************************************************************/
 void fnet_free_netbuf( void *ap )
 {
+#if FNET_CFG_NETBUF_POOL
+    if(fnet_netbuf_pool_free(ap) == FNET_OK)
+        return;
+#endif
     fnet_mempool_free(fnet_mempool_netbuf, ap);
 }
 
@@ -836,6 +1234,12 @@ void fnet_free_netbuf( void *ap )
 *************************************************************************/
 void *fnet_malloc_netbuf( unsigned nbytes )
 {
+#if FNET_CFG_NETBUF_POOL
+    void *block = fnet_netbuf_pool_malloc(nbytes);
+    
+    if(block)
+        return block;
+#endif
     return fnet_mempool_malloc( fnet_mempool_netbuf, nbytes );
 }
 
@@ -847,7 +1251,13 @@ void *fnet_malloc_netbuf( unsigned nbytes )
 *************************************************************************/
 unsigned long fnet_free_mem_status_netbuf( void )
 {
+#if FNET_CFG_NETBUF_POOL
+    unsigned long max = 0;
+    
+    return fnet_mempool_free_mem_status( fnet_mempool_netbuf ) + fnet_netbuf_pool_free_mem(&max);
+#else
     return fnet_mempool_free_mem_status( fnet_mempool_netbuf );
+#endif
 }
 
 /************************************************************************
@@ -858,7 +1268,15 @@ unsigned long fnet_free_mem_status_netbuf( void )
 *************************************************************************/
 unsigned long fnet_malloc_max_netbuf( void )
 {
+#if FNET_CFG_NETBUF_POOL
+    unsigned long max = fnet_mempool_malloc_max( fnet_mempool_netbuf  );
+    
+    fnet_netbuf_pool_free_mem(&max);
+    
+    return max;
+#else
     return fnet_mempool_malloc_max( fnet_mempool_netbuf  );
+#endif
 }
 
 /************************************************************************
@@ -869,6 +1287,9 @@ unsigned long fnet_malloc_max_netbuf( void )
 *************************************************************************/
 void fnet_mem_release_netbuf( void )
 {
+#if FNET_CFG_NETBUF_POOL
+    fnet_memset_zero(fnet_netbuf_pool, sizeof(fnet_netbuf_pool));
+#endif
     fnet_mempool_release(fnet_mempool_netbuf);
 }
 
@@ -84,10 +84,25 @@ typedef struct fnet_netbuf
     void                *data_ptr;      /**< pointer to actual data */
     unsigned long       length;         /**< amount of actual data in this net_buf */
     unsigned long       total_length;   /**< length of buffer + additionally chained buffers (only for first netbuf)*/
+    struct fnet_netif   *netif;         /**< receiving interface (only for first netbuf in IP input queue)*/
 } fnet_netbuf_t;
 
 #define FNET_NETBUF_COPYALL   (-1)
 
+/**************************************************************************/ /*!
+ * @internal
+ * @brief    Control block of an external data buffer (e.g. a driver DMA buffer).
+ *           Heap data buffers start with the reference counter only; 
+ *           external ones start with this structure, so that the net_buf 
+ *           can point at the data in place and hand the buffer back 
+ *           to its owner once the last reference is freed.
+ ******************************************************************************/
+typedef struct fnet_netbuf_ext
+{
+    int     reference_counter;                      /**< Must be first. Managed by netbuf functions.*/
+    void    (*free)( struct fnet_netbuf_ext *ext ); /**< Called when the buffer is no longer referenced.*/
+} fnet_netbuf_ext_t;
+
 /* Memory management functions */
 int fnet_heap_init( unsigned char *heap_ptr, unsigned long heap_size );
 void fnet_free( void *ap );
@@ -104,15 +119,22 @@ void fnet_mem_release_netbuf( void );
 
 /* Netbuf service routines */
 fnet_netbuf_t *fnet_netbuf_new( int len, int drain );
+fnet_netbuf_t *fnet_netbuf_new_headroom( int headroom, int len, int drain );
+int fnet_netbuf_headroom( fnet_netbuf_t *nb );
+fnet_netbuf_t *fnet_netbuf_push( fnet_netbuf_t *nb, int len, int drain );
 fnet_netbuf_t *fnet_netbuf_free( fnet_netbuf_t *nb );
 fnet_netbuf_t *fnet_netbuf_copy( fnet_netbuf_t *nb, int offset, int len, int drain );
 fnet_netbuf_t *fnet_netbuf_from_buf( void *data_ptr, int len,int drain );
+fnet_netbuf_t *fnet_netbuf_from_ext( fnet_netbuf_ext_t *ext, void *data_ptr, int len, int drain );
+fnet_netbuf_t *fnet_netbuf_from_const( const void *data_ptr, int len, int drain );
 fnet_netbuf_t *fnet_netbuf_concat( fnet_netbuf_t *nb1, fnet_netbuf_t *nb2 );
+void fnet_netbuf_concat_tail( fnet_netbuf_t ** nb_ptr, fnet_netbuf_t ** tail_ptr, fnet_netbuf_t *nb );
 void fnet_netbuf_to_buf( fnet_netbuf_t *nb, int offset, int len, void *data_ptr );
 fnet_netbuf_t *fnet_netbuf_pullup( fnet_netbuf_t *nb, int len);
 void fnet_netbuf_trim( fnet_netbuf_t ** nb_ptr, int len );
 fnet_netbuf_t *fnet_netbuf_cut_center( fnet_netbuf_t ** nb_ptr, int offset, int len);
 void fnet_netbuf_add_chain( fnet_netbuf_t ** nb_ptr, fnet_netbuf_t *nb_chain );
+void fnet_netbuf_add_chain_tail( fnet_netbuf_t ** nb_ptr, fnet_netbuf_t ** tail_ptr, fnet_netbuf_t *nb_chain );
 void fnet_netbuf_del_chain( fnet_netbuf_t ** nb_ptr, fnet_netbuf_t *nb_chain );
 void fnet_netbuf_free_chain( fnet_netbuf_t *nb );
                                              
@@ -773,7 +773,12 @@ int fnet_netif_get_statistics( fnet_netif_desc_t netif_desc, struct fnet_netif_s
     fnet_netif_t *netif = (fnet_netif_t *)netif_desc;
 
     if(netif && statistics && netif->api->get_statistics)
+    {
+        /* Counters not kept by the driver read as zero.*/
+        fnet_memset_zero(statistics, sizeof(struct fnet_netif_statistics));
         result = netif->api->get_statistics(netif, statistics);
+        statistics->rx_queue_drop = netif->rx_queue_drop;
+    }
     else
         result = FNET_ERR;
 
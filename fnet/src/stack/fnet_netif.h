@@ -83,6 +83,47 @@ struct fnet_netif_statistics
                               */
     unsigned long rx_packet; /**< @brief Rx packet count.
                               */
+    unsigned long rx_copied; /**< @brief Number of received packets copied 
+                              *   out of the DMA buffers, because the driver 
+                              *   had no spare buffer to lend to the stack.
+                              */
+    unsigned long rx_interrupts; /**< @brief Number of receive interrupts.
+                              *   With @c rx_polls, divided by @c rx_packet,
+                              *   it gives the interrupts taken per 
+                              *   received packet.
+                              */
+    unsigned long rx_polls;  /**< @brief Number of poll timer ticks.
+                              */
+    unsigned long rx_batch_max; /**< @brief Largest number of packets 
+                              *   received in one pass.
+                              */
+    unsigned long rx_poll_mode; /**< @brief Number of switches from 
+                              *   interrupts to polling.
+                              */
+    unsigned long rx_queue_drop; /**< @brief Number of received packets 
+                              *   dropped, because the IP input queue 
+                              *   was full.
+                              */
+};
+
+/**************************************************************************/ /*!
+ * @brief  ARP cache statistics, used by the @ref fnet_netif_get_arp_statistics().
+ ******************************************************************************/
+struct fnet_arp_statistics
+{
+    unsigned long hit;       /**< @brief Number of resolved lookups.
+                              */
+    unsigned long miss;      /**< @brief Number of lookups without a resolved entry.
+                              */
+    unsigned long hold_drop; /**< @brief Number of packets dropped from 
+                              *   the queues of unresolved entries.
+                              */
+    unsigned long resolve_wait; /**< @brief Number of transmits that 
+                              *   waited for the address resolution.
+                              */
+    unsigned long refresh;   /**< @brief Number of unicast requests sent 
+                              *   to refresh the used entries.
+                              */
 };
 
 /**************************************************************************/ /*!
@@ -558,6 +599,31 @@ int fnet_netif_connected( fnet_netif_desc_t netif );
  ******************************************************************************/
 int fnet_netif_get_statistics( fnet_netif_desc_t netif, struct fnet_netif_statistics *statistics );
 
+#if (FNET_CFG_ETH && FNET_CFG_IP4) || defined(__DOXYGEN__)
+/***************************************************************************/ /*!
+ *
+ * @brief    Retrieves the ARP cache statistics of the interface.
+ *
+ * @param netif  Network interface descriptor.
+ *
+ * @param statistics  Structure that receives the ARP statistics 
+ *                    defined by the @ref fnet_arp_statistics structure.
+ *
+ * @return This function returns:
+ *   - @ref FNET_OK if no error occurs.
+ *   - @ref FNET_ERR if an error occurs or the network interface does 
+ *          not use ARP.
+ *
+ ******************************************************************************
+ *
+ * This function retrieves the ARP cache statistics of the @c netif 
+ * interface and puts it into the @c statistics defined by the 
+ * @ref fnet_arp_statistics structure.
+ *
+ ******************************************************************************/
+int fnet_netif_get_arp_statistics( fnet_netif_desc_t netif, struct fnet_arp_statistics *statistics );
+#endif
+
 /**************************************************************************/ /*!
  * @brief Event handler callback function prototype, that is 
  * called when there is an IP address conflict with another system 
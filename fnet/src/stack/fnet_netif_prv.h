@@ -153,6 +153,7 @@ typedef struct fnet_netif
     void                    *if_ptr;                            /* Points to specific control data structure of current interface. */
     const fnet_netif_api_t  *api;                               /* Pointer to Interafce API structure.*/
     unsigned long           scope_id;                           /* Scope zone index, defining network interface. Used by IPv6 sockets.*/
+    unsigned long           rx_queue_drop;                      /* Datagrams dropped, because the IP input queue was full.*/
 #if FNET_CFG_IP4    
     fnet_netif_ip4_addr_t   ip4_addr;                           /* The interface IPv4 address structure. */    
 #endif
@@ -86,6 +86,9 @@ static const fnet_socket_prot_if_t fnet_raw_socket_api =
     fnet_ip_setsockopt,     /* Protocol "setsockopt" function.*/
     fnet_ip_getsockopt,     /* Protocol "getsockopt" function.*/
     0,                      /* Protocol "listen" function.*/
+    0,                      /* Protocol "poll" function.*/
+    0,                      /* Protocol zero-copy "receive" function.*/
+    0                       /* Protocol zero-copy "send" function.*/
 };
 
 fnet_prot_if_t fnet_raw_prot_if =
@@ -289,6 +292,8 @@ static void fnet_raw_input(fnet_netif_t *netif, struct sockaddr *foreign_addr,
                         {
                             fnet_netbuf_free_chain(nb_tmp);
                         }
+                        else
+                            fnet_socket_notify(last);
                     }
                 }
                 last = sock;
@@ -308,6 +313,8 @@ static void fnet_raw_input(fnet_netif_t *netif, struct sockaddr *foreign_addr,
                     fnet_netbuf_free_chain(nb_tmp);
                     goto BAD;
                 }
+                
+                fnet_socket_notify(last);
             }
             else
                 goto BAD;
@@ -329,6 +336,8 @@ static void fnet_raw_input(fnet_netif_t *netif, struct sockaddr *foreign_addr,
                         fnet_netbuf_free_chain(nb_tmp);
                         goto BAD;
                     }
+                    
+                    fnet_socket_notify(sock);
                 }
                 else
                     goto BAD;
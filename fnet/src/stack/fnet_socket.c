@@ -368,6 +368,8 @@ fnet_socket_t *fnet_socket_copy( fnet_socket_t *sock )
         sock_cp->state = SS_UNCONNECTED;
         sock_cp->protocol_control = 0;
         sock_cp->head_con = 0;
+        sock_cp->hash_next = 0;
+        sock_cp->callback = 0;
         sock_cp->partial_con = 0;
         sock_cp->incoming_con = 0;
         sock_cp->receive_buffer.count = 0;
@@ -711,6 +713,9 @@ int closesocket( SOCKET s )
 
 
 
+        /* The socket is not owned by the application any more.*/
+        sock->callback = 0;
+
         if(sock->protocol_interface->socket_api->prot_detach)
             result = sock->protocol_interface->socket_api->prot_detach(sock);
 
@@ -1088,6 +1093,163 @@ ERROR:
     return (SOCKET_ERROR);
 }
 
+/************************************************************************
+* NAME: fnet_send_nb
+*
+* DESCRIPTION: This function sends a net_buf chain, without copying it. 
+*************************************************************************/
+int fnet_send_nb( SOCKET s, fnet_netbuf_t *nb, int flags, const struct sockaddr *to, int tolen )
+{
+    fnet_socket_t   *sock;
+    int             error;
+    int             result = FNET_OK;
+
+    fnet_os_mutex_lock();
+
+    if((sock = fnet_socket_desc_find(s)) != 0)
+    {
+        if(nb == 0)
+        {
+            error = FNET_ERR_INVAL; /* Invalid argument.*/
+            goto ERROR_SOCK;
+        }
+
+        if((to == FNET_NULL) || (tolen == 0))
+        {
+            if(fnet_socket_addr_is_unspecified(&sock->foreign_addr))
+            {
+                error = FNET_ERR_NOTCONN; /* Socket is not connected.*/
+                goto ERROR_SOCK;
+            }
+            
+            to = FNET_NULL;
+        }
+        else
+        {
+            if((error = fnet_socket_addr_check_len(to, (unsigned int)tolen)) != FNET_OK)
+            {
+                goto ERROR_SOCK;
+            }     
+
+            if(fnet_socket_addr_is_unspecified(to))
+            {
+                error = FNET_ERR_DESTADDRREQ; /* Destination address required.*/
+                goto ERROR_SOCK;
+            }
+        }    
+        
+        /* If the socket is shutdowned, return.*/
+        if(sock->send_buffer.is_shutdown)
+        {
+            error = FNET_ERR_SHUTDOWN;
+            goto ERROR_SOCK;
+        }
+
+        if(sock->protocol_interface->socket_api->prot_snd_nb)
+        {
+            /* The protocol takes care of the chain.*/
+            result = sock->protocol_interface->socket_api->prot_snd_nb(sock, nb, flags, to);
+        }
+        else
+        {
+            error = FNET_ERR_OPNOTSUPP; /* Operation not supported.*/
+            goto ERROR_SOCK;
+        }
+    }
+    else
+    {
+        fnet_error_set(FNET_ERR_BAD_DESC);/* Bad descriptor.*/
+        goto ERROR;
+    }
+
+    fnet_os_mutex_unlock();
+    return (result);
+
+ERROR_SOCK:
+    fnet_socket_set_error(sock, error);
+
+ERROR:
+    fnet_netbuf_free_chain(nb);
+    fnet_os_mutex_unlock();
+    return (SOCKET_ERROR);
+}
+
+/************************************************************************
+* NAME: fnet_recv_nb
+*
+* DESCRIPTION: This function receives data as a net_buf chain, without
+*              copying it, and captures the address from which 
+*              the data was sent.  
+*************************************************************************/
+int fnet_recv_nb( SOCKET s, fnet_netbuf_t **nb, int len, int flags, struct sockaddr *from, int *fromlen )
+{
+    fnet_socket_t   *sock;
+    int             error;
+    int             result = FNET_OK;
+
+    fnet_os_mutex_lock();
+
+    if((sock = fnet_socket_desc_find(s)) != 0)
+    {
+        if(nb && (len >= 0))
+        {
+            *nb = 0;
+
+            /* The sockets must be bound before calling recv.*/
+            if((sock->local_addr.sa_port == 0) && (sock->protocol_interface->type != SOCK_RAW))
+            {
+                error = FNET_ERR_BOUNDREQ; /* The socket has not been bound with bind().*/
+                goto ERROR_SOCK;
+            }
+
+            if(from && fromlen)
+            {
+                if((error = fnet_socket_addr_check_len(&sock->local_addr, (unsigned int)(*fromlen) )) != FNET_OK )
+                {
+                    goto ERROR_SOCK;
+                }
+            }
+            
+            /* If the socket is shutdowned, return.*/
+            if(sock->receive_buffer.is_shutdown)
+            {
+                error = FNET_ERR_SHUTDOWN;
+                goto ERROR_SOCK;
+            }
+
+            if(sock->protocol_interface->socket_api->prot_rcv_nb)
+            {
+                result = sock->protocol_interface->socket_api->prot_rcv_nb(sock, nb, len, flags, (from && fromlen) ? from : FNET_NULL);
+            }
+            else
+            {
+                error = FNET_ERR_OPNOTSUPP; /* Operation not supported.*/
+                goto ERROR_SOCK;
+            }
+        }
+        else
+        {
+            error = FNET_ERR_INVAL; /* Invalid argument.*/
+            goto ERROR_SOCK;
+        }
+    }
+    else
+    {
+        fnet_error_set(FNET_ERR_BAD_DESC);/* Bad descriptor.*/
+        goto ERROR;
+    }
+
+    fnet_os_mutex_unlock();
+    return (result);
+
+ERROR_SOCK:
+    fnet_socket_set_error(sock, error);
+
+ERROR:
+    fnet_os_mutex_unlock();
+    return (SOCKET_ERROR);
+}
+
 /************************************************************************
 * NAME: getsockname
 *
@@ -1466,6 +1628,191 @@ ERROR:
     return (SOCKET_ERROR);
 }
 
+/************************************************************************
+* NAME: fnet_socket_revents
+*
+* DESCRIPTION: This function returns the current readiness events 
+*              of the socket.
+*************************************************************************/
+static int fnet_socket_revents( fnet_socket_t *sock )
+{
+    int revents;
+
+    if(sock->protocol_interface->socket_api->prot_poll)
+    {
+        revents = sock->protocol_interface->socket_api->prot_poll(sock);
+    }
+    else /* Datagram sockets.*/
+    {
+        revents = 0;
+
+        if(sock->receive_buffer.net_buf_chain || sock->receive_buffer.is_shutdown)
+            revents |= FNET_POLLIN;
+
+        if(!sock->send_buffer.is_shutdown)
+            revents |= FNET_POLLOUT;
+    }
+
+    if(sock->options.local_error != FNET_OK)
+        revents |= FNET_POLLERR;
+
+    return revents;
+}
+
+/************************************************************************
+* NAME: fnet_socket_notify
+*
+* DESCRIPTION: This function calls the socket event callback, if 
+*              any of the requested events is ready. 
+*              It is called by protocols, when the socket state changes.
+*************************************************************************/
+void fnet_socket_notify( fnet_socket_t *sock )
+{
+    int revents;
+
+    if(sock->callback)
+    {
+        revents = fnet_socket_revents(sock) & (sock->callback_events | FNET_POLLERR | FNET_POLLHUP);
+
+        if(revents)
+            sock->callback(sock->descriptor, revents, sock->callback_cookie);
+    }
+}
+
+/************************************************************************
+* NAME: fnet_poll
+*
+* DESCRIPTION: This function checks readiness of a list of sockets.
+*************************************************************************/
+int fnet_poll( struct fnet_pollfd *fds, unsigned int nfds )
+{
+    fnet_socket_t   *sock;
+    unsigned int    i;
+    int             result = 0;
+
+    fnet_os_mutex_lock();
+    fnet_isr_lock();
+
+    for(i = 0; i < nfds; i++)
+    {
+        fds[i].revents = 0;
+
+        if(fds[i].fd >= 0)
+        {
+            if((sock = fnet_socket_desc_find(fds[i].fd)) != 0)
+                fds[i].revents = fnet_socket_revents(sock) & (fds[i].events | FNET_POLLERR | FNET_POLLHUP);
+            else
+                fds[i].revents = FNET_POLLNVAL;
+
+            if(fds[i].revents)
+                result++;
+        }
+    }
+
+    fnet_isr_unlock();
+    fnet_os_mutex_unlock();
+
+    return result;
+}
+
+/************************************************************************
+* NAME: fnet_select
+*
+* DESCRIPTION: This function checks readiness of sets of sockets.
+*************************************************************************/
+int fnet_select( int nfds, fnet_fd_set *readfds, fnet_fd_set *writefds, fnet_fd_set *exceptfds )
+{
+    fnet_socket_t   *sock;
+    SOCKET          s;
+    int             revents;
+    int             result = 0;
+
+    if(nfds > FNET_CFG_SOCKET_MAX)
+        nfds = FNET_CFG_SOCKET_MAX;
+
+    fnet_os_mutex_lock();
+    fnet_isr_lock();
+
+    for(s = 0; s < nfds; s++)
+    {
+        if((readfds && FNET_FD_ISSET(s, readfds)) || (writefds && FNET_FD_ISSET(s, writefds)) 
+            || (exceptfds && FNET_FD_ISSET(s, exceptfds)))
+        {
+            if((sock = fnet_socket_desc_find(s)) == 0)
+            {
+                result = SOCKET_ERROR;
+                break;
+            }
+
+            revents = fnet_socket_revents(sock);
+
+            if(readfds && FNET_FD_ISSET(s, readfds))
+            {
+                if(revents & (FNET_POLLIN | FNET_POLLERR | FNET_POLLHUP))
+                    result++;
+                else
+                    FNET_FD_CLR(s, readfds);
+            }
+
+            if(writefds && FNET_FD_ISSET(s, writefds))
+            {
+                if(revents & (FNET_POLLOUT | FNET_POLLERR))
+                    result++;
+                else
+                    FNET_FD_CLR(s, writefds);
+            }
+
+            if(exceptfds && FNET_FD_ISSET(s, exceptfds))
+            {
+                if(revents & (FNET_POLLPRI | FNET_POLLERR))
+                    result++;
+                else
+                    FNET_FD_CLR(s, exceptfds);
+            }
+        }
+    }
+
+    fnet_isr_unlock();
+    fnet_os_mutex_unlock();
+
+    if(result == SOCKET_ERROR)
+        fnet_error_set(FNET_ERR_BAD_DESC); /* Bad descriptor.*/
+
+    return result;
+}
+
+/************************************************************************
+* NAME: fnet_socket_set_callback
+*
+* DESCRIPTION: This function registers the socket event callback.
+*************************************************************************/
+int fnet_socket_set_callback( SOCKET s, int events, fnet_socket_callback_t callback, long cookie )
+{
+    fnet_socket_t   *sock;
+    int             result = FNET_OK;
+
+    fnet_os_mutex_lock();
+
+    if((sock = fnet_socket_desc_find(s)) != 0)
+    {
+        fnet_isr_lock();
+        sock->callback = 0;
+        sock->callback_events = events;
+        sock->callback_cookie = cookie;
+        sock->callback = callback;
+        fnet_isr_unlock();
+    }
+    else
+    {
+        fnet_error_set(FNET_ERR_BAD_DESC); /* Bad descriptor.*/
+        result = SOCKET_ERROR;
+    }
+
+    fnet_os_mutex_unlock();
+
+    return result;
+}
+
 /************************************************************************
 * NAME: fnet_socket_buffer_release
 *
@@ -1511,7 +1858,8 @@ int fnet_socket_buffer_append_record( fnet_socket_buffer_t *sb, fnet_netbuf_t *n
         return FNET_ERR;
     }
 
-    sb->net_buf_chain = fnet_netbuf_concat(sb->net_buf_chain, nb);
+    fnet_netbuf_concat_tail(&sb->net_buf_chain, &sb->net_buf_tail, nb);
+    sb->net_buf_tail_room = 0;
 
     sb->count += nb->total_length;
     fnet_isr_unlock();
@@ -1519,6 +1867,73 @@ int fnet_socket_buffer_append_record( fnet_socket_buffer_t *sb, fnet_netbuf_t *n
     return FNET_OK;
 }
 
+/************************************************************************
+* NAME: fnet_socket_buffer_append_stream
+*
+* DESCRIPTION: Copies up to len bytes of the application data to the end
+*              of the stream socket buffer. The free space of the last 
+*              net_buf is filled first. A new net_buf is allocated for 
+*              at least block_size bytes, so that the following small 
+*              writes are added to it, and the queued data stays 
+*              in a few large contiguous net_bufs.
+*              It must be called with fnet_isr_lock() held.
+*
+* RETURNS: The number of bytes added.
+*************************************************************************/
+int fnet_socket_buffer_append_stream( fnet_socket_buffer_t *sb, const char *buf, int len, int block_size )
+{
+    fnet_netbuf_t   *nb;
+    fnet_netbuf_t   *tail;
+    int             added = 0;
+    int             size;
+
+    if(len > (long)(sb->count_max - sb->count))
+        len = (int)(sb->count_max - sb->count);
+
+    /* Fill the free space of the last net_buf.
+     * The data, that is already referenced by the segments in flight, 
+     * is not touched.*/
+    if(sb->net_buf_chain && sb->net_buf_tail_room && (len > 0))
+    {
+        tail = sb->net_buf_tail;
+        added = (len < (long)sb->net_buf_tail_room) ? len : (int)sb->net_buf_tail_room;
+
+        fnet_memcpy((char *)tail->data_ptr + tail->length, buf, (unsigned int)added);
+
+        tail->length += (unsigned long)added;
+        sb->net_buf_chain->total_length += (unsigned long)added;
+        sb->net_buf_tail_room -= (unsigned long)added;
+        sb->count += (unsigned long)added;
+    }
+
+    /* Add a new net_buf for the rest.*/
+    if(added < len)
+    {
+        len -= added;
+        size = (block_size > len) ? block_size : len;
+
+        if((nb = fnet_netbuf_new(size, FNET_TRUE)) == 0)
+        {
+            size = len;
+            nb = fnet_netbuf_new(size, FNET_TRUE);
+        }
+
+        if(nb)
+        {
+            fnet_memcpy(nb->data_ptr, buf + added, (unsigned int)len);
+            nb->length = (unsigned long)len;
+            nb->total_length = (unsigned long)len;
+
+            fnet_netbuf_concat_tail(&sb->net_buf_chain, &sb->net_buf_tail, nb);
+            sb->net_buf_tail_room = (unsigned long)(size - len);
+            sb->count += (unsigned long)len;
+            added += len;
+        }
+    }
+
+    return added;
+}
+
 /************************************************************************
 * NAME: fnet_socket_buffer_append_address
 *
@@ -1550,7 +1965,8 @@ int fnet_socket_buffer_append_address( fnet_socket_buffer_t *sb, fnet_netbuf_t *
     sb->count += nb->total_length;
 
     nb = fnet_netbuf_concat(nb_addr, nb);
-    fnet_netbuf_add_chain(&sb->net_buf_chain, nb);
+    fnet_netbuf_add_chain_tail(&sb->net_buf_chain, &sb->net_buf_tail, nb);
+    sb->net_buf_tail_room = 0;
     fnet_isr_unlock();
     
 	/* Wake-up user application.*/
@@ -1592,6 +2008,193 @@ int fnet_socket_buffer_read_record( fnet_socket_buffer_t *sb, char *buf, int len
     return len;
 }
 
+/************************************************************************
+* NAME: fnet_socket_buffer_remove_record
+*
+* DESCRIPTION: This function removes data from the stream socket buffer 
+*              and puts this data into application buffer. 
+*              It must be called with fnet_isr_lock() held.
+*              Only the tail, that is a part of a net_buf, is copied here.
+*              The net_bufs, that are read entirely, are just unlinked and 
+*              returned in 'detached'. They are copied by 
+*              fnet_socket_buffer_copy_detached() after fnet_isr_unlock(), 
+*              so the bottom halves are not held back by the copying.
+*************************************************************************/
+int fnet_socket_buffer_remove_record( fnet_socket_buffer_t *sb, char *buf, int len, fnet_netbuf_t **detached )
+{
+    fnet_netbuf_t   *nb;
+    fnet_netbuf_t   *nb_last = 0;
+    unsigned long   detached_len = 0;
+
+    *detached = 0;
+
+    if(sb->net_buf_chain)
+    {
+        if(len > sb->net_buf_chain->total_length)
+            len = (int)sb->net_buf_chain->total_length;
+
+        /* Find the net_bufs, that are read entirely.*/
+        nb = sb->net_buf_chain;
+
+        while(nb && ((detached_len + nb->length) <= (unsigned long)len))
+        {
+            detached_len += nb->length;
+            nb_last = nb;
+            nb = nb->next;
+        }
+
+        if(nb_last)
+        {
+            if(nb)
+                nb->total_length = sb->net_buf_chain->total_length - detached_len;
+
+            *detached = sb->net_buf_chain;
+            (*detached)->total_length = detached_len;
+            nb_last->next = 0;
+            sb->net_buf_chain = nb;
+        }
+
+        /* Copy the rest, it is a part of the first remaining net_buf.*/
+        if((unsigned long)len > detached_len)
+        {
+            fnet_netbuf_to_buf(sb->net_buf_chain, 0, (int)(len - detached_len), buf + detached_len);
+            fnet_netbuf_trim(&sb->net_buf_chain, (int)(len - detached_len));
+        }
+
+        sb->count -= len;
+    }
+    else
+        len = 0;
+
+    return len;
+}
+
+/************************************************************************
+* NAME: fnet_socket_buffer_copy_detached
+*
+* DESCRIPTION: This function copies the net_bufs, detached by 
+*              fnet_socket_buffer_remove_record(), into application 
+*              buffer and frees them.
+*************************************************************************/
+void fnet_socket_buffer_copy_detached( fnet_netbuf_t *detached, char *buf )
+{
+    if(detached)
+    {
+        fnet_netbuf_to_buf(detached, 0, (int)detached->total_length, buf);
+        fnet_netbuf_free_chain(detached);
+    }
+}
+
+/************************************************************************
+* NAME: fnet_socket_buffer_detach_record
+*
+* DESCRIPTION: This function removes up to len bytes from the stream 
+*              socket buffer and returns them as a net_buf chain, 
+*              without copying the data. A net_buf, that is removed 
+*              only partly, shares its data buffer with the socket buffer.
+*              It must be called with fnet_isr_lock() held.
+*************************************************************************/
+fnet_netbuf_t *fnet_socket_buffer_detach_record( fnet_socket_buffer_t *sb, int len )
+{
+    fnet_netbuf_t   *nb;
+    fnet_netbuf_t   *nb_last = 0;
+    fnet_netbuf_t   *detached = 0;
+    fnet_netbuf_t   *part = 0;
+    unsigned long   detached_len = 0;
+
+    if((sb->net_buf_chain == 0) || (len <= 0))
+        return 0;
+
+    if(len > sb->net_buf_chain->total_length)
+        len = (int)sb->net_buf_chain->total_length;
+
+    /* Find the net_bufs, that are removed entirely.*/
+    nb = sb->net_buf_chain;
+
+    while(nb && ((detached_len + nb->length) <= (unsigned long)len))
+    {
+        detached_len += nb->length;
+        nb_last = nb;
+        nb = nb->next;
+    }
+
+    /* The rest is a part of the first remaining net_buf.*/
+    if((unsigned long)len > detached_len)
+        part = fnet_netbuf_copy(nb, 0, (int)(len - detached_len), FNET_FALSE);
+
+    if(nb_last)
+    {
+        if(nb)
+            nb->total_length = sb->net_buf_chain->total_length - detached_len;
+
+        detached = sb->net_buf_chain;
+        detached->total_length = detached_len;
+        nb_last->next = 0;
+        sb->net_buf_chain = nb;
+    }
+
+    if(part)
+    {
+        fnet_netbuf_trim(&sb->net_buf_chain, (int)part->total_length);
+        detached_len += part->total_length;
+        detached = fnet_netbuf_concat(detached, part);
+    }
+
+    sb->count -= detached_len;
+
+    return detached;
+}
+
+/************************************************************************
+* NAME: fnet_socket_buffer_detach_address
+*
+* DESCRIPTION: This function removes the first datagram from the socket
+*              buffer and returns its data as a net_buf chain, without
+*              copying, and the address from which it was sent. 
+*              If remove is 0, the datagram stays in the socket buffer
+*              and the returned chain shares its data.
+*
+* RETURNS: The length of the datagram, or FNET_ERR if no memory.
+*************************************************************************/
+int fnet_socket_buffer_detach_address( fnet_socket_buffer_t *sb, fnet_netbuf_t **nb_ptr, struct sockaddr *foreign_addr, int remove )
+{
+    fnet_netbuf_t   *nb;
+    fnet_netbuf_t   *nb_addr;
+    int             len = 0;
+
+    *nb_ptr = 0;
+
+    fnet_isr_lock();
+
+    if((nb_addr = sb->net_buf_chain) != 0) 
+    {
+        *foreign_addr = ((fnet_socket_buffer_addr_t *)(nb_addr->data_ptr))->addr_s;
+
+        if((nb = nb_addr->next) != 0)
+            len = (int)nb->total_length;
+
+        if(remove)
+        {
+            sb->net_buf_chain = nb_addr->next_chain;
+            sb->count -= (unsigned long)len;
+
+            nb_addr->next = 0;
+            fnet_netbuf_free(nb_addr);
+
+            *nb_ptr = nb;
+        }
+        else if(nb)
+        {
+            if((*nb_ptr = fnet_netbuf_copy(nb, 0, FNET_NETBUF_COPYALL, FNET_FALSE)) == 0)
+                len = FNET_ERR;
+        }
+    }
+
+    fnet_isr_unlock();
+
+    return len;
+}
+
 /************************************************************************
 * NAME: fnet_socket_buffer_read_address
 *
@@ -50,6 +50,7 @@
 
 #include "fnet_ip.h"
 #include "fnet_ip6.h"
+#include "fnet_netbuf.h"
 
 /*! @addtogroup fnet_socket 
 * The Socket Application Program Interface (API) defines the way, in which the 
@@ -104,6 +105,14 @@
 * address.</td><td>X</td><td>X</td><td>@n</td><td>X</td>
 * </tr>
 * <tr>
+* <td>input</td><td>@ref fnet_recv_nb()</td><td>Receives the data as 
+* a net_buf chain, without copying.</td><td>X</td><td>X</td><td>@n</td><td>X</td>
+* </tr>
+* <tr>
+* <td>output</td><td>@ref fnet_send_nb()</td><td>Sends a net_buf chain, 
+* without copying.</td><td>X</td><td>X</td><td>@n</td><td>X</td>
+* </tr>
+* <tr>
 * <td>termination</td><td>@ref shutdown()</td><td>Terminates a connection 
 * in one or both directions.</td><td>X</td><td>X</td><td>X</td><td>X</td>
 * </tr>
@@ -1198,6 +1207,103 @@ int send( SOCKET s, char *buf, int len, int flags );
  ******************************************************************************/
 int sendto( SOCKET s, char *buf, int len, int flags, const struct sockaddr *to, int tolen );
 
+/***************************************************************************/ /*!
+ *
+ * @brief    Sends a net_buf chain, without copying its data.
+ *
+ *
+ * @param s      Descriptor, identifying a socket.
+ *
+ * @param nb     Net_buf chain containing the data to be transmitted.
+ *
+ * @param flags  Optional flag specifying the way, in which the call is made. 
+ *               It can be constructed by using the bitwise OR operator with
+ *               any of the values defined by the @ref fnet_flags_t.
+ *
+ * @param to     Optional pointer to the address of the target socket.
+ *
+ * @param tolen  Size of the address in @c to.
+ *
+ *
+ * @return This function returns:
+ *   - The total number of bytes sent, if no error occurs. 
+ *   - @c 0, if the chain is empty or, for a stream-oriented socket, 
+ *     there is no room for it in the socket output buffer.
+ *   - @ref SOCKET_ERROR if an error occurs. @n 
+ *     The specific error code can be retrieved using the @ref fnet_error_get().
+ *
+ * @see sendto(), fnet_recv_nb(), fnet_netbuf_from_const()
+ *
+ ******************************************************************************
+ *
+ * This function is the zero-copy variant of @ref sendto(). The stack 
+ * takes the chain over and frees it, with @ref fnet_netbuf_free_chain(), 
+ * when it is transmitted or acknowledged, or when an error occurs. 
+ * The only exception is a stream-oriented socket (@ref SOCK_STREAM) 
+ * returning @c 0: the chain is then left to the application, 
+ * which can retry later.@n
+ * @n
+ * For stream-oriented sockets, the chain is added to the socket output buffer
+ * as a whole or not at all, and its data must not be changed until it is freed. 
+ * The segments and their retransmissions share the data of the chain.@n
+ * For message-oriented sockets (@ref SOCK_DGRAM), the chain is sent as 
+ * one datagram.@n
+ * @n
+ * A chain can be allocated by @ref fnet_netbuf_new(), or can refer to 
+ * constant data (in flash for example) by @ref fnet_netbuf_from_const(). 
+ * Raw sockets (@ref SOCK_RAW) do not support this function.
+ *
+ ******************************************************************************/
+int fnet_send_nb( SOCKET s, fnet_netbuf_t *nb, int flags, const struct sockaddr *to, int tolen );
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Receives the data as a net_buf chain, without copying it, 
+ *           and captures the address from which the data was sent.
+ *
+ *
+ * @param s       Descriptor, identifying a socket.
+ *
+ * @param nb      Pointer to the net_buf chain pointer, that receives 
+ *                the data. It is set to @c 0, if no data is received.
+ *
+ * @param len     Maximum length of the data to receive, for 
+ *                stream-oriented sockets. @n
+ *                It is ignored for message-oriented sockets, a whole 
+ *                datagram is received.
+ *
+ * @param flags   Optional flag specifying the way, in which the call is made. 
+ *                It can be constructed by using the bitwise OR operator with
+ *                any of the values defined by the @ref fnet_flags_t.
+ *
+ * @param from    Optional pointer to a buffer that will hold the 
+ *                source address upon return.
+ *
+ * @param fromlen Optional pointer to the size of the @c from buffer.
+ *
+ *
+ * @return This function returns:
+ *   - The number of bytes received, if no error occurs. 
+ *     The return value is zero if there is no input data.
+ *   - @ref SOCKET_ERROR if an error occurs. @n 
+ *     The specific error code can be retrieved using the @ref fnet_error_get().
+ *
+ * @see recvfrom(), fnet_send_nb()
+ *
+ ******************************************************************************
+ *
+ * This function is the zero-copy variant of @ref recvfrom(). The application
+ * owns the received chain and must free it by @ref fnet_netbuf_free_chain(). @n
+ * With the @ref MSG_PEEK flag, the data stays in the socket input buffer and 
+ * the returned chain shares it, so it must not be changed.@n
+ * @n
+ * Out-of-band data (@ref MSG_OOB) can be received only by @ref recv() 
+ * or @ref recvfrom(). 
+ * Raw sockets (@ref SOCK_RAW) do not support this function.
+ *
+ ******************************************************************************/
+int fnet_recv_nb( SOCKET s, fnet_netbuf_t **nb, int len, int flags, struct sockaddr *from, int *fromlen );
+
 /***************************************************************************/ /*!
  *
  * @brief    Terminates the connection in one or both directions.
@@ -1456,6 +1562,181 @@ int fnet_socket_addr_are_equal(const struct sockaddr *addr1, const struct sockad
  ******************************************************************************/
 int fnet_socket_addr_is_unspecified(const struct sockaddr *addr);
 
+/**************************************************************************/ /*!
+ * @brief Socket readiness events, used by @ref fnet_poll(), @ref fnet_select() 
+ * and @ref fnet_socket_callback_t.
+ *
+ * The events can be combined by using the bitwise OR.
+ ******************************************************************************/
+typedef enum
+{
+    FNET_POLLIN   = (0x01), /**< @brief Data can be read without blocking, or 
+                             *   a new connection can be accepted on a listening socket. @n
+                             *   It is also set when the peer has closed the connection.
+                             */
+    FNET_POLLPRI  = (0x02), /**< @brief Urgent (out-of-band) data can be read.
+                             */
+    FNET_POLLOUT  = (0x04), /**< @brief Data can be sent without blocking.
+                             */
+    FNET_POLLERR  = (0x08), /**< @brief An asynchronous error is pending 
+                             *   (connection reset, ICMP error, timeout). @n
+                             *   It is returned, even if it was not requested.
+                             */
+    FNET_POLLHUP  = (0x10), /**< @brief The stream socket is not connected. @n
+                             *   It is returned, even if it was not requested.
+                             */
+    FNET_POLLNVAL = (0x20)  /**< @brief The socket descriptor is invalid. @n
+                             *   It is returned only by @ref fnet_poll().
+                             */
+} fnet_poll_event_t;
+
+/**************************************************************************/ /*!
+ * @brief Socket entry of the @ref fnet_poll() list.
+ ******************************************************************************/
+struct fnet_pollfd
+{
+    SOCKET  fd;         /**< @brief Socket descriptor. @n
+                         *   The entry is ignored if it is negative. 
+                         */
+    int     events;     /**< @brief Requested events, defined by @ref fnet_poll_event_t.
+                         */
+    int     revents;    /**< @brief Returned events, defined by @ref fnet_poll_event_t.
+                         */
+};
+
+/**************************************************************************/ /*!
+ * @brief Socket descriptor set, used by @ref fnet_select(). @n
+ * It is handled by the @ref FNET_FD_ZERO(), @ref FNET_FD_SET(), 
+ * @ref FNET_FD_CLR() and @ref FNET_FD_ISSET() macros.
+ ******************************************************************************/
+typedef struct
+{
+    unsigned long fds_bits[(FNET_CFG_SOCKET_MAX + 31)/32]; /**< @brief One bit per socket descriptor.*/
+} fnet_fd_set;
+
+/** @brief Clears the socket descriptor set @c set.*/
+#define FNET_FD_ZERO(set)       do{ unsigned int _i; \
+                                    for(_i = 0; _i < (sizeof((set)->fds_bits)/sizeof((set)->fds_bits[0])); _i++) \
+                                        (set)->fds_bits[_i] = 0; \
+                                }while(0)
+/** @brief Adds the socket descriptor @c s to the set @c set.*/
+#define FNET_FD_SET(s, set)     ((set)->fds_bits[(unsigned int)(s) >> 5] |= (1UL << ((unsigned int)(s) & 31)))
+/** @brief Removes the socket descriptor @c s from the set @c set.*/
+#define FNET_FD_CLR(s, set)     ((set)->fds_bits[(unsigned int)(s) >> 5] &= ~(1UL << ((unsigned int)(s) & 31)))
+/** @brief Tests, whether the socket descriptor @c s is a member of the set @c set.*/
+#define FNET_FD_ISSET(s, set)   (((set)->fds_bits[(unsigned int)(s) >> 5] & (1UL << ((unsigned int)(s) & 31))) != 0)
+
+/**************************************************************************/ /*!
+ * @brief Prototype of the socket event callback function, 
+ * registered by @ref fnet_socket_set_callback().
+ *
+ * @param s         Socket descriptor.
+ *
+ * @param revents   Current readiness events of the socket, 
+ *                  defined by @ref fnet_poll_event_t.
+ *
+ * @param cookie    User-application specific parameter. 
+ *
+ * It is called from the stack bottom-half (interrupt) context, 
+ * so it must not call the socket API. @n
+ * It is intended to mark the socket as ready and to wake up the main loop.
+ ******************************************************************************/
+typedef void(*fnet_socket_callback_t)(SOCKET s, int revents, long cookie);
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Checks readiness of a list of sockets.
+ *
+ * @param fds       Array of socket entries, defined by @ref fnet_pollfd.
+ *
+ * @param nfds      Number of entries in @c fds.
+ *
+ * @return This function returns the number of entries with non-zero 
+ *         @c revents field.
+ *
+ * @see fnet_select(), fnet_socket_set_callback()
+ *
+ ******************************************************************************
+ *
+ * This function sets the @c revents field of every entry to the requested 
+ * @c events, which are ready on the socket, plus @ref FNET_POLLERR and 
+ * @ref FNET_POLLHUP if they are present.@n
+ * The function does not block, it is equal to the BSD @c poll() with 
+ * zero timeout. @n
+ * It replaces calling non-blocking @ref recv() and @ref accept() 
+ * on every socket in the polling loop.
+ *
+ ******************************************************************************/
+int fnet_poll( struct fnet_pollfd *fds, unsigned int nfds );
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Checks readiness of sets of sockets.
+ *
+ * @param nfds      The highest socket descriptor in any of the sets, plus 1.
+ *
+ * @param readfds   (Optional) Sockets to be checked for readability. 
+ *
+ * @param writefds  (Optional) Sockets to be checked for writability.
+ *
+ * @param exceptfds (Optional) Sockets to be checked for errors 
+ *                  and urgent data.
+ *
+ * @return This function returns:
+ *   - The total number of ready socket descriptors in all sets.
+ *   - @ref SOCKET_ERROR if a set contains an invalid descriptor. @n 
+ *     The specific error code can be retrieved using the @ref fnet_error_get().
+ *
+ * @see fnet_poll()
+ *
+ ******************************************************************************
+ *
+ * This function leaves in the sets only the socket descriptors, that are ready. @n
+ * A socket is readable, if @ref recv() or @ref accept() does not block 
+ * (data, connection request, closed connection or error). @n
+ * A socket is writable, if @ref send() can queue data. @n
+ * The function does not block, it is equal to the BSD @c select() with 
+ * zero timeout.
+ *
+ ******************************************************************************/
+int fnet_select( int nfds, fnet_fd_set *readfds, fnet_fd_set *writefds, fnet_fd_set *exceptfds );
+
+/***************************************************************************/ /*!
+ *
+ * @brief    Registers the socket event callback.
+ *
+ * @param s         Socket descriptor.
+ *
+ * @param events    Events, defined by @ref fnet_poll_event_t, 
+ *                  the callback is called for. 
+ *
+ * @param callback  Callback function, defined by @ref fnet_socket_callback_t. @n
+ *                  @ref FNET_NULL unregisters the callback.
+ *
+ * @param cookie    Optional application-specific parameter, passed to the 
+ *                  @c callback function.
+ *
+ * @return This function returns:
+ *   - @ref FNET_OK if no error occurs.
+ *   - @ref SOCKET_ERROR if an error occurs. @n 
+ *     The specific error code can be retrieved using the @ref fnet_error_get().
+ *
+ * @see fnet_poll(), fnet_socket_callback_t
+ *
+ ******************************************************************************
+ *
+ * The @c callback is called by the stack when the socket state changes 
+ * (data or connection request received, data acknowledged, connection 
+ * established or closed, error) and one of @c events, @ref FNET_POLLERR 
+ * or @ref FNET_POLLHUP is ready. @n
+ * So a service can be idle until its socket gets an event, and the main 
+ * loop can sleep. @n
+ * The callback is unregistered automatically by @ref closesocket(). 
+ * It is not inherited by sockets returned by @ref accept().
+ *
+ ******************************************************************************/
+int fnet_socket_set_callback( SOCKET s, int events, fnet_socket_callback_t callback, long cookie );
+
 /*! @} */
 
 #endif /* _FNET_SOCKET_H_ */
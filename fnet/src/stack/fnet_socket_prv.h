@@ -85,6 +85,10 @@ typedef struct
     unsigned long   count;              /**< Aactual chars in buffer.*/
     unsigned long   count_max;          /**< Max actual char count (9*1024).*/
     fnet_netbuf_t   *net_buf_chain;     /**< The net_buf chain.*/
+    fnet_netbuf_t   *net_buf_tail;      /**< Last net_buf (stream) or last chain (datagram) of net_buf_chain, 
+                                         *   valid only while net_buf_chain is not 0.*/
+    unsigned long   net_buf_tail_room;  /**< Free space after the data of net_buf_tail, 
+                                         *   filled by fnet_socket_buffer_append_stream().*/
     int             is_shutdown;        /**< The socket has been shut down for read/write.*/    
 } fnet_socket_buffer_t;
 
@@ -140,6 +144,7 @@ typedef struct _socket
     int                     incoming_con_len;       /**< Number of connections on incoming_con.*/
     int                     con_limit;              /**< Max number queued connections (specified  by "listen").*/
     struct _socket          *head_con;              /**< Back pointer to accept socket.*/
+    struct _socket          *hash_next;             /**< Next socket in the same protocol lookup table entry (TCP).*/
 
     fnet_socket_buffer_t    receive_buffer;         /**< Socket buffer for incoming data.*/
     fnet_socket_buffer_t    send_buffer;            /**< Socket buffer for outgoing data.*/
@@ -148,6 +153,9 @@ typedef struct _socket
     struct sockaddr         foreign_addr;           /**< Foreign socket address.*/
     struct sockaddr         local_addr;             /**< Lockal socket address.*/
     fnet_socket_option_t    options;                /**< Collection of socket options.*/
+    fnet_socket_callback_t  callback;               /**< Event callback (optional).*/
+    int                     callback_events;        /**< Events, the callback is called for.*/
+    long                    callback_cookie;        /**< Event callback parameter.*/
     
 #if FNET_CFG_MULTICAST
     /* Multicast params.*/
@@ -173,6 +181,9 @@ typedef struct fnet_socket_prot_if
     int  (*prot_setsockopt)(fnet_socket_t *sk, int level, int optname, char *optval, int optlen);           /* Protocol "setsockopt" function. */
     int  (*prot_getsockopt)(fnet_socket_t *sk, int level, int optname, char *optval, int *optlen);          /* Protocol "getsockopt" function. */
     int  (*prot_listen)(fnet_socket_t *sk, int backlog);                                                    /* Protocol "listen" function.*/
+    int  (*prot_poll)(fnet_socket_t *sk);                                                                   /* (Optional) Protocol "poll" function, returns fnet_poll_event_t. */
+    int  (*prot_rcv_nb)(fnet_socket_t *sk, fnet_netbuf_t **nb_ptr, int len, int flags, struct sockaddr *foreign_addr );   /* (Optional) Protocol zero-copy "receive" function. */
+    int  (*prot_snd_nb)(fnet_socket_t *sk, fnet_netbuf_t *nb, int flags, const struct sockaddr *foreign_addr );           /* (Optional) Protocol zero-copy "send" function. */
                                                                            
 } fnet_socket_prot_if_t;
 
@@ -191,9 +202,15 @@ fnet_socket_t *fnet_socket_copy( fnet_socket_t *sock );
 void fnet_socket_release( fnet_socket_t ** head, fnet_socket_t *sock );
 int fnet_socket_buffer_append_address( fnet_socket_buffer_t *sb, fnet_netbuf_t *nb, struct sockaddr *addr);
 int fnet_socket_buffer_append_record( fnet_socket_buffer_t *sb, fnet_netbuf_t *nb );
+int fnet_socket_buffer_append_stream( fnet_socket_buffer_t *sb, const char *buf, int len, int block_size );
 int fnet_socket_buffer_read_address( fnet_socket_buffer_t *sb, char *buf, int len, struct sockaddr *foreign_addr, int remove );
 int fnet_socket_buffer_read_record( fnet_socket_buffer_t *sb, char *buf, int len, int remove );
+int fnet_socket_buffer_remove_record( fnet_socket_buffer_t *sb, char *buf, int len, fnet_netbuf_t **detached );
+void fnet_socket_buffer_copy_detached( fnet_netbuf_t *detached, char *buf );
+fnet_netbuf_t *fnet_socket_buffer_detach_record( fnet_socket_buffer_t *sb, int len );
+int fnet_socket_buffer_detach_address( fnet_socket_buffer_t *sb, fnet_netbuf_t **nb_ptr, struct sockaddr *foreign_addr, int remove );
 void fnet_socket_buffer_release( fnet_socket_buffer_t *sb );
+void fnet_socket_notify( fnet_socket_t *sock );
 
 int fnet_ip_setsockopt( fnet_socket_t *sock, int level, int optname, char *optval, int optlen );
 int fnet_ip_getsockopt( fnet_socket_t *sock, int level, int optname, char *optval, int *optlen );
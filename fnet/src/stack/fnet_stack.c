@@ -87,7 +87,11 @@ int fnet_init( struct fnet_init_params *init_params )
 *************************************************************************/
 int fnet_init_static()
 {
+#ifdef FNET_CFG_CPU_HEAP_ADDR
+    unsigned char *heap = (unsigned char *)FNET_CFG_CPU_HEAP_ADDR; /* Platform-reserved RAM. */
+#else
     static unsigned char heap[FNET_CFG_HEAP_SIZE];
+#endif
     struct fnet_init_params init_params;
 
     init_params.netheap_ptr = heap;
@@ -67,6 +67,77 @@
     #define FNET_CFG_IP4                    (1)
 #endif
 
+/**************************************************************************/ /*!
+ * @def     FNET_CFG_ARP_TABLE_SIZE
+ * @brief   Maximum number of entries in the ARP cache (per interface).
+ *          If the cache is full, the oldest entry is replaced.
+ * @showinitializer 
+ ******************************************************************************/ 
+#ifndef FNET_CFG_ARP_TABLE_SIZE
+    #define FNET_CFG_ARP_TABLE_SIZE         (10)
+#endif
+
+/**************************************************************************/ /*!
+ * @def     FNET_CFG_ARP_HASH_SIZE
+ * @brief   Number of hash buckets of the ARP cache (per interface).
+ *          It must be a power of two.
+ * @showinitializer 
+ ******************************************************************************/ 
+#ifndef FNET_CFG_ARP_HASH_SIZE
+    #define FNET_CFG_ARP_HASH_SIZE          (8)
+#endif
+
+/**************************************************************************/ /*!
+ * @def     FNET_CFG_ARP_HOLD_MAX
+ * @brief   Maximum number of packets queued for an unresolved 
+ *          ARP cache entry. 
+ *          When the queue is full, the oldest packet is dropped.
+ * @showinitializer 
+ ******************************************************************************/ 
+#ifndef FNET_CFG_ARP_HOLD_MAX
+    #define FNET_CFG_ARP_HOLD_MAX           (3)
+#endif
+
+/**************************************************************************/ /*!
+ * @def     FNET_CFG_ARP_REFRESH
+ * @brief   ARP cache entry refresh:
+ *               - @b @c 1 = is enabled (Default value). @n
+ *                 An entry that was used since the previous ARP timer run 
+ *                 is refreshed by a unicast ARP request before it expires,
+ *                 so transmits do not wait for the resolution.
+ *               - @c 0 = is disabled.
+ * @showinitializer 
+ ******************************************************************************/ 
+#ifndef FNET_CFG_ARP_REFRESH
+    #define FNET_CFG_ARP_REFRESH            (1)
+#endif
+
+/**************************************************************************/ /*!
+ * @def     FNET_CFG_ARP_LEARN_GRATUITOUS
+ * @brief   Learning of the ARP cache entries from gratuitous ARP packets:
+ *               - @c 1 = is enabled. @n
+ *                 An entry is created for the sender of a gratuitous ARP.
+ *               - @b @c 0 = is disabled (Default value). @n
+ *                 Gratuitous ARPs update existing entries only.
+ * @showinitializer 
+ ******************************************************************************/ 
+#ifndef FNET_CFG_ARP_LEARN_GRATUITOUS
+    #define FNET_CFG_ARP_LEARN_GRATUITOUS   (0)
+#endif
+
+/**************************************************************************/ /*!
+ * @def     FNET_CFG_ARP_LEARN_IP
+ * @brief   Learning of the ARP cache entries from received IPv4 packets:
+ *               - @c 1 = is enabled. @n
+ *                 The source MAC address of an IPv4 packet from 
+ *                 an on-link sender creates or refreshes its ARP cache entry.
+ *               - @b @c 0 = is disabled (Default value).
+ * @showinitializer 
+ ******************************************************************************/ 
+#ifndef FNET_CFG_ARP_LEARN_IP
+    #define FNET_CFG_ARP_LEARN_IP           (0)
+#endif
+
 /**************************************************************************/ /*!
  * @def     FNET_CFG_IP6
  * @brief   IPv6 protocol support:
@@ -484,6 +555,48 @@
     #define FNET_CFG_TCP_URGENT                 (0)
 #endif
 
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_TCP_SACK
+ * @brief    TCP Selective Acknowledgment (SACK, RFC 2018):
+ *               - @b @c 1 = is enabled (Default value).
+ *               - @c 0 = is disabled.@n
+ *           @n
+ *           If both sides permit it, the segments received out of order 
+ *           are reported to another side, and after a loss only the holes 
+ *           reported by another side are retransmitted.@n
+ *           The out-of-order segments are reported only if 
+ *           @ref FNET_CFG_TCP_DISCARD_OUT_OF_ORDER is @c 0.
+ * @see FNET_CFG_TCP_SACK_BLOCKS
+ * @showinitializer 
+ ******************************************************************************/
+#ifndef FNET_CFG_TCP_SACK
+    #define FNET_CFG_TCP_SACK                   (1)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_TCP_SACK_BLOCKS
+ * @brief    Maximal number of the SACK blocks, that are kept 
+ *           for every connection, about the sent data received by 
+ *           another side out of order.@n
+ *           Each block takes 8 bytes of the TCP control block.
+ * @showinitializer 
+ ******************************************************************************/
+#ifndef FNET_CFG_TCP_SACK_BLOCKS
+    #define FNET_CFG_TCP_SACK_BLOCKS            (4)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_TCP_HASH_SIZE
+ * @brief    Number of entries in the TCP connection lookup table.@n
+ *           Incoming segments are matched to sockets through this table
+ *           hashed by the address and ports, instead of scanning 
+ *           all sockets. It must be a power of two.
+ * @showinitializer 
+ ******************************************************************************/
+#ifndef FNET_CFG_TCP_HASH_SIZE
+    #define FNET_CFG_TCP_HASH_SIZE              (16)
+#endif
+
 /**************************************************************************/ /*!
  * @def      FNET_CFG_UDP
  * @brief    UDP protocol support:
@@ -554,6 +667,98 @@
     #define FNET_CFG_HEAP_SIZE                  (50 * 1024)
 #endif
 
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_MEMPOOL_TLSF
+ * @brief    Heap allocator:
+ *               - @b @c 1 = Two-Level Segregated Fit allocator (default value).@n
+ *                 Allocation and release take constant time, freed
+ *                 memory is merged with free neighbours at once.
+ *               - @c 0 = Free-list allocator. Allocation and release 
+ *                 time grow with heap fragmentation.
+ * @showinitializer 
+ ******************************************************************************/
+#ifndef FNET_CFG_MEMPOOL_TLSF
+    #define FNET_CFG_MEMPOOL_TLSF               (1)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_NETBUF_POOL
+ * @brief    Net_buf fixed-size pools:
+ *               - @b @c 1 = is enabled (default value).@n
+ *                 Net_buf descriptors, small data buffers and MTU-sized 
+ *                 data buffers are taken from pools, carved from the heap 
+ *                 by @ref fnet_init(). Their allocation and release 
+ *                 take constant time and do not fragment the heap.
+ *                 If a pool is empty, the heap is used.@n
+ *                 The pools take at most half of the heap. A pool that 
+ *                 does not fit is left out, and its size class is 
+ *                 served by the heap.
+ *               - @c 0 = is disabled.
+ * @showinitializer 
+ ******************************************************************************/
+#ifndef FNET_CFG_NETBUF_POOL
+    #define FNET_CFG_NETBUF_POOL                (1)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_NETBUF_POOL_HEADERS
+ * @brief    Number of net_buf descriptors in the descriptor pool.
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_NETBUF_POOL_HEADERS
+    #define FNET_CFG_NETBUF_POOL_HEADERS        (16)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_NETBUF_POOL_SMALL
+ * @brief    Number of data buffers in the small buffer pool.
+ *           They hold protocol headers and short packets.
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_NETBUF_POOL_SMALL
+    #define FNET_CFG_NETBUF_POOL_SMALL          (8)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_NETBUF_POOL_SMALL_SIZE
+ * @brief    Data size of the small buffer pool blocks, in bytes.
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_NETBUF_POOL_SMALL_SIZE
+    #define FNET_CFG_NETBUF_POOL_SMALL_SIZE     (64)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_NETBUF_POOL_LARGE
+ * @brief    Number of data buffers in the MTU-sized buffer pool.
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_NETBUF_POOL_LARGE
+    #define FNET_CFG_NETBUF_POOL_LARGE          (2)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_NETBUF_POOL_LARGE_SIZE
+ * @brief    Data size of the MTU-sized buffer pool blocks, in bytes.
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_NETBUF_POOL_LARGE_SIZE
+    #define FNET_CFG_NETBUF_POOL_LARGE_SIZE     (1500)
+#endif
+
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_NETBUF_HEADROOM
+ * @brief    Number of bytes left free in front of the protocol headers
+ *           that the stack allocates for outgoing packets, so that 
+ *           the lower layers can prepend their headers in place.@n
+ *           The default covers the IPv4 and Ethernet headers and keeps 
+ *           the IPv4 header 32-bit aligned. It must be a multiple of 4.
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_NETBUF_HEADROOM
+    #define FNET_CFG_NETBUF_HEADROOM            (36)
+#endif
+
 /**************************************************************************/ /*!
  * @def      FNET_CFG_SOCKET_MAX
  * @brief    Maximum number of sockets that can exist at the same time.
@@ -669,6 +874,22 @@
     #define FNET_CFG_IP_MAX_PACKET              (10*1024)  
 #endif
 
+/**************************************************************************/ /*!
+ * @def      FNET_CFG_IP_QUEUE_SIZE
+ * @brief    Number of entries of the IPv4 and IPv6 input queues. 
+ *           It must be a power of two. 
+ *           Received datagrams are dropped, when the queue is full. @n
+ *           Default value is @b @c 8.
+ * @showinitializer
+ ******************************************************************************/
+#ifndef FNET_CFG_IP_QUEUE_SIZE
+    #define FNET_CFG_IP_QUEUE_SIZE              (8)  
+#endif
+
+#if (FNET_CFG_IP_QUEUE_SIZE & (FNET_CFG_IP_QUEUE_SIZE - 1))
+    #error "FNET_CFG_IP_QUEUE_SIZE must be a power of two."
+#endif
+
 /*****************************************************************************
  * Function Overload
  *****************************************************************************/
@@ -50,6 +50,13 @@
 /************************************************************************
 *     Definitions
 *************************************************************************/
+#if (FNET_CFG_TCP_HASH_SIZE & (FNET_CFG_TCP_HASH_SIZE - 1)) || (FNET_CFG_TCP_HASH_SIZE == 0)
+    #error "FNET_CFG_TCP_HASH_SIZE must be a power of two"
+#endif
+
+#define FNET_TCP_LISTEN_HASH_SIZE       (4)     /* Listening sockets, by local port.*/
+#define FNET_TCP_LISTEN_HASH(port)      (((port) ^ ((port) >> 8)) & (FNET_TCP_LISTEN_HASH_SIZE - 1))
+
 struct fnet_tcp_segment
 {
     fnet_socket_option_t    *sockoption; 
@@ -65,35 +72,47 @@ struct fnet_tcp_segment
     fnet_netbuf_t           *data;
 };
 
+/* Lookup tables of fnet_tcp_findsk(). Sockets with a foreign address 
+ * (connected, partial and incoming) are hashed by the local port 
+ * and the foreign address and port. Listening sockets are hashed by 
+ * the local port. */
+static fnet_socket_t *fnet_tcp_hash_con[FNET_CFG_TCP_HASH_SIZE];
+static fnet_socket_t *fnet_tcp_hash_listen[FNET_TCP_LISTEN_HASH_SIZE];
+
 /************************************************************************
 *     Function Prototypes
 *************************************************************************/
 static void fnet_tcp_slowtimo( void *cookie );
-static void fnet_tcp_fasttimo( void *cookie );
 static void fnet_tcp_slowtimosk( fnet_socket_t *sk );
-static void fnet_tcp_fasttimosk( fnet_socket_t *sk );
-static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct sockaddr *src_addr,  struct sockaddr *dest_addr);
+static void fnet_tcp_rexmt_timeo( void *cookie );
+static void fnet_tcp_delack_timeo( void *cookie );
+static int fnet_tcp_timers_new( fnet_socket_t *sk );
+static void fnet_tcp_rexmt_start( fnet_tcp_control_t *cb, int rto );
+static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, fnet_tcp_seginfo_t *seg, struct sockaddr *src_addr,  struct sockaddr *dest_addr);
 static void fnet_tcp_initconnection( fnet_socket_t *sk );
-static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, int *ackparam );
+static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, fnet_tcp_seginfo_t *seg, int *ackparam );
 static int fnet_tcp_sendheadseg( fnet_socket_t *sk, unsigned char flags, void *options, char optlen );
 static int fnet_tcp_senddataseg( fnet_socket_t *sk, void *options, char optlen, unsigned long datasize );
 static unsigned long fnet_tcp_getrcvwnd( fnet_socket_t *sk );
 static int fnet_tcp_sendseg( struct fnet_tcp_segment *segment);                      
-static void fnet_tcp_sendrst( fnet_socket_option_t *sockoption, fnet_netbuf_t *insegment, struct sockaddr *src_addr,  struct sockaddr *dest_addr);
+static void fnet_tcp_sendrst( fnet_socket_option_t *sockoption, fnet_netbuf_t *insegment, fnet_tcp_seginfo_t *seg, struct sockaddr *src_addr,  struct sockaddr *dest_addr);
 static void fnet_tcp_sendrstsk( fnet_socket_t *sk );
 static void fnet_tcp_sendack( fnet_socket_t *sk );
 static void fnet_tcp_abortsk( fnet_socket_t *sk );
 static void fnet_tcp_setsynopt( fnet_socket_t *sk, char *options, char *optionlen );
 static void fnet_tcp_getsynopt( fnet_socket_t *sk );
-static int fnet_tcp_addopt( fnet_netbuf_t *segment, unsigned char len, void *data );
-static void fnet_tcp_getopt( fnet_socket_t *sk, fnet_netbuf_t *segment );
+static void fnet_tcp_getseginfo( fnet_netbuf_t *segment, fnet_tcp_seginfo_t *seg );
+static void fnet_tcp_getopt( fnet_socket_t *sk, fnet_tcp_seginfo_t *seg );
 static unsigned long fnet_tcp_getsize( unsigned long pos1, unsigned long pos2 );
 static void fnet_tcp_rtimeo( fnet_socket_t *sk );
 static void fnet_tcp_ktimeo( fnet_socket_t *sk );
 static void fnet_tcp_ptimeo( fnet_socket_t *sk );
 static int fnet_tcp_hit( unsigned long startpos, unsigned long endpos, unsigned long pos );
-static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int *ackparam );
+static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, fnet_tcp_seginfo_t *seg, int *ackparam );
 static fnet_socket_t *fnet_tcp_findsk( struct sockaddr *src_addr,  struct sockaddr *dest_addr );
+static unsigned int fnet_tcp_hash( const struct sockaddr *local_addr, const struct sockaddr *foreign_addr );
+static void fnet_tcp_hash_add( fnet_socket_t *sk );
+static void fnet_tcp_hash_del( fnet_socket_t *sk );
 static void fnet_tcp_addpartialsk( fnet_socket_t *mainsk, fnet_socket_t *partialsk );
 static void fnet_tcp_movesk2incominglist( fnet_socket_t *sk );
 static void fnet_tcp_closesk( fnet_socket_t *sk );
@@ -108,6 +127,14 @@ static int fnet_tcp_sendanydata( fnet_socket_t *sk, int oneexec );
 #if FNET_CFG_TCP_URGENT
     static void fnet_tcp_urgprocessing( fnet_socket_t *sk, fnet_netbuf_t ** segment, unsigned long repdatasize, int *ackparam );
 #endif
+#if FNET_CFG_TCP_SACK
+    static void fnet_tcp_sackupdate( fnet_tcp_control_t *cb, fnet_tcp_seginfo_t *seg );
+    static int fnet_tcp_sackretransmit( fnet_socket_t *sk );
+    static void fnet_tcp_sackskip( fnet_tcp_control_t *cb, unsigned long *datasize );
+#if !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER
+    static char fnet_tcp_setsackopt( fnet_socket_t *sk, char *options );
+#endif
+#endif /* FNET_CFG_TCP_SACK */
 static void fnet_tcp_finprocessing( fnet_socket_t *sk, unsigned long ack );
 static int fnet_tcp_init( void );
 static void fnet_tcp_release( void );
@@ -121,10 +148,15 @@ static int fnet_tcp_connect( fnet_socket_t *sk, struct sockaddr *foreign_addr);
 static fnet_socket_t *fnet_tcp_accept( fnet_socket_t *listensk );
 static int fnet_tcp_rcv( fnet_socket_t *sk, char *buf, int len, int flags, struct sockaddr *foreign_addr);
 static int fnet_tcp_snd( fnet_socket_t *sk, char *buf, int len, int flags, const struct sockaddr *foreign_addr);
+static void fnet_tcp_snd_output( fnet_socket_t *sk );
+static int fnet_tcp_rcv_nb( fnet_socket_t *sk, fnet_netbuf_t **nb_ptr, int len, int flags, struct sockaddr *foreign_addr);
+static int fnet_tcp_snd_nb( fnet_socket_t *sk, fnet_netbuf_t *nb, int flags, const struct sockaddr *foreign_addr);
+static void fnet_tcp_rcvd( fnet_socket_t *sk, int len );
 static int fnet_tcp_shutdown( fnet_socket_t *sk, int how );
 static int fnet_tcp_setsockopt( fnet_socket_t *sk, int level, int optname, char *optval, int optlen );
 static int fnet_tcp_getsockopt( fnet_socket_t *sk, int level, int optname, char *optval, int *optlen );
 static int fnet_tcp_listen( fnet_socket_t *sk, int backlog );
+static int fnet_tcp_poll( fnet_socket_t *sk );
 static void fnet_tcp_drain( void );
 
 #if FNET_CFG_DEBUG_TRACE_TCP
@@ -148,7 +180,6 @@ static void fnet_tcp_drain( void );
 static unsigned long fnet_tcp_isntime = 1;
 
 /* Timers.*/
-static fnet_timer_desc_t fnet_tcp_fasttimer;
 static fnet_timer_desc_t fnet_tcp_slowtimer;
 
 
@@ -167,7 +198,10 @@ static const fnet_socket_prot_if_t fnet_tcp_socket_api =
     fnet_tcp_shutdown,
     fnet_tcp_setsockopt, 
     fnet_tcp_getsockopt,
-    fnet_tcp_listen   
+    fnet_tcp_listen,
+    fnet_tcp_poll,
+    fnet_tcp_rcv_nb,
+    fnet_tcp_snd_nb
 };
 
 /* Protocol structure.*/
@@ -201,21 +235,12 @@ fnet_prot_if_t fnet_tcp_prot_if =
 static int fnet_tcp_init( void )
 {
 
-    /* Create the slow timer.*/
-    fnet_tcp_fasttimer = fnet_timer_new(FNET_TCP_FASTTIMO / FNET_TIMER_PERIOD_MS, fnet_tcp_fasttimo, 0);
-
-    if(!fnet_tcp_fasttimer)
-        return FNET_ERR;
-
-    /* Create the fast timer.*/
+    /* Create the slow timer. The retransmission and delayed acknowledgment 
+     * timers are per control block.*/
     fnet_tcp_slowtimer = fnet_timer_new(FNET_TCP_SLOWTIMO / FNET_TIMER_PERIOD_MS, fnet_tcp_slowtimo, 0);
 
     if(!fnet_tcp_slowtimer)
-    {
-        fnet_timer_free(fnet_tcp_fasttimer);
-        fnet_tcp_fasttimer = 0;
         return FNET_ERR;
-    }
 
     return FNET_OK;
 }
@@ -242,10 +267,8 @@ static void fnet_tcp_release( void )
     }
 
     /* Free timers.*/
-    fnet_timer_free(fnet_tcp_fasttimer);
     fnet_timer_free(fnet_tcp_slowtimer);
 
-    fnet_tcp_fasttimer = 0;
     fnet_tcp_slowtimer = 0;
 
     fnet_isr_unlock();
@@ -310,10 +333,13 @@ static void fnet_tcp_input_ip6(fnet_netif_t *netif, fnet_ip6_addr_t *src_ip, fne
 static void fnet_tcp_input(fnet_netif_t *netif, struct sockaddr *src_addr,  struct sockaddr *dest_addr, fnet_netbuf_t *nb, fnet_netbuf_t *ip_nb)
 {
 
-    fnet_socket_t   *sk;       
-    fnet_netbuf_t   *buf;
-    unsigned short  checksum; 
-    unsigned long   tcp_length;
+    fnet_socket_t       *sk;       
+    fnet_netbuf_t       *buf;
+    unsigned short      checksum; 
+    unsigned long       tcp_length;
+    fnet_tcp_seginfo_t  seg;
+    int                 notify;
+    int                 drop;
     
     tcp_length = (unsigned long)FNET_TCP_LENGTH(nb);
     
@@ -346,10 +372,13 @@ static void fnet_tcp_input(fnet_netif_t *netif, struct sockaddr *src_addr,  stru
     src_addr->sa_port = FNET_TCP_SPORT(nb);
     dest_addr->sa_port = FNET_TCP_DPORT(nb);
 
+    /* Decode the header, only once for all the processing.*/
+    fnet_tcp_getseginfo(nb, &seg);
+
     if(fnet_socket_addr_is_broadcast(dest_addr, netif) || fnet_socket_addr_is_multicast(dest_addr))
     {
         /* Send RST.*/
-        fnet_tcp_sendrst(0, nb, dest_addr, src_addr);
+        fnet_tcp_sendrst(0, nb, &seg, dest_addr, src_addr);
         goto DROP;
     }
     
@@ -366,14 +395,25 @@ static void fnet_tcp_input(fnet_netif_t *netif, struct sockaddr *src_addr,  stru
 
         nb->next_chain = 0;
 
+        /* Only application sockets have the callback. 
+         * They are not freed by the segment processing.*/
+        notify = (sk->callback != 0);
+
         /* Process  the segment.*/
-        if(fnet_tcp_inputsk(sk, nb, src_addr, dest_addr) == FNET_TRUE)
+        drop = fnet_tcp_inputsk(sk, nb, &seg, src_addr, dest_addr);
+
+        /* If the segment has closed the connection, 
+         * fnet_tcp_closesk() has notified already.*/
+        if(notify && (sk->state != SS_UNCONNECTED))
+            fnet_socket_notify(sk);
+
+        if(drop == FNET_TRUE)
             goto DROP;
     }
     else
     {
-        if(!(FNET_TCP_FLAGS(nb) & FNET_TCP_SGT_RST))
-            fnet_tcp_sendrst(0, nb, dest_addr, src_addr);
+        if(!(seg.flags & FNET_TCP_SGT_RST))
+            fnet_tcp_sendrst(0, nb, &seg, dest_addr, src_addr);
 
         goto DROP;
     }
@@ -493,6 +533,14 @@ static int fnet_tcp_attach( fnet_socket_t *sk )
 
     sk->protocol_control = (void *)cb;
 
+    if(fnet_tcp_timers_new(sk) == FNET_ERR)
+    {
+        fnet_free(cb);
+        sk->protocol_control = 0;
+        fnet_socket_set_error(sk, FNET_ERR_NOMEM);
+        return FNET_ERR;
+    }
+
     /* Set the maximal segment size option.*/
     sk->options.tcp_opt.mss = FNET_CFG_SOCKET_TCP_MSS;
 
@@ -680,12 +728,13 @@ static int fnet_tcp_connect( fnet_socket_t *sk, struct sockaddr *foreign_addr)
     /* Change the states.*/
     cb->tcpcb_connection_state = FNET_TCP_CS_SYN_SENT;
     sk->state = SS_CONNECTING;
+    fnet_tcp_hash_add(sk);
 
     /* Increase Initial Sequence Number.*/
     fnet_tcp_isntime += FNET_TCP_STEPISN;
 
     /* Initialize Abort Timer.*/
-    cb->tcpcb_timers.retransmission = cb->tcpcb_rto;
+    fnet_tcp_rexmt_start(cb, cb->tcpcb_rto);
     cb->tcpcb_timers.connection = FNET_TCP_ABORT_INTERVAL_CON;
 
     fnet_isr_unlock();
@@ -748,6 +797,7 @@ static int fnet_tcp_rcv( fnet_socket_t *sk, char *buf, int len, int flags, struc
     int                 remove; /* Remove flag. 1 means that the data must be deleted
                                  * from the input buffer after the reading.*/
     int                 error_code;                 
+    fnet_netbuf_t       *detached;
     
     /* Receive the flags.*/
     remove = !(flags & MSG_PEEK);
@@ -811,20 +861,26 @@ static int fnet_tcp_rcv( fnet_socket_t *sk, char *buf, int len, int flags, struc
         len = (int)sk->receive_buffer.count;
     }
 
-    /* Copy the data to the buffer.*/
-    len = fnet_socket_buffer_read_record(&sk->receive_buffer, buf, len, remove); 
-
     /* Remove the data from input buffer.*/
     if(remove)
     {
-        /* Recalculate the new free size in the input buffer.*/
-        cb->tcpcb_newfreercvsize += len;
+        /* Copy the data to the buffer.*/
+        len = fnet_socket_buffer_remove_record(&sk->receive_buffer, buf, len, &detached);
+
+        if(detached)
+        {
+            /* Let the RX processing run, while the whole net_bufs are copied.*/
+            fnet_isr_unlock();
+            fnet_socket_buffer_copy_detached(detached, buf);
+            fnet_isr_lock();
+        }
 
-        /* If the window is opened, send acknowledgment.*/
-        if((cb->tcpcb_newfreercvsize >= (cb->tcpcb_rcvmss << 1)
-                || cb->tcpcb_newfreercvsize >= (cb->tcpcb_rcvcountmax >> 1)
-                || (!cb->tcpcb_rcvwnd && cb->tcpcb_newfreercvsize)) && (sk->state == SS_CONNECTED))
-            fnet_tcp_sendack(sk);
+        fnet_tcp_rcvd(sk, len);
+    }
+    else
+    {
+        /* Copy the data to the buffer.*/
+        len = fnet_socket_buffer_read_record(&sk->receive_buffer, buf, len, 0); 
     }
 
     /* If the socket is not connected and the data are not received, return with error.*/
@@ -859,6 +915,52 @@ ERROR:
     return FNET_ERR;
 }
 
+/************************************************************************
+* NAME: fnet_tcp_snd_output
+*
+* DESCRIPTION: This function sends the data, that is added to 
+*              the output buffer, or sets the persist timer if the window 
+*              of another side is closed.
+*              It must be called with fnet_isr_lock() held.
+*************************************************************************/
+static void fnet_tcp_snd_output( fnet_socket_t *sk )
+{
+    fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control; 
+
+    /* If the window of another side is closed, set the persist timer.*/
+    if(!cb->tcpcb_sndwnd)
+    {
+        if(cb->tcpcb_timers.persist == FNET_TCP_TIMER_OFF)
+        {
+            cb->tcpcb_cprto = cb->tcpcb_rto;
+            cb->tcpcb_timers.persist = cb->tcpcb_cprto;
+        }
+    }
+    else
+    {
+        /* Try to send the data.*/
+        while(1)
+        {
+            /* If the connection is not established, delete the data. Otherwise try to send the data*/
+            if(sk->state == SS_CONNECTED)
+            {
+                if(!fnet_tcp_sendanydata(sk, 1))
+                {
+                    cb->tcpcb_flags &= ~FNET_TCP_CBF_INSND;
+                    break;
+                }
+            }
+            else
+            {
+                /* If socket is not connected, delete the output buffer.*/
+                fnet_socket_buffer_release(&sk->send_buffer);
+                cb->tcpcb_flags &= ~FNET_TCP_CBF_INSND;
+                break;
+            }
+        }
+    }
+}
+
 /************************************************************************
 * NAME: fnet_tcp_snd
 *
@@ -872,7 +974,6 @@ ERROR:
 static int fnet_tcp_snd( fnet_socket_t *sk, char *buf, int len, int flags, const struct sockaddr *foreign_addr)
 {
     fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control; 
-    fnet_netbuf_t       *netbuf;                                             
     long                sendlength = len;   /* Size of the data that must be sent.*/
     long                sentlength = 0;     /* Length of the sent data.*/
     long                freespace;          /* Free space in the output buffer.*/
@@ -908,7 +1009,7 @@ static int fnet_tcp_snd( fnet_socket_t *sk, char *buf, int len, int flags, const
         /* Check maximum allocated memory chunck */
         malloc_max = fnet_malloc_max_netbuf();
 
-        if(malloc_max < (long)(FNET_CFG_ETH_MTU*1.5)) //TBD I do not like it ????
+        if(malloc_max < FNET_TCP_TX_MALLOC_MIN)
         {
             freespace = 0;     
         }
@@ -984,56 +1085,18 @@ static int fnet_tcp_snd( fnet_socket_t *sk, char *buf, int len, int flags, const
             else
                 currentlen = sendlength;
 
-            netbuf = fnet_netbuf_from_buf(&buf[sentlength], currentlen, FNET_TRUE);
+            /* Add the data to the output buffer, joining it to the last 
+             * net_buf if possible. New net_bufs are sized for a full segment.*/
+            currentlen = fnet_socket_buffer_append_stream(&sk->send_buffer, &buf[sentlength], (int)currentlen,
+                                                          (cb->tcpcb_sndmss < freespace) ? cb->tcpcb_sndmss : (int)freespace);
 
             /* Check the memory allocation.*/
-            if(netbuf) 
+            if(currentlen) 
             {
                 sendlength -= currentlen;
                 sentlength += currentlen;
 
-                if(fnet_socket_buffer_append_record(&sk->send_buffer, netbuf) == FNET_OK)
-                {
-
-                    /* If the window of another side is closed, set the persist timer.*/
-                    if(!cb->tcpcb_sndwnd)
-                    {
-                        if(cb->tcpcb_timers.persist == FNET_TCP_TIMER_OFF)
-                        {
-                            cb->tcpcb_cprto = cb->tcpcb_rto;
-                            cb->tcpcb_timers.persist = cb->tcpcb_cprto;
-                        }
-                    }
-                    else
-                    {
-                        /* Try to send the data.*/
-                        while(1)
-                        {
-                            /* If the connection is not established, delete the data. Otherwise try to send the data*/
-                            if(sk->state == SS_CONNECTED)
-                            {
-                                if(!fnet_tcp_sendanydata(sk, 1))
-                                {
-                                    cb->tcpcb_flags &= ~FNET_TCP_CBF_INSND;
-                                    break;
-                                }
-                            }
-                            else
-                            {
-                                /* If socket is not connected, delete the output buffer.*/
-                                fnet_socket_buffer_release(&sk->send_buffer);
-                                cb->tcpcb_flags &= ~FNET_TCP_CBF_INSND;
-                                break;
-                            }
-                        }
-                    }                    
-                }
-                else /* Not able to add to the socket send buffer.*/
-                {
-                    fnet_netbuf_free( netbuf );
-                    fnet_isr_unlock();
-                    return 0;
-                }
+                fnet_tcp_snd_output(sk);
             }
         }
             
@@ -1060,6 +1123,199 @@ ERROR:
     return FNET_ERR;
 }
 
+/************************************************************************
+* NAME: fnet_tcp_rcvd
+*
+* DESCRIPTION: This function recalculates the free size of the input 
+*              buffer after the application removed 'len' bytes from it,
+*              and sends the acknowledgment if the window is opened.
+*************************************************************************/
+static void fnet_tcp_rcvd( fnet_socket_t *sk, int len )
+{
+    fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control;
+
+    /* Recalculate the new free size in the input buffer.*/
+    cb->tcpcb_newfreercvsize += len;
+
+    /* If the window is opened, send acknowledgment.*/
+    if((cb->tcpcb_newfreercvsize >= (cb->tcpcb_rcvmss << 1)
+            || cb->tcpcb_newfreercvsize >= (cb->tcpcb_rcvcountmax >> 1)
+            || (!cb->tcpcb_rcvwnd && cb->tcpcb_newfreercvsize)) && (sk->state == SS_CONNECTED))
+        fnet_tcp_sendack(sk);
+}
+
+/************************************************************************
+* NAME: fnet_tcp_rcv_nb
+*
+* DESCRIPTION: This function removes up to 'len' bytes from the input 
+*              buffer and returns them as a net_buf chain, without copying.
+*              With MSG_PEEK, the data stays in the buffer and 
+*              the returned chain shares it.
+* 
+* RETURNS: If no error occurs, this function returns the length
+*          of the received data. Otherwise, it returns FNET_ERR.
+*************************************************************************/
+static int fnet_tcp_rcv_nb( fnet_socket_t *sk, fnet_netbuf_t **nb_ptr, int len, int flags, struct sockaddr *foreign_addr)
+{
+    fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control;
+    int                 remove = !(flags & MSG_PEEK);
+    int                 error_code;
+    fnet_netbuf_t       *nb = 0;
+
+#if FNET_CFG_TCP_URGENT
+    if(flags & MSG_OOB)
+    {
+        error_code = FNET_ERR_OPNOTSUPP; /* Use recv() for the OOB byte.*/
+        goto ERROR;
+    }
+#endif /* FNET_CFG_TCP_URGENT */
+
+    fnet_isr_lock();
+
+#if FNET_CFG_TCP_URGENT
+    /* Calculate the length of the data that can be received.*/
+    if(cb->tcpcb_rcvurgmark > 0 && len >= cb->tcpcb_rcvurgmark)
+    {
+        len = cb->tcpcb_rcvurgmark;
+
+        if(remove)
+            cb->tcpcb_rcvurgmark = FNET_TCP_NOT_USED;
+    }
+    else 
+#endif /* FNET_CFG_TCP_URGENT */
+    if(sk->receive_buffer.count < len)
+    {
+        len = (int)sk->receive_buffer.count;
+    }
+
+    if(len > 0)
+    {
+        if(remove)
+            nb = fnet_socket_buffer_detach_record(&sk->receive_buffer, len);
+        else
+            nb = fnet_netbuf_copy(sk->receive_buffer.net_buf_chain, 0, len, FNET_FALSE);
+
+        if(nb == 0)
+        {
+            error_code = FNET_ERR_NOMEM;
+            goto ERROR_UNLOCK;
+        }
+
+        len = (int)nb->total_length;
+
+        if(remove)
+            fnet_tcp_rcvd(sk, len);
+    }
+    else
+    {
+        len = 0;
+    }
+
+    /* If the socket is not connected and the data are not received, return with error.*/
+    if(len == 0 && sk->state != SS_CONNECTED)
+    {
+        error_code = FNET_ERR_NOTCONN;
+        goto ERROR_UNLOCK;
+    }
+    
+    /* Set the foreign address and port.*/
+    if(foreign_addr)
+        *foreign_addr = sk->foreign_addr;
+     
+    /* If the socket is closed by peer and no data.*/
+    if((len == 0) && (cb->tcpcb_flags & FNET_TCP_CBF_FIN_RCVD))
+    {
+        error_code = FNET_ERR_CONNCLOSED;
+        goto ERROR_UNLOCK;
+    }
+    
+    fnet_isr_unlock();
+    *nb_ptr = nb;
+    return len;
+    
+ERROR_UNLOCK:
+    fnet_isr_unlock();
+#if FNET_CFG_TCP_URGENT    
+ERROR:
+#endif    
+    fnet_socket_set_error(sk, error_code);
+    return FNET_ERR;
+}
+
+/************************************************************************
+* NAME: fnet_tcp_snd_nb
+*
+* DESCRIPTION: This function adds the net_buf chain to the output buffer,
+*              without copying, and sends the data that can be sent.
+*              The chain is added as a whole or not at all. It is kept 
+*              until acknowledged, the segments and their retransmissions 
+*              share its data.
+*
+* RETURNS: The length of the chain, if it is added to the output buffer.
+*          0, if the chain is empty or there is no room for it, 
+*          the chain is then left to the caller. 
+*          Otherwise FNET_ERR, the chain is then freed.
+*************************************************************************/
+static int fnet_tcp_snd_nb( fnet_socket_t *sk, fnet_netbuf_t *nb, int flags, const struct sockaddr *foreign_addr)
+{
+    fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control; 
+    int                 len = (int)nb->total_length;
+    int                 dontroute = 0;      /* Routing flag.*/
+    int                 error_code;
+
+    FNET_COMP_UNUSED_ARG(foreign_addr);
+
+#if FNET_CFG_TCP_URGENT
+    if(flags & MSG_OOB)
+    {
+        error_code = FNET_ERR_OPNOTSUPP; /* Use send() for the OOB byte.*/
+        goto ERROR;
+    }
+#endif /* FNET_CFG_TCP_URGENT */
+
+    /* If the socket is not connected, return*/
+    if(sk->state != SS_CONNECTED)
+    {
+        error_code = FNET_ERR_NOTCONN;
+        goto ERROR;
+    }
+
+    if(len == 0)
+        return 0;
+
+    fnet_isr_lock();
+
+    /* If the routing tables should be bypassed for this message only, set dontroute flag.*/
+    if((flags & MSG_DONTROUTE) && !(sk->options.flags & SO_DONTROUTE))
+    {
+        dontroute = 1;
+        sk->options.flags |= SO_DONTROUTE;
+    }
+
+    if(fnet_socket_buffer_append_record(&sk->send_buffer, nb) == FNET_OK)
+    {
+        cb->tcpcb_flags |= FNET_TCP_CBF_INSND;
+        fnet_tcp_snd_output(sk);
+    }
+    else
+    {
+        len = 0; /* No room, the caller keeps the chain.*/
+    }
+
+    /* Remove the dontroute flag.*/
+    if(dontroute)
+        sk->options.flags &= ~SO_DONTROUTE;
+
+    fnet_isr_unlock();
+
+    return len;
+
+ERROR:
+    fnet_netbuf_free_chain(nb);
+    fnet_socket_set_error(sk, error_code);
+    return FNET_ERR;
+}
+
 /************************************************************************
 * NAME: fnet_tcp_shutdown
 *
@@ -1332,11 +1588,57 @@ static int fnet_tcp_listen( fnet_socket_t *sk, int backlog )
         /* Change the state.*/
         cb->tcpcb_connection_state = FNET_TCP_CS_LISTENING;
         sk->state = SS_LISTENING;
+        fnet_tcp_hash_add(sk);
     }
     
     return FNET_OK;
 }
 
+/************************************************************************
+* NAME: fnet_tcp_poll
+*
+* DESCRIPTION: This function returns the readiness flags 
+*              of the socket.
+*
+* RETURNS: Set of FNET_POLL* flags.
+*************************************************************************/
+static int fnet_tcp_poll( fnet_socket_t *sk )
+{
+    fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control;
+    int                 revents = 0;
+
+    switch(sk->state)
+    {
+        case SS_LISTENING:
+            /* Connection is ready to be accepted.*/
+            if(sk->incoming_con)
+                revents |= FNET_POLLIN;
+            break;
+        case SS_CONNECTED:
+            if(sk->receive_buffer.count || sk->receive_buffer.is_shutdown 
+                || (cb->tcpcb_flags & FNET_TCP_CBF_FIN_RCVD))
+                revents |= FNET_POLLIN;
+#if FNET_CFG_TCP_URGENT
+            if(cb->tcpcb_flags & FNET_TCP_CBF_RCVURGENT)
+                revents |= FNET_POLLPRI;
+#endif
+            if(!sk->send_buffer.is_shutdown && (sk->send_buffer.count < sk->send_buffer.count_max))
+                revents |= FNET_POLLOUT;
+            break;
+        case SS_CONNECTING:
+            break;
+        default:
+            /* The connection is closed or was never established.*/
+            revents |= FNET_POLLHUP;
+            
+            if(sk->receive_buffer.count)
+                revents |= FNET_POLLIN;
+            break;
+    }
+    
+    return revents;
+}
+
 /************************************************************************
 * NAME: fnet_tcp_drain
 *
@@ -1398,11 +1700,22 @@ static void fnet_tcp_drain( void )
 static void fnet_tcp_initconnection( fnet_socket_t *sk )
 {
     fnet_tcp_control_t  *cb;
+    fnet_timer_desc_t   rexmt_timer;
+    fnet_timer_desc_t   delack_timer;
 
     cb = sk->protocol_control;
 
+    /* The timers of the control block are kept, stopped.*/
+    rexmt_timer = cb->tcpcb_rexmt_timer;
+    delack_timer = cb->tcpcb_delack_timer;
+    fnet_timer_stop(rexmt_timer);
+    fnet_timer_stop(delack_timer);
+
     fnet_memset_zero(cb, sizeof(fnet_tcp_control_t));
 
+    cb->tcpcb_rexmt_timer = rexmt_timer;
+    cb->tcpcb_delack_timer = delack_timer;
+
     /* Set the default maximal segment size value.*/
     cb->tcpcb_sndmss = FNET_TCP_DEFAULT_MSS;
     cb->tcpcb_rcvmss = sk->options.tcp_opt.mss;
@@ -1423,13 +1736,10 @@ static void fnet_tcp_initconnection( fnet_socket_t *sk )
       cb->tcpcb_recvscale++;
 
     /* Stop all timers.*/
-    cb->tcpcb_timers.retransmission = FNET_TCP_TIMER_OFF;
     cb->tcpcb_timers.connection = FNET_TCP_TIMER_OFF;
     cb->tcpcb_timers.abort = FNET_TCP_TIMER_OFF;
-    cb->tcpcb_timers.round_trip = FNET_TCP_TIMER_OFF;
     cb->tcpcb_timers.persist = FNET_TCP_TIMER_OFF;
     cb->tcpcb_timers.keepalive = FNET_TCP_TIMER_OFF;
-    cb->tcpcb_timers.delayed_ack = FNET_TCP_TIMER_OFF;
 
     /* Initialize the retransmission timeout.*/
     cb->tcpcb_rto = cb->tcpcb_crto = FNET_TCP_TIMERS_INIT;
@@ -1457,24 +1767,17 @@ static void fnet_tcp_initconnection( fnet_socket_t *sk )
 * RETURNS: TRUE if the input segment must be deleted. Otherwise
 *          this function returns FALSE.          
 *************************************************************************/
-static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct sockaddr *src_addr,  struct sockaddr *dest_addr)
+static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, fnet_tcp_seginfo_t *seg, struct sockaddr *src_addr,  struct sockaddr *dest_addr)
 {
     fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control; 
     fnet_tcp_control_t  *pcb;                   /* Pointer to the partial control block.*/
-    unsigned char       sgmtype;                /* Flags of the segment.*/
     fnet_socket_t       *psk;                   /* Pointer to the partial socket.*/
     int                 result = FNET_TRUE;                         
     char                options[FNET_TCP_MAX_OPT_SIZE];    
     char                optionlen;                         
     unsigned long       repsize;                /* Size of repeated data.*/
     int                 ackparam = 0;           /* Acknowledgment parameter.*/
-    unsigned long       tcp_seq = fnet_ntohl(FNET_TCP_SEQ(insegment));
-    unsigned long       tcp_length = (unsigned long)FNET_TCP_LENGTH(insegment);
-    unsigned long       tcp_ack = fnet_ntohl(FNET_TCP_ACK(insegment));
 
-    /* Get the flags.*/
-    sgmtype = (unsigned char)(FNET_TCP_FLAGS(insegment));
-    
     /* Check the sequence number.*/
     switch(cb->tcpcb_connection_state)
     {
@@ -1483,23 +1786,23 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
             break;
 
         case FNET_TCP_CS_SYN_RCVD:
-            if(cb->tcpcb_prev_connection_state == FNET_TCP_CS_SYN_SENT && (sgmtype & FNET_TCP_SGT_SYN))
+            if(cb->tcpcb_prev_connection_state == FNET_TCP_CS_SYN_SENT && (seg->flags & FNET_TCP_SGT_SYN))
             {
                 /* Check the sequence number for simultaneouos open.*/
-                if(tcp_seq == cb->tcpcb_sndack - 1)
+                if(seg->seq == cb->tcpcb_sndack - 1)
                     break;
             }
         default:
-            if(FNET_TCP_COMP_G(cb->tcpcb_sndack, tcp_seq)) 
+            if(FNET_TCP_COMP_G(cb->tcpcb_sndack, seg->seq)) 
             {
-                if(FNET_TCP_COMP_G(tcp_seq + insegment->total_length - tcp_length, cb->tcpcb_sndack))
+                if(FNET_TCP_COMP_G(seg->seq + insegment->total_length - seg->length, cb->tcpcb_sndack))
                 {
                     /* Delete the left repeated part.*/
-                    repsize = fnet_tcp_getsize(tcp_seq, cb->tcpcb_sndack);
-                    fnet_netbuf_cut_center(&insegment, (int)tcp_length, (int)repsize);
+                    repsize = fnet_tcp_getsize(seg->seq, cb->tcpcb_sndack);
+                    fnet_netbuf_cut_center(&insegment, (int)seg->length, (int)repsize);
 
                     /* If urgent  flag is present, recalculate of the urgent pointer.*/
-                    if(sgmtype & FNET_TCP_SGT_URG)
+                    if(seg->flags & FNET_TCP_SGT_URG)
                     {
                         if((int)fnet_ntohs(FNET_TCP_URG(insegment)) - (int)repsize >= 0)               
                         {
@@ -1507,14 +1810,15 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
                         }
                         else
                         {
-                            sgmtype &= ~FNET_TCP_SGT_URG;
-                            FNET_TCP_SET_FLAGS(insegment) = sgmtype;
+                            seg->flags &= ~FNET_TCP_SGT_URG;
+                            FNET_TCP_SET_FLAGS(insegment) = seg->flags;
                         }
                     }
 
-                    /* Set the sequence number.*/
-                    tcp_seq = cb->tcpcb_sndack;
-                    FNET_TCP_SEQ(insegment) = fnet_htonl(tcp_seq);
+                    /* Set the sequence number.
+                     * The header is updated too, as the segment may be queued.*/
+                    seg->seq = cb->tcpcb_sndack;
+                    FNET_TCP_SEQ(insegment) = fnet_htonl(seg->seq);
 
                     /* Acknowledgment must be sent immediatelly.*/
                     ackparam |= FNET_TCP_AP_SEND_IMMEDIATELLY;
@@ -1528,7 +1832,7 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
                 }
             }
 
-            if(FNET_TCP_COMP_G(tcp_seq, cb->tcpcb_sndack + cb->tcpcb_rcvwnd))
+            if(FNET_TCP_COMP_G(seg->seq, cb->tcpcb_sndack + cb->tcpcb_rcvwnd))
             {
                 /* Segment is not in the window*/
                 /* Send the acknowledgment */
@@ -1537,11 +1841,11 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
             }
             else
             {
-                if(FNET_TCP_COMP_G(tcp_seq + insegment->total_length - tcp_length, cb->tcpcb_sndack + cb->tcpcb_rcvwnd))
+                if(FNET_TCP_COMP_G(seg->seq + insegment->total_length - seg->length, cb->tcpcb_sndack + cb->tcpcb_rcvwnd))
                 {
                     /* Delete the right part that is not in the window.*/
                     fnet_netbuf_trim(&insegment, -(int)fnet_tcp_getsize(cb->tcpcb_sndack + cb->tcpcb_rcvwnd,
-                                               (unsigned long)(tcp_seq + insegment->total_length - tcp_length)));
+                                               (unsigned long)(seg->seq + insegment->total_length - seg->length)));
                     /* Acknowledgment must be sent immediatelly.*/
                     ackparam |= FNET_TCP_AP_SEND_IMMEDIATELLY;
                 }
@@ -1549,11 +1853,11 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
     }
 
     /* Process the reset segment with acknowledgment.*/
-    if((sgmtype &(FNET_TCP_SGT_RST | FNET_TCP_SGT_ACK)) == (FNET_TCP_SGT_RST | FNET_TCP_SGT_ACK))
+    if((seg->flags &(FNET_TCP_SGT_RST | FNET_TCP_SGT_ACK)) == (FNET_TCP_SGT_RST | FNET_TCP_SGT_ACK))
     {
         if(cb->tcpcb_connection_state == FNET_TCP_CS_SYN_SENT)
         {
-              if(tcp_ack == cb->tcpcb_sndseq)
+              if(seg->ack == cb->tcpcb_sndseq)
                   /* Close the socket (connecting is failed).*/
                   sk->options.local_error = FNET_ERR_CONNRESET;
 
@@ -1564,7 +1868,7 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
     }
 
     /* Process the reset segment without acknowledgment.*/
-    if(sgmtype & FNET_TCP_SGT_RST)
+    if(seg->flags & FNET_TCP_SGT_RST)
     {
         switch(cb->tcpcb_connection_state)
         {
@@ -1583,7 +1887,7 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
 
 
     /* Process the SYN segment.*/
-    if(sgmtype & FNET_TCP_SGT_SYN)
+    if(seg->flags & FNET_TCP_SGT_SYN)
     {
         switch(cb->tcpcb_connection_state)
         {
@@ -1592,12 +1896,12 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
               break;
 
             case FNET_TCP_CS_SYN_RCVD:
-              if((cb->tcpcb_prev_connection_state == FNET_TCP_CS_SYN_SENT) && (tcp_seq == (cb->tcpcb_sndack - 1))) 
+              if((cb->tcpcb_prev_connection_state == FNET_TCP_CS_SYN_SENT) && (seg->seq == (cb->tcpcb_sndack - 1))) 
                   break;
 
             default:
               /* Close the socket and send the reset segment.*/
-              fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+              fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
               fnet_tcp_closesk(sk);
               return FNET_TRUE;
         }
@@ -1608,16 +1912,16 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
         switch(cb->tcpcb_connection_state)
         {
             case FNET_TCP_CS_LISTENING:
-              if(sgmtype & FNET_TCP_SGT_ACK)
+              if(seg->flags & FNET_TCP_SGT_ACK)
                   /* Send the reset segment.*/
-                  fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+                  fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
 
               return FNET_TRUE;
 
             case FNET_TCP_CS_SYN_SENT:
-              if(sgmtype & FNET_TCP_SGT_ACK)
+              if(seg->flags & FNET_TCP_SGT_ACK)
                   /* Send the reset segment.*/
-                  fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+                  fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
 
               return FNET_TRUE;
         }
@@ -1625,16 +1929,16 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
 
 
     /* Process the segment with acknowledgment.*/
-    if(sgmtype & FNET_TCP_SGT_ACK)
+    if(seg->flags & FNET_TCP_SGT_ACK)
     {
         switch(cb->tcpcb_connection_state)
         {
             case FNET_TCP_CS_SYN_SENT:
             case FNET_TCP_CS_SYN_RCVD:
-              if(tcp_ack != cb->tcpcb_sndseq) 
+              if(seg->ack != cb->tcpcb_sndseq) 
               {
                   /* Send the reset segment.*/
-                  fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+                  fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
                   return FNET_TRUE;
               }
 
@@ -1642,13 +1946,13 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
 
             case FNET_TCP_CS_LISTENING:
               /* Send the reset segment.*/
-              fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+              fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
               return FNET_TRUE;
               
             default:
-              if(!fnet_tcp_hit(cb->tcpcb_rcvack, cb->tcpcb_maxrcvack, tcp_ack))
+              if(!fnet_tcp_hit(cb->tcpcb_rcvack, cb->tcpcb_maxrcvack, seg->ack))
               {
-                  if(FNET_TCP_COMP_G(tcp_ack, cb->tcpcb_maxrcvack))
+                  if(FNET_TCP_COMP_G(seg->ack, cb->tcpcb_maxrcvack))
                       /* Send the acknowledgment.*/
                       fnet_tcp_sendack(sk);
 
@@ -1674,10 +1978,10 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
     }
 
     /* Set the window size (of another side).*/
-    if(sgmtype & FNET_TCP_SGT_SYN)
-        cb->tcpcb_sndwnd = fnet_ntohs(FNET_TCP_WND(insegment));
+    if(seg->flags & FNET_TCP_SGT_SYN)
+        cb->tcpcb_sndwnd = seg->wnd;
     else
-        cb->tcpcb_sndwnd = (unsigned long)(fnet_ntohs(FNET_TCP_WND(insegment)) << cb->tcpcb_sendscale);
+        cb->tcpcb_sndwnd = (unsigned long)(seg->wnd << cb->tcpcb_sendscale);
 
     if(cb->tcpcb_maxwnd < cb->tcpcb_sndwnd)
         cb->tcpcb_maxwnd = cb->tcpcb_sndwnd;
@@ -1686,32 +1990,32 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
     switch(cb->tcpcb_connection_state)
     {
         case FNET_TCP_CS_SYN_SENT:
-          cb->tcpcb_sndack = tcp_seq + 1; 
+          cb->tcpcb_sndack = seg->seq + 1; 
 
           /* Process the second segment of the open.*/
-          if(sgmtype & FNET_TCP_SGT_ACK)
+          if(seg->flags & FNET_TCP_SGT_ACK)
           {
-              cb->tcpcb_rcvack = tcp_ack;
+              cb->tcpcb_rcvack = seg->ack;
 
 #if FNET_CFG_TCP_URGENT
               /* Initialize the urgent sequence number.*/
-              cb->tcpcb_rcvurgseq = tcp_seq;
+              cb->tcpcb_rcvurgseq = seg->seq;
 #endif /* FNET_CFG_TCP_URGENT */
 
               /* Receive the options.*/
-              fnet_tcp_getopt(sk, insegment);
+              fnet_tcp_getopt(sk, seg);
               fnet_tcp_getsynopt(sk);
 
               /* If MSS of another side 0, return.*/
               if(!cb->tcpcb_sndmss)
               {
-                  fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+                  fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
                   fnet_tcp_closesk(sk);
                   return FNET_TRUE;
               }
 
               /* Stop the timers.*/
-              cb->tcpcb_timers.retransmission = FNET_TCP_TIMER_OFF;
+              fnet_timer_stop(cb->tcpcb_rexmt_timer);
               cb->tcpcb_timers.connection = FNET_TCP_TIMER_OFF;
 
               /* Send the acknowledgment (third segment of the open).*/
@@ -1731,23 +2035,23 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
           /* Process the simultaneous open.*/
           {
               /* Reinitialize the retrasmission timer.*/
-              cb->tcpcb_timers.retransmission = cb->tcpcb_rto;
+              fnet_tcp_rexmt_start(cb, cb->tcpcb_rto);
 
               /* Receive the options.*/
-              fnet_tcp_getopt(sk, insegment);
+              fnet_tcp_getopt(sk, seg);
               fnet_tcp_getsynopt(sk);
 
               /* If MSS of another side 0, return.*/
               if(!cb->tcpcb_sndmss)
               {
-                  fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+                  fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
                   fnet_tcp_closesk(sk);
                   return FNET_TRUE;
               }
 
 #if FNET_CFG_TCP_URGENT
               /* Initialize the urgent sequence number.*/
-              cb->tcpcb_rcvurgseq = tcp_seq;
+              cb->tcpcb_rcvurgseq = seg->seq;
 #endif /* FNET_CFG_TCP_URGENT */
 
               /* Change the states.*/
@@ -1800,7 +2104,18 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
             }
 
             /* Initialize the pointer.*/
+            fnet_memset_zero(pcb, sizeof(fnet_tcp_control_t));
             psk->protocol_control = (void *)pcb;
+
+            if(fnet_tcp_timers_new(psk) == FNET_ERR)
+            {
+                fnet_free(pcb);
+                fnet_free(psk);
+                cb->tcpcb_sndwnd = 0;
+                cb->tcpcb_maxwnd = 0;
+                break;
+            }
+
             fnet_tcp_initconnection(psk);
 
             /* Copy the control block parameters.*/
@@ -1813,29 +2128,30 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
             fnet_tcp_addpartialsk(sk, psk);
 
             /* Initialize the parameters of the control block.*/
-            pcb->tcpcb_sndack = tcp_seq + 1;
+            pcb->tcpcb_sndack = seg->seq + 1;
             pcb->tcpcb_sndseq = fnet_tcp_isntime;
             pcb->tcpcb_maxrcvack = fnet_tcp_isntime + 1;
           
 
 #if FNET_CFG_TCP_URGENT  
             pcb->tcpcb_sndurgseq = pcb->tcpcb_sndseq;        
-            pcb->tcpcb_rcvurgseq = tcp_seq;
+            pcb->tcpcb_rcvurgseq = seg->seq;
 #endif /* FNET_CFG_TCP_URGENT */
 
             /* Change the states.*/
             psk->state = SS_CONNECTING;
+            fnet_tcp_hash_add(psk);
             pcb->tcpcb_prev_connection_state = FNET_TCP_CS_LISTENING;
             pcb->tcpcb_connection_state = FNET_TCP_CS_SYN_RCVD;
 
             /* Receive the options.*/
-            fnet_tcp_getopt(psk, insegment);
+            fnet_tcp_getopt(psk, seg);
             fnet_tcp_getsynopt(psk);
 
             /* If MSS of another side 0, return.*/
             if(!pcb->tcpcb_sndmss)
             {
-                fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+                fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
                 fnet_tcp_closesk(psk);
                 break;
             }
@@ -1851,7 +2167,7 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
 
             /* Initialization the connection timer.*/
             pcb->tcpcb_timers.connection = FNET_TCP_ABORT_INTERVAL_CON;
-            pcb->tcpcb_timers.retransmission = pcb->tcpcb_rto;
+            fnet_tcp_rexmt_start(pcb, pcb->tcpcb_rto);
             break;
 
         case FNET_TCP_CS_SYN_RCVD:
@@ -1862,9 +2178,9 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
 
           /* Stop the connection and retransmission timers.*/
           cb->tcpcb_timers.connection = FNET_TCP_TIMER_OFF;
-          cb->tcpcb_timers.retransmission = FNET_TCP_TIMER_OFF;
+          fnet_timer_stop(cb->tcpcb_rexmt_timer);
 
-          cb->tcpcb_rcvack = tcp_ack;
+          cb->tcpcb_rcvack = seg->ack;
 
           /* If previous state is FNET_TCP_CS_LISTENING, process the acknowledgment (third segment of the open)
            * Otherwise, process the SYN segment.*/
@@ -1874,15 +2190,15 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
               fnet_tcp_movesk2incominglist(sk);
 
               /* Proceed the processing.*/
-              result = fnet_tcp_dataprocess(sk, insegment, &ackparam);
+              result = fnet_tcp_dataprocess(sk, insegment, seg, &ackparam);
               break;
           }
           else
           {
-              if(!(sgmtype & FNET_TCP_SGT_SYN))
+              if(!(seg->flags & FNET_TCP_SGT_SYN))
               {
                   /* Proseed the processing.*/
-                  result = fnet_tcp_dataprocess(sk, insegment, &ackparam);
+                  result = fnet_tcp_dataprocess(sk, insegment, seg, &ackparam);
               }
               else
               {
@@ -1899,13 +2215,13 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
         case FNET_TCP_CS_ESTABLISHED:
 
           /* Proseed the processing.*/
-          result = fnet_tcp_dataprocess(sk, insegment, &ackparam);
+          result = fnet_tcp_dataprocess(sk, insegment, seg, &ackparam);
           break;
 
         case FNET_TCP_CS_FIN_WAIT_1:
 
           /* Proseed the processing.*/
-          result = fnet_tcp_dataprocess(sk, insegment, &ackparam);
+          result = fnet_tcp_dataprocess(sk, insegment, seg, &ackparam);
 
           if(cb->tcpcb_sndseq == cb->tcpcb_rcvack && cb->tcpcb_connection_state == FNET_TCP_CS_FIN_WAIT_1)
               /* Change the state.*/
@@ -1914,26 +2230,26 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
           break;
 
         case FNET_TCP_CS_LAST_ACK:
-          if(tcp_ack == cb->tcpcb_sndseq) 
+          if(seg->ack == cb->tcpcb_sndseq) 
               /* Close the socket.*/
               fnet_tcp_closesk(sk);
 
           return FNET_TRUE;
 
         case FNET_TCP_CS_CLOSING:
-          if(tcp_ack == cb->tcpcb_sndseq) 
+          if(seg->ack == cb->tcpcb_sndseq) 
           {
               cb->tcpcb_connection_state = FNET_TCP_CS_TIME_WAIT;
               /* Set the  timeout of the TIME_WAIT state.*/
               cb->tcpcb_timers.connection = FNET_TCP_TIME_WAIT;
-              cb->tcpcb_timers.retransmission = FNET_TCP_TIMER_OFF;
+              fnet_timer_stop(cb->tcpcb_rexmt_timer);
               cb->tcpcb_timers.keepalive = FNET_TCP_TIMER_OFF;
           }
 
           break;
 
         case FNET_TCP_CS_TIME_WAIT:
-          fnet_tcp_sendrst(&sk->options, insegment, dest_addr, src_addr);
+          fnet_tcp_sendrst(&sk->options, insegment, seg, dest_addr, src_addr);
           break;
     }
 
@@ -1952,14 +2268,14 @@ static int fnet_tcp_inputsk( fnet_socket_t *sk, fnet_netbuf_t *insegment, struct
 * RETURNS: TRUE if the input segment must be deleted. Otherwise
 *          this function returns FALSE.             
 *************************************************************************/
-static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, int *ackparam )
+static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, fnet_tcp_seginfo_t *seg, int *ackparam )
 {
     fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control;       
     long                size;                                     
-    short               err;
+    long                err;
+    long                rtt;
     int                 delflag = 1;
     unsigned long       seq;
-    unsigned long       tcp_ack = fnet_ntohl(FNET_TCP_ACK(insegment));
 
     /* Reinitialize the keepalive timer.*/
     if(sk->options.flags & SO_KEEPALIVE)
@@ -1970,8 +2286,14 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
     /* Reset the abort timer.*/
     cb->tcpcb_timers.abort = FNET_TCP_TIMER_OFF;
 
+#if FNET_CFG_TCP_SACK
+    /* Update the blocks SACKed by another side.*/
+    if(cb->tcpcb_flags & FNET_TCP_CBF_SACK)
+        fnet_tcp_sackupdate(cb, seg);
+#endif /* FNET_CFG_TCP_SACK */
+
     /* If acknowledgment is repeated.*/
-    if(cb->tcpcb_rcvack == tcp_ack)
+    if(cb->tcpcb_rcvack == seg->ack)
     {
         /* If unacknowledged data is present.*/
         if(cb->tcpcb_sndseq != cb->tcpcb_rcvack && sk->send_buffer.count)
@@ -1979,6 +2301,16 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
             /* Increase the timer of rpeated acknowledgments.*/
             cb->tcpcb_fastretrcounter++;
 
+        #if FNET_CFG_TCP_SACK
+            /* Each repeated acknowledgment of the recovery lets the next hole out.*/
+            if(cb->tcpcb_flags & FNET_TCP_CBF_SACK_RECOVERY)
+            {
+                if(fnet_tcp_sackretransmit(sk))
+                    *ackparam |= FNET_TCP_AP_NO_SENDING;
+            }
+            else
+        #endif /* FNET_CFG_TCP_SACK */
+
             /* If the number of repeated acknowledgments is FNET_TCP_NUMBER_FOR_FAST_RET,
              * process the fast retransmission.*/
             if(cb->tcpcb_fastretrcounter == FNET_TCP_NUMBER_FOR_FAST_RET)
@@ -1997,17 +2329,30 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
 
                 cb->tcpcb_cwnd = cb->tcpcb_ssthresh;
 
-                /* Retransmit the segment.*/
-                seq = cb->tcpcb_sndseq;
-                cb->tcpcb_sndseq = cb->tcpcb_rcvack;
-                fnet_tcp_senddataseg(sk, 0, 0, cb->tcpcb_sndmss);
-                cb->tcpcb_sndseq = seq;
+            #if FNET_CFG_TCP_SACK
+                if(cb->tcpcb_flags & FNET_TCP_CBF_SACK)
+                {
+                    /* Retransmit only the holes between the SACKed blocks,
+                     * until all the data sent before is acknowledged.*/
+                    cb->tcpcb_flags |= FNET_TCP_CBF_SACK_RECOVERY;
+                    cb->tcpcb_sackrecover = cb->tcpcb_maxrcvack;
+                    cb->tcpcb_sackrexmt = cb->tcpcb_rcvack;
+                    fnet_tcp_sackretransmit(sk);
+                }
+                else
+            #endif /* FNET_CFG_TCP_SACK */
+                {
+                    /* Retransmit the segment.*/
+                    seq = cb->tcpcb_sndseq;
+                    cb->tcpcb_sndseq = cb->tcpcb_rcvack;
+                    fnet_tcp_senddataseg(sk, 0, 0, cb->tcpcb_sndmss);
+                    cb->tcpcb_sndseq = seq;
+                }
 
                 /* Acknowledgment is sent in retransmited segment.*/
                 *ackparam |= FNET_TCP_AP_NO_SENDING;
 
                 /* Round trip time can't be measured in this case.*/
-                cb->tcpcb_timers.round_trip = FNET_TCP_TIMER_OFF;
                 cb->tcpcb_timing_state = TCP_TS_SEGMENT_LOST;
             }
         }
@@ -2018,7 +2363,7 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
         cb->tcpcb_fastretrcounter = 0;
 
         /* Recalculate the congestion window and slow start threshold values.*/
-        size = (long)fnet_tcp_getsize(cb->tcpcb_rcvack, tcp_ack);
+        size = (long)fnet_tcp_getsize(cb->tcpcb_rcvack, seg->ack);
 
         if(size > sk->send_buffer.count)
             size = (long)sk->send_buffer.count;
@@ -2056,23 +2401,43 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
         sk->send_buffer.count -= size;
 
         /* Save the acknowledgment number.*/
-        cb->tcpcb_rcvack = tcp_ack;
+        cb->tcpcb_rcvack = seg->ack;
 
         if(FNET_TCP_COMP_G(cb->tcpcb_rcvack, cb->tcpcb_sndseq))
             cb->tcpcb_sndseq = cb->tcpcb_rcvack;
 
-        /* Calculate the retransmission timeout ( using Jacobson method ).*/
-        if(FNET_TCP_COMP_GE(cb->tcpcb_rcvack, cb->tcpcb_timingack) && cb->tcpcb_timing_state == TCP_TS_SEGMENT_SENT)
+    #if FNET_CFG_TCP_SACK
+        if(cb->tcpcb_flags & FNET_TCP_CBF_SACK_RECOVERY)
         {
-            if(cb->tcpcb_srtt)
+            if(FNET_TCP_COMP_GE(cb->tcpcb_rcvack, cb->tcpcb_sackrecover))
             {
-                err = (short)(cb->tcpcb_timers.round_trip - (cb->tcpcb_srtt >> FNET_TCP_RTT_SHIFT));
-
-                if((cb->tcpcb_srtt += err) <= 0)
-                    cb->tcpcb_srtt = 1;
-
+                /* All the data sent before the recovery is acknowledged.*/
+                cb->tcpcb_flags &= ~FNET_TCP_CBF_SACK_RECOVERY;
+            }
+            else
+            {
+                /* Partial acknowledgment, retransmit the next hole.*/
+                if(fnet_tcp_sackretransmit(sk))
+                    *ackparam |= FNET_TCP_AP_NO_SENDING;
+            }
+        }
+    #endif /* FNET_CFG_TCP_SACK */
+
+        /* Calculate the retransmission timeout ( using Jacobson method ).*/
+        if(FNET_TCP_COMP_GE(cb->tcpcb_rcvack, cb->tcpcb_timingack) && cb->tcpcb_timing_state == TCP_TS_SEGMENT_SENT)
+        {
+            /* Round trip time of the timed segment (ms).*/
+            rtt = (long)(fnet_timer_get_interval(cb->tcpcb_timingstart, fnet_timer_us()) / 1000);
+
+            if(cb->tcpcb_srtt)
+            {
+                err = rtt - (cb->tcpcb_srtt >> FNET_TCP_RTT_SHIFT);
+
+                if((cb->tcpcb_srtt += err) <= 0)
+                    cb->tcpcb_srtt = 1;
+
                 if(err < 0)
-                    err = (short)(-err);
+                    err = -err;
 
                 err -= (cb->tcpcb_rttvar >> FNET_TCP_RTTVAR_SHIFT);
 
@@ -2082,25 +2447,29 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
             else
             {
                 /* Initial calculation of the retransmission variables.*/
-                cb->tcpcb_srtt = (unsigned short)((cb->tcpcb_timers.round_trip + 1) << FNET_TCP_RTT_SHIFT);
-                cb->tcpcb_rttvar = (unsigned short)((cb->tcpcb_timers.round_trip + 1)
-                                                        << (FNET_TCP_RTTVAR_SHIFT - 1));
+                cb->tcpcb_srtt = (rtt + 1) << FNET_TCP_RTT_SHIFT;
+                cb->tcpcb_rttvar = (rtt + 1) << (FNET_TCP_RTTVAR_SHIFT - 1);
             }
 
             cb->tcpcb_timing_state = TCP_TS_ACK_RECEIVED;
-            cb->tcpcb_rto = (cb->tcpcb_srtt >> FNET_TCP_RTT_SHIFT) + cb->tcpcb_rttvar;
-            cb->tcpcb_timers.round_trip = FNET_TCP_TIMER_OFF;
+            
+            /* Convert to the slow timer periods, rounding up.*/
+            cb->tcpcb_rto = (int)(((cb->tcpcb_srtt >> FNET_TCP_RTT_SHIFT) + cb->tcpcb_rttvar 
+                                    + FNET_TCP_SLOWTIMO - 1) / FNET_TCP_SLOWTIMO);
+            
+            if(cb->tcpcb_rto < FNET_TCP_RTO_MIN)
+                cb->tcpcb_rto = FNET_TCP_RTO_MIN;
         }
     }
 
     /* If the final segment is not received, add the data to the input buffer.*/
     if(!(cb->tcpcb_flags & FNET_TCP_CBF_FIN_RCVD))
     {
-        delflag = !fnet_tcp_addinpbuf(sk, insegment, ackparam);
+        delflag = !fnet_tcp_addinpbuf(sk, insegment, seg, ackparam);
 
     }
 
-    else if((insegment->total_length - FNET_TCP_LENGTH(insegment)) > 0)
+    else if((insegment->total_length - seg->length) > 0)
             *ackparam |= FNET_TCP_AP_SEND_IMMEDIATELLY;
 
     /* Acknowledgment of the final segment must be send immediatelly.*/
@@ -2127,9 +2496,9 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
 
     /* If the sent data is acknowledged, turn of the retransmission timer.*/
     if(cb->tcpcb_rcvack == cb->tcpcb_sndseq)
-        cb->tcpcb_timers.retransmission = FNET_TCP_TIMER_OFF;
+        fnet_timer_stop(cb->tcpcb_rexmt_timer);
     else
-        cb->tcpcb_timers.retransmission = cb->tcpcb_rto;
+        fnet_tcp_rexmt_start(cb, cb->tcpcb_rto);
 
     /* If the acknowledgment is sent, return
      * If the acnkowledgment must be sent immediatelly, send it
@@ -2143,8 +2512,9 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
         return delflag;
     }
 
-    if(*ackparam & FNET_TCP_AP_SEND_WITH_DELAY)
-        cb->tcpcb_timers.delayed_ack = 1; /* Delay 200 ms*/
+    /* Delay up to FNET_TCP_FASTTIMO, from the first segment not acknowledged.*/
+    if((*ackparam & FNET_TCP_AP_SEND_WITH_DELAY) && !fnet_timer_is_active(cb->tcpcb_delack_timer))
+        fnet_timer_start(cb->tcpcb_delack_timer, FNET_TCP_FASTTIMO / FNET_TIMER_PERIOD_MS);
 
     return delflag;
 }
@@ -2158,11 +2528,11 @@ static int fnet_tcp_dataprocess( fnet_socket_t *sk, fnet_netbuf_t *insegment, in
 * RETURNS: TRUE if the input segment is added to the buffer. Otherwise
 *          this function returns FALSE.
 *************************************************************************/
-static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int *ackparam )
+static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, fnet_tcp_seginfo_t *seg, int *ackparam )
 {
     fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control;
-    unsigned long       tcp_length = (unsigned long)FNET_TCP_LENGTH(insegment);
-    unsigned long       tcp_flags = (unsigned long)FNET_TCP_FLAGS(insegment); 
+    unsigned long       tcp_length = seg->length;
+    unsigned long       tcp_flags = seg->flags; 
     int                 result;                   
     
     
@@ -2174,7 +2544,7 @@ static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int
 
     
     /* Process the segment that came in order.*/
-    if(fnet_ntohl(FNET_TCP_SEQ(insegment)) == cb->tcpcb_sndack 
+    if(seg->seq == cb->tcpcb_sndack 
         #if !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER 
             && !cb->tcpcb_count
         #endif
@@ -2197,7 +2567,7 @@ static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int
         /* Process the final segment. */
         if(tcp_flags & FNET_TCP_SGT_FIN)
         {
-            fnet_tcp_finprocessing(sk, fnet_ntohl(FNET_TCP_ACK(insegment)));
+            fnet_tcp_finprocessing(sk, seg->ack);
             cb->tcpcb_sndack++;
             *ackparam |= FNET_TCP_AP_FIN_ACK;
         }
@@ -2210,8 +2580,7 @@ static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int
         if(insegment)
         {
             cb->tcpcb_sndack += insegment->total_length;
-            sk->receive_buffer.net_buf_chain = fnet_netbuf_concat(sk->receive_buffer.net_buf_chain,
-                                                                  insegment);
+            fnet_netbuf_concat_tail(&sk->receive_buffer.net_buf_chain, &sk->receive_buffer.net_buf_tail, insegment);
             sk->receive_buffer.count += insegment->total_length;
            
             *ackparam |= FNET_TCP_AP_SEND_WITH_DELAY;
@@ -2230,7 +2599,7 @@ static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int
     
         /* Add to the temporary input buffer.*/
         if(cb->tcpcb_count + insegment->total_length <= cb->tcpcb_rcvcountmax
-               || fnet_ntohl(FNET_TCP_SEQ(insegment)) == cb->tcpcb_sndack)
+               || seg->seq == cb->tcpcb_sndack)
         {
             /* Acknowledgement must be sent immediately.*/
             *ackparam |= FNET_TCP_AP_SEND_IMMEDIATELLY;
@@ -2238,46 +2607,44 @@ static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int
             /* Data is added to the buffer.*/
             result = 1;
 
-            /* Add the segment to the temporary buffer (with sorting).*/
-            if(cb->tcpcb_rcvchain)
+            /* Add the segment to the temporary buffer (with sorting).
+             * Segments mostly arrive in order behind a hole, so the tail is checked first.*/
+            if((cb->tcpcb_rcvchain == 0) 
+                || !FNET_TCP_COMP_G(fnet_ntohl(FNET_TCP_SEQ(cb->tcpcb_rcvchain_tail)), seg->seq))
+            {
+                fnet_netbuf_add_chain_tail(&cb->tcpcb_rcvchain, &cb->tcpcb_rcvchain_tail, insegment);
+            }
+            else
             {
                 buf = cb->tcpcb_rcvchain;
                 prevbuf = 0;
 
-                while(1)
+                /* The tail follows the segment, so the search stops before the end.*/
+                while(!FNET_TCP_COMP_G(fnet_ntohl(FNET_TCP_SEQ(buf)), seg->seq))
                 {
-                    if(FNET_TCP_COMP_G(fnet_ntohl(FNET_TCP_SEQ(buf)), fnet_ntohl(FNET_TCP_SEQ(insegment))))
-                    {
-                        if(prevbuf)
-                            prevbuf->next_chain = insegment;
-                        else
-                            cb->tcpcb_rcvchain = insegment;
-
-                        insegment->next_chain = buf;
-                        break;
-                    }
-
-                    if(!buf->next_chain)
-                    {
-                        buf->next_chain = insegment;
-                        break;
-                    }
-
                     prevbuf = buf;
                     buf = buf->next_chain;
                 }
-            }
-            else
-            {
-                cb->tcpcb_rcvchain = insegment;
+
+                if(prevbuf)
+                    prevbuf->next_chain = insegment;
+                else
+                    cb->tcpcb_rcvchain = insegment;
+
+                insegment->next_chain = buf;
             }
 
             cb->tcpcb_count += insegment->total_length;
+
+        #if FNET_CFG_TCP_SACK
+            /* The first SACK block reports the last received segment.*/
+            cb->tcpcb_rcvsackseq = seg->seq;
+        #endif
         }
 
         /* If the temporary buffer received the lost segment
          * move the data from the temporary buffer to the input buffer of the socket.*/
-        if(fnet_ntohl(FNET_TCP_SEQ(insegment)) == cb->tcpcb_sndack) 
+        if(seg->seq == cb->tcpcb_sndack) 
         {
             seq = cb->tcpcb_sndack;
 
@@ -2336,9 +2703,7 @@ static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int
                         if(buf)
                         {
                             sk->receive_buffer.count += buf->total_length;
-                            sk->receive_buffer.net_buf_chain =
-                                fnet_netbuf_concat(sk->receive_buffer.net_buf_chain,
-                                                   buf);
+                            fnet_netbuf_concat_tail(&sk->receive_buffer.net_buf_chain, &sk->receive_buffer.net_buf_tail, buf);
                         }
 
                         /* Set the  new acknowledgment number.*/
@@ -2351,7 +2716,7 @@ static int fnet_tcp_addinpbuf( fnet_socket_t *sk, fnet_netbuf_t *insegment, int
                         cb->tcpcb_rcvchain = cb->tcpcb_rcvchain->next_chain;
 
                         /* Set the new size of the temporary buffer.*/
-                        cb->tcpcb_count -= cb->tcpcb_rcvchain->total_length;
+                        cb->tcpcb_count -= buf->total_length;
                         fnet_netbuf_free_chain(buf);
                     }
                 }
@@ -2429,8 +2794,8 @@ static int fnet_tcp_sendanydata( fnet_socket_t *sk, int oneexec )
             fnet_tcp_sendheadseg(sk, FNET_TCP_SGT_FIN | FNET_TCP_SGT_ACK, 0, 0);
 
             /* Reinitialize the retransmission timer.*/
-            if(cb->tcpcb_timers.retransmission == FNET_TCP_TIMER_OFF)
-                cb->tcpcb_timers.retransmission = cb->tcpcb_rto;
+            if(!fnet_timer_is_active(cb->tcpcb_rexmt_timer))
+                fnet_tcp_rexmt_start(cb, cb->tcpcb_rto);
 
             result = 1;
         }
@@ -2514,7 +2879,7 @@ static int fnet_tcp_sendanydata( fnet_socket_t *sk, int oneexec )
                && FNET_TCP_COMP_G(cb->tcpcb_sndseq, cb->tcpcb_timingack)))
         {
             cb->tcpcb_timingack = cb->tcpcb_sndseq;
-            cb->tcpcb_timers.round_trip = FNET_TCP_TIMER_ON_INCREMENT;
+            cb->tcpcb_timingstart = fnet_timer_us();
 
             cb->tcpcb_timing_state = TCP_TS_SEGMENT_SENT;
         }
@@ -2524,8 +2889,8 @@ static int fnet_tcp_sendanydata( fnet_socket_t *sk, int oneexec )
     }
 
     /* Reinitialize the retransmission timer.*/
-    if(sntdata > 0 && cb->tcpcb_timers.retransmission == FNET_TCP_TIMER_OFF)
-        cb->tcpcb_timers.retransmission = cb->tcpcb_rto;
+    if(sntdata > 0 && !fnet_timer_is_active(cb->tcpcb_rexmt_timer))
+        fnet_tcp_rexmt_start(cb, cb->tcpcb_rto);
 
     return result;
 }
@@ -2746,41 +3111,6 @@ static void fnet_tcp_slowtimo(void *cookie)
     fnet_isr_unlock();
 }
 
-/************************************************************************
-* NAME: fnet_tcp_fasttimo
-*
-* DESCRIPTION: This function processes the timeouts 
-*              (fnet_tcp_fasttimo is performed every 200 ms).
-*
-* RETURNS: None. 
-*************************************************************************/
-static void fnet_tcp_fasttimo( void *cookie )
-{
-    fnet_socket_t *sk; 
-    fnet_socket_t *addedsk;
-    
-    FNET_COMP_UNUSED_ARG(cookie);
-    
-    fnet_isr_lock();
-    sk = fnet_tcp_prot_if.head;
-
-    while(sk)
-    {
-        fnet_tcp_fasttimosk(sk);
-        addedsk = sk->incoming_con;
-
-        while(addedsk)
-        {
-            fnet_tcp_fasttimosk(addedsk);
-            addedsk = addedsk->next;
-        }
-
-        sk = sk->next;
-    }
-
-    fnet_isr_unlock();
-}
-
 /************************************************************************
 * NAME: fnet_tcp_slowtimosk
 *
@@ -2843,18 +3173,6 @@ static void fnet_tcp_slowtimosk( fnet_socket_t *sk )
             }
         }
 
-        /* Check the retransmission timer.*/
-        if(cb->tcpcb_timers.retransmission != FNET_TCP_TIMER_OFF)
-        {
-            cb->tcpcb_timers.retransmission--;
-
-            if(!cb->tcpcb_timers.retransmission)
-            {
-                cb->tcpcb_timers.retransmission = FNET_TCP_TIMER_OFF;
-                fnet_tcp_rtimeo(sk);
-            }
-        }
-
         /* Check the keepalive timer.*/
         if(cb->tcpcb_timers.keepalive != FNET_TCP_TIMER_OFF)
         {
@@ -2878,43 +3196,92 @@ static void fnet_tcp_slowtimosk( fnet_socket_t *sk )
                 fnet_tcp_ptimeo(sk);
             }
         }
-
-        /* If the round trip timer is turned on, recalculate it.*/
-        if(cb->tcpcb_timers.round_trip != FNET_TCP_TIMER_OFF)
-            cb->tcpcb_timers.round_trip++;
     }
     
 }
 
 /************************************************************************
-* NAME: fnet_tcp_fasttimosk
+* NAME: fnet_tcp_timers_new
 *
-* DESCRIPTION: This function processes the delayed acknowledgment timer 
-*              of the socket (fnet_tcp_fasttimo is performed every 200 ms).
+* DESCRIPTION: This function creates the retransmission and the delayed 
+*              acknowledgment timers of the socket. They are started 
+*              only while they are needed, so the timer wheel has no 
+*              work for idle connections.
 *
-* RETURNS: None. 
+* RETURNS: If no error occurs, this function returns FNET_OK. Otherwise
+*          it returns FNET_ERR.
 *************************************************************************/
-static void fnet_tcp_fasttimosk( fnet_socket_t *sk )
+static int fnet_tcp_timers_new( fnet_socket_t *sk )
 {
     fnet_tcp_control_t *cb = (fnet_tcp_control_t *)sk->protocol_control;
-    
-   
-    if(sk->state != SS_UNCONNECTED)
-    {
-        /* Check the delayed acknowledgment timer.*/
-        if(cb->tcpcb_timers.delayed_ack != FNET_TCP_TIMER_OFF)
-        {
-            cb->tcpcb_timers.delayed_ack--;
 
-            if(!cb->tcpcb_timers.delayed_ack)
-            {
-                cb->tcpcb_timers.delayed_ack = FNET_TCP_TIMER_OFF;
-                fnet_tcp_sendack(sk);
-                return;
-            }
-        }
+    cb->tcpcb_rexmt_timer = fnet_timer_new_oneshot(fnet_tcp_rexmt_timeo, sk);
+
+    if(!cb->tcpcb_rexmt_timer)
+        return FNET_ERR;
+
+    cb->tcpcb_delack_timer = fnet_timer_new_oneshot(fnet_tcp_delack_timeo, sk);
+
+    if(!cb->tcpcb_delack_timer)
+    {
+        fnet_timer_free(cb->tcpcb_rexmt_timer);
+        cb->tcpcb_rexmt_timer = 0;
+        return FNET_ERR;
     }
-    
+
+    return FNET_OK;
+}
+
+/************************************************************************
+* NAME: fnet_tcp_rexmt_start
+*
+* DESCRIPTION: This function (re)starts the retransmission timer.
+*              The timeout 'rto' is in the slow timer periods.
+*
+* RETURNS: None. 
+*************************************************************************/
+static void fnet_tcp_rexmt_start( fnet_tcp_control_t *cb, int rto )
+{
+    fnet_timer_start(cb->tcpcb_rexmt_timer, (unsigned long)rto * (FNET_TCP_SLOWTIMO / FNET_TIMER_PERIOD_MS));
+}
+
+/************************************************************************
+* NAME: fnet_tcp_rexmt_timeo
+*
+* DESCRIPTION: This function is the handler of the retransmission timer.
+*
+* RETURNS: None. 
+*************************************************************************/
+static void fnet_tcp_rexmt_timeo( void *cookie )
+{
+    fnet_socket_t *sk = (fnet_socket_t *)cookie;
+
+    fnet_isr_lock();
+
+    if(sk->state != SS_UNCONNECTED)
+        fnet_tcp_rtimeo(sk);
+
+    fnet_isr_unlock();
+}
+
+/************************************************************************
+* NAME: fnet_tcp_delack_timeo
+*
+* DESCRIPTION: This function is the handler of the delayed 
+*              acknowledgment timer.
+*
+* RETURNS: None. 
+*************************************************************************/
+static void fnet_tcp_delack_timeo( void *cookie )
+{
+    fnet_socket_t *sk = (fnet_socket_t *)cookie;
+
+    fnet_isr_lock();
+
+    if(sk->state != SS_UNCONNECTED)
+        fnet_tcp_sendack(sk);
+
+    fnet_isr_unlock();
 }
 
 /************************************************************************
@@ -2969,6 +3336,15 @@ static void fnet_tcp_rtimeo( fnet_socket_t *sk )
           /* Recalculate the sequence number.*/
           cb->tcpcb_sndseq = cb->tcpcb_rcvack;
 
+      #if FNET_CFG_TCP_SACK
+          cb->tcpcb_flags &= ~FNET_TCP_CBF_SACK_RECOVERY;
+
+          /* The SACKed data is skipped by the retransmission. But if the timeout 
+           * repeats at the same point, another side may have discarded it (RFC 2018).*/
+          if(cb->tcpcb_retrseq == cb->tcpcb_rcvack)
+              cb->tcpcb_sndsackcount = 0;
+      #endif /* FNET_CFG_TCP_SACK */
+
           /* Recalculate the congestion window and slow start threshold values (for case of  retransmission).*/
           if(cb->tcpcb_cwnd > cb->tcpcb_sndwnd)
               cb->tcpcb_ssthresh = cb->tcpcb_sndwnd >> 1;
@@ -2981,7 +3357,6 @@ static void fnet_tcp_rtimeo( fnet_socket_t *sk )
           cb->tcpcb_cwnd = cb->tcpcb_sndmss;
 
           /* Round trip time can't be measured in this case.*/
-          cb->tcpcb_timers.round_trip = FNET_TCP_TIMER_OFF;
           cb->tcpcb_timing_state = TCP_TS_SEGMENT_LOST;
 
           cb->tcpcb_flags |= FNET_TCP_CBF_FORCE_SEND;
@@ -3007,7 +3382,7 @@ static void fnet_tcp_rtimeo( fnet_socket_t *sk )
             cb->tcpcb_crto <<= 1;
     }
 
-    cb->tcpcb_timers.retransmission = cb->tcpcb_crto;
+    fnet_tcp_rexmt_start(cb, cb->tcpcb_crto);
     
 }
 
@@ -3120,9 +3495,20 @@ static int fnet_tcp_sendseg(struct fnet_tcp_segment *segment)
 {
     fnet_netbuf_t *segment_buf;
     int error = FNET_OK;
+    int optlen = 0;
+    int header_length;
 
-    /* Create the header.*/
-    segment_buf = fnet_netbuf_new(FNET_TCP_SIZE_HEADER, FNET_FALSE);
+    if(segment->options)
+        optlen = (segment->optlen + 3) & ~3;   /* The options are padded to 4-byte words.*/
+
+    header_length = FNET_TCP_SIZE_HEADER + optlen;
+
+    /* Create the header and the options in front of the data, 
+     * in one buffer with room for the IP and link-level headers.*/
+    if(segment->data)
+        segment_buf = fnet_netbuf_push(segment->data, header_length, FNET_FALSE);
+    else
+        segment_buf = fnet_netbuf_new_headroom(FNET_CFG_NETBUF_HEADROOM, header_length, FNET_FALSE);
 
     if(!segment_buf)
     {
@@ -3132,27 +3518,13 @@ static int fnet_tcp_sendseg(struct fnet_tcp_segment *segment)
         return FNET_ERR_NOMEM;
     }
 
-    fnet_memset_zero(segment_buf->data_ptr, FNET_TCP_SIZE_HEADER);
+    fnet_memset_zero(segment_buf->data_ptr, (unsigned int)header_length); /* Pads the options with FNET_TCP_OTYPES_END.*/
 
     /* Add TCP options.*/
-    if(segment->options && segment->optlen)
-    {
-        error = (unsigned char)fnet_tcp_addopt(segment_buf, (unsigned char)segment->optlen, segment->options);
-
-        if(error)
-        {
-            fnet_netbuf_free_chain(segment_buf);
+    if(optlen)
+        fnet_memcpy((char *)segment_buf->data_ptr + FNET_TCP_SIZE_HEADER, segment->options, (unsigned int)segment->optlen);
 
-            if(segment->data)
-                fnet_netbuf_free_chain(segment->data);
-
-            return error;
-        }
-    }
-    else
-    {
-        FNET_TCP_SET_LENGTH(segment_buf) = FNET_TCP_SIZE_HEADER << 2;  /* (FNET_TCP_SIZE_HEADER/4 + opt_len/4) */
-    }
+    FNET_TCP_SET_LENGTH(segment_buf) = (unsigned char)(header_length << 2);  /* (FNET_TCP_SIZE_HEADER/4 + opt_len/4) */
 
     /* Initialization of the header.*/
     FNET_TCP_SPORT(segment_buf) = segment->src_addr.sa_port;
@@ -3162,9 +3534,6 @@ static int fnet_tcp_sendseg(struct fnet_tcp_segment *segment)
     FNET_TCP_SET_FLAGS(segment_buf) = segment->flags;
     FNET_TCP_WND(segment_buf) = fnet_htons(segment->wnd);
 
-    /* Add the data.*/
-    segment_buf = fnet_netbuf_concat(segment_buf, segment->data);
-
     /* Set the pointer to the urgent data.*/
     FNET_TCP_URG(segment_buf) = fnet_htons(segment->urgpointer);
 
@@ -3224,6 +3593,9 @@ static int fnet_tcp_sendheadseg( fnet_socket_t *sk, unsigned char flags, void *o
     unsigned long   ack = 0;         
     unsigned short  urgpointer = 0;
     struct fnet_tcp_segment segment;
+#if FNET_CFG_TCP_SACK && !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER
+    unsigned long   sackopt[FNET_TCP_SACK_OPT_SIZE / 4];  /* Aligned for the word writes.*/
+#endif
 
     fnet_tcp_control_t *cb = (fnet_tcp_control_t *)sk->protocol_control;
 
@@ -3231,6 +3603,15 @@ static int fnet_tcp_sendheadseg( fnet_socket_t *sk, unsigned char flags, void *o
     /* Get the sequence number.*/
     seq = cb->tcpcb_sndseq;
 
+#if FNET_CFG_TCP_SACK && !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER
+    /* Report the segments received out of order.*/
+    if(!optlen && (flags & FNET_TCP_SGT_ACK) && !(flags & FNET_TCP_SGT_SYN))
+    {
+        optlen = fnet_tcp_setsackopt(sk, (char *)sackopt);
+        options = sackopt;
+    }
+#endif
+
     /* Get the window.*/
     cb->tcpcb_rcvwnd = fnet_tcp_getrcvwnd(sk);
 
@@ -3296,7 +3677,7 @@ static int fnet_tcp_sendheadseg( fnet_socket_t *sk, unsigned char flags, void *o
     
 
     /* Turn off the delayed acknowledgment timer.*/
-    cb->tcpcb_timers.delayed_ack = FNET_TCP_TIMER_OFF;
+    fnet_timer_stop(cb->tcpcb_delack_timer);
 
     cb->tcpcb_newfreercvsize = 0;
 
@@ -3328,6 +3709,31 @@ static int fnet_tcp_senddataseg( fnet_socket_t *sk, void *options, char optlen,
     unsigned long           tmp;
     struct fnet_tcp_segment segment;
     fnet_tcp_control_t      *cb = (fnet_tcp_control_t *)sk->protocol_control;
+#if FNET_CFG_TCP_SACK && !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER
+    unsigned long           sackopt[FNET_TCP_SACK_OPT_SIZE / 4];  /* Aligned for the word writes.*/
+
+    /* Report the segments received out of order.*/
+    if(!optlen)
+    {
+        optlen = fnet_tcp_setsackopt(sk, (char *)sackopt);
+        options = sackopt;
+
+        /* The segment, with the options, must not exceed MSS.*/
+        if(optlen && (cb->tcpcb_sndmss > optlen) && (datasize + optlen > cb->tcpcb_sndmss))
+            datasize = (unsigned long)(cb->tcpcb_sndmss - optlen);
+    }
+#endif
+
+#if FNET_CFG_TCP_SACK
+    /* The data, SACKed by another side, is not sent again.*/
+    if(datasize && cb->tcpcb_sndsackcount)
+    {
+        fnet_tcp_sackskip(cb, &datasize);
+
+        if(fnet_tcp_getsize(cb->tcpcb_rcvack, cb->tcpcb_sndseq) >= sk->send_buffer.count)
+            return FNET_OK; /* All the data is sent.*/
+    }
+#endif /* FNET_CFG_TCP_SACK */
     
     /* Receive the sequence number.*/
     seq = cb->tcpcb_sndseq;
@@ -3348,8 +3754,8 @@ static int fnet_tcp_senddataseg( fnet_socket_t *sk, void *options, char optlen,
     tmp = 0;
 #endif    
 
-    if((datasize + FNET_TCP_SIZE_HEADER) > tmp)
-        datasize = (tmp - FNET_TCP_SIZE_HEADER);
+    if((datasize + FNET_TCP_SIZE_HEADER + optlen) > tmp)
+        datasize = (tmp - FNET_TCP_SIZE_HEADER - optlen);
 
     /* Create the flags.*/
     flags |= FNET_TCP_SGT_ACK;
@@ -3435,7 +3841,7 @@ static int fnet_tcp_senddataseg( fnet_socket_t *sk, void *options, char optlen,
     error = fnet_tcp_sendseg(&segment);
 
     /* Turn off the delayed acknowledgment timer.*/
-    cb->tcpcb_timers.delayed_ack = FNET_TCP_TIMER_OFF;
+    fnet_timer_stop(cb->tcpcb_delack_timer);
     cb->tcpcb_newfreercvsize = 0;
 
     /* Set the new sequence number.*/
@@ -3499,7 +3905,7 @@ static void fnet_tcp_sendack( fnet_socket_t *sk )
     }
 
     /* Turn of the delayed acknowledgment timer.*/
-    cb->tcpcb_timers.delayed_ack = FNET_TCP_TIMER_OFF;
+    fnet_timer_stop(cb->tcpcb_delack_timer);
     
 
 }
@@ -3511,15 +3917,15 @@ static void fnet_tcp_sendack( fnet_socket_t *sk )
 *
 * RETURNS: None.                  
 *************************************************************************/
-static void fnet_tcp_sendrst( fnet_socket_option_t *sockoption, fnet_netbuf_t *insegment,
+static void fnet_tcp_sendrst( fnet_socket_option_t *sockoption, fnet_netbuf_t *insegment, fnet_tcp_seginfo_t *seg,
                               struct sockaddr *src_addr,  struct sockaddr *dest_addr)
 {
     struct fnet_tcp_segment segment;
     
-    if(FNET_TCP_FLAGS(insegment) & FNET_TCP_SGT_ACK)
+    if(seg->flags & FNET_TCP_SGT_ACK)
     {
         /* Send the reset segment without acknowledgment*/
-        segment.seq = fnet_ntohl(FNET_TCP_ACK(insegment));
+        segment.seq = seg->ack;
         segment.ack = 0;
         segment.flags = FNET_TCP_SGT_RST;
     }                         
@@ -3527,9 +3933,8 @@ static void fnet_tcp_sendrst( fnet_socket_option_t *sockoption, fnet_netbuf_t *i
     {
         /* Send the reset segment with acknowledgment*/
         segment.seq = 0;
-        segment.ack = fnet_ntohl(FNET_TCP_SEQ(insegment)) + insegment->total_length - FNET_TCP_LENGTH(insegment)
-                      + (FNET_TCP_SGT_FIN & FNET_TCP_FLAGS(insegment)) + ((FNET_TCP_SGT_SYN
-                       & FNET_TCP_FLAGS(insegment)) >> 1);
+        segment.ack = seg->seq + insegment->total_length - seg->length
+                      + (FNET_TCP_SGT_FIN & seg->flags) + ((FNET_TCP_SGT_SYN & seg->flags) >> 1);
         segment.flags = FNET_TCP_SGT_RST | FNET_TCP_SGT_ACK;
     } 
     
@@ -3619,105 +4024,135 @@ static void fnet_tcp_abortsk( fnet_socket_t *sk )
 }
 
 /************************************************************************
-* NAME: fnet_tcp_addopt
+* NAME: fnet_tcp_getseginfo
 *
-* DESCRIPTION: This function adds the options in the segment.             
-*              fnet_tcp_addopt can be used only before the data adding and only after 
-*              the creating of the main header.   
-*
-* RETURNS: If no error occurs, this function returns FNET_OK. Otherwise,
-*          it returns FNET_ERR.
-*************************************************************************/
-static int fnet_tcp_addopt( fnet_netbuf_t *segment, unsigned char len, void *data )
-{
-    fnet_netbuf_t   *buf; 
-    int             i;             
-    char            size;   /* Size of options.*/
-
-    /* Create the buffer of the options.*/
-    buf = fnet_netbuf_new(FNET_TCP_SIZE_OPTIONS, FNET_FALSE);
-
-    /* Check the memory allocatio.*/
-    if(!buf)
-        return FNET_ERR_NOMEM;
-
-    /* Reset the buffer and add it to the header.*/
-    fnet_memset_zero(buf->data_ptr, FNET_TCP_SIZE_OPTIONS); /* Set to FNET_TCP_OTYPES_END.*/
-    segment = fnet_netbuf_concat(segment, buf);
-    buf = segment->next;
-
-    /* Copy the options.*/
-    for (i = 0; i < len; ++i)
-      FNET_TCP_GETUCHAR(buf->data_ptr, i) = FNET_TCP_GETUCHAR(data, i);
-
-    /* Set the length  (this value is saved in 4-byte words format).*/
-    if(len & 0x3)
-        size = (char)((len & 0xfffc) + 4);
-    else
-        size = (char)len;
-
-    /* Trim the buffer of the options.*/
-    fnet_netbuf_trim(&segment, size - FNET_TCP_SIZE_OPTIONS);
-
-    /* Recalculate the header length.*/
-    FNET_TCP_SET_LENGTH(segment) = (unsigned char)((buf->length + FNET_TCP_SIZE_HEADER) << 2);
-
-    return FNET_OK;
-}
-
-/************************************************************************
-* NAME: fnet_tcp_getopt
-*
-* DESCRIPTION: This function processes the received options.
+* DESCRIPTION: This function decodes the header and the options 
+*              of the received segment to the host byte order.
+*              The header must reside in contiguous area of the memory.
 *
 * RETURNS: None.
 *************************************************************************/
-static void fnet_tcp_getopt( fnet_socket_t *sk, fnet_netbuf_t *segment )
+static void fnet_tcp_getseginfo( fnet_netbuf_t *segment, fnet_tcp_seginfo_t *seg )
 {
-    int i; /* index variable.*/
-
-    fnet_tcp_control_t *cb = (fnet_tcp_control_t *)sk->protocol_control;
-
-    if(!segment)
+    fnet_tcp_header_t   *header = (fnet_tcp_header_t *)segment->data_ptr;
+    unsigned char       *opt = (unsigned char *)segment->data_ptr;
+    unsigned long       i;          /* index variable.*/
+    unsigned long       optlen;
+
+    seg->seq = fnet_ntohl(header->sequence_number);
+    seg->ack = fnet_ntohl(header->ack_number);
+    seg->length = (unsigned long)(FNET_TCP_HEADER_GET_HDRLENGTH(header) << 2);
+    seg->wnd = fnet_ntohs(header->window);
+    seg->flags = (unsigned char)FNET_TCP_HEADER_GET_FLAGS(header);
+    seg->options = 0;
+
+#if FNET_CFG_TCP_SACK
+    seg->sack_count = 0;
+
+    /* The options are processed in the synchronized (SYN) segments,
+     * and the SACK option in the other segments.*/
+    if(seg->length <= FNET_TCP_SIZE_HEADER)
         return;
+#else
+    /* The options are processed only in the synchronized (SYN) segments.*/
+    if(!(seg->flags & FNET_TCP_SGT_SYN))
+        return;
+#endif /* FNET_CFG_TCP_SACK */
 
     /* Start position of the options.*/
     i = FNET_TCP_SIZE_HEADER;
 
     /* Receive the of the options.*/
-    while(i < FNET_TCP_LENGTH(segment) && FNET_TCP_GETUCHAR(segment->data_ptr, i) != FNET_TCP_OTYPES_END)
+    while(i < seg->length && opt[i] != FNET_TCP_OTYPES_END)
     {
-        if(FNET_TCP_GETUCHAR(segment->data_ptr, i) == FNET_TCP_OTYPES_NOP)
+        if(opt[i] == FNET_TCP_OTYPES_NOP)
         {
             ++i;
         }
         else
         {
-            if(i + 1 >= FNET_TCP_LENGTH(segment)
-                   || i + FNET_TCP_GETUCHAR(segment->data_ptr, i + 1) - 1 >= FNET_TCP_LENGTH(segment))
+            if(i + 1 >= seg->length)
+                break;
+            
+            optlen = opt[i + 1];
+            
+            if((optlen < 2) || (i + optlen > seg->length))
                 break;
 
             /* Process the options.*/
-            switch(FNET_TCP_GETUCHAR(segment->data_ptr, i))
+            switch(opt[i])
             {
                 case FNET_TCP_OTYPES_MSS:
-                  cb->tcpcb_sndmss = fnet_ntohs(FNET_TCP_GETUSHORT(segment->data_ptr, i + 2));
+                  if(optlen == FNET_TCP_MSS_SIZE)
+                  {
+                      seg->mss = (unsigned short)((opt[i + 2] << 8) | opt[i + 3]);
+                      seg->options |= FNET_TCP_SEGOPT_MSS;
+                  }
                   break;
 
                 case FNET_TCP_OTYPES_WINDOW:
-                  cb->tcpcb_sendscale = FNET_TCP_GETUCHAR(segment->data_ptr, i + 2);
+                  if(optlen == FNET_TCP_WINDOW_SIZE)
+                  {
+                      seg->wscale = opt[i + 2];
+                      seg->options |= FNET_TCP_SEGOPT_WINDOW;
+                  }
+                  break;
 
-                  if(cb->tcpcb_sendscale > FNET_TCP_MAX_WINSHIFT)
-                      cb->tcpcb_sendscale = FNET_TCP_MAX_WINSHIFT;
+            #if FNET_CFG_TCP_SACK
+                case FNET_TCP_OTYPES_SACK_PERMITTED:
+                  if((optlen == FNET_TCP_SACK_PERMITTED_SIZE) && (seg->flags & FNET_TCP_SGT_SYN))
+                      seg->options |= FNET_TCP_SEGOPT_SACK_PERMITTED;
+                  break;
 
-                  cb->tcpcb_flags |= FNET_TCP_CBF_RCVD_SCALE;
+                case FNET_TCP_OTYPES_SACK:
+                  if(!(seg->flags & FNET_TCP_SGT_SYN) && (((optlen - 2) % FNET_TCP_SACK_BLOCK_SIZE) == 0))
+                  {
+                      unsigned long j;
+
+                      for(j = i + 2; (j < i + optlen) && (seg->sack_count < FNET_TCP_SACK_MAX_BLOCKS); j += FNET_TCP_SACK_BLOCK_SIZE)
+                      {
+                          seg->sack[seg->sack_count].start = (unsigned long)((opt[j] << 24) | (opt[j + 1] << 16) | (opt[j + 2] << 8) | opt[j + 3]);
+                          seg->sack[seg->sack_count].end = (unsigned long)((opt[j + 4] << 24) | (opt[j + 5] << 16) | (opt[j + 6] << 8) | opt[j + 7]);
+                          seg->sack_count++;
+                      }
+                  }
                   break;
+            #endif /* FNET_CFG_TCP_SACK */
             }
 
-            i += FNET_TCP_GETUCHAR(segment->data_ptr, i + 1);
+            i += optlen;
         }
     }
+}
 
+/************************************************************************
+* NAME: fnet_tcp_getopt
+*
+* DESCRIPTION: This function processes the received options.
+*
+* RETURNS: None.
+*************************************************************************/
+static void fnet_tcp_getopt( fnet_socket_t *sk, fnet_tcp_seginfo_t *seg )
+{
+    fnet_tcp_control_t *cb = (fnet_tcp_control_t *)sk->protocol_control;
+
+    if(seg->options & FNET_TCP_SEGOPT_MSS)
+        cb->tcpcb_sndmss = seg->mss;
+
+    if(seg->options & FNET_TCP_SEGOPT_WINDOW)
+    {
+        cb->tcpcb_sendscale = seg->wscale;
+
+        if(cb->tcpcb_sendscale > FNET_TCP_MAX_WINSHIFT)
+            cb->tcpcb_sendscale = FNET_TCP_MAX_WINSHIFT;
+
+        cb->tcpcb_flags |= FNET_TCP_CBF_RCVD_SCALE;
+    }
+
+#if FNET_CFG_TCP_SACK
+    if(seg->options & FNET_TCP_SEGOPT_SACK_PERMITTED)
+        cb->tcpcb_flags |= FNET_TCP_CBF_SACK;
+#endif /* FNET_CFG_TCP_SACK */
 }
 
 /************************************************************************
@@ -3757,6 +4192,16 @@ static void fnet_tcp_setsynopt( fnet_socket_t *sk, char *options, char *optionle
          = fnet_htonl((unsigned long)((cb->tcpcb_recvscale | FNET_TCP_WINDOW_HEADER) << 8));
     *optionlen += FNET_TCP_WINDOW_SIZE;
 
+#if FNET_CFG_TCP_SACK
+    /* Set the SACK-permitted option.
+     * The answer to SYN has it, only if another side has sent it.*/
+    if((cb->tcpcb_connection_state != FNET_TCP_CS_SYN_RCVD) || (cb->tcpcb_flags & FNET_TCP_CBF_SACK))
+    {
+        options[(int)*optionlen] = FNET_TCP_OTYPES_SACK_PERMITTED;
+        options[(int)*optionlen + 1] = FNET_TCP_SACK_PERMITTED_SIZE;
+        *optionlen += FNET_TCP_SACK_PERMITTED_SIZE;
+    }
+#endif /* FNET_CFG_TCP_SACK */
 }
 
 /************************************************************************
@@ -3788,6 +4233,271 @@ static void fnet_tcp_getsynopt( fnet_socket_t *sk )
 
 }
 
+#if FNET_CFG_TCP_SACK
+#if !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER
+/************************************************************************
+* NAME: fnet_tcp_setsackopt
+*
+* DESCRIPTION: This function sets the SACK option, that reports 
+*              the blocks of the temporary buffer (RFC 2018).
+*              The first block includes the last received segment.
+*
+* RETURNS: The size of the option, or 0 if there is nothing to report.
+*************************************************************************/
+static char fnet_tcp_setsackopt( fnet_socket_t *sk, char *options )
+{
+    fnet_tcp_control_t      *cb = (fnet_tcp_control_t *)sk->protocol_control;
+    fnet_tcp_sack_block_t   blocks[FNET_TCP_SACK_MAX_BLOCKS];
+    int                     count = 0;
+    int                     first = 0;  /* The block of the last segment is added.*/
+    int                     i;
+    fnet_netbuf_t           *buf;
+    unsigned long           start;
+    unsigned long           end;
+    unsigned long           seq;
+
+    if(!(cb->tcpcb_flags & FNET_TCP_CBF_SACK))
+        return 0;
+
+    buf = cb->tcpcb_rcvchain;
+
+    while(buf)
+    {
+        /* The segments are sorted, join the overlapping and adjacent ones.*/
+        start = fnet_ntohl(FNET_TCP_SEQ(buf));
+        end = start + buf->total_length - FNET_TCP_LENGTH(buf);
+
+        for(buf = buf->next_chain; buf && FNET_TCP_COMP_GE(end, fnet_ntohl(FNET_TCP_SEQ(buf))); buf = buf->next_chain)
+        {
+            seq = fnet_ntohl(FNET_TCP_SEQ(buf)) + buf->total_length - FNET_TCP_LENGTH(buf);
+
+            if(FNET_TCP_COMP_G(seq, end))
+                end = seq;
+        }
+
+        if(FNET_TCP_COMP_G(cb->tcpcb_sndack, start))
+            start = cb->tcpcb_sndack;
+
+        /* Skip the block without data.*/
+        if(!FNET_TCP_COMP_G(end, start))
+            continue;
+
+        if(!first && fnet_tcp_hit(start, end - 1, cb->tcpcb_rcvsackseq))
+        {
+            /* The place for the first block is always free.*/
+            for(i = count; i > 0; i--)
+                blocks[i] = blocks[i - 1];
+
+            first = 1;
+            i = 0;
+        }
+        else if(count < (first ? FNET_TCP_SACK_MAX_BLOCKS : FNET_TCP_SACK_MAX_BLOCKS - 1))
+        {
+            i = count;
+        }
+        else
+        {
+            continue;
+        }
+
+        blocks[i].start = start;
+        blocks[i].end = end;
+        count++;
+    }
+
+    if(!count)
+        return 0;
+
+    *((unsigned long *)options) = fnet_htonl((unsigned long)(FNET_TCP_SACK_HEADER | (2 + count * FNET_TCP_SACK_BLOCK_SIZE)));
+
+    for(i = 0; i < count; i++)
+    {
+        *((unsigned long *)(options + 4 + i * FNET_TCP_SACK_BLOCK_SIZE)) = fnet_htonl(blocks[i].start);
+        *((unsigned long *)(options + 8 + i * FNET_TCP_SACK_BLOCK_SIZE)) = fnet_htonl(blocks[i].end);
+    }
+
+    return (char)(4 + count * FNET_TCP_SACK_BLOCK_SIZE);
+}
+#endif /* !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER */
+
+/************************************************************************
+* NAME: fnet_tcp_sackupdate
+*
+* DESCRIPTION: This function removes the acknowledged data from 
+*              the SACKed blocks, and adds the SACK blocks 
+*              of the received segment.
+*
+* RETURNS: None.
+*************************************************************************/
+static void fnet_tcp_sackupdate( fnet_tcp_control_t *cb, fnet_tcp_seginfo_t *seg )
+{
+    fnet_tcp_sack_block_t   *sack = cb->tcpcb_sndsack;
+    unsigned long           start;
+    unsigned long           end;
+    int                     i;
+    int                     j;
+    int                     k;
+    int                     n;
+
+    /* Remove the acknowledged blocks.*/
+    for(i = 0; (i < cb->tcpcb_sndsackcount) && FNET_TCP_COMP_GE(seg->ack, sack[i].end); i++)
+    {}
+
+    if(i)
+    {
+        for(j = i; j < cb->tcpcb_sndsackcount; j++)
+            sack[j - i] = sack[j];
+
+        cb->tcpcb_sndsackcount -= i;
+    }
+
+    if(cb->tcpcb_sndsackcount && FNET_TCP_COMP_G(seg->ack, sack[0].start))
+        sack[0].start = seg->ack;
+
+    /* Add the received blocks.*/
+    for(k = 0; k < seg->sack_count; k++)
+    {
+        start = seg->sack[k].start;
+        end = seg->sack[k].end;
+
+        /* The block must be in the sent and not acknowledged data.*/
+        if(!FNET_TCP_COMP_G(end, start) || !FNET_TCP_COMP_G(end, seg->ack) 
+            || !FNET_TCP_COMP_GE(cb->tcpcb_maxrcvack, end))
+            continue;
+
+        if(FNET_TCP_COMP_G(seg->ack, start))
+            start = seg->ack;
+
+        /* Find the blocks that overlap or adjoin it (i..j-1).*/
+        for(i = 0; (i < cb->tcpcb_sndsackcount) && FNET_TCP_COMP_G(start, sack[i].end); i++)
+        {}
+
+        for(j = i; (j < cb->tcpcb_sndsackcount) && FNET_TCP_COMP_GE(end, sack[j].start); j++)
+        {
+            if(FNET_TCP_COMP_G(start, sack[j].start))
+                start = sack[j].start;
+
+            if(FNET_TCP_COMP_G(sack[j].end, end))
+                end = sack[j].end;
+        }
+
+        if(j == i)
+        {
+            /* Insert the new block. If there is no room, the highest block is lost.*/
+            if(cb->tcpcb_sndsackcount == FNET_CFG_TCP_SACK_BLOCKS)
+            {
+                if(i == cb->tcpcb_sndsackcount)
+                    continue;
+
+                cb->tcpcb_sndsackcount--;
+            }
+
+            for(j = cb->tcpcb_sndsackcount; j > i; j--)
+                sack[j] = sack[j - 1];
+
+            cb->tcpcb_sndsackcount++;
+        }
+        else
+        {
+            /* Join the blocks.*/
+            for(n = j; n < cb->tcpcb_sndsackcount; n++)
+                sack[n - (j - i - 1)] = sack[n];
+
+            cb->tcpcb_sndsackcount -= j - i - 1;
+        }
+
+        sack[i].start = start;
+        sack[i].end = end;
+    }
+}
+
+/************************************************************************
+* NAME: fnet_tcp_sackretransmit
+*
+* DESCRIPTION: This function retransmits the next hole between 
+*              the SACKed blocks (up to MSS). Without SACKed blocks, 
+*              the first unacknowledged segment is retransmitted once.
+*
+* RETURNS: TRUE if a segment is sent. Otherwise
+*          this function returns FALSE.
+*************************************************************************/
+static int fnet_tcp_sackretransmit( fnet_socket_t *sk )
+{
+    fnet_tcp_control_t      *cb = (fnet_tcp_control_t *)sk->protocol_control;
+    fnet_tcp_sack_block_t   *sack = cb->tcpcb_sndsack;
+    unsigned long           seq;
+    unsigned long           end;
+    unsigned long           size;
+    int                     i;
+
+    seq = cb->tcpcb_sackrexmt;
+
+    if(FNET_TCP_COMP_G(cb->tcpcb_rcvack, seq))
+        seq = cb->tcpcb_rcvack;
+
+    /* Skip the SACKed blocks.*/
+    for(i = 0; (i < cb->tcpcb_sndsackcount) && !FNET_TCP_COMP_G(sack[i].start, seq); i++)
+    {
+        if(FNET_TCP_COMP_G(sack[i].end, seq))
+            seq = sack[i].end;
+    }
+
+    if(i < cb->tcpcb_sndsackcount)
+        end = sack[i].start;
+    else if(!cb->tcpcb_sndsackcount && (seq == cb->tcpcb_rcvack))
+        end = seq + cb->tcpcb_sndmss;
+    else
+        return FNET_FALSE; /* No hole is known.*/
+
+    size = fnet_tcp_getsize(seq, end);
+
+    if(size > cb->tcpcb_sndmss)
+        size = cb->tcpcb_sndmss;
+
+    /* Retransmit the segment.*/
+    end = cb->tcpcb_sndseq;
+    cb->tcpcb_sndseq = seq;
+    fnet_tcp_senddataseg(sk, 0, 0, size);
+    cb->tcpcb_sackrexmt = cb->tcpcb_sndseq;
+    cb->tcpcb_sndseq = end;
+
+    return FNET_TRUE;
+}
+
+/************************************************************************
+* NAME: fnet_tcp_sackskip
+*
+* DESCRIPTION: This function moves the sequence number over  
+*              the SACKed data, and limits the size of the data 
+*              to the next SACKed block.
+*
+* RETURNS: None.
+*************************************************************************/
+static void fnet_tcp_sackskip( fnet_tcp_control_t *cb, unsigned long *datasize )
+{
+    fnet_tcp_sack_block_t   *sack = cb->tcpcb_sndsack;
+    unsigned long           size;
+    int                     i;
+
+    for(i = 0; i < cb->tcpcb_sndsackcount; i++)
+    {
+        if(FNET_TCP_COMP_G(sack[i].start, cb->tcpcb_sndseq))
+        {
+            /* The data ends before the next SACKed block.*/
+            size = fnet_tcp_getsize(cb->tcpcb_sndseq, sack[i].start);
+
+            if(*datasize > size)
+                *datasize = size;
+
+            break;
+        }
+
+        if(FNET_TCP_COMP_G(sack[i].end, cb->tcpcb_sndseq))
+            cb->tcpcb_sndseq = sack[i].end;
+    }
+}
+#endif /* FNET_CFG_TCP_SACK */
+
 /************************************************************************
 * NAME: fnet_tcp_findsk
 *
@@ -3799,70 +4509,135 @@ static void fnet_tcp_getsynopt( fnet_socket_t *sk )
 *************************************************************************/
 static fnet_socket_t *fnet_tcp_findsk( struct sockaddr *src_addr,  struct sockaddr *dest_addr )                                       
 {
-    fnet_socket_t   *listensk = 0;
     fnet_socket_t   *sk;
 
     fnet_isr_lock();
     
-    sk = fnet_tcp_prot_if.head;
+    /* Search the connected, partial or incoming socket with the same 
+     * local and foreign parameters (address and port).*/
+    sk = fnet_tcp_hash_con[fnet_tcp_hash(dest_addr, src_addr)];
 
     while(sk)
     {
-        if(sk->local_addr.sa_port == dest_addr->sa_port)
-        {
-            /* Listening socket.*/
-            if(sk->state == SS_LISTENING)
-            {
-                if(!listensk && (fnet_socket_addr_is_unspecified(&sk->local_addr) || fnet_socket_addr_are_equal(&sk->local_addr, dest_addr) ))
-                    listensk = sk;
-            }
-            else
-            {
-                /* Not listening socket.*/
-                if(fnet_socket_addr_are_equal(&sk->local_addr, dest_addr) && sk->state != SS_UNCONNECTED && 
-                   fnet_socket_addr_are_equal(&sk->foreign_addr, src_addr) && sk->foreign_addr.sa_port == src_addr->sa_port)
-                     break;
-            }
-        }
-        sk = sk->next;
+        if((sk->local_addr.sa_port == dest_addr->sa_port) && (sk->foreign_addr.sa_port == src_addr->sa_port)
+           && fnet_socket_addr_are_equal(&sk->foreign_addr, src_addr) && fnet_socket_addr_are_equal(&sk->local_addr, dest_addr))
+            break;
+            
+        sk = sk->hash_next;
     }
 
-    /* If the listening socket with the same local parameters (address and port) is present.*/
-    if(!sk && listensk)
+    /* Otherwise, the listening socket with the same local parameters (address and port).*/
+    if(!sk)
     {
-        /* Search the partial socket with the same foreign parameters (address and port).*/
-        sk = listensk->partial_con;
-
+        sk = fnet_tcp_hash_listen[FNET_TCP_LISTEN_HASH(dest_addr->sa_port)];
+        
         while(sk)
         {
-            if(fnet_socket_addr_are_equal(&sk->foreign_addr, src_addr) && sk->foreign_addr.sa_port == src_addr->sa_port)
+            if((sk->local_addr.sa_port == dest_addr->sa_port) 
+               && (fnet_socket_addr_is_unspecified(&sk->local_addr) || fnet_socket_addr_are_equal(&sk->local_addr, dest_addr)))
                 break;
-
-            sk = sk->next;
+                
+            sk = sk->hash_next;
         }
+    }
 
-        if(!sk)
-        {
-            /* Search the incoming socket with the same foreign parameters (address and port).*/
-            sk = listensk->incoming_con;
+    fnet_isr_unlock();
 
-            while(sk)
-            {
-                if(fnet_socket_addr_are_equal(&sk->foreign_addr, src_addr) && sk->foreign_addr.sa_port == src_addr->sa_port)
-                    break;
+    return sk;
+}
 
-                sk = sk->next;
-            }
+/************************************************************************
+* NAME: fnet_tcp_hash
+*
+* DESCRIPTION: This function returns the connection lookup table index
+*              of the local port and foreign address and port.
+*
+* RETURNS: Table index.
+*************************************************************************/
+static unsigned int fnet_tcp_hash( const struct sockaddr *local_addr, const struct sockaddr *foreign_addr )
+{
+    unsigned long key = ((unsigned long)foreign_addr->sa_port << 16) ^ local_addr->sa_port;
+
+#if FNET_CFG_IP4
+    if(foreign_addr->sa_family & AF_INET)
+        key ^= ((const struct sockaddr_in *)foreign_addr)->sin_addr.s_addr;
+#endif
+#if FNET_CFG_IP6
+    if(foreign_addr->sa_family & AF_INET6)
+        key ^= ((const struct sockaddr_in6 *)foreign_addr)->sin6_addr.s6_addr.addr32[3]; /* Low bits of the interface ID.*/
+#endif
+
+    key ^= key >> 16;
+    key ^= key >> 8;
+
+    return (unsigned int)(key & (FNET_CFG_TCP_HASH_SIZE - 1));
+}
+
+/***********************************************************************
+* NAME: fnet_tcp_hash_add
+*
+* DESCRIPTION: This function adds the socket to the lookup table, 
+*              the listening table if it is listening.
+*              The addresses of the socket must not change, until
+*              fnet_tcp_hash_del() is called.
+*
+* RETURNS: None.
+*************************************************************************/
+static void fnet_tcp_hash_add( fnet_socket_t *sk )
+{
+    fnet_socket_t **entry;
+    
+    fnet_isr_lock();
+    
+    fnet_tcp_hash_del(sk); /* Just in case.*/
+
+    if(sk->state == SS_LISTENING)
+        entry = &fnet_tcp_hash_listen[FNET_TCP_LISTEN_HASH(sk->local_addr.sa_port)];
+    else
+        entry = &fnet_tcp_hash_con[fnet_tcp_hash(&sk->local_addr, &sk->foreign_addr)];
+
+    sk->hash_next = *entry;
+    *entry = sk;
+    
+    fnet_isr_unlock();
+}
+
+/***********************************************************************
+* NAME: fnet_tcp_hash_del
+*
+* DESCRIPTION: This function deletes the socket from the lookup tables,
+*              if it is there.
+*
+* RETURNS: None.
+*************************************************************************/
+static void fnet_tcp_hash_del( fnet_socket_t *sk )
+{
+    fnet_socket_t **entry;
+    
+    fnet_isr_lock();
+
+    /* The state may have changed, so look in both tables.*/
+    for(entry = &fnet_tcp_hash_con[fnet_tcp_hash(&sk->local_addr, &sk->foreign_addr)]; *entry; entry = &(*entry)->hash_next)
+    {
+        if(*entry == sk)
+        {
+            *entry = sk->hash_next;
+            break;
         }
+    }
 
-        /* Listening socket is unique (with the same local parameters).*/
-        if(!sk)
-            sk = listensk;
+    for(entry = &fnet_tcp_hash_listen[FNET_TCP_LISTEN_HASH(sk->local_addr.sa_port)]; *entry; entry = &(*entry)->hash_next)
+    {
+        if(*entry == sk)
+        {
+            *entry = sk->hash_next;
+            break;
+        }
     }
 
+    sk->hash_next = 0;
+    
     fnet_isr_unlock();
-
-    return sk;
 }
 
 /***********************************************************************
@@ -3897,6 +4672,9 @@ static void fnet_tcp_movesk2incominglist( fnet_socket_t *sk )
 
     fnet_socket_list_del(&mainsk->partial_con, sk);
     fnet_socket_list_add(&mainsk->incoming_con, sk);
+    
+    /* New connection can be accepted.*/
+    fnet_socket_notify(mainsk);
 }
 
 /***********************************************************************
@@ -3936,8 +4714,12 @@ static void fnet_tcp_closesk( fnet_socket_t *sk )
             fnet_tcp_deletetmpbuf(cb);
 #endif            
             fnet_socket_buffer_release(&sk->send_buffer);
+            fnet_timer_stop(cb->tcpcb_rexmt_timer);
+            fnet_timer_stop(cb->tcpcb_delack_timer);
+            fnet_tcp_hash_del(sk);
             sk->state = SS_UNCONNECTED;
             fnet_memset_zero(&sk->foreign_addr, sizeof(sk->foreign_addr));
+            fnet_socket_notify(sk);
         }
     }
 }
@@ -3982,6 +4764,8 @@ static void fnet_tcp_delcb( fnet_tcp_control_t *cb )
 #if !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER
     fnet_tcp_deletetmpbuf(cb);
 #endif    
+    fnet_timer_free(cb->tcpcb_rexmt_timer);
+    fnet_timer_free(cb->tcpcb_delack_timer);
     fnet_free(cb);
 }
 
@@ -4021,6 +4805,7 @@ static void fnet_tcp_deletetmpbuf( fnet_tcp_control_t *cb )
 *************************************************************************/
 static void fnet_tcp_delsk( fnet_socket_t ** head, fnet_socket_t *sk )
 {
+    fnet_tcp_hash_del(sk);
     fnet_tcp_delcb((fnet_tcp_control_t *)sk->protocol_control);
     fnet_socket_release(head, sk);
 }
@@ -38,6 +38,7 @@
 #include "fnet_netbuf.h"
 #include "fnet_netif.h"
 #include "fnet_netif_prv.h"
+#include "fnet_timer_prv.h"
 //#include "fnet_prot.h"
 
 /************************************************************************
@@ -46,6 +47,7 @@
 
 #define FNET_TCP_MSS_HEADER         (0x02040000) /* MSS option*/ 
 #define FNET_TCP_WINDOW_HEADER      (0x30300)    /* Window scale option*/
+#define FNET_TCP_SACK_HEADER        (0x01010500) /* SACK option, aligned by two NOPs*/
 
 /************************************************************************
 *    Protocol structure
@@ -66,7 +68,6 @@ extern struct fnet_prot_if fnet_tcp_prot_if;
 *    Control values for timers
 *************************************************************************/
 #define FNET_TCP_TIMER_OFF          (-1)    /* Switch off value.*/
-#define FNET_TCP_TIMER_ON_INCREMENT (0)     /* Switch on value for increment timers.*/
 
 /************************************************************************
 *    Step of Initial sequence number (ISN)
@@ -79,12 +80,13 @@ extern struct fnet_prot_if fnet_tcp_prot_if;
 #define FNET_TCP_DEFAULT_MSS    (536)                      /* Default value of MSS.*/
 #define FNET_TCP_TX_BUF_MAX     (FNET_CFG_SOCKET_TCP_TX_BUF_SIZE) /* Default maximum size for TCP send socket buffer.*/
 #define FNET_TCP_RX_BUF_MAX     (FNET_CFG_SOCKET_TCP_RX_BUF_SIZE) /* Default maximum size for TCP receive socket buffer.*/
+#define FNET_TCP_TX_MALLOC_MIN  ((long)(FNET_CFG_ETH_MTU + (FNET_CFG_ETH_MTU >> 1))) /* Minimal free heap chunk for sending (1.5 x MTU).*/
 
 /************************************************************************
 *    Periods of timers
 *************************************************************************/
 #define FNET_TCP_SLOWTIMO       (500)       /* Slow timer period (ms).*/
-#define FNET_TCP_FASTTIMO       (200)       /* Fast timer period (ms).*/
+#define FNET_TCP_FASTTIMO       (FNET_TIMER_PERIOD_MS) /* Delayed acknowledgment timeout (ms).*/
 
 /************************************************************************
 *    Keepalive timer parameters                                          
@@ -104,6 +106,11 @@ extern struct fnet_prot_if fnet_tcp_prot_if;
 *************************************************************************/
 #define FNET_TCP_TIMERS_INIT    (12)
 
+/************************************************************************
+*    Minimal value of the retransmission timeout (1 sec)     
+*************************************************************************/
+#define FNET_TCP_RTO_MIN        (2)
+
 /************************************************************************
 *    Limit of timers (60 sec)                                            
 *************************************************************************/
@@ -116,9 +123,10 @@ extern struct fnet_prot_if fnet_tcp_prot_if;
 #define FNET_TCP_RTTVAR_SHIFT   (2) /* Round trip time variance shift.*/
 
 /************************************************************************
-*    Maximal size of synchronized options
+*    Maximal size of synchronized options 
+*    (MSS, window scale, SACK-permitted, and room for 4-byte writes)
 *************************************************************************/
-#define FNET_TCP_MAX_OPT_SIZE       (7)
+#define FNET_TCP_MAX_OPT_SIZE       (12)
 
 /************************************************************************
 *    Maximal window size 
@@ -182,9 +190,8 @@ extern struct fnet_prot_if fnet_tcp_prot_if;
 #define FNET_TCP_COMP_G(a,b)    fnet_tcp_hit(b+1, b + 0x20000000, a) /* Greater.*/
 
 /************************************************************************
-*    Segment header fields
+*    Segment header fields (output segments and queued input segments)
 *************************************************************************/
-//TBD eliminate these definitions => use structure header. 
 #define FNET_TCP_DPORT(segment)        FNET_TCP_GETUSHORT(segment->data_ptr, 2)
 #define FNET_TCP_SPORT(segment)        FNET_TCP_GETUSHORT(segment->data_ptr, 0)
 #define FNET_TCP_WND(segment)          FNET_TCP_GETUSHORT(segment->data_ptr, 14)
@@ -214,9 +221,20 @@ extern struct fnet_prot_if fnet_tcp_prot_if;
 #define FNET_TCP_OTYPES_NOP         (1) /* No Option.*/
 #define FNET_TCP_OTYPES_MSS         (2) /* Maximal segment size.*/
 #define FNET_TCP_OTYPES_WINDOW      (3) /* Scale window.*/
+#define FNET_TCP_OTYPES_SACK_PERMITTED  (4) /* SACK permitted.*/
+#define FNET_TCP_OTYPES_SACK        (5) /* SACK blocks.*/
 
 #define FNET_TCP_MSS_SIZE           (4) /* MSS option size.*/
 #define FNET_TCP_WINDOW_SIZE        (3) /* Window scale option size.*/
+#define FNET_TCP_SACK_PERMITTED_SIZE    (2) /* SACK-permitted option size.*/
+#define FNET_TCP_SACK_BLOCK_SIZE    (8) /* Size of a block in the SACK option.*/
+
+/************************************************************************
+*    Maximal number of blocks in the SACK option, and size of the option
+*    (with two NOPs, it fits in the 40 bytes of the options)
+*************************************************************************/
+#define FNET_TCP_SACK_MAX_BLOCKS    (4)
+#define FNET_TCP_SACK_OPT_SIZE      (4 + FNET_TCP_SACK_MAX_BLOCKS * FNET_TCP_SACK_BLOCK_SIZE)
 
 /**************************************************************************/ /*!
  * @internal
@@ -233,7 +251,7 @@ typedef struct
 } fnet_tcp_sockopt_t;
 
 /************************************************************************
-*    TCP header structure. //TBD use it instead of definitions.
+*    TCP header structure.
 *************************************************************************/
 FNET_COMP_PACKED_BEGIN
 typedef struct
@@ -252,6 +270,47 @@ FNET_COMP_PACKED_END
 #define FNET_TCP_HEADER_GET_HDRLENGTH(x)    (fnet_ntohs(x->hdrlength__flags)>>12)
 #define FNET_TCP_HEADER_GET_FLAGS(x)        (fnet_ntohs(x->hdrlength__flags)&0x3F)
 
+/************************************************************************
+*    Options present in the received segment
+*************************************************************************/
+#define FNET_TCP_SEGOPT_MSS         (0x01)  /* MSS option is received.*/
+#define FNET_TCP_SEGOPT_WINDOW      (0x02)  /* Window scale option is received.*/
+#define FNET_TCP_SEGOPT_SACK_PERMITTED  (0x04)  /* SACK-permitted option is received.*/
+
+#if FNET_CFG_TCP_SACK
+/**************************************************************************/ /*!
+ * @internal
+ * @brief    Block of the data received out of order (SACK block).
+ ******************************************************************************/
+typedef struct
+{
+    unsigned long   start;          /* First sequence number of the block.*/
+    unsigned long   end;            /* Sequence number following the block.*/
+} fnet_tcp_sack_block_t;
+#endif /* FNET_CFG_TCP_SACK */
+
+/**************************************************************************/ /*!
+ * @internal
+ * @brief    Header of the received segment, decoded to the host byte
+ *           order once by fnet_tcp_input() and passed through 
+ *           the input processing.
+ ******************************************************************************/
+typedef struct
+{
+    unsigned long   seq;            /* Sequence number.*/
+    unsigned long   ack;            /* Acknowledgment number.*/
+    unsigned long   length;         /* Header length, including the options.*/
+    unsigned short  wnd;            /* Window (not scaled).*/
+    unsigned char   flags;          /* Flags (FNET_TCP_SGT_xxx).*/
+    unsigned char   options;        /* Received options (FNET_TCP_SEGOPT_xxx).*/
+    unsigned short  mss;            /* Value of the MSS option.*/
+    unsigned char   wscale;         /* Value of the window scale option.*/
+#if FNET_CFG_TCP_SACK
+    unsigned char   sack_count;     /* Number of the received SACK blocks.*/
+    fnet_tcp_sack_block_t sack[FNET_TCP_SACK_MAX_BLOCKS]; /* SACK blocks.*/
+#endif /* FNET_CFG_TCP_SACK */
+} fnet_tcp_seginfo_t;
+
 /************************************************************************
 *    TCP header size without options
 *************************************************************************/
@@ -286,6 +345,8 @@ FNET_COMP_PACKED_END
 #define FNET_TCP_CBF_RCVD_SCALE     (0x20)  /* Another side uses the scale option.*/
 #define FNET_TCP_CBF_SEND_TIMEOUT   (0x40)  /* Silly window avoidance flag.*/
 #define FNET_TCP_CBF_INSND          (0x80)  /* The fnet_tcp_snd function is executed now.*/
+#define FNET_TCP_CBF_SACK           (0x100) /* Both sides permit SACK.*/
+#define FNET_TCP_CBF_SACK_RECOVERY  (0x200) /* Holes, reported by SACK, are retransmitted.*/
 
 /************************************************************************
 *    Standart states for TCP ( described in RFC793)
@@ -325,12 +386,8 @@ typedef struct
     int keepalive;          /* Keepalive timer. 
                              * It detects when the other end on an otherwise idle connection crashes or reboots.*/
     int connection;         /* Connection timer.*/
-    int retransmission;     /* Retransmission timer. 
-                             * It is used when expecting an acknowledgment from the other end. */
     int persist;            /* Persist timer. 
                              * It keeps window size information flowing even if the other end closes its receive window.*/
-    int delayed_ack;        /* Delayed acknowledgment timer.*/
-    int round_trip;         /* Round trip timer.*/
 } fnet_tcp_timers_t;
 
 
@@ -342,7 +399,11 @@ typedef struct
     /* Receive variables.*/
 #if !FNET_CFG_TCP_DISCARD_OUT_OF_ORDER    
     fnet_netbuf_t *tcpcb_rcvchain;      /* Temporary buffer.*/
+    fnet_netbuf_t *tcpcb_rcvchain_tail; /* Last segment in the temporary buffer (valid if tcpcb_rcvchain is not 0).*/
     unsigned long tcpcb_count;          /* Size of data in the temporary buffer.*/
+#if FNET_CFG_TCP_SACK
+    unsigned long tcpcb_rcvsackseq;     /* Sequence number of the last segment added to the temporary buffer.*/
+#endif
 #endif    
     unsigned long tcpcb_rcvcountmax;    /* Size of the input and temporary buffers.*/
     
@@ -381,12 +442,22 @@ typedef struct
     int tcpcb_crto;                     /* Current retransmission timeout.*/
     int tcpcb_cprto;                    /* Current retransmission timeout for persist timer.*/
     unsigned long tcpcb_retrseq;        /* Sequenc number of the retransmitting data.*/
-    unsigned short tcpcb_srtt;          /* Smoothed round trip time.*/
-    unsigned short tcpcb_rttvar;        /* Round trip time variance.*/
+    unsigned long tcpcb_timingstart;    /* Send time of the timed segment (us).*/
+    long tcpcb_srtt;                    /* Smoothed round trip time (ms, scaled by 8).*/
+    long tcpcb_rttvar;                  /* Round trip time variance (ms, scaled by 4).*/
     fnet_tcp_timing_state_t tcpcb_timing_state;   /* Timing state, defined by fnet_tcp_timing_state_t.*/
+#if FNET_CFG_TCP_SACK
+    fnet_tcp_sack_block_t tcpcb_sndsack[FNET_CFG_TCP_SACK_BLOCKS]; /* Sent data, SACKed by another side (sorted).*/
+    int tcpcb_sndsackcount;             /* Number of the SACKed blocks.*/
+    unsigned long tcpcb_sackrecover;    /* Highest sent sequence number, when the hole retransmission started.*/
+    unsigned long tcpcb_sackrexmt;      /* Sequence number following the last retransmitted hole.*/
+#endif /* FNET_CFG_TCP_SACK */
 
     /* Timers.*/
-    fnet_tcp_timers_t tcpcb_timers;     /* Structure of the timers.*/
+    fnet_tcp_timers_t tcpcb_timers;     /* Structure of the timers, counted by the slow timer.*/
+    fnet_timer_desc_t tcpcb_rexmt_timer;    /* Retransmission timer. 
+                                         * It is used when expecting an acknowledgment from the other end. */
+    fnet_timer_desc_t tcpcb_delack_timer;   /* Delayed acknowledgment timer.*/
 
     fnet_tcp_connection_state_t tcpcb_connection_state;         /* Connection state, defined by fnet_tcp_connection_state_t.*/
     fnet_tcp_connection_state_t tcpcb_prev_connection_state;    /* Previous connection state (used only for simultaneous open),
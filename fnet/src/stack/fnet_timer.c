@@ -47,22 +47,47 @@
 #include "fnet.h"
 #include "fnet_timer_prv.h"
 #include "fnet_netbuf.h"
-
-/* Queue of the software timers*/
+#include "fnet_isr.h"
+
+/* Software timers are kept in a two-level timing wheel.
+ * The first level has a slot per tick, for the timers expiring 
+ * in the next FNET_TIMER_WHEEL0_SIZE ticks. The second level has 
+ * a slot per FNET_TIMER_WHEEL0_SIZE ticks, its slot is moved (cascaded) 
+ * to the first level when the wheel time reaches it. 
+ * Later timers wait in the last second level slot and are cascaded again.
+ * So insertion and removal take a constant time, and a tick handles 
+ * only the expiring timers.*/
+#define FNET_TIMER_WHEEL0_BITS  (6)
+#define FNET_TIMER_WHEEL1_BITS  (6)
+#define FNET_TIMER_WHEEL0_SIZE  (1UL << FNET_TIMER_WHEEL0_BITS)
+#define FNET_TIMER_WHEEL1_SIZE  (1UL << FNET_TIMER_WHEEL1_BITS)
+#define FNET_TIMER_WHEEL0_MASK  (FNET_TIMER_WHEEL0_SIZE - 1)
+#define FNET_TIMER_WHEEL1_MASK  (FNET_TIMER_WHEEL1_SIZE - 1)
+#define FNET_TIMER_WHEEL_SPAN   (FNET_TIMER_WHEEL0_SIZE * FNET_TIMER_WHEEL1_SIZE)
 
 struct fnet_net_timer
 {
-    struct fnet_net_timer *next; /* Next timer in list.*/
-    unsigned long timer_cnt;     /* Timer counter. */
-    unsigned long timer_rv;      /* Timer reference value. */
-    void (*handler)( void * );   /* Timer handler. */
-    void *cookie;                /* Handler Cookie. */
+    struct fnet_net_timer *next;    /* Next timer in the wheel slot.*/
+    struct fnet_net_timer **pprev;  /* Link to this timer in the wheel slot, 0 if not scheduled.*/
+    struct fnet_net_timer *list_next;   /* Next timer in list of all timers.*/
+    struct fnet_net_timer **list_pprev; /* Link to this timer in list of all timers.*/
+    unsigned long expire;           /* Expiration time, in ticks. */
+    unsigned long timer_rv;         /* Timer reference value (period or delay). */
+    int oneshot;                    /* Timer is stopped after its expiration. */
+    void (*handler)( void * );      /* Timer handler. */
+    void *cookie;                   /* Handler Cookie. */
 };
 
 static struct fnet_net_timer *fnet_tl_head = 0;
+static struct fnet_net_timer *fnet_timer_wheel0[FNET_TIMER_WHEEL0_SIZE];
+static struct fnet_net_timer *fnet_timer_wheel1[FNET_TIMER_WHEEL1_SIZE];
+static unsigned long fnet_timer_wheel_time; /* The wheel is processed till this time.*/
 
 volatile static unsigned long fnet_current_time;
 
+static void fnet_timer_schedule( struct fnet_net_timer *timer );
+static void fnet_timer_unschedule( struct fnet_net_timer *timer );
+
 #if FNET_CFG_DEBUG_TIMER    
     #define FNET_DEBUG_TIMER   FNET_DEBUG
 #else
@@ -79,6 +104,7 @@ int fnet_timer_init( unsigned int period_ms )
    int result;
    
    fnet_current_time = 0;           /* Reset RTC counter. */
+   fnet_timer_wheel_time = 0;
    result = fnet_cpu_timer_init(period_ms);  /* Start HW timer. */
    
    return result;
@@ -92,17 +118,11 @@ int fnet_timer_init( unsigned int period_ms )
 *************************************************************************/
 void fnet_timer_release( void )
 {
-    struct fnet_net_timer *tmp_tl;
-
     fnet_cpu_timer_release();
     
     while(fnet_tl_head != 0)
     {
-        tmp_tl = fnet_tl_head->next;
-
-        fnet_free(fnet_tl_head);
-
-        fnet_tl_head = tmp_tl;
+        fnet_timer_free(fnet_tl_head);
     }
 }
 
@@ -137,6 +157,21 @@ unsigned long fnet_timer_ms( void )
     return (fnet_current_time*FNET_TIMER_PERIOD_MS);
 }
 
+/************************************************************************
+* NAME: fnet_timer_us
+*
+* DESCRIPTION: This function returns current value of the free-running
+* clock in microseconds. 
+*************************************************************************/
+unsigned long fnet_timer_us( void )
+{
+#if FNET_CFG_CPU_TIMER_US
+    return fnet_cpu_timer_us();
+#else
+    return (fnet_current_time*(FNET_TIMER_PERIOD_MS*1000));
+#endif
+}
+
 /************************************************************************
 * NAME: fnet_timer_ticks_inc
 *
@@ -152,6 +187,55 @@ void fnet_timer_ticks_inc( void )
 #endif	    
 }
 
+/************************************************************************
+* NAME: fnet_timer_schedule
+*
+* DESCRIPTION: Puts the timer to the wheel slot of its expiration time.
+*              The timer must not be scheduled.
+*************************************************************************/
+static void fnet_timer_schedule( struct fnet_net_timer *timer )
+{
+    struct fnet_net_timer   **slot;
+    unsigned long           delta = timer->expire - fnet_timer_wheel_time;
+    
+    if(delta < FNET_TIMER_WHEEL0_SIZE)
+    {
+        slot = &fnet_timer_wheel0[timer->expire & FNET_TIMER_WHEEL0_MASK];
+    }
+    else if(delta < FNET_TIMER_WHEEL_SPAN)
+    {
+        slot = &fnet_timer_wheel1[(timer->expire >> FNET_TIMER_WHEEL0_BITS) & FNET_TIMER_WHEEL1_MASK];
+    }
+    else
+    {
+        /* Out of the wheel span, it will be cascaded again.*/
+        slot = &fnet_timer_wheel1[((fnet_timer_wheel_time + FNET_TIMER_WHEEL_SPAN - 1) >> FNET_TIMER_WHEEL0_BITS) & FNET_TIMER_WHEEL1_MASK];
+    }
+    
+    timer->next = *slot;
+    if(timer->next)
+        timer->next->pprev = &timer->next;
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+/************************************************************************
+* NAME: fnet_timer_unschedule
+*
+* DESCRIPTION: Removes the timer from its wheel slot, if it is scheduled.
+*************************************************************************/
+static void fnet_timer_unschedule( struct fnet_net_timer *timer )
+{
+    if(timer->pprev)
+    {
+        *timer->pprev = timer->next;
+        if(timer->next)
+            timer->next->pprev = timer->pprev;
+        
+        timer->pprev = 0;
+    }
+}
+
 /************************************************************************
 * NAME: fnet_timer_handler_bottom
 *
@@ -160,22 +244,51 @@ void fnet_timer_ticks_inc( void )
 *************************************************************************/
 void fnet_timer_handler_bottom( void )
 {
-    struct fnet_net_timer *timer;
+    struct fnet_net_timer   *timer;
+    struct fnet_net_timer   **slot;
+    unsigned long           current_time;
+
+    fnet_isr_lock();
 
-    timer = fnet_tl_head;
+    current_time = fnet_current_time;
 
-    while(timer)
+    /* Catch up all ticks, that came since the last call.*/
+    while(fnet_timer_wheel_time != current_time)
     {
-        if(fnet_timer_get_interval(timer->timer_cnt, fnet_current_time) >= timer->timer_rv)
+        fnet_timer_wheel_time++;
+        
+        /* Cascade the next second level slot.*/
+        if((fnet_timer_wheel_time & FNET_TIMER_WHEEL0_MASK) == 0)
         {
-            timer->timer_cnt = fnet_current_time;
-
-            if(timer->handler)
-                timer->handler(timer->cookie);
+            slot = &fnet_timer_wheel1[(fnet_timer_wheel_time >> FNET_TIMER_WHEEL0_BITS) & FNET_TIMER_WHEEL1_MASK];
+            
+            while((timer = *slot) != 0)
+            {
+                fnet_timer_unschedule(timer);
+                fnet_timer_schedule(timer);
+            }
+        }
+        
+        /* All timers of the slot expire now.
+         * The handler may stop or free any timer, so take them one by one.*/
+        slot = &fnet_timer_wheel0[fnet_timer_wheel_time & FNET_TIMER_WHEEL0_MASK];
+        
+        while((timer = *slot) != 0)
+        {
+            fnet_timer_unschedule(timer);
+            
+            if(!timer->oneshot)
+            {
+                /* The period starts from the moment of the handler call.*/
+                timer->expire = current_time + timer->timer_rv;
+                fnet_timer_schedule(timer);
+            }
+
+            timer->handler(timer->cookie);
         }
-
-        timer = timer->next;
     }
+
+    fnet_isr_unlock();
 }
 
 /************************************************************************
@@ -190,26 +303,115 @@ fnet_timer_desc_t fnet_timer_new( unsigned long period_ticks, void (*handler)( v
 
     if( period_ticks && handler )
     {
-        timer = (struct fnet_net_timer *)fnet_malloc(sizeof(struct fnet_net_timer));
+        timer = fnet_timer_new_oneshot(handler, cookie);
 
         if(timer)
         {
-            timer->next = fnet_tl_head;
+            timer->oneshot = 0;
+            timer->timer_rv = period_ticks;
+            fnet_timer_start(timer, period_ticks);
+        }
+    }
 
-            fnet_tl_head = timer;
+    return (fnet_timer_desc_t)timer;
+}
 
-            timer->timer_cnt = 0;
+/************************************************************************
+* NAME: fnet_timer_new_oneshot
+*
+* DESCRIPTION: Creates new software timer, that is called once 
+*              after it is started by fnet_timer_start().
+*************************************************************************/
+fnet_timer_desc_t fnet_timer_new_oneshot( void (*handler)( void * ), void *cookie )
+{
+    struct fnet_net_timer *timer = FNET_NULL;
 
-            timer->timer_rv = period_ticks;
+    if(handler)
+    {
+        timer = (struct fnet_net_timer *)fnet_malloc(sizeof(struct fnet_net_timer));
 
+        if(timer)
+        {
+            fnet_memset_zero(timer, sizeof(*timer));
+            
+            timer->oneshot = 1;
             timer->handler = handler;
             timer->cookie = cookie;
+            
+            fnet_isr_lock();
+            
+            timer->list_next = fnet_tl_head;
+            if(timer->list_next)
+                timer->list_next->list_pprev = &timer->list_next;
+            timer->list_pprev = &fnet_tl_head;
+            fnet_tl_head = timer;
+            
+            fnet_isr_unlock();
         }
     }
 
     return (fnet_timer_desc_t)timer;
 }
 
+/************************************************************************
+* NAME: fnet_timer_start
+*
+* DESCRIPTION: (Re)starts the timer, to expire after delay_ticks.
+*              A periodic timer continues with its period after that.
+*************************************************************************/
+void fnet_timer_start( fnet_timer_desc_t timer, unsigned long delay_ticks )
+{
+    struct fnet_net_timer *tl = timer;
+
+    if(tl)
+    {
+        if(delay_ticks == 0)
+            delay_ticks = 1;
+        
+        fnet_isr_lock();
+        
+        fnet_timer_unschedule(tl);
+        
+        if(tl->oneshot)
+            tl->timer_rv = delay_ticks;
+        
+        tl->expire = fnet_current_time + delay_ticks;
+        fnet_timer_schedule(tl);
+        
+        fnet_isr_unlock();
+    }
+}
+
+/************************************************************************
+* NAME: fnet_timer_stop
+*
+* DESCRIPTION: Stops the timer. It may be started again.
+*************************************************************************/
+void fnet_timer_stop( fnet_timer_desc_t timer )
+{
+    struct fnet_net_timer *tl = timer;
+
+    if(tl)
+    {
+        fnet_isr_lock();
+        fnet_timer_unschedule(tl);
+        fnet_isr_unlock();
+    }
+}
+
+/************************************************************************
+* NAME: fnet_timer_is_active
+*
+* DESCRIPTION: Returns FNET_TRUE if the timer is started and has not 
+*              expired yet.
+*************************************************************************/
+int fnet_timer_is_active( fnet_timer_desc_t timer )
+{
+    struct fnet_net_timer *tl = timer;
+
+    return (tl && tl->pprev) ? FNET_TRUE : FNET_FALSE;
+}
+
 /************************************************************************
 * NAME: fnet_timer_free
 *
@@ -219,21 +421,18 @@ fnet_timer_desc_t fnet_timer_new( unsigned long period_ticks, void (*handler)( v
 void fnet_timer_free( fnet_timer_desc_t timer )
 {
     struct fnet_net_timer *tl = timer;
-    struct fnet_net_timer *tl_temp;
 
     if(tl)
     {
-        if(tl == fnet_tl_head)
-            fnet_tl_head = fnet_tl_head->next;
-        else
-        {
-            tl_temp = fnet_tl_head;
-
-            while(tl_temp->next != tl)
-              tl_temp = tl_temp->next;
-
-            tl_temp->next = tl->next;
-        }
+        fnet_isr_lock();
+        
+        fnet_timer_unschedule(tl);
+        
+        *tl->list_pprev = tl->list_next;
+        if(tl->list_next)
+            tl->list_next->list_pprev = tl->list_pprev;
+        
+        fnet_isr_unlock();
 
         fnet_free(tl);
     }
@@ -249,13 +448,23 @@ void fnet_timer_reset_all( void )
 {
     struct fnet_net_timer *tl;
 
+    fnet_isr_lock();
+
     tl = fnet_tl_head;
 
     while(tl != 0)
     {
-        tl->timer_cnt = fnet_current_time;
-        tl = tl->next;
+        if(tl->pprev)
+        {
+            fnet_timer_unschedule(tl);
+            tl->expire = fnet_current_time + tl->timer_rv;
+            fnet_timer_schedule(tl);
+        }
+        
+        tl = tl->list_next;
     }
+    
+    fnet_isr_unlock();
 }
 
 /************************************************************************
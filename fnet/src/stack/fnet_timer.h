@@ -132,6 +132,23 @@ unsigned long fnet_timer_seconds( void );
  ******************************************************************************/
 unsigned long fnet_timer_ms( void );
 
+/***************************************************************************/ /*!
+ * @brief    Gets the free-running microsecond clock.
+ * @return   This function returns a current value of the clock 
+ *           in microseconds.
+ * @see fnet_timer_ticks()
+ ******************************************************************************
+ * This function returns a current value of the free-running clock in 
+ * microseconds, from the moment of the hardware timer initialization.
+ * It wraps around every 2^32 microseconds (about 71 minutes), 
+ * so it is intended for measuring intervals with the 
+ * @ref fnet_timer_get_interval() function.@n
+ * The clock has the microsecond resolution, if the platform timer driver
+ * supports it (@ref FNET_CFG_CPU_TIMER_US). Otherwise, its resolution is 
+ * one timer tick (@ref FNET_TIMER_PERIOD_MS).
+ ******************************************************************************/
+unsigned long fnet_timer_us( void );
+
 /***************************************************************************/ /*!
  *
  * @brief    Converts milliseconds to timer ticks.
@@ -60,9 +60,16 @@ void fnet_cpu_timer_release( void );
 void fnet_timer_release( void );
 void fnet_timer_reset_all( void );
 fnet_timer_desc_t fnet_timer_new( unsigned long period_ticks, void (*handler)( void *cookie ), void *cookie );
+fnet_timer_desc_t fnet_timer_new_oneshot( void (*handler)( void *cookie ), void *cookie );
+void fnet_timer_start( fnet_timer_desc_t timer, unsigned long delay_ticks );
+void fnet_timer_stop( fnet_timer_desc_t timer );
+int fnet_timer_is_active( fnet_timer_desc_t timer );
 void fnet_timer_free( fnet_timer_desc_t timer );
 void fnet_timer_ticks_inc( void );
 void fnet_timer_handler_bottom( void );
 int fnet_cpu_timer_init( unsigned int period_ms );
+#if FNET_CFG_CPU_TIMER_US
+unsigned long fnet_cpu_timer_us( void );
+#endif
 
 #endif
@@ -65,6 +65,8 @@ static int fnet_udp_detach( fnet_socket_t *sk );
 static int fnet_udp_connect( fnet_socket_t *sk, struct sockaddr *foreign_addr);
 static int fnet_udp_snd( fnet_socket_t *sk, char *buf, int len, int flags, const struct sockaddr *foreign_addr);
 static int fnet_udp_rcv( fnet_socket_t *sk, char *buf, int len, int flags, struct sockaddr *foreign_addr);
+static int fnet_udp_snd_nb( fnet_socket_t *sk, fnet_netbuf_t *nb, int flags, const struct sockaddr *foreign_addr);
+static int fnet_udp_rcv_nb( fnet_socket_t *sk, fnet_netbuf_t **nb_ptr, int len, int flags, struct sockaddr *foreign_addr);
 static void fnet_udp_control_input( fnet_prot_notify_t command, fnet_ip_header_t *ip_hdr );
 static int fnet_udp_shutdown( fnet_socket_t *sk, int how );
 static void fnet_udp_input( fnet_netif_t *netif, struct sockaddr *foreign_addr,  struct sockaddr *local_addr, fnet_netbuf_t *nb, fnet_netbuf_t *ip_nb);
@@ -94,7 +96,10 @@ static const fnet_socket_prot_if_t fnet_udp_socket_api =
     fnet_udp_shutdown,      /* Protocol "shutdown" function.*/
     fnet_ip_setsockopt,     /* Protocol "setsockopt" function.*/
     fnet_ip_getsockopt,     /* Protocol "getsockopt" function.*/
-    0                       /* Protocol "listen" function.*/
+    0,                      /* Protocol "listen" function.*/
+    0,                      /* Protocol "poll" function.*/
+    fnet_udp_rcv_nb,        /* Protocol zero-copy "receive" function.*/
+    fnet_udp_snd_nb         /* Protocol zero-copy "send" function.*/
 };
 
 fnet_prot_if_t fnet_udp_prot_if =
@@ -134,7 +139,7 @@ static void fnet_udp_release( void )
 * DESCRIPTION: UDP output function
 *************************************************************************/
 static int fnet_udp_output(  struct sockaddr *src_addr, const struct sockaddr *dest_addr,
-                             fnet_socket_option_t *sockoption, fnet_netbuf_t *nb )                            
+                             fnet_socket_option_t *sockoption, fnet_netbuf_t *nb, unsigned short data_sum )                            
 {
     fnet_netbuf_t       *nb_header;
     fnet_udp_header_t   *udp_header;
@@ -142,8 +147,8 @@ static int fnet_udp_output(  struct sockaddr *src_addr, const struct sockaddr *d
     
     fnet_netif_t *netif = FNET_NULL;
 
-    /* Construct UDP header.*/
-    if((nb_header = fnet_netbuf_new(sizeof(fnet_udp_header_t), FNET_TRUE)) == 0)
+    /* Construct UDP header, in the headroom of the data if possible.*/
+    if((nb_header = fnet_netbuf_push(nb, sizeof(fnet_udp_header_t), FNET_TRUE)) == 0)
     {
         fnet_netbuf_free_chain(nb); /* No route.*/
         return (FNET_ERR_NOMEM);
@@ -153,13 +158,17 @@ static int fnet_udp_output(  struct sockaddr *src_addr, const struct sockaddr *d
 
     udp_header->source_port = src_addr->sa_port;             /* Source port number.*/
     udp_header->destination_port = dest_addr->sa_port;       /* Destination port number.*/
-    nb = fnet_netbuf_concat(nb_header, nb);
+    nb = nb_header;
     udp_header->length = fnet_htons((unsigned short)nb->total_length);  /* Length.*/
 
     udp_header->checksum = 0;                       /* Checksum.*/
 
 #if FNET_CFG_UDP_CHECKSUM
-    udp_header->checksum = fnet_checksum_pseudo_start( nb, FNET_HTONS((unsigned short)FNET_IP_PROTOCOL_UDP), (unsigned short)nb->total_length );
+    /* The data was summed while copied from the user buffer. */
+    udp_header->checksum = fnet_checksum_pseudo_start_partial( nb, sizeof(fnet_udp_header_t), data_sum,
+                                                FNET_HTONS((unsigned short)FNET_IP_PROTOCOL_UDP), (unsigned short)nb->total_length );
+#else
+    FNET_COMP_UNUSED_ARG(data_sum);
 #endif
 
 #if FNET_CFG_IP4
@@ -365,6 +374,8 @@ static void fnet_udp_input(fnet_netif_t *netif, struct sockaddr *foreign_addr,
                             {
                                 fnet_netbuf_free_chain(nb_tmp);
                             }
+                            else
+                                fnet_socket_notify(last);
                         }
                     }
                     last = sock;
@@ -379,6 +390,7 @@ static void fnet_udp_input(fnet_netif_t *netif, struct sockaddr *foreign_addr,
                 if(fnet_socket_buffer_append_address(&(last->receive_buffer), nb, foreign_addr) == FNET_ERR)
                     goto BAD;
                 
+                fnet_socket_notify(last);
                 fnet_netbuf_free_chain(ip_nb);                  
             }
             else /* For unicast datagram.*/
@@ -393,6 +405,7 @@ static void fnet_udp_input(fnet_netif_t *netif, struct sockaddr *foreign_addr,
                     if(fnet_socket_buffer_append_address(&(sock->receive_buffer), nb, foreign_addr) == FNET_ERR)
                         goto BAD;
                     
+                    fnet_socket_notify(sock);
                     fnet_netbuf_free_chain(ip_nb);
                 }
                 else
@@ -510,6 +523,7 @@ static int fnet_udp_snd( fnet_socket_t *sk, char *buf, int len, int flags, const
     int                     error = FNET_OK;
     const struct sockaddr   *foreign_addr;
     int                     flags_save = 0;
+    unsigned short          data_sum = 0;
 
 #if FNET_CFG_TCP_URGENT
     if(flags & MSG_OOB)
@@ -534,12 +548,19 @@ static int fnet_udp_snd( fnet_socket_t *sk, char *buf, int len, int flags, const
         foreign_addr = &sk->foreign_addr;
     }
 
-    if((nb = fnet_netbuf_from_buf(buf, len, FNET_FALSE)) == 0)
+    /* Leave room for the UDP, IP and link-level headers in front of the data.*/
+    if((nb = fnet_netbuf_new_headroom((int)(FNET_CFG_NETBUF_HEADROOM + sizeof(fnet_udp_header_t)), len, FNET_FALSE)) == 0)
     {
         error = FNET_ERR_NOMEM;     /* Cannot allocate memory.*/
         goto ERROR;
     }
 
+#if FNET_CFG_UDP_CHECKSUM
+    data_sum = fnet_checksum_copy(nb->data_ptr, buf, len);
+#else
+    fnet_memcpy(nb->data_ptr, buf, (unsigned int)len);
+#endif
+
     if(sk->local_addr.sa_port == 0)
     {
         sk->local_addr.sa_port = fnet_socket_get_uniqueport(sk->protocol_interface->head, &sk->local_addr); /* Get ephemeral port.*/
@@ -551,7 +572,7 @@ static int fnet_udp_snd( fnet_socket_t *sk, char *buf, int len, int flags, const
         sk->options.flags |= SO_DONTROUTE;
     }
 
-    error = fnet_udp_output(&sk->local_addr, foreign_addr, &(sk->options), nb);
+    error = fnet_udp_output(&sk->local_addr, foreign_addr, &(sk->options), nb, data_sum);
 
     if(flags & MSG_DONTROUTE) /* Restore.*/
     {
@@ -611,6 +632,127 @@ ERROR:
     return (SOCKET_ERROR);
 }
 
+/************************************************************************
+* NAME: fnet_udp_snd_nb
+*
+* DESCRIPTION: UDP zero-copy send function. 
+*              The net_buf chain is sent as the datagram, it is always 
+*              taken by UDP.
+*************************************************************************/
+static int fnet_udp_snd_nb( fnet_socket_t *sk, fnet_netbuf_t *nb, int flags, const struct sockaddr *addr)
+{
+    int                     error = FNET_OK;
+    int                     len = (int)nb->total_length;
+    const struct sockaddr   *foreign_addr;
+    int                     flags_save = 0;
+    unsigned short          data_sum = 0;
+
+#if FNET_CFG_TCP_URGENT
+    if(flags & MSG_OOB)
+    {
+        error = FNET_ERR_OPNOTSUPP; /* Operation not supported.*/
+        goto ERROR_FREE;
+    }
+#endif /* FNET_CFG_TCP_URGENT */
+
+    if(len > sk->send_buffer.count_max)
+    {
+        error = FNET_ERR_MSGSIZE;   /* Message too long. */
+        goto ERROR_FREE;
+    }
+
+    if(addr)
+    {
+        foreign_addr = addr;
+    }
+    else
+    {
+        foreign_addr = &sk->foreign_addr;
+    }
+
+#if FNET_CFG_UDP_CHECKSUM
+    data_sum = (unsigned short)~fnet_checksum(nb, len);
+#endif
+
+    if(sk->local_addr.sa_port == 0)
+    {
+        sk->local_addr.sa_port = fnet_socket_get_uniqueport(sk->protocol_interface->head, &sk->local_addr); /* Get ephemeral port.*/
+    }
+
+    if(flags & MSG_DONTROUTE) /* Save */
+    {
+        flags_save = sk->options.flags;
+        sk->options.flags |= SO_DONTROUTE;
+    }
+
+    error = fnet_udp_output(&sk->local_addr, foreign_addr, &(sk->options), nb, data_sum);
+
+    if(flags & MSG_DONTROUTE) /* Restore.*/
+    {
+        sk->options.flags = flags_save;
+    }
+
+    if((error == FNET_OK) && (sk->options.local_error == FNET_OK)) /* We get UDP or ICMP error.*/
+    {
+        return (len);
+    }
+
+    goto ERROR;
+
+ERROR_FREE:
+    fnet_netbuf_free_chain(nb);
+ERROR:
+    fnet_socket_set_error(sk, error);
+    return (SOCKET_ERROR);
+}
+
+/************************************************************************
+* NAME: fnet_udp_rcv_nb
+*
+* DESCRIPTION: UDP zero-copy receive function. 
+*              The whole datagram is returned, 'len' is not used.
+*************************************************************************/
+static int fnet_udp_rcv_nb(fnet_socket_t *sk, fnet_netbuf_t **nb_ptr, int len, int flags, struct sockaddr *addr)
+{
+    int error = FNET_OK;
+    int length;
+    struct sockaddr foreign_addr;
+
+    FNET_COMP_UNUSED_ARG(len);
+
+#if FNET_CFG_TCP_URGENT
+    if(flags & MSG_OOB)
+    {
+        error = FNET_ERR_OPNOTSUPP; /* Operation not supported.*/
+        goto ERROR;
+    }
+#endif /* FNET_CFG_TCP_URGENT */
+    
+    if((length = fnet_socket_buffer_detach_address(&(sk->receive_buffer), nb_ptr,
+            &foreign_addr, ((flags &MSG_PEEK)== 0))) == FNET_ERR)
+    {
+        error = FNET_ERR_NOMEM;
+        goto ERROR;
+    }
+
+    if((error == FNET_OK) && (sk->options.local_error == FNET_OK)) /* We get UDP or ICMP error.*/
+    {
+        if(addr)
+        {
+            fnet_socket_addr_copy(&foreign_addr, addr);
+        }
+        
+        return (length);
+    }
+
+    fnet_netbuf_free_chain(*nb_ptr);
+    *nb_ptr = 0;
+
+ERROR:
+    fnet_socket_set_error(sk, error);
+    return (SOCKET_ERROR);
+}
+
 /************************************************************************
 * NAME: fnet_udp_control_input
 *
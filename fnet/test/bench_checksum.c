@@ -0,0 +1,131 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file bench_checksum.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Internet checksum benchmark.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+
+#include "fnet.h"
+#include "fnet_checksum.h"
+
+#define BENCH_BYTES     (64UL * 1024 * 1024)   /* Summed per measurement.*/
+
+static unsigned char src[2048] __attribute__((aligned(8)));
+static unsigned char dst[2048] __attribute__((aligned(8)));
+
+/* The previous fnet_checksum_low(), 16-bit additions into a 32-bit sum.*/
+static unsigned short bench_sum16( unsigned short *d_ptr, int len )
+{
+    unsigned long sum = 0;
+
+    while((len -= 2) >= 0)
+        sum += *d_ptr++;
+    if(len += 2)
+        sum += *(unsigned char *)d_ptr;
+
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum += sum >> 16;
+
+    return (unsigned short)~sum;
+}
+
+/* Prints bytes per microsecond (MB/s) of 'count' calls over 'len' bytes.*/
+static void bench_report( const char *name, int len, unsigned long count, unsigned long start )
+{
+    unsigned long us = fnet_test_time_us() - start;
+
+    printf("  %-32s %5d %8lu\n", name, len, (unsigned long)((unsigned long long)count * (unsigned long)len / (us ? us : 1)));
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    static const int        lens[] = {64, 576, 1460};
+    volatile unsigned short result;
+    unsigned long           count, n, start;
+    int                     i, len;
+
+    for(i = 0; i < (int)sizeof(src); i++)
+        src[i] = (unsigned char)(i * 7);
+
+    printf("  %-32s %5s %8s\n", "", "bytes", "MB/s");
+
+    for(i = 0; i < (int)(sizeof(lens) / sizeof(lens[0])); i++)
+    {
+        len = lens[i];
+        count = BENCH_BYTES / (unsigned long)len;
+
+        start = fnet_test_time_us();
+        for(n = 0; n < count; n++)
+            result = bench_sum16((unsigned short *)src, len);
+        bench_report("16-bit sum (previous)", len, count, start);
+
+        start = fnet_test_time_us();
+        for(n = 0; n < count; n++)
+            result = fnet_checksum_buf((char *)src, len);
+        bench_report("fnet_checksum_buf", len, count, start);
+
+        start = fnet_test_time_us();
+        for(n = 0; n < count; n++)
+            result = fnet_checksum_buf((char *)src + 2, len);
+        bench_report("fnet_checksum_buf, 2-aligned", len, count, start);
+
+        start = fnet_test_time_us();
+        for(n = 0; n < count; n++)
+        {
+            fnet_memcpy(dst, src, (unsigned)len);
+            result = fnet_checksum_buf((char *)dst, len);
+        }
+        bench_report("fnet_memcpy + fnet_checksum_buf", len, count, start);
+
+        start = fnet_test_time_us();
+        for(n = 0; n < count; n++)
+            result = fnet_checksum_copy(dst, src, len);
+        bench_report("fnet_checksum_copy", len, count, start);
+    }
+    (void)result;
+
+    return 0;
+}
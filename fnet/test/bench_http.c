@@ -0,0 +1,289 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file bench_http.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief HTTP server requests per second.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include "fnet_test_link.h"
+#include <string.h>
+
+#include "fnet.h"
+#include "fnet_http.h"
+#include "fnet_http_prv.h"
+#include "fnet_poll.h"
+#include "fnet_fs.h"
+
+/* Requests per second of the HTTP server, over TCP sockets on the host
+ * link. The request is read with one recv() of all available data, or 
+ * with recv() capped to one byte as the server did before. Only the 
+ * server is timed, from accept() to closesocket(). The recv() of the 
+ * server is wrapped, -Wl,--wrap=recv.*/
+#define BENCH_REQUESTS      (2000)
+
+#define INDEX_FILE          ((FNET_FS_FILE)1)
+
+static unsigned char heap[64 * 1024];
+
+static char             index_html[512];
+static int              index_pos;
+
+static fnet_poll_service_t  service;
+static void                 *service_param;
+
+static int              in_service;     /* The server is running.*/
+static int              bytewise;       /* Cap the recv() of the server to one byte.*/
+static unsigned long    recv_calls;
+
+static unsigned short   client_port = 40000;
+
+int __real_recv( SOCKET s, char *buf, int len, int flags );
+
+int __wrap_recv( SOCKET s, char *buf, int len, int flags )
+{
+    if(in_service)
+    {
+        recv_calls++;
+        if(bytewise && (len > 1))
+            len = 1;
+    }
+    return __real_recv(s, buf, len, flags);
+}
+
+/************************************************************************
+* File system, the index file only.
+*************************************************************************/
+FNET_FS_DIR fnet_fs_opendir( const char *dirname )
+{
+    return (FNET_FS_DIR)1;
+}
+
+int fnet_fs_closedir( FNET_FS_DIR dir )
+{
+    return FNET_OK;
+}
+
+FNET_FS_FILE fnet_fs_fopen_re( const char *filename, const char *mode, FNET_FS_FILE dir )
+{
+    return fnet_strcmp(filename, "index.html") ? 0 : INDEX_FILE;
+}
+
+int fnet_fs_fclose( FNET_FS_FILE file )
+{
+    return FNET_OK;
+}
+
+void fnet_fs_rewind( FNET_FS_FILE file )
+{
+    index_pos = 0;
+}
+
+unsigned long fnet_fs_fread( void *buf, unsigned long size, FNET_FS_FILE file )
+{
+    unsigned long n = sizeof(index_html) - (unsigned long)index_pos;
+
+    if(n > size)
+        n = size;
+    memcpy(buf, index_html + index_pos, n);
+    index_pos += (int)n;
+
+    return n;
+}
+
+int fnet_fs_finfo( FNET_FS_FILE file, struct fnet_fs_dirent *dirent )
+{
+    fnet_memset_zero(dirent, sizeof(*dirent));
+    dirent->d_size = sizeof(index_html);
+    return FNET_OK;
+}
+
+/************************************************************************
+* Polling, the service is run by the bench.
+*************************************************************************/
+fnet_poll_desc_t fnet_poll_service_register( fnet_poll_service_t service_fn, void *param )
+{
+    service = service_fn;
+    service_param = param;
+    return 0;
+}
+
+int fnet_poll_service_unregister( fnet_poll_desc_t desc )
+{
+    service = 0;
+    return FNET_OK;
+}
+
+int fnet_poll_service_wait_socket( fnet_poll_desc_t desc, SOCKET s, int events )
+{
+    return FNET_OK;
+}
+
+/************************************************************************
+* NAME: bench_request
+*
+* DESCRIPTION: Sends one request from a new client connection and 
+*              returns the time the server takes for it, in us.
+*************************************************************************/
+static unsigned long bench_request( struct fnet_http_if *http, const char *request, int len )
+{
+    static char         response[2048];
+    SOCKET              client;
+    struct sockaddr_in  addr;
+    struct linger       abort_option = {1, 0};
+    unsigned long       start, us;
+    int                 n, received = 0, i;
+
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    FNET_TEST_CHECK(client != SOCKET_INVALID);
+
+    fnet_memset_zero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = fnet_htons(client_port++);
+    addr.sin_addr.s_addr = FNET_TEST_LINK_CLIENT_IP;
+    FNET_TEST_CHECK(bind(client, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+
+    addr.sin_port = FNET_HTONS(FNET_TEST_LINK_SERVER_PORT);
+    addr.sin_addr.s_addr = FNET_TEST_LINK_SERVER_IP;
+    FNET_TEST_CHECK(connect(client, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+
+    /* The handshake, then the request in one segment.*/
+    fnet_test_link_run(2 * fnet_test_link_delay + 1);
+    FNET_TEST_CHECK(send(client, (char *)request, len, 0) == len);
+    fnet_test_link_run(fnet_test_link_delay + 1);
+
+    in_service = 1;
+    start = fnet_test_time_us();
+    service(service_param);
+    FNET_TEST_CHECK(http->state != FNET_HTTP_STATE_LISTENING);
+    for(i = 0; (i < 1000) && (http->state != FNET_HTTP_STATE_LISTENING); i++)
+        service(service_param);
+    us = fnet_test_time_us() - start;
+    in_service = 0;
+    FNET_TEST_CHECK(http->state == FNET_HTTP_STATE_LISTENING);
+
+    /* The response, then an abortive close.*/
+    for(i = 0; (received < (int)sizeof(index_html)) 
+                || memcmp(response + received - sizeof(index_html), index_html, sizeof(index_html)); i++)
+    {
+        FNET_TEST_CHECK(i < 10000);
+        fnet_test_link_step();
+        while((n = recv(client, response + received, (int)sizeof(response) - received, 0)) > 0)
+            received += n;
+    }
+    FNET_TEST_CHECK(fnet_strncmp(response, "HTTP/1.0 200 OK\r\n", 17) == 0);
+
+    FNET_TEST_CHECK(setsockopt(client, SOL_SOCKET, SO_LINGER, (char *)&abort_option, sizeof(abort_option)) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(client) == FNET_OK);
+    fnet_test_link_run(fnet_test_link_delay + 1);
+
+    return us;
+}
+
+/************************************************************************
+* NAME: bench_run
+*
+* DESCRIPTION: Prints the requests per second and the recv() calls per
+*              request of the server, for both readers.
+*************************************************************************/
+static void bench_run( const char *name, struct fnet_http_if *http, const char *request )
+{
+    unsigned long   us[2], calls[2];
+    unsigned long   free_mem = fnet_free_mem_status();
+    int             len = (int)fnet_strlen(request);
+    int             i;
+
+    for(bytewise = 0; bytewise < 2; bytewise++)
+    {
+        us[bytewise] = 0;
+        recv_calls = 0;
+        for(i = 0; i < BENCH_REQUESTS; i++)
+            us[bytewise] += bench_request(http, request, len);
+        calls[bytewise] = recv_calls / BENCH_REQUESTS;
+        if(us[bytewise] == 0)
+            us[bytewise] = 1;
+    }
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+
+    printf("  %-12s %6d %10lu %10lu %10lu %10lu\n", name, len, 
+           (unsigned long)((unsigned long long)BENCH_REQUESTS * 1000000 / us[0]), calls[0],
+           (unsigned long)((unsigned long long)BENCH_REQUESTS * 1000000 / us[1]), calls[1]);
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    static const char short_request[] = "GET / HTTP/1.0\r\n\r\n";
+    static const char browser_request[] = 
+        "GET / HTTP/1.1\r\n"
+        "Host: 10.0.0.1\r\n"
+        "Connection: keep-alive\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "\r\n";
+    struct fnet_http_params params;
+    struct fnet_http_if     *http;
+    int                     i;
+
+    for(i = 0; i < (int)sizeof(index_html); i++)
+        index_html[i] = (char)('a' + i % 26);
+
+    fnet_test_link_init(heap, sizeof(heap));
+
+    fnet_memset_zero(&params, sizeof(params));
+    params.root_path = "/";
+    params.index_path = "index.html";
+    params.address.sa_family = AF_INET;
+    http = (struct fnet_http_if *)fnet_http_init(&params);
+    FNET_TEST_CHECK(http != (struct fnet_http_if *)FNET_ERR);
+    FNET_TEST_CHECK(service != 0);
+
+    printf("  %d requests, %d byte response\n", BENCH_REQUESTS, (int)sizeof(index_html));
+    printf("  %-12s %6s %10s %10s %10s %10s\n", "request", "bytes", "chunked/s", "recv", "1 byte/s", "recv");
+
+    bench_run("short", http, short_request);
+    bench_run("browser", http, browser_request);
+
+    return 0;
+}
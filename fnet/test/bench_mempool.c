@@ -0,0 +1,384 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file bench_mempool.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Memory pool benchmark.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+#include <time.h>
+
+#include "fnet.h"
+#include "fnet_mempool.h"
+#include "fnet_netbuf.h"
+
+/* The same traces are replayed on the allocator chosen by
+ * FNET_CFG_MEMPOOL_TLSF, so the two builds can be compared.
+ * The heap size is the first argument, FNET_CFG_HEAP_SIZE by default.*/
+#define BENCH_HEAP_MAX      (64 * 1024)
+#define BENCH_SLOTS         (256)
+#define BENCH_OPS           (20000)
+#define BENCH_REPEAT        (20)
+#define BENCH_FRAG_PERIOD   (64)
+
+typedef struct
+{
+    unsigned short slot;
+    unsigned short size;    /* 0 = free the block in the slot.*/
+} bench_op_t;
+
+typedef struct
+{
+    const char      *name;
+    void            (*generate)( void );
+} bench_trace_t;
+
+static unsigned char heap[BENCH_HEAP_MAX] __attribute__((aligned(8)));
+static unsigned long heap_size = FNET_CFG_HEAP_SIZE;
+static void *block[BENCH_SLOTS];
+
+static bench_op_t ops[BENCH_OPS];
+static int ops_n;
+
+/* Live blocks of the trace being generated.*/
+static unsigned short live_size[BENCH_SLOTS];
+static unsigned long live_bytes;
+static unsigned short fifo[BENCH_SLOTS];
+static int fifo_head, fifo_n;
+
+static unsigned long seed;
+static unsigned long clock_overhead;
+
+static unsigned long bench_rand( void )
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 16) & 0x7FFF;
+}
+
+static unsigned long bench_range( unsigned long min, unsigned long max )
+{
+    return min + bench_rand() % (max - min + 1);
+}
+
+static unsigned long bench_time_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long)ts.tv_sec * 1000000000UL + (unsigned long)ts.tv_nsec;
+}
+
+/************************************************************************
+* Trace generation. The traces stay within 3/5 of the heap,
+* so that failed allocations come from fragmentation.
+*************************************************************************/
+static void trace_reset( void )
+{
+    memset(live_size, 0, sizeof(live_size));
+    live_bytes = 0;
+    fifo_head = fifo_n = 0;
+    ops_n = 0;
+    seed = 1;
+}
+
+static void trace_free( int slot )
+{
+    ops[ops_n].slot = (unsigned short)slot;
+    ops[ops_n].size = 0;
+    ops_n++;
+    live_bytes -= live_size[slot];
+    live_size[slot] = 0;
+}
+
+static void trace_fifo_free( void )
+{
+    trace_free(fifo[fifo_head]);
+    fifo_head = (fifo_head + 1) % BENCH_SLOTS;
+    fifo_n--;
+}
+
+/* Returns the slot, or -1 if the trace is full.*/
+static int trace_alloc( unsigned long size, int queued )
+{
+    int slot;
+
+    if(ops_n >= BENCH_OPS)
+        return -1;
+
+    for(slot = 0; (slot < BENCH_SLOTS) && live_size[slot]; slot++)
+    {}
+    while((slot == BENCH_SLOTS) || (live_bytes + size > heap_size * 3 / 5))
+    {
+        if(fifo_n == 0)
+            return -1;
+        slot = fifo[fifo_head];
+        trace_fifo_free();
+        if(ops_n >= BENCH_OPS)
+            return -1;
+    }
+
+    ops[ops_n].slot = (unsigned short)slot;
+    ops[ops_n].size = (unsigned short)size;
+    ops_n++;
+    live_size[slot] = (unsigned short)size;
+    live_bytes += size;
+
+    if(queued)
+    {
+        fifo[(fifo_head + fifo_n) % BENCH_SLOTS] = (unsigned short)slot;
+        fifo_n++;
+    }
+    return slot;
+}
+
+/* Queued packets: a net_buf header and a data buffer for each, 
+ * half ACK-sized and half full-sized, released oldest first.*/
+static void trace_packet( void )
+{
+    unsigned long window = bench_range(2, 24);
+
+    while(fifo_n > window)
+        trace_fifo_free();
+
+    if(trace_alloc(sizeof(fnet_netbuf_t), 1) >= 0)
+        trace_alloc((bench_rand() & 1) ? bench_range(60, 128) : bench_range(1460, 1514), 1);
+}
+
+static void trace_packets( void )
+{
+    while(ops_n < BENCH_OPS)
+        trace_packet();
+}
+
+/* Packet traffic with long-lived blocks (sockets, buffers, service
+ * state) allocated and released in between.*/
+static void trace_long_lived( void )
+{
+    int             held[6];
+    int             held_n = 0;
+    int             slot;
+
+    while(ops_n < BENCH_OPS)
+    {
+        trace_packet();
+
+        if((bench_rand() % 64) == 0)
+        {
+            if(held_n == (int)(sizeof(held) / sizeof(held[0])))
+            {
+                slot = (int)(bench_rand() % held_n);
+                trace_free(held[slot]);
+                held[slot] = held[--held_n];
+            }
+            else if((slot = trace_alloc(bench_range(32, 512), 0)) >= 0)
+            {
+                held[held_n++] = slot;
+            }
+        }
+    }
+}
+
+/* Random sizes and lifetimes.*/
+static void trace_random( void )
+{
+    int slot;
+
+    while(ops_n < BENCH_OPS)
+    {
+        slot = (int)(bench_rand() % BENCH_SLOTS);
+
+        if(live_size[slot])
+            trace_free(slot);
+        else if((bench_rand() & 3) == 0)
+            trace_alloc(bench_range(1, 1600), 0);
+        else
+            trace_alloc(bench_range(1, 100), 0);
+    }
+}
+
+static const bench_trace_t traces[] =
+{
+    {"packets", trace_packets},
+    {"packets+long-lived", trace_long_lived},
+    {"random", trace_random}
+};
+
+/************************************************************************
+* Trace replay.
+*************************************************************************/
+typedef struct
+{
+    unsigned long malloc_ns, malloc_max, malloc_n;
+    unsigned long free_ns, free_max, free_n;
+    unsigned long failed;
+    unsigned long frag_sum, frag_max, frag_n;
+} bench_result_t;
+
+/* Fastest time of each operation over the repetitions, 
+ * which leaves out host interrupts and preemption.*/
+static unsigned long op_ns[BENCH_OPS];
+
+static void bench_replay( bench_result_t *res )
+{
+    fnet_mempool_desc_t mp;
+    unsigned long       start, t, max_block, mem_free;
+    int                 i;
+
+    mp = fnet_mempool_init(heap, heap_size, FNET_MEMPOOL_ALIGN_8);
+    FNET_TEST_CHECK(mp != 0);
+    memset(block, 0, sizeof(block));
+
+    for(i = 0; i < ops_n; i++)
+    {
+        /* Nothing to free after a failed allocation.*/
+        if((ops[i].size == 0) && (block[ops[i].slot] == 0))
+            continue;
+
+        start = bench_time_ns();
+        if(ops[i].size)
+            block[ops[i].slot] = fnet_mempool_malloc(mp, ops[i].size);
+        else
+            fnet_mempool_free(mp, block[ops[i].slot]);
+        t = bench_time_ns() - start;
+
+        t = (t > clock_overhead) ? (t - clock_overhead) : 0;
+        if(t < op_ns[i])
+            op_ns[i] = t;
+
+        if(ops[i].size == 0)
+        {
+            block[ops[i].slot] = 0;
+        }
+        else if(res && (block[ops[i].slot] == 0))
+        {
+            res->failed++;
+        }
+
+        /* Share of the free memory that the largest allocation cannot use.*/
+        if(res && ((i % BENCH_FRAG_PERIOD) == 0))
+        {
+            max_block = fnet_mempool_malloc_max(mp);
+            mem_free = fnet_mempool_free_mem_status(mp);
+            t = mem_free ? (100 - max_block * 100 / mem_free) : 0;
+
+            res->frag_sum += t;
+            res->frag_n++;
+            if(t > res->frag_max)
+                res->frag_max = t;
+        }
+    }
+    fnet_mempool_release(mp);
+}
+
+static void bench_trace( const bench_trace_t *trace )
+{
+    bench_result_t  res;
+    int             i;
+
+    trace_reset();
+    trace->generate();
+
+    memset(&res, 0, sizeof(res));
+    memset(op_ns, 0xFF, sizeof(op_ns));
+
+    bench_replay(&res);
+    for(i = 1; i < BENCH_REPEAT; i++)
+        bench_replay(0);
+
+    for(i = 0; i < ops_n; i++)
+    {
+        if(op_ns[i] == ~0UL)
+            continue;
+
+        if(ops[i].size)
+        {
+            res.malloc_ns += op_ns[i];
+            res.malloc_n++;
+            if(op_ns[i] > res.malloc_max)
+                res.malloc_max = op_ns[i];
+        }
+        else
+        {
+            res.free_ns += op_ns[i];
+            res.free_n++;
+            if(op_ns[i] > res.free_max)
+                res.free_max = op_ns[i];
+        }
+    }
+
+    printf("  %-20s %6d %6lu %6lu %6lu %6lu %6lu %5lu %5lu\n", trace->name, ops_n,
+           res.malloc_ns / (res.malloc_n ? res.malloc_n : 1), res.malloc_max,
+           res.free_ns / (res.free_n ? res.free_n : 1), res.free_max,
+           res.failed, res.frag_sum / (res.frag_n ? res.frag_n : 1), res.frag_max);
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( int argc, char **argv )
+{
+    unsigned long   start, t;
+    int             i;
+
+    if(argc > 1)
+        heap_size = (unsigned long)atoi(argv[1]);
+    FNET_TEST_CHECK((heap_size > 0) && (heap_size <= sizeof(heap)));
+
+    /* Cost of reading the clock, taken off every measurement.*/
+    clock_overhead = ~0UL;
+    for(i = 0; i < 1000; i++)
+    {
+        start = bench_time_ns();
+        t = bench_time_ns() - start;
+        if(t < clock_overhead)
+            clock_overhead = t;
+    }
+
+    printf("  %s allocator, %lu byte heap\n", FNET_CFG_MEMPOOL_TLSF ? "TLSF" : "free-list", heap_size);
+    printf("  %-20s %6s %13s %13s %6s %11s\n", "", "", "malloc ns", "free ns", "", "frag %");
+    printf("  %-20s %6s %6s %6s %6s %6s %6s %5s %5s\n", "trace", "ops", "avg", "max", "avg", "max", "failed", "avg", "max");
+
+    for(i = 0; i < (int)(sizeof(traces) / sizeof(traces[0])); i++)
+        bench_trace(&traces[i]);
+
+    return 0;
+}
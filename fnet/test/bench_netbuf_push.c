@@ -0,0 +1,441 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file bench_netbuf_push.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Net_buf allocations per transmitted packet.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+
+#include "fnet.h"
+#include "fnet_socket_prv.h"
+#include "fnet_prot.h"
+#include "fnet_ip_prv.h"
+#include "fnet_ip6_prv.h"
+#include "fnet_netif_prv.h"
+#include "fnet_eth_prv.h"
+#include "fnet_nd6.h"
+#include "fnet_icmp.h"
+#include "fnet_icmp6.h"
+#include "fnet_timer_prv.h"
+#include "fnet_mempool.h"
+#include "fnet_tcp.h"
+#include "fnet_udp.h"
+
+/* fnet_malloc_netbuf() calls made to send a packet, through the socket,
+ * the transport and the IP layer, and the number of net_bufs in the 
+ * packet handed to the interface. The LPC17xx driver sends the Ethernet
+ * header from its own buffer when there is no headroom, so the link 
+ * layer allocates nothing. The net_buf pools are disabled, so that 
+ * every allocation reaches fnet_mempool_malloc(), which is wrapped.
+ * The counts include the copy of the user data: the socket buffer 
+ * (TCP) or the datagram (UDP).
+ * The second table builds the headers of a packet both ways: one 
+ * fnet_netbuf_new() per header joined by fnet_netbuf_concat(), as the
+ * stack did before fnet_netbuf_push(), and fnet_netbuf_push(). The
+ * difference is what a packet of the first table cost before.*/
+#define BENCH_IP            FNET_IP4_ADDR_INIT(10, 0, 0, 1)
+#define BENCH_PORT          (80)
+#define BENCH_BUF_SIZE      (16 * 1024)
+#define BENCH_REPEAT        (16)
+#define BENCH_MTU           (1500)
+#define BENCH_SEGMENT       (BENCH_MTU - 80)    /* fnet_ip_maximum_packet() leaves room for IP options.*/
+
+static unsigned char heap[256 * 1024];
+static char data[4 * BENCH_SEGMENT];
+
+static fnet_netif_api_t netif_api;
+static fnet_netif_t     netif;
+
+static void (*ip_event)( void );
+static int ip_event_pending;
+static unsigned long now_ms;
+
+/* Counted while 'counting' is set.*/
+static int counting;
+static unsigned long allocs;    /* fnet_malloc_netbuf() calls.*/
+static unsigned long packets;   /* Packets sent.*/
+static unsigned long bufs;      /* Net_bufs in the sent packets.*/
+
+extern int fnet_enabled;
+
+/************************************************************************
+* Allocation counter.
+*************************************************************************/
+void *__real_fnet_mempool_malloc( fnet_mempool_desc_t mpool, unsigned nbytes );
+
+void *__wrap_fnet_mempool_malloc( fnet_mempool_desc_t mpool, unsigned nbytes )
+{
+    if(counting)
+        allocs++;
+
+    return __real_fnet_mempool_malloc(mpool, nbytes);
+}
+
+/************************************************************************
+* Network interface, sends the packets back to the IP layer.
+*************************************************************************/
+static void bench_output_ip4( fnet_netif_t *netif_ptr, fnet_ip4_addr_t dest_ip_addr, fnet_netbuf_t *nb )
+{
+    fnet_netbuf_t *tmp;
+
+    if(counting)
+    {
+        packets++;
+        for(tmp = nb; tmp; tmp = tmp->next)
+            bufs++;
+    }
+
+    fnet_ip_input(netif_ptr, nb);
+}
+
+int fnet_event_init( fnet_event_t event_number, void (*event_handler)( void ) )
+{
+    FNET_TEST_CHECK(event_number == FNET_EVENT_IP);
+    ip_event = event_handler;
+    return FNET_OK;
+}
+
+void fnet_event_raise( fnet_event_t event_number )
+{
+    ip_event_pending = 1;
+}
+
+fnet_prot_if_t *fnet_prot_find( fnet_address_family_t family, fnet_socket_type_t type, int protocol )
+{
+    if((type == SOCK_STREAM) || ((type == SOCK_UNSPEC) && (protocol == FNET_IP_PROTOCOL_TCP)))
+        return &fnet_tcp_prot_if;
+    if((type == SOCK_DGRAM) || ((type == SOCK_UNSPEC) && (protocol == FNET_IP_PROTOCOL_UDP)))
+        return &fnet_udp_prot_if;
+    return 0;
+}
+
+void fnet_icmp_error( fnet_netif_t *netif_ptr, unsigned char type, unsigned char code, fnet_netbuf_t *nb )
+{
+    fnet_netbuf_free_chain(nb);
+}
+
+/************************************************************************
+* Ethernet and IPv6, not used.
+*************************************************************************/
+fnet_netif_t fnet_eth0_if;
+const fnet_ip6_addr_t fnet_ip6_addr_any;
+
+int fnet_eth_init( fnet_netif_t *netif_ptr )
+{
+    return FNET_ERR;
+}
+
+void fnet_ip6_get_solicited_multicast_addr( fnet_ip6_addr_t *ip_addr, fnet_ip6_addr_t *solicited_multicast_addr )
+{
+}
+
+void fnet_nd6_dad_start( struct fnet_netif *netif_ptr, struct fnet_netif_ip6_addr *addr_info )
+{
+}
+
+const fnet_ip6_addr_t *fnet_ip6_select_src_addr( fnet_netif_t *netif_ptr, fnet_ip6_addr_t *dest_addr )
+{
+    return 0;
+}
+
+int fnet_ip6_output( fnet_netif_t *netif_ptr, fnet_ip6_addr_t *src_ip, fnet_ip6_addr_t *dest_ip, unsigned char protocol, 
+                     unsigned char hop_limit, fnet_netbuf_t *nb, FNET_COMP_PACKED_VAR unsigned short *checksum )
+{
+    fnet_netbuf_free_chain(nb);
+    return FNET_ERR;
+}
+
+void fnet_icmp6_error( fnet_netif_t *netif_ptr, unsigned char type, unsigned char code, unsigned long param, fnet_netbuf_t *origin_nb )
+{
+    fnet_netbuf_free_chain(origin_nb);
+}
+
+/************************************************************************
+* Hardware timer, in virtual time.
+*************************************************************************/
+int fnet_cpu_timer_init( unsigned int period_ms )
+{
+    return FNET_OK;
+}
+
+void fnet_cpu_timer_release( void )
+{
+}
+
+unsigned long fnet_cpu_timer_us( void )
+{
+    return now_ms * 1000;
+}
+
+/************************************************************************
+* NAME: bench_run
+*
+* DESCRIPTION: Advances the time by 'ms', handling the received packets
+*              and running the timers.
+*************************************************************************/
+static void bench_run( unsigned long ms )
+{
+    do
+    {
+        while(ip_event_pending)
+        {
+            ip_event_pending = 0;
+            ip_event();
+        }
+
+        now_ms++;
+        if((now_ms % FNET_TIMER_PERIOD_MS) == 0)
+        {
+            fnet_timer_ticks_inc();
+            fnet_timer_handler_bottom();
+        }
+    } while(ms--);
+}
+
+static void bench_receive( SOCKET sock, int length )
+{
+    int received = 0, result;
+
+    while(received < length)
+    {
+        bench_run(10);
+        FNET_TEST_CHECK((result = recv(sock, data, sizeof(data), 0)) >= 0);
+        received += result;
+    }
+    FNET_TEST_CHECK(received == length);
+    bench_run(1000);                        /* Acknowledged.*/
+}
+
+static void bench_start( void )
+{
+    allocs = packets = bufs = 0;
+    counting = 1;
+}
+
+static void bench_print( const char *name )
+{
+    counting = 0;
+    FNET_TEST_CHECK(packets != 0);
+    printf("  %-20s %10lu %10lu.%02lu %10lu.%02lu\n", name, packets,
+           allocs / packets, (allocs * 100 / packets) % 100,
+           bufs / packets, (bufs * 100 / packets) % 100);
+}
+
+/************************************************************************
+* NAME: bench_tcp
+*
+* DESCRIPTION: Sends 'length' bytes BENCH_REPEAT times over 
+*              a connection, each once the previous one is acknowledged.
+*************************************************************************/
+static void bench_tcp( SOCKET client, SOCKET server, int length, const char *name )
+{
+    int i;
+
+    bench_start();
+    for(i = 0; i < BENCH_REPEAT; i++)
+    {
+        counting = 1;
+        FNET_TEST_CHECK(send(client, data, length, 0) == length);
+        counting = 0;
+        bench_receive(server, length);
+    }
+    bench_print(name);
+}
+
+/************************************************************************
+* NAME: bench_udp
+*
+* DESCRIPTION: Sends BENCH_REPEAT datagrams of 'length' bytes.
+*************************************************************************/
+static void bench_udp( SOCKET sock, int length, const char *name )
+{
+    int i;
+
+    bench_start();
+    for(i = 0; i < BENCH_REPEAT; i++)
+    {
+        counting = 1;
+        FNET_TEST_CHECK(send(sock, data, length, 0) == length);
+        counting = 0;
+        bench_run(10);
+        FNET_TEST_CHECK(recv(sock, data, sizeof(data), 0) == length);
+    }
+    bench_print(name);
+}
+
+/************************************************************************
+* NAME: bench_headers
+*
+* DESCRIPTION: Prepends the transport header, with 'optlen' option bytes,
+*              and the IP header to 'length' bytes of data, as before 
+*              or with fnet_netbuf_push(). Returns the allocations.
+*************************************************************************/
+static unsigned long bench_headers( int push, int header_length, int optlen, int length, int shared )
+{
+    fnet_netbuf_t   *nb, *copy, *header;
+
+    nb = fnet_netbuf_new_headroom(shared ? 0 : FNET_CFG_NETBUF_HEADROOM + header_length, length, FNET_FALSE);
+    FNET_TEST_CHECK(nb != 0);
+    if(shared)
+    {
+        /* A TCP segment refers to the data in the socket buffer.*/
+        copy = fnet_netbuf_copy(nb, 0, FNET_NETBUF_COPYALL, FNET_FALSE);
+        FNET_TEST_CHECK(copy != 0);
+        fnet_netbuf_free_chain(nb);
+        nb = copy;
+    }
+
+    allocs = 0;
+    counting = 1;
+    if(push)
+    {
+        nb = fnet_netbuf_push(nb, header_length + optlen, FNET_FALSE);
+        FNET_TEST_CHECK(nb != 0);
+        nb = fnet_netbuf_push(nb, sizeof(fnet_ip_header_t), FNET_FALSE);
+        FNET_TEST_CHECK(nb != 0);
+    }
+    else
+    {
+        header = fnet_netbuf_new(header_length, FNET_FALSE);
+        FNET_TEST_CHECK(header != 0);
+        if(optlen)
+        {
+            /* fnet_tcp_addopt() */
+            header = fnet_netbuf_concat(header, fnet_netbuf_new(FNET_TCP_SIZE_OPTIONS, FNET_FALSE));
+            fnet_netbuf_trim(&header, optlen - FNET_TCP_SIZE_OPTIONS);
+        }
+        nb = fnet_netbuf_concat(header, nb);
+        header = fnet_netbuf_new(sizeof(fnet_ip_header_t), FNET_FALSE);
+        FNET_TEST_CHECK(header != 0);
+        nb = fnet_netbuf_concat(header, nb);
+    }
+    counting = 0;
+
+    FNET_TEST_CHECK(nb->total_length == (unsigned long)(sizeof(fnet_ip_header_t) + header_length + optlen + length));
+    fnet_netbuf_free_chain(nb);
+
+    return allocs;
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    SOCKET              listener, client, server, udp;
+    struct sockaddr_in  addr;
+    int                 bufsize = BENCH_BUF_SIZE;
+    int                 i;
+
+    FNET_TEST_CHECK(fnet_heap_init(heap, sizeof(heap)) == FNET_OK);
+    FNET_TEST_CHECK(fnet_timer_init(FNET_TIMER_PERIOD_MS) == FNET_OK);
+    fnet_socket_init();
+    FNET_TEST_CHECK(fnet_ip_init() == FNET_OK);
+    FNET_TEST_CHECK(fnet_tcp_prot_if.prot_init() == FNET_OK);
+    fnet_enabled = 1;
+
+    netif_api.type = FNET_NETIF_TYPE_ETHERNET;
+    netif_api.output_ip4 = bench_output_ip4;
+    netif.api = &netif_api;
+    netif.mtu = BENCH_MTU;
+    netif.ip4_addr.address = BENCH_IP;
+    netif.ip4_addr.subnetmask = FNET_IP4_ADDR_INIT(255, 255, 255, 0);
+    FNET_TEST_CHECK(fnet_netif_init(&netif) == FNET_OK);
+    fnet_netif_set_default(&netif);
+
+    for(i = 0; i < (int)sizeof(data); i++)
+        data[i] = (char)i;
+
+    /* TCP connection.*/
+    fnet_memset_zero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = FNET_HTONS(BENCH_PORT);
+    addr.sin_addr.s_addr = BENCH_IP;
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    FNET_TEST_CHECK(listener != SOCKET_INVALID);
+    FNET_TEST_CHECK(setsockopt(listener, SOL_SOCKET, SO_RCVBUF, (char *)&bufsize, sizeof(bufsize)) == FNET_OK);
+    FNET_TEST_CHECK(bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+    FNET_TEST_CHECK(listen(listener, 1) == FNET_OK);
+
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    FNET_TEST_CHECK(client != SOCKET_INVALID);
+    FNET_TEST_CHECK(setsockopt(client, SOL_SOCKET, SO_SNDBUF, (char *)&bufsize, sizeof(bufsize)) == FNET_OK);
+    FNET_TEST_CHECK(connect(client, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+    for(i = 0; (server = accept(listener, 0, 0)) == SOCKET_INVALID; i++)
+    {
+        FNET_TEST_CHECK(i < 1000);
+        bench_run(10);
+    }
+
+    /* Opens the congestion window.*/
+    for(i = 0; i < 32; i++)
+    {
+        FNET_TEST_CHECK(send(client, data, sizeof(data), 0) == (int)sizeof(data));
+        bench_receive(server, sizeof(data));
+    }
+
+    /* UDP socket, sending to itself.*/
+    udp = socket(AF_INET, SOCK_DGRAM, 0);
+    FNET_TEST_CHECK(udp != SOCKET_INVALID);
+    addr.sin_port = FNET_HTONS(BENCH_PORT + 1);
+    FNET_TEST_CHECK(bind(udp, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+    FNET_TEST_CHECK(connect(udp, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+
+    printf("  per packet, through the stack\n");
+    printf("  %-20s %10s %13s %13s\n", "send", "packets", "allocs", "net_bufs");
+    bench_tcp(client, server, 100, "TCP 100");
+    bench_tcp(client, server, BENCH_SEGMENT, "TCP 1 segment");
+    bench_tcp(client, server, 3 * BENCH_SEGMENT, "TCP 3 segments");
+    bench_udp(udp, 100, "UDP 100");
+    bench_udp(udp, BENCH_MTU - 28, "UDP 1472");
+
+    printf("  allocs for the headers of a packet\n");
+    printf("  %-20s %10s %10s\n", "headers", "new+concat", "push");
+    printf("  %-20s %10lu %10lu\n", "TCP", bench_headers(0, 20, 0, BENCH_SEGMENT, 1), bench_headers(1, 20, 0, BENCH_SEGMENT, 1));
+    printf("  %-20s %10lu %10lu\n", "TCP, 12 option bytes", bench_headers(0, 20, 12, BENCH_SEGMENT, 1), bench_headers(1, 20, 12, BENCH_SEGMENT, 1));
+    printf("  %-20s %10lu %10lu\n", "UDP", bench_headers(0, 8, 0, BENCH_SEGMENT, 0), bench_headers(1, 8, 0, BENCH_SEGMENT, 0));
+
+    FNET_TEST_CHECK(closesocket(udp) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(listener) == FNET_OK);
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file bench_tcp_append.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief TCP receive queue append benchmark.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include "fnet_test_link.h"
+
+#include "fnet_tcp.h"
+#include "fnet_checksum.h"
+
+/* Cost of queueing a small segment against the number of segments 
+ * already queued, in the receive buffer and in the out-of-order queue
+ * behind a hole. Appends keep a tail pointer, so the cost should not 
+ * grow with the queue. The first table is the same comparison at the
+ * net_buf level, against fnet_netbuf_concat(), which walks the chain.
+ * With SACK, each segment behind the hole is acknowledged at once with
+ * SACK blocks, which are built from the whole queue. Build with 
+ * FNET_CFG_TCP_SACK 0 to see the append alone.*/
+#define BENCH_LENGTH        (8)
+#define BENCH_MAX           (1024)
+#define BENCH_BUF_SIZE      (48 * 1024)
+#define BENCH_REPEAT        (10000)
+
+static unsigned char heap[256 * 1024];
+static fnet_netbuf_t *segments[BENCH_MAX + 1];
+
+/* Nothing goes back to the client, the ACKs would only fill the link.*/
+static int bench_loss( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    return 1;
+}
+
+/************************************************************************
+* NAME: bench_segment
+*
+* DESCRIPTION: Builds a segment from the client to 'sk' carrying
+*              BENCH_LENGTH bytes at 'seq'.
+*************************************************************************/
+static fnet_netbuf_t *bench_segment( fnet_socket_t *sk, unsigned long seq )
+{
+    fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control;
+    fnet_netbuf_t       *nb;
+    unsigned char       *header;
+    unsigned short      checksum;
+    fnet_ip4_addr_t     src_ip = FNET_TEST_LINK_CLIENT_IP;
+    fnet_ip4_addr_t     dest_ip = FNET_TEST_LINK_SERVER_IP;
+
+    nb = fnet_netbuf_new(20 + BENCH_LENGTH, FNET_FALSE);
+    FNET_TEST_CHECK(nb != 0);
+    header = (unsigned char *)nb->data_ptr;
+    fnet_memset_zero(header, 20);
+    fnet_memset(header + 20, (unsigned char)seq, BENCH_LENGTH);
+
+    *(unsigned short *)(header + 0) = sk->foreign_addr.sa_port;
+    *(unsigned short *)(header + 2) = sk->local_addr.sa_port;
+    *(unsigned long *)(header + 4) = fnet_htonl(seq);
+    *(unsigned long *)(header + 8) = fnet_htonl(cb->tcpcb_sndseq);
+    header[12] = 5 << 4;
+    header[13] = FNET_TCP_SGT_ACK;
+    *(unsigned short *)(header + 14) = FNET_HTONS(8192);
+
+    checksum = fnet_checksum_pseudo_start(nb, FNET_HTONS((unsigned short)FNET_IP_PROTOCOL_TCP), (unsigned short)nb->total_length);
+    checksum = fnet_checksum_pseudo_end(checksum, (char *)&src_ip, (char *)&dest_ip, sizeof(fnet_ip4_addr_t));
+    *(unsigned short *)(header + 16) = checksum;
+
+    return nb;
+}
+
+/* Returns ns per segment, for 'n' segments in order or behind a hole 
+ * of one segment. The queues are checked afterwards.*/
+static unsigned long bench_input( int n, int hole )
+{
+    SOCKET              client, server;
+    fnet_socket_t       *sk;
+    fnet_tcp_control_t  *cb;
+    unsigned long       start, ns;
+    unsigned long       seq;
+    int                 i;
+    struct linger       linger = {1, 0};
+
+    fnet_test_link_connect(&client, &server, BENCH_BUF_SIZE);
+    sk = fnet_test_link_socket(server);
+    cb = (fnet_tcp_control_t *)sk->protocol_control;
+    fnet_test_link_loss = bench_loss;
+
+    seq = cb->tcpcb_sndack;
+    for(i = 0; i <= n; i++)
+        segments[i] = bench_segment(sk, seq + (unsigned long)(i * BENCH_LENGTH));
+
+    start = fnet_test_time_us();
+    for(i = hole; i < n + hole; i++)
+        fnet_test_link_input(FNET_TEST_LINK_CLIENT_IP, FNET_TEST_LINK_SERVER_IP, segments[i]);
+    ns = (fnet_test_time_us() - start) * 1000 / (unsigned long)n;
+
+    if(hole)
+    {
+        FNET_TEST_CHECK(sk->receive_buffer.count == 0);
+        FNET_TEST_CHECK(cb->tcpcb_count == (unsigned long)(n * (20 + BENCH_LENGTH)));
+        fnet_test_link_input(FNET_TEST_LINK_CLIENT_IP, FNET_TEST_LINK_SERVER_IP, segments[0]);
+        FNET_TEST_CHECK(cb->tcpcb_count == 0);
+        FNET_TEST_CHECK(sk->receive_buffer.count == (unsigned long)((n + 1) * BENCH_LENGTH));
+    }
+    else
+    {
+        fnet_netbuf_free_chain(segments[n]);
+        FNET_TEST_CHECK(sk->receive_buffer.count == (unsigned long)(n * BENCH_LENGTH));
+    }
+
+    fnet_test_link_loss = 0;
+    FNET_TEST_CHECK(setsockopt(client, SOL_SOCKET, SO_LINGER, (char *)&linger, sizeof(linger)) == FNET_OK);
+    FNET_TEST_CHECK(setsockopt(server, SOL_SOCKET, SO_LINGER, (char *)&linger, sizeof(linger)) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(client) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+    fnet_test_link_run(1000);
+
+    return ns;
+}
+
+/* Returns ns per append of a net_buf to a chain of 'n' net_bufs.
+ * The appended net_buf is taken off again after each append.*/
+static unsigned long bench_concat( int n, int tail )
+{
+    fnet_netbuf_t   *chain = 0, *last = 0, *end, *nb;
+    unsigned long   start, ns;
+    int             i;
+
+    for(i = 0; i < n; i++)
+    {
+        nb = fnet_netbuf_new(BENCH_LENGTH, FNET_FALSE);
+        FNET_TEST_CHECK(nb != 0);
+        fnet_netbuf_concat_tail(&chain, &last, nb);
+    }
+    nb = fnet_netbuf_new(BENCH_LENGTH, FNET_FALSE);
+    FNET_TEST_CHECK(nb != 0);
+    end = last;
+
+    start = fnet_test_time_us();
+    for(i = 0; i < BENCH_REPEAT; i++)
+    {
+        if(tail)
+            fnet_netbuf_concat_tail(&chain, &last, nb);
+        else
+            chain = fnet_netbuf_concat(chain, nb);
+
+        end->next = 0;
+        last = end;
+        chain->total_length -= BENCH_LENGTH;
+    }
+    ns = (fnet_test_time_us() - start) * 1000 / BENCH_REPEAT;
+
+    FNET_TEST_CHECK(chain->total_length == (unsigned long)(n * BENCH_LENGTH));
+    fnet_netbuf_free_chain(chain);
+    fnet_netbuf_free_chain(nb);
+
+    return ns;
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    static const int    counts[] = {16, 128, BENCH_MAX};
+    int                 i;
+
+    fnet_test_link_init(heap, sizeof(heap));
+
+    printf("  ns per append of a net_buf\n");
+    printf("  %-12s %10s %10s\n", "chain", "walk", "tail");
+    for(i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++)
+        printf("  %-12d %10lu %10lu\n", counts[i], bench_concat(counts[i], 0), bench_concat(counts[i], 1));
+
+    printf("  ns per %d-byte segment\n", BENCH_LENGTH);
+    printf("  %-12s %10s %10s\n", "segments", "in order", "behind hole");
+    for(i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++)
+        printf("  %-12d %10lu %10lu\n", counts[i], bench_input(counts[i], 0), bench_input(counts[i], 1));
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file bench_tcp_lookup.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief TCP socket lookup benchmark.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include "fnet_test_link.h"
+
+#include "fnet_tcp.h"
+#include "fnet_checksum.h"
+
+/* Cost of a received segment against the number of open connections.
+ * With FNET_CFG_TCP_HASH_SIZE 1, all sockets are on one chain, which
+ * is the cost of the former linear search.*/
+#define BENCH_CONNECTIONS   (64)
+#define BENCH_SEGMENTS      (200000)
+
+static unsigned char heap[1024 * 1024];
+static SOCKET client[BENCH_CONNECTIONS];
+static SOCKET server[BENCH_CONNECTIONS];
+
+/************************************************************************
+* NAME: bench_segment
+*
+* DESCRIPTION: Builds a segment without data from the client port to
+*              the server port, with correct sequence numbers for 'sk'.
+*************************************************************************/
+static fnet_netbuf_t *bench_segment( fnet_socket_t *sk, unsigned char flags )
+{
+    fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control;
+    fnet_netbuf_t       *nb;
+    unsigned char       *header;
+    unsigned short      checksum;
+    fnet_ip4_addr_t     src_ip = FNET_TEST_LINK_CLIENT_IP;
+    fnet_ip4_addr_t     dest_ip = FNET_TEST_LINK_SERVER_IP;
+
+    nb = fnet_netbuf_new(20, FNET_FALSE);
+    FNET_TEST_CHECK(nb != 0);
+    header = (unsigned char *)nb->data_ptr;
+    fnet_memset_zero(header, 20);
+
+    *(unsigned short *)(header + 0) = sk->foreign_addr.sa_port;
+    *(unsigned short *)(header + 2) = sk->local_addr.sa_port;
+    *(unsigned long *)(header + 4) = fnet_htonl(cb->tcpcb_sndack);
+    *(unsigned long *)(header + 8) = fnet_htonl(cb->tcpcb_sndseq);
+    header[12] = 5 << 4;
+    header[13] = flags;
+    *(unsigned short *)(header + 14) = FNET_HTONS(8192);
+
+    checksum = fnet_checksum_pseudo_start(nb, FNET_HTONS((unsigned short)FNET_IP_PROTOCOL_TCP), (unsigned short)nb->total_length);
+    checksum = fnet_checksum_pseudo_end(checksum, (char *)&src_ip, (char *)&dest_ip, sizeof(fnet_ip4_addr_t));
+    *(unsigned short *)(header + 16) = checksum;
+
+    /* As fnet_tcp_input() checks it.*/
+    checksum = fnet_checksum_pseudo_start(nb, FNET_HTONS((unsigned short)FNET_IP_PROTOCOL_TCP), (unsigned short)nb->total_length);
+    checksum = fnet_checksum_pseudo_end(checksum, (char *)&src_ip, (char *)&dest_ip, sizeof(fnet_ip4_addr_t));
+    FNET_TEST_CHECK(checksum == 0);
+
+    return nb;
+}
+
+/* Returns ns per segment.*/
+static unsigned long bench_input( fnet_socket_t *sk, unsigned char flags )
+{
+    fnet_netbuf_t   *segment = bench_segment(sk, flags);
+    fnet_netbuf_t   *nb;
+    unsigned long   start, n;
+
+    start = fnet_test_time_us();
+    for(n = 0; n < BENCH_SEGMENTS; n++)
+    {
+        nb = fnet_netbuf_copy(segment, 0, FNET_NETBUF_COPYALL, FNET_FALSE);
+        fnet_test_link_input(FNET_TEST_LINK_CLIENT_IP, FNET_TEST_LINK_SERVER_IP, nb);
+    }
+    n = (fnet_test_time_us() - start) * 1000 / BENCH_SEGMENTS;
+
+    fnet_netbuf_free_chain(segment);
+    return n;
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    static const int    counts[] = {1, 4, 16, 64};
+    int                 open = 0;
+    int                 i;
+    fnet_socket_t       *oldest;
+    fnet_socket_t       unknown;
+
+    fnet_test_link_init(heap, sizeof(heap));
+
+    printf("  hash size %d, ns per segment\n", FNET_CFG_TCP_HASH_SIZE);
+    printf("  %-12s %10s %10s\n", "connections", "ACK", "unknown");
+
+    for(i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++)
+    {
+        while(open < counts[i])
+        {
+            fnet_test_link_connect(&client[open], &server[open], 2048);
+            open++;
+        }
+        fnet_test_link_run(1000);
+
+        /* The first connection is at the end of its chain.*/
+        oldest = fnet_test_link_socket(server[0]);
+
+        /* An RST for a connection that does not exist is dropped
+         * silently, after a full search.*/
+        unknown = *oldest;
+        unknown.foreign_addr.sa_port = FNET_HTONS(1);
+
+        printf("  %-12d %10lu %10lu\n", counts[i], 
+               bench_input(oldest, FNET_TCP_SGT_ACK), bench_input(&unknown, FNET_TCP_SGT_RST));
+    }
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file bench_tcp_loss.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief TCP bulk transfer over a lossy link.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include "fnet_test_link.h"
+
+#include "fnet_tcp.h"
+
+/* A bulk transfer from the client to the server, with losses on the 
+ * link. Prints the virtual time it takes and the data retransmitted.
+ * The received data is checked. Build with FNET_CFG_TCP_SACK 0 to 
+ * compare with the recovery without SACK.*/
+#define BENCH_CHUNK         (1000)
+
+static unsigned char heap[256 * 1024];
+static char tx_chunk[BENCH_CHUNK];
+static char rx_chunk[8192];
+
+static unsigned long seed;
+
+static unsigned long bench_rand( void )
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/************************************************************************
+* Loss models. 'seq' is relative to the ISN, data starts at 1.
+*************************************************************************/
+/* The first transmission of two data segments.*/
+static int loss_single( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    return (dir == FNET_TEST_LINK_TO_SERVER) && len && !rexmt 
+           && (((seq <= 50001) && (seq + len > 50001)) || ((seq <= 150001) && (seq + len > 150001)));
+}
+
+/* Three segments of one window, every second one.*/
+static int loss_burst( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    return (dir == FNET_TEST_LINK_TO_SERVER) && len && !rexmt 
+           && (seq >= 60001) && (seq < 60001 + 1460 * 5) && ((((seq - 60001) / 1460) % 2) == 0);
+}
+
+/* 'loss_pct' % of the data segments, half as many of the ACKs.*/
+static int loss_pct;
+
+static int loss_random( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    if((dir == FNET_TEST_LINK_TO_SERVER) && len)
+        return (int)(bench_rand() % 1000) < loss_pct * 10;
+
+    return (int)(bench_rand() % 1000) < loss_pct * 5;
+}
+
+/************************************************************************
+* NAME: bench_run
+*
+* DESCRIPTION: Sends 'total' bytes of a known pattern over a new 
+*              connection, with 'loss' on the link.
+*************************************************************************/
+static void bench_run( const char *name, int (*loss)( int dir, unsigned long seq, unsigned long len, int rexmt ), 
+                       unsigned long total, int bufsize )
+{
+    SOCKET                  client, server;
+    fnet_test_link_stat_t   *stat = fnet_test_link_stat;
+    unsigned long           sent = 0, received = 0;
+    unsigned long           start, free_mem = fnet_free_mem_status();
+    int                     n, i;
+
+    fnet_test_link_connect(&client, &server, bufsize);
+    fnet_test_link_reset_stat();
+    fnet_test_link_loss = loss;
+    start = fnet_test_link_now();
+
+    while(received < total)
+    {
+        FNET_TEST_CHECK(fnet_test_link_now() - start < 600000);
+        fnet_test_link_step();
+
+        while(sent < total)
+        {
+            n = (total - sent < BENCH_CHUNK) ? (int)(total - sent) : BENCH_CHUNK;
+            for(i = 0; i < n; i++)
+                tx_chunk[i] = (char)((sent + (unsigned long)i) * 13 + 7);
+            n = send(client, tx_chunk, n, 0);
+            FNET_TEST_CHECK(n >= 0);
+            if(n == 0)
+                break;
+            sent += (unsigned long)n;
+        }
+
+        while((n = recv(server, rx_chunk, sizeof(rx_chunk), 0)) > 0)
+        {
+            for(i = 0; i < n; i++)
+                FNET_TEST_CHECK(rx_chunk[i] == (char)((received + (unsigned long)i) * 13 + 7));
+            received += (unsigned long)n;
+        }
+        FNET_TEST_CHECK(n == 0);
+    }
+
+    printf("  %-12s %8lu %8lu %8lu %5lu %5lu %8lu\n", name, fnet_test_link_now() - start, 
+           stat[FNET_TEST_LINK_TO_SERVER].data, stat[FNET_TEST_LINK_TO_SERVER].rexmt,
+           stat[FNET_TEST_LINK_TO_SERVER].drops, stat[FNET_TEST_LINK_TO_CLIENT].drops, 
+           stat[FNET_TEST_LINK_TO_CLIENT].sack);
+
+    fnet_test_link_loss = 0;
+    FNET_TEST_CHECK(closesocket(client) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+    fnet_test_link_run(30000);  /* TIME_WAIT */
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    static const int    pcts[] = {1, 3, 5};
+    static const char   *names[] = {"random 1%", "random 3%", "random 5%"};
+    int                 i;
+
+    fnet_test_link_init(heap, sizeof(heap));
+
+    printf("  SACK %d, %d ms each way\n", FNET_CFG_TCP_SACK, (int)fnet_test_link_delay);
+    printf("  %-12s %8s %8s %8s %5s %5s %8s\n", "loss", "ms", "sent", "rexmt", "drops", "acks", "sack");
+
+    bench_run("none", 0, 300000, 16384);
+    bench_run("single", loss_single, 300000, 16384);
+    bench_run("burst", loss_burst, 300000, 16384);
+    for(i = 0; i < (int)(sizeof(pcts) / sizeof(pcts[0])); i++)
+    {
+        loss_pct = pcts[i];
+        seed = (unsigned long)(i + 1);
+        bench_run(names[i], loss_random, 300000, 16384);
+    }
+    loss_pct = 3;
+    seed = 4;
+    bench_run("small 3%", loss_random, 100000, 4096);
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file fnet_test.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Host test support.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <time.h>
+
+/************************************************************************
+* NAME: fnet_test_fail
+*
+* DESCRIPTION: Reports a failed check and stops the test program.
+*************************************************************************/
+void fnet_test_fail( const char *file, int line, const char *expr )
+{
+    printf("%s:%d: check failed: %s\n", file, line, expr);
+    exit(1);
+}
+
+/************************************************************************
+* NAME: fnet_test_pass
+*
+* DESCRIPTION: Reports a passed test case.
+*************************************************************************/
+void fnet_test_pass( const char *name )
+{
+    printf("  %-40s ok\n", name);
+}
+
+/************************************************************************
+* NAME: fnet_test_time_us
+*
+* DESCRIPTION: Host monotonic clock, in microseconds. Wraps around
+*              like fnet_timer_us().
+*************************************************************************/
+unsigned long fnet_test_time_us( void )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long)ts.tv_sec * 1000000UL + (unsigned long)(ts.tv_nsec / 1000);
+}
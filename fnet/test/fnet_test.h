@@ -0,0 +1,67 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file fnet_test.h
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Host test support.
+*
+***************************************************************************/
+
+#ifndef _FNET_TEST_H_
+
+#define _FNET_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Stops the test program if 'cond' is false. */
+#define FNET_TEST_CHECK(cond) \
+    do { if(!(cond)) fnet_test_fail(__FILE__, __LINE__, #cond); } while(0)
+
+void fnet_test_fail( const char *file, int line, const char *expr );
+void fnet_test_pass( const char *name );
+unsigned long fnet_test_time_us( void );
+
+/* fnet_isr_lock() nesting depth, kept by the host fnet_isr_lock()/fnet_isr_unlock(). */
+extern int fnet_test_isr_locked;
+
+/* Called once, the next time the last fnet_isr_lock() is released.
+ * This is where a deferred bottom half would run on the target. */
+extern void (*fnet_test_isr_unlock_hook)( void );
+
+#endif
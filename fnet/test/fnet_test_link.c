@@ -0,0 +1,488 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file fnet_test_link.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Host network for the TCP and UDP tests.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include "fnet_test_link.h"
+
+#include "fnet_socket_prv.h"
+#include "fnet_prot.h"
+#include "fnet_ip_prv.h"
+#include "fnet_ip6_prv.h"
+#include "fnet_netif_prv.h"
+#include "fnet_timer_prv.h"
+#include "fnet_checksum.h"
+#include "fnet_tcp.h"
+#include "fnet_icmp.h"
+#include "fnet_icmp6.h"
+
+#define FNET_TEST_LINK_QUEUE    (1024)
+
+typedef struct
+{
+    fnet_ip4_addr_t src_ip;
+    fnet_ip4_addr_t dest_ip;
+    unsigned char   protocol;
+    fnet_netbuf_t   *nb;
+    unsigned long   time;           /* Arrival time.*/
+} fnet_test_link_packet_t;
+
+extern fnet_prot_if_t fnet_tcp_prot_if;
+extern fnet_prot_if_t fnet_udp_prot_if;
+extern int fnet_enabled;
+
+unsigned long fnet_test_link_delay = 20;
+fnet_test_link_stat_t fnet_test_link_stat[2];
+int (*fnet_test_link_loss)( int dir, unsigned long seq, unsigned long len, int rexmt );
+void (*fnet_test_link_tap)( int dir, fnet_netbuf_t *nb );
+
+static fnet_netif_t fnet_test_link_netif;
+static fnet_test_link_packet_t fnet_test_link_queue[FNET_TEST_LINK_QUEUE];
+static int fnet_test_link_head;
+static int fnet_test_link_tail;
+static unsigned long fnet_test_link_time;       /* ms */
+static unsigned long fnet_test_link_isn[2];
+static unsigned long fnet_test_link_maxseq[2];
+static int fnet_test_link_maxseq_valid[2];
+static unsigned short fnet_test_link_port = 1024;
+
+/************************************************************************
+* Network interface and IP layer.
+*************************************************************************/
+fnet_prot_if_t *fnet_prot_find( fnet_address_family_t family, fnet_socket_type_t type, int protocol )
+{
+    if(type == SOCK_STREAM)
+        return &fnet_tcp_prot_if;
+    if(type == SOCK_DGRAM)
+        return &fnet_udp_prot_if;
+    return 0;
+}
+
+fnet_netif_t *fnet_ip_route( fnet_ip4_addr_t dest_ip )
+{
+    return &fnet_test_link_netif;
+}
+
+unsigned long fnet_ip_maximum_packet( fnet_ip4_addr_t dest_ip )
+{
+    return fnet_test_link_netif.mtu - 20;
+}
+
+int fnet_ip_addr_is_broadcast( fnet_ip4_addr_t addr, fnet_netif_t *netif )
+{
+    return FNET_FALSE;
+}
+
+void fnet_ip_multicast_leave( fnet_ip_multicast_list_entry_t *multicastentry )
+{
+}
+
+int fnet_ip_setsockopt( fnet_socket_t *sock, int level, int optname, char *optval, int optlen )
+{
+    return FNET_ERR;
+}
+
+int fnet_ip_getsockopt( fnet_socket_t *sock, int level, int optname, char *optval, int *optlen )
+{
+    return FNET_ERR;
+}
+
+const fnet_ip6_addr_t *fnet_ip6_select_src_addr( fnet_netif_t *netif, fnet_ip6_addr_t *dest_addr )
+{
+    return 0;
+}
+
+int fnet_ip6_output( fnet_netif_t *netif, fnet_ip6_addr_t *src_ip, fnet_ip6_addr_t *dest_ip, unsigned char protocol, 
+                     unsigned char hop_limit, fnet_netbuf_t *nb, FNET_COMP_PACKED_VAR unsigned short *checksum )
+{
+    fnet_netbuf_free_chain(nb);
+    return FNET_ERR;
+}
+
+void fnet_icmp_error( fnet_netif_t *netif, unsigned char type, unsigned char code, fnet_netbuf_t *nb )
+{
+    fnet_netbuf_free_chain(nb);
+}
+
+void fnet_icmp6_error( struct fnet_netif *netif, unsigned char type, unsigned char code, unsigned long param, fnet_netbuf_t *origin_nb )
+{
+    fnet_netbuf_free_chain(origin_nb);
+}
+
+fnet_netif_desc_t fnet_netif_get_by_scope_id( unsigned long scope_id )
+{
+    return &fnet_test_link_netif;
+}
+
+fnet_netif_desc_t fnet_netif_get_by_ip6_addr( fnet_ip6_addr_t *ip_addr )
+{
+    return 0;
+}
+
+fnet_netif_desc_t fnet_netif_get_by_sockaddr( const struct sockaddr *addr )
+{
+    return &fnet_test_link_netif;
+}
+
+/************************************************************************
+* Hardware timer, in virtual time.
+*************************************************************************/
+int fnet_cpu_timer_init( unsigned int period_ms )
+{
+    return FNET_OK;
+}
+
+void fnet_cpu_timer_release( void )
+{
+}
+
+unsigned long fnet_cpu_timer_us( void )
+{
+    return fnet_test_link_time * 1000;
+}
+
+/************************************************************************
+* NAME: fnet_test_link_option
+*
+* DESCRIPTION: Returns non-zero if the TCP header has the option.
+*************************************************************************/
+static int fnet_test_link_option( const unsigned char *header, int header_length, int kind )
+{
+    int i = 20;
+
+    while(i < header_length)
+    {
+        if(header[i] == 0)                  /* End of list.*/
+            break;
+
+        if(header[i] == 1)                  /* No operation.*/
+        {
+            i++;
+            continue;
+        }
+
+        if(header[i] == kind)
+            return 1;
+
+        if((i + 1 >= header_length) || (header[i + 1] < 2))
+            break;
+
+        i += header[i + 1];
+    }
+
+    return 0;
+}
+
+/************************************************************************
+* NAME: fnet_test_link_queue_packet
+*
+* DESCRIPTION: Queues the packet for delivery after the link delay.
+*************************************************************************/
+static void fnet_test_link_queue_packet( fnet_ip4_addr_t src_ip, fnet_ip4_addr_t dest_ip, unsigned char protocol, fnet_netbuf_t *nb )
+{
+    fnet_test_link_packet_t *packet;
+
+    FNET_TEST_CHECK(((fnet_test_link_tail + 1) % FNET_TEST_LINK_QUEUE) != fnet_test_link_head);
+    packet = &fnet_test_link_queue[fnet_test_link_tail];
+    packet->src_ip = src_ip;
+    packet->dest_ip = dest_ip;
+    packet->protocol = protocol;
+    packet->nb = nb;
+    packet->time = fnet_test_link_time + fnet_test_link_delay;
+    fnet_test_link_tail = (fnet_test_link_tail + 1) % FNET_TEST_LINK_QUEUE;
+}
+
+/************************************************************************
+* NAME: fnet_ip_output
+*
+* DESCRIPTION: Completes the checksum, takes the statistics and queues 
+*              the segment for delivery. UDP datagrams are only queued.
+*************************************************************************/
+int fnet_ip_output( fnet_netif_t *netif, fnet_ip4_addr_t src_ip, fnet_ip4_addr_t dest_ip,
+                    unsigned char protocol, unsigned char tos, unsigned char ttl,
+                    fnet_netbuf_t *nb, int DF, int do_not_route, FNET_COMP_PACKED_VAR unsigned short *checksum )
+{
+    int                     dir = (src_ip == FNET_TEST_LINK_CLIENT_IP) ? FNET_TEST_LINK_TO_SERVER : FNET_TEST_LINK_TO_CLIENT;
+    fnet_test_link_stat_t   *stat = &fnet_test_link_stat[dir];
+    unsigned char           *header;
+    int                     header_length;
+    unsigned long           seq, len;
+    int                     rexmt = 0;
+
+    if(checksum)
+        *checksum = fnet_checksum_pseudo_end(*checksum, (char *)&src_ip, (char *)&dest_ip, sizeof(fnet_ip4_addr_t));
+
+    if(protocol != FNET_IP_PROTOCOL_TCP)
+    {
+        fnet_test_link_queue_packet(src_ip, dest_ip, protocol, nb);
+        return FNET_OK;
+    }
+
+    nb = fnet_netbuf_pullup(nb, 20);
+    FNET_TEST_CHECK(nb != 0);
+    header_length = (((unsigned char *)nb->data_ptr)[12] >> 4) * 4;
+    nb = fnet_netbuf_pullup(nb, header_length);
+    FNET_TEST_CHECK(nb != 0);
+    header = (unsigned char *)nb->data_ptr;
+
+    seq = fnet_ntohl(*(unsigned long *)(header + 4));
+    len = nb->total_length - (unsigned long)header_length;
+
+    if(header[13] & FNET_TCP_SGT_SYN)
+    {
+        fnet_test_link_isn[dir] = seq;
+        fnet_test_link_maxseq_valid[dir] = 0;
+        if(fnet_test_link_option(header, header_length, 4))
+            stat->sack_permitted++;
+    }
+    if(fnet_test_link_option(header, header_length, 5))
+        stat->sack++;
+    stat->segments++;
+
+    if(len)
+    {
+        stat->data += len;
+        if(fnet_test_link_maxseq_valid[dir] && ((long)(seq - fnet_test_link_maxseq[dir]) < 0))
+        {
+            rexmt = 1;
+            stat->rexmt += len;
+        }
+        if(!fnet_test_link_maxseq_valid[dir] || ((long)(seq + len - fnet_test_link_maxseq[dir]) > 0))
+        {
+            fnet_test_link_maxseq[dir] = seq + len;
+            fnet_test_link_maxseq_valid[dir] = 1;
+        }
+    }
+
+    if(fnet_test_link_tap)
+        fnet_test_link_tap(dir, nb);
+
+    if(fnet_test_link_loss && fnet_test_link_loss(dir, seq - fnet_test_link_isn[dir], len, rexmt))
+    {
+        stat->drops++;
+        fnet_netbuf_free_chain(nb);
+        return FNET_OK;
+    }
+
+    fnet_test_link_queue_packet(src_ip, dest_ip, protocol, nb);
+
+    return FNET_OK;
+}
+
+/************************************************************************
+* NAME: fnet_test_link_input
+*
+* DESCRIPTION: Passes a segment to TCP, as the IP layer does.
+*************************************************************************/
+void fnet_test_link_input( fnet_ip4_addr_t src_ip, fnet_ip4_addr_t dest_ip, fnet_netbuf_t *nb )
+{
+    fnet_tcp_prot_if.prot_input_ip4(&fnet_test_link_netif, src_ip, dest_ip, nb, 0);
+}
+
+/************************************************************************
+* NAME: fnet_test_link_socket
+*
+* DESCRIPTION: Returns the TCP or UDP socket of a descriptor.
+*************************************************************************/
+fnet_socket_t *fnet_test_link_socket( SOCKET desc )
+{
+    fnet_socket_t *sk;
+
+    for(sk = fnet_tcp_prot_if.head; sk && (sk->descriptor != desc); sk = sk->next)
+    {}
+    if(sk == 0)
+    {
+        for(sk = fnet_udp_prot_if.head; sk && (sk->descriptor != desc); sk = sk->next)
+        {}
+    }
+
+    FNET_TEST_CHECK(sk != 0);
+    return sk;
+}
+
+/************************************************************************
+* NAME: fnet_test_link_init
+*
+* DESCRIPTION: Initializes the heap, the timers and TCP.
+*************************************************************************/
+void fnet_test_link_init( unsigned char *heap, unsigned long heap_size )
+{
+    fnet_test_link_netif.mtu = 1500;
+    fnet_test_link_netif.ip4_addr.address = FNET_TEST_LINK_SERVER_IP;
+
+    FNET_TEST_CHECK(fnet_heap_init(heap, heap_size) == FNET_OK);
+    FNET_TEST_CHECK(fnet_timer_init(FNET_TIMER_PERIOD_MS) == FNET_OK);
+    fnet_socket_init();
+    FNET_TEST_CHECK(fnet_tcp_prot_if.prot_init() == FNET_OK);
+    fnet_enabled = 1;
+}
+
+/************************************************************************
+* NAME: fnet_test_link_deliver
+*
+* DESCRIPTION: Passes the arrived segments to TCP, or all queued 
+*              segments if 'all' is set.
+*************************************************************************/
+static void fnet_test_link_deliver( int all )
+{
+    fnet_test_link_packet_t packet;
+
+    while((fnet_test_link_head != fnet_test_link_tail) 
+          && (all || ((long)(fnet_test_link_queue[fnet_test_link_head].time - fnet_test_link_time) <= 0)))
+    {
+        packet = fnet_test_link_queue[fnet_test_link_head];
+        fnet_test_link_head = (fnet_test_link_head + 1) % FNET_TEST_LINK_QUEUE;
+
+        if(packet.protocol == FNET_IP_PROTOCOL_TCP)
+            fnet_test_link_input(packet.src_ip, packet.dest_ip, packet.nb);
+        else
+            fnet_udp_prot_if.prot_input_ip4(&fnet_test_link_netif, packet.src_ip, packet.dest_ip, packet.nb, 0);
+    }
+}
+
+/************************************************************************
+* NAME: fnet_test_link_step
+*
+* DESCRIPTION: Advances the time by 1 ms, delivers the arrived segments
+*              and runs the timers.
+*************************************************************************/
+void fnet_test_link_step( void )
+{
+    fnet_test_link_time++;
+
+    fnet_test_link_deliver(0);
+
+    if((fnet_test_link_time % FNET_TIMER_PERIOD_MS) == 0)
+    {
+        fnet_timer_ticks_inc();
+        fnet_timer_handler_bottom();
+    }
+}
+
+/************************************************************************
+* NAME: fnet_test_link_flush
+*
+* DESCRIPTION: Delivers all queued segments now, without the delay.
+*************************************************************************/
+void fnet_test_link_flush( void )
+{
+    fnet_test_link_deliver(1);
+}
+
+/************************************************************************
+* NAME: fnet_test_link_run
+*
+* DESCRIPTION: Advances the time by 'ms'.
+*************************************************************************/
+void fnet_test_link_run( unsigned long ms )
+{
+    while(ms--)
+        fnet_test_link_step();
+}
+
+/************************************************************************
+* NAME: fnet_test_link_now
+*
+* DESCRIPTION: Returns the virtual time, in ms.
+*************************************************************************/
+unsigned long fnet_test_link_now( void )
+{
+    return fnet_test_link_time;
+}
+
+/************************************************************************
+* NAME: fnet_test_link_reset_stat
+*
+* DESCRIPTION: Clears the link statistics.
+*************************************************************************/
+void fnet_test_link_reset_stat( void )
+{
+    fnet_memset_zero(fnet_test_link_stat, sizeof(fnet_test_link_stat));
+}
+
+/************************************************************************
+* NAME: fnet_test_link_connect
+*
+* DESCRIPTION: Opens a connection from a new client port to the server
+*              port. Both sockets get 'bufsize' byte buffers.
+*************************************************************************/
+void fnet_test_link_connect( SOCKET *client, SOCKET *server, int bufsize )
+{
+    SOCKET              listener;
+    struct sockaddr_in  addr;
+    unsigned long       start;
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    FNET_TEST_CHECK(listener != SOCKET_INVALID);
+    FNET_TEST_CHECK(setsockopt(listener, SOL_SOCKET, SO_RCVBUF, (char *)&bufsize, sizeof(bufsize)) == FNET_OK);
+    FNET_TEST_CHECK(setsockopt(listener, SOL_SOCKET, SO_SNDBUF, (char *)&bufsize, sizeof(bufsize)) == FNET_OK);
+
+    fnet_memset_zero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = FNET_HTONS(FNET_TEST_LINK_SERVER_PORT);
+    addr.sin_addr.s_addr = FNET_TEST_LINK_SERVER_IP;
+    FNET_TEST_CHECK(bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+    FNET_TEST_CHECK(listen(listener, 1) == FNET_OK);
+
+    *client = socket(AF_INET, SOCK_STREAM, 0);
+    FNET_TEST_CHECK(*client != SOCKET_INVALID);
+    FNET_TEST_CHECK(setsockopt(*client, SOL_SOCKET, SO_RCVBUF, (char *)&bufsize, sizeof(bufsize)) == FNET_OK);
+    FNET_TEST_CHECK(setsockopt(*client, SOL_SOCKET, SO_SNDBUF, (char *)&bufsize, sizeof(bufsize)) == FNET_OK);
+
+    addr.sin_port = fnet_htons(fnet_test_link_port++);
+    addr.sin_addr.s_addr = FNET_TEST_LINK_CLIENT_IP;
+    FNET_TEST_CHECK(bind(*client, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+
+    addr.sin_port = FNET_HTONS(FNET_TEST_LINK_SERVER_PORT);
+    addr.sin_addr.s_addr = FNET_TEST_LINK_SERVER_IP;
+    FNET_TEST_CHECK(connect(*client, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+
+    start = fnet_test_link_time;
+    while((*server = accept(listener, 0, 0)) == SOCKET_INVALID)
+    {
+        FNET_TEST_CHECK(fnet_test_link_time - start < 10000);
+        fnet_test_link_step();
+    }
+
+    FNET_TEST_CHECK(closesocket(listener) == FNET_OK);
+}
@@ -0,0 +1,97 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file fnet_test_link.h
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Host network for the TCP and UDP tests.
+*
+***************************************************************************/
+
+#ifndef _FNET_TEST_LINK_H_
+
+#define _FNET_TEST_LINK_H_
+
+#include "fnet.h"
+#include "fnet_netbuf.h"
+#include "fnet_socket_prv.h"
+
+/* The IP layer is replaced by a link between two addresses of the same 
+ * stack. A segment arrives fnet_test_link_delay ms after it is sent,
+ * unless fnet_test_link_loss drops it. Time is virtual and only moves 
+ * in fnet_test_link_step(), which also runs the stack timers.
+ * UDP datagrams are carried too, they are never dropped.*/
+
+#define FNET_TEST_LINK_SERVER_IP    FNET_IP4_ADDR_INIT(10, 0, 0, 1)
+#define FNET_TEST_LINK_CLIENT_IP    FNET_IP4_ADDR_INIT(10, 0, 0, 2)
+#define FNET_TEST_LINK_SERVER_PORT  (80)
+
+/* Link directions.*/
+#define FNET_TEST_LINK_TO_SERVER    (0)
+#define FNET_TEST_LINK_TO_CLIENT    (1)
+
+typedef struct
+{
+    unsigned long segments;         /* Segments sent.*/
+    unsigned long data;             /* Data bytes sent, with retransmissions.*/
+    unsigned long rexmt;            /* Retransmitted data bytes.*/
+    unsigned long drops;            /* Segments dropped by the link.*/
+    unsigned long sack;             /* Segments with a SACK option.*/
+    unsigned long sack_permitted;   /* SYNs with the SACK-permitted option.*/
+} fnet_test_link_stat_t;
+
+extern unsigned long fnet_test_link_delay;
+extern fnet_test_link_stat_t fnet_test_link_stat[2];
+
+/* Returns non-zero to drop a segment. 'seq' is relative to the ISN of
+ * the direction, 'rexmt' tells whether the data was sent before.*/
+extern int (*fnet_test_link_loss)( int dir, unsigned long seq, unsigned long len, int rexmt );
+
+/* Called for every sent segment, with the TCP header in contiguous memory.*/
+extern void (*fnet_test_link_tap)( int dir, fnet_netbuf_t *nb );
+
+void fnet_test_link_init( unsigned char *heap, unsigned long heap_size );
+void fnet_test_link_step( void );
+void fnet_test_link_run( unsigned long ms );
+void fnet_test_link_flush( void );
+unsigned long fnet_test_link_now( void );
+void fnet_test_link_reset_stat( void );
+void fnet_test_link_connect( SOCKET *client, SOCKET *server, int bufsize );
+void fnet_test_link_input( fnet_ip4_addr_t src_ip, fnet_ip4_addr_t dest_ip, fnet_netbuf_t *nb );
+fnet_socket_t *fnet_test_link_socket( SOCKET desc );
+
+#endif
@@ -0,0 +1,124 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file fnet_test_stubs.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Host stand-ins for the stack modules and CPU functions a test does not link.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include "fnet.h"
+#include "fnet_isr.h"
+#include "fnet_timer.h"
+#include "fnet_prot.h"
+#include "fnet_serial.h"
+#include <stdint.h>
+
+/* All definitions are weak: a test that links the real module, or 
+ * defines its own version, gets that one instead.*/
+#define FNET_TEST_WEAK  __attribute__((weak))
+
+int fnet_test_isr_locked;
+void (*fnet_test_isr_unlock_hook)( void );
+
+/************************************************************************
+* Interrupts.
+*************************************************************************/
+FNET_TEST_WEAK void fnet_isr_lock( void )
+{
+    fnet_test_isr_locked++;
+}
+
+FNET_TEST_WEAK void fnet_isr_unlock( void )
+{
+    void (*hook)( void );
+
+    FNET_TEST_CHECK(fnet_test_isr_locked > 0);
+
+    if((--fnet_test_isr_locked == 0) && ((hook = fnet_test_isr_unlock_hook) != 0))
+    {
+        fnet_test_isr_unlock_hook = 0;
+        hook();
+    }
+}
+
+FNET_TEST_WEAK int fnet_isr_vector_init( unsigned int vector_number, void (*handler_top)( void ), void (*handler_bottom)( void ), unsigned int priority )
+{
+    return FNET_OK;
+}
+
+FNET_TEST_WEAK void fnet_isr_handler( int vector_number )
+{
+}
+
+/************************************************************************
+* Timers.
+*************************************************************************/
+FNET_TEST_WEAK void fnet_timer_delay( unsigned long delay_ticks )
+{
+}
+
+/************************************************************************
+* Protocols.
+*************************************************************************/
+FNET_TEST_WEAK void fnet_prot_drain( void )
+{
+}
+
+/************************************************************************
+* Serial port, the console output goes to stdout.
+*************************************************************************/
+FNET_TEST_WEAK void fnet_cpu_serial_putchar( long port_number, int character )
+{
+    putchar(character);
+}
+
+FNET_TEST_WEAK int fnet_cpu_serial_getchar( long port_number )
+{
+    return FNET_ERR;
+}
+
+FNET_TEST_WEAK void fnet_cpu_serial_init( long port_number, unsigned long baud_rate )
+{
+}
+
+/************************************************************************
+* CMSIS.
+*************************************************************************/
+FNET_TEST_WEAK uint32_t SystemCoreClock = 100000000;
@@ -0,0 +1,459 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_arp.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief ARP cache test.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+
+#include "fnet.h"
+#include "fnet_arp.h"
+#include "fnet_eth_prv.h"
+#include "fnet_netif_prv.h"
+#include "fnet_ip_prv.h"
+#include "fnet_ip6_prv.h"
+#include "fnet_nd6.h"
+#include "fnet_timer.h"
+
+#define LOCAL_IP        FNET_IP4_ADDR_INIT(10, 0, 0, 1)
+#define PEER_IP         FNET_IP4_ADDR_INIT(10, 0, 0, 2)
+#define SENT_MAX        (64)
+
+static unsigned char heap[32 * 1024];
+
+static fnet_eth_if_t    eth_if;
+static fnet_netif_api_t eth_api;
+static fnet_netif_t     netif;
+
+static const fnet_mac_addr_t local_mac = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static const fnet_mac_addr_t peer_mac = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+
+/* Frames sent by the driver.*/
+static struct
+{
+    unsigned short  type;
+    fnet_mac_addr_t dest_addr;
+    unsigned long   id;             /* First word of an IPv4 packet.*/
+    unsigned short  op;             /* ARP opcode.*/
+    fnet_ip4_addr_t target;         /* ARP target address.*/
+    int             locked;         /* fnet_isr_lock() depth.*/
+} sent[SENT_MAX];
+static int sent_count;
+
+/* ARP timer and clock.*/
+static void             (*arp_timer)( void *cookie );
+static void             *arp_timer_cookie;
+static unsigned long    ticks;
+
+/************************************************************************
+* Timers.
+*************************************************************************/
+fnet_timer_desc_t fnet_timer_new( unsigned long period_ticks, void (*handler)( void *cookie ), void *cookie )
+{
+    arp_timer = handler;
+    arp_timer_cookie = cookie;
+    return (fnet_timer_desc_t)1;
+}
+
+void fnet_timer_free( fnet_timer_desc_t timer )
+{
+    arp_timer = 0;
+}
+
+unsigned long fnet_timer_ticks( void )
+{
+    return ticks;
+}
+
+unsigned long fnet_timer_ms( void )
+{
+    return ticks * FNET_TIMER_PERIOD_MS;
+}
+
+unsigned long fnet_timer_us( void )
+{
+    return ticks * FNET_TIMER_PERIOD_MS * 1000;
+}
+
+unsigned long fnet_timer_get_interval( unsigned long start, unsigned long end )
+{
+    return end - start;
+}
+
+/************************************************************************
+* Network interface, IP and IPv6, not used by ARP.
+*************************************************************************/
+const fnet_ip6_addr_t fnet_ip6_addr_any;
+const fnet_ip6_addr_t fnet_ip6_addr_linklocal_allnodes;
+
+int fnet_event_init( fnet_event_t event_number, void (*event_handler)( void ) )
+{
+    return FNET_OK;
+}
+
+void fnet_event_raise( fnet_event_t event_number )
+{
+}
+
+int fnet_netif_get_hw_addr( fnet_netif_desc_t netif_desc, unsigned char *hw_addr, unsigned int hw_addr_size )
+{
+    memcpy(hw_addr, local_mac, sizeof(fnet_mac_addr_t));
+    return FNET_OK;
+}
+
+int fnet_netif_set_hw_addr( fnet_netif_desc_t netif_desc, unsigned char *hw_addr, unsigned int hw_addr_size )
+{
+    return FNET_OK;
+}
+
+int fnet_netif_connected( fnet_netif_desc_t netif_desc )
+{
+    return FNET_TRUE;
+}
+
+void fnet_netif_dupip_handler_signal( fnet_netif_desc_t netif_desc )
+{
+}
+
+int fnet_ip_addr_is_broadcast( fnet_ip4_addr_t addr, fnet_netif_t *netif_ptr )
+{
+    return addr == FNET_IP4_ADDR_INIT(255, 255, 255, 255);
+}
+
+void fnet_ip_input( fnet_netif_t *netif_ptr, fnet_netbuf_t *nb )
+{
+    fnet_netbuf_free_chain(nb);
+}
+
+void fnet_ip6_input( fnet_netif_t *netif_ptr, fnet_netbuf_t *nb )
+{
+    fnet_netbuf_free_chain(nb);
+}
+
+void fnet_netif_join_ip6_multicast( fnet_netif_desc_t netif_desc, const fnet_ip6_addr_t *multicast_addr )
+{
+}
+
+int fnet_netif_bind_ip6_addr_prv( fnet_netif_t *netif_ptr, fnet_ip6_addr_t *addr, fnet_netif_ip6_addr_type_t addr_type, 
+                                  unsigned long lifetime, unsigned long prefix_length )
+{
+    return FNET_ERR;
+}
+
+int fnet_nd6_init( struct fnet_netif *netif_ptr, fnet_nd6_if_t *nd6_if_ptr )
+{
+    return FNET_ERR;
+}
+
+int fnet_nd6_addr_is_onlink( struct fnet_netif *netif_ptr, fnet_ip6_addr_t *addr )
+{
+    return FNET_FALSE;
+}
+
+fnet_nd6_neighbor_entry_t *fnet_nd6_default_router_get( struct fnet_netif *netif_ptr )
+{
+    return 0;
+}
+
+fnet_nd6_neighbor_entry_t *fnet_nd6_neighbor_cache_add( struct fnet_netif *netif_ptr, fnet_ip6_addr_t *ip_addr, fnet_nd6_ll_addr_t ll_addr, fnet_nd6_neighbor_state_t state )
+{
+    return 0;
+}
+
+fnet_nd6_neighbor_entry_t *fnet_nd6_neighbor_cache_get( struct fnet_netif *netif_ptr, fnet_ip6_addr_t *ip_addr )
+{
+    return 0;
+}
+
+void fnet_nd6_neighbor_enqueue_waiting_netbuf( fnet_nd6_neighbor_entry_t *neighbor_entry, fnet_netbuf_t *waiting_netbuf )
+{
+    fnet_netbuf_free_chain(waiting_netbuf);
+}
+
+void fnet_nd6_neighbor_solicitation_send( struct fnet_netif *netif_ptr, fnet_ip6_addr_t *ipsrc, fnet_ip6_addr_t *ipdest, fnet_ip6_addr_t *target_addr )
+{
+}
+
+void fnet_nd6_rd_start( struct fnet_netif *netif_ptr )
+{
+}
+
+void fnet_nd6_redirect_addr( struct fnet_netif *if_ptr, fnet_ip6_addr_t **destination_addr_p )
+{
+}
+
+/************************************************************************
+* Ethernet driver, keeps the sent frames.
+*************************************************************************/
+static void eth_output( fnet_netif_t *netif_ptr, unsigned short type, const fnet_mac_addr_t dest_addr, fnet_netbuf_t *nb )
+{
+    fnet_arp_header_t *arp_hdr = nb->data_ptr;
+
+    FNET_TEST_CHECK(sent_count < SENT_MAX);
+    sent[sent_count].type = type;
+    memcpy(sent[sent_count].dest_addr, dest_addr, sizeof(fnet_mac_addr_t));
+    sent[sent_count].locked = fnet_test_isr_locked;
+    if(type == FNET_ETH_TYPE_IP4)
+    {
+        sent[sent_count].id = *(unsigned long *)nb->data_ptr;
+    }
+    else
+    {
+        FNET_TEST_CHECK(type == FNET_ETH_TYPE_ARP);
+        sent[sent_count].op = fnet_ntohs(arp_hdr->op);
+        sent[sent_count].target = arp_hdr->targer_prot_addr;
+    }
+    sent_count++;
+
+    fnet_netbuf_free_chain(nb);
+}
+
+static fnet_netbuf_t *ip_packet( unsigned long id )
+{
+    fnet_netbuf_t *nb = fnet_netbuf_new(20, FNET_TRUE);
+
+    FNET_TEST_CHECK(nb != 0);
+    *(unsigned long *)nb->data_ptr = id;
+    return nb;
+}
+
+/* Sends an IPv4 packet, as the IP layer does.*/
+static void ip_output( fnet_ip4_addr_t dest, unsigned long id )
+{
+    fnet_eth_output_ip4(&netif, dest, ip_packet(id));
+}
+
+/* An ARP packet received by the Ethernet bottom half.*/
+static void arp_receive( unsigned short op, const fnet_mac_addr_t sender_mac, fnet_ip4_addr_t sender, fnet_ip4_addr_t target )
+{
+    fnet_netbuf_t       *nb = fnet_netbuf_new(sizeof(fnet_arp_header_t), FNET_TRUE);
+    fnet_arp_header_t   *arp_hdr;
+
+    FNET_TEST_CHECK(nb != 0);
+    arp_hdr = nb->data_ptr;
+    fnet_memset_zero(arp_hdr, sizeof(*arp_hdr));
+    arp_hdr->hard_type = FNET_HTONS(FNET_ARP_HARD_TYPE);
+    arp_hdr->prot_type = FNET_HTONS(FNET_ETH_TYPE_IP4);
+    arp_hdr->hard_size = FNET_ARP_HARD_SIZE;
+    arp_hdr->prot_size = FNET_ARP_PROT_SIZE;
+    arp_hdr->op = fnet_htons(op);
+    memcpy(arp_hdr->sender_hard_addr, sender_mac, sizeof(fnet_mac_addr_t));
+    arp_hdr->sender_prot_addr = sender;
+    arp_hdr->targer_prot_addr = target;
+
+    fnet_arp_input(&netif, nb);
+}
+
+static void peer_reply( void )
+{
+    arp_receive(FNET_ARP_OP_REPLY, peer_mac, PEER_IP, LOCAL_IP);
+}
+
+static void arp_restart( void )
+{
+    FNET_TEST_CHECK(fnet_arp_init(&netif) == FNET_OK);
+    FNET_TEST_CHECK(arp_timer != 0);
+    sent_count = 0;
+}
+
+/* Checks the hash chains against the table.*/
+static int arp_check_cache( void )
+{
+    fnet_arp_if_t       *arpif = &eth_if.arp_if;
+    fnet_arp_entry_t    *entry;
+    int                 i, used = 0, hashed = 0;
+
+    for(i = 0; i < FNET_ARP_TABLE_SIZE; i++)
+    {
+        if(arpif->arp_table[i].prot_addr)
+            used++;
+    }
+
+    for(i = 0; i < FNET_CFG_ARP_HASH_SIZE; i++)
+    {
+        for(entry = arpif->arp_hash[i]; entry; entry = entry->hash_next)
+        {
+            FNET_TEST_CHECK(entry->prot_addr != 0);
+            FNET_TEST_CHECK(hashed++ < FNET_ARP_TABLE_SIZE);
+        }
+    }
+    FNET_TEST_CHECK(hashed == used);
+
+    return used;
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_resolve( void )
+{
+    struct fnet_arp_statistics  stat;
+    int                         i;
+
+    arp_restart();
+
+    /* One request, the queue keeps the newest packets.*/
+    for(i = 0; i < FNET_CFG_ARP_HOLD_MAX + 2; i++)
+        ip_output(PEER_IP, (unsigned long)i);
+
+    FNET_TEST_CHECK(sent_count == 1);
+    FNET_TEST_CHECK((sent[0].type == FNET_ETH_TYPE_ARP) && (sent[0].op == FNET_ARP_OP_REQUEST));
+    FNET_TEST_CHECK(sent[0].target == PEER_IP);
+    FNET_TEST_CHECK(memcmp(sent[0].dest_addr, fnet_eth_broadcast, sizeof(fnet_mac_addr_t)) == 0);
+
+    /* The reply sends them in order.*/
+    peer_reply();
+    FNET_TEST_CHECK(sent_count == 1 + FNET_CFG_ARP_HOLD_MAX);
+    for(i = 0; i < FNET_CFG_ARP_HOLD_MAX; i++)
+    {
+        FNET_TEST_CHECK(sent[1 + i].type == FNET_ETH_TYPE_IP4);
+        FNET_TEST_CHECK(sent[1 + i].id == (unsigned long)(i + 2));
+        FNET_TEST_CHECK(memcmp(sent[1 + i].dest_addr, peer_mac, sizeof(fnet_mac_addr_t)) == 0);
+    }
+
+    /* Resolved.*/
+    ip_output(PEER_IP, 100);
+    FNET_TEST_CHECK((sent_count == 2 + FNET_CFG_ARP_HOLD_MAX) && (sent[sent_count - 1].id == 100));
+
+    FNET_TEST_CHECK(fnet_netif_get_arp_statistics(&netif, &stat) == FNET_OK);
+    FNET_TEST_CHECK(stat.hold_drop == 2);
+    FNET_TEST_CHECK(stat.resolve_wait == FNET_CFG_ARP_HOLD_MAX + 2);
+    FNET_TEST_CHECK(stat.hit == 1);
+    fnet_test_pass("resolve, queue and send in order");
+}
+
+static void test_timer( void )
+{
+    arp_restart();
+    ip_output(PEER_IP, 1);
+    peer_reply();
+    sent_count = 0;
+
+    /* A used entry is refreshed by a unicast request before it expires.*/
+    ticks += FNET_ARP_REFRESH_TIME / FNET_TIMER_PERIOD_MS + 1;
+    ip_output(PEER_IP, 2);
+    arp_timer(arp_timer_cookie);
+    FNET_TEST_CHECK((sent_count == 2) && (sent[1].type == FNET_ETH_TYPE_ARP));
+    FNET_TEST_CHECK(memcmp(sent[1].dest_addr, peer_mac, sizeof(fnet_mac_addr_t)) == 0);
+
+    /* Not used since, no refresh.*/
+    arp_timer(arp_timer_cookie);
+    FNET_TEST_CHECK(sent_count == 2);
+
+    /* Expired.*/
+    ticks += FNET_ARP_TIMEOUT / FNET_TIMER_PERIOD_MS;
+    arp_timer(arp_timer_cookie);
+    FNET_TEST_CHECK(arp_check_cache() == 0);
+    ip_output(PEER_IP, 3);
+    FNET_TEST_CHECK((sent_count == 3) && (sent[2].type == FNET_ETH_TYPE_ARP));
+    fnet_test_pass("refresh and expiry");
+}
+
+static void test_table_full( void )
+{
+    unsigned long   free_mem;
+    int             i;
+
+    arp_restart();
+    free_mem = fnet_free_mem_status();
+
+    /* The oldest entries are replaced, with their queued packets.*/
+    for(i = 0; i < 3 * FNET_ARP_TABLE_SIZE; i++)
+    {
+        ticks++;
+        ip_output(FNET_IP4_ADDR_INIT(10, 0, 1, i), (unsigned long)i);
+        FNET_TEST_CHECK(arp_check_cache() == ((i < FNET_ARP_TABLE_SIZE) ? (i + 1) : FNET_ARP_TABLE_SIZE));
+    }
+    FNET_TEST_CHECK(sent_count == 3 * FNET_ARP_TABLE_SIZE);
+
+    arp_receive(FNET_ARP_OP_REPLY, peer_mac, FNET_IP4_ADDR_INIT(10, 0, 1, 3 * FNET_ARP_TABLE_SIZE - 1), LOCAL_IP);
+    FNET_TEST_CHECK(sent_count == 3 * FNET_ARP_TABLE_SIZE + 1);
+    FNET_TEST_CHECK(sent[sent_count - 1].id == 3 * FNET_ARP_TABLE_SIZE - 1);
+
+    fnet_arp_release(&netif);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    FNET_TEST_CHECK(arp_check_cache() == 0);
+    fnet_test_pass("full table, release");
+}
+
+static void test_lock( void )
+{
+    fnet_netbuf_t *nb;
+
+    arp_restart();
+
+    /* The cache is used under fnet_isr_lock(), a reply handled by the 
+     * Ethernet bottom half is deferred until the packet is queued.*/
+    nb = ip_packet(1);
+    fnet_test_isr_unlock_hook = peer_reply;
+    fnet_eth_output_ip4(&netif, PEER_IP, nb);
+    FNET_TEST_CHECK(fnet_test_isr_unlock_hook == 0);
+
+    FNET_TEST_CHECK(sent_count == 2);
+    FNET_TEST_CHECK((sent[0].type == FNET_ETH_TYPE_ARP) && (sent[0].locked > 0));
+    FNET_TEST_CHECK((sent[1].type == FNET_ETH_TYPE_IP4) && (sent[1].id == 1));
+    fnet_test_pass("cache locked against the bottom half");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    FNET_TEST_CHECK(fnet_heap_init(heap, sizeof(heap)) == FNET_OK);
+
+    eth_api.type = FNET_NETIF_TYPE_ETHERNET;
+    eth_if.output = eth_output;
+    netif.api = &eth_api;
+    netif.if_ptr = &eth_if;
+    netif.ip4_addr.address = LOCAL_IP;
+    netif.ip4_addr.subnetmask = FNET_IP4_ADDR_INIT(255, 255, 255, 0);
+
+    test_resolve();
+    test_timer();
+    test_table_full();
+    test_lock();
+
+    fnet_arp_release(&netif);
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_checksum.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Internet checksum test.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+
+#include "fnet.h"
+#include "fnet_checksum.h"
+#include "fnet_netbuf.h"
+
+#define DATA_MAX    (2048)
+
+static unsigned char heap[50 * 1024];
+static unsigned char data[DATA_MAX + 8] __attribute__((aligned(8)));
+static unsigned char copy[DATA_MAX + 8] __attribute__((aligned(8)));
+
+static unsigned long seed = 1;
+
+static unsigned long test_rand( void )
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/* RFC 1071, a byte at a time. The 16-bit words are taken in host
+ * (little endian) order, the same as the stack does.*/
+static unsigned short ref_sum( const unsigned char *buf, int len )
+{
+    unsigned long   sum = 0;
+    int             i;
+
+    for(i = 0; i + 1 < len; i += 2)
+        sum += (unsigned long)buf[i] | ((unsigned long)buf[i + 1] << 8);
+    if(len & 1)
+        sum += buf[len - 1];
+
+    while(sum >> 16)
+        sum = (sum >> 16) + (sum & 0xffff);
+
+    return (unsigned short)sum;
+}
+
+static void fill( unsigned char *buf, int len )
+{
+    int i;
+
+    /* Mostly 0xFF, to get many carries.*/
+    for(i = 0; i < len; i++)
+        buf[i] = (test_rand() & 3) ? 0xFF : (unsigned char)test_rand();
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_buf( void )
+{
+    int             i, offset, len;
+    unsigned char   *buf;
+
+    for(i = 0; i < 20000; i++)
+    {
+        offset = (int)(test_rand() & 7);
+        len = (int)(test_rand() % DATA_MAX);
+        buf = data + offset;
+        fill(buf, len);
+
+        FNET_TEST_CHECK(fnet_checksum_buf((char *)buf, len) == (unsigned short)~ref_sum(buf, len));
+    }
+    fnet_test_pass("buffer, any length and alignment");
+}
+
+static void test_copy( void )
+{
+    int             i, offset_dst, offset_src, len;
+
+    for(i = 0; i < 20000; i++)
+    {
+        offset_src = (int)(test_rand() & 3) * 2;
+        offset_dst = (test_rand() & 1) ? offset_src : (int)(test_rand() & 3) * 2;
+        len = (int)(test_rand() % DATA_MAX);
+        fill(data + offset_src, len);
+        memset(copy, 0, sizeof(copy));
+
+        FNET_TEST_CHECK(fnet_checksum_copy(copy + offset_dst, data + offset_src, len) == ref_sum(data + offset_src, len));
+        FNET_TEST_CHECK(memcmp(copy + offset_dst, data + offset_src, (size_t)len) == 0);
+        FNET_TEST_CHECK(copy[offset_dst + len] == 0);
+    }
+    fnet_test_pass("copy and checksum");
+}
+
+static void test_chain( void )
+{
+    fnet_netbuf_t   *chain, *nb;
+    int             i, n, frags, len, skip, total;
+
+    for(i = 0; i < 5000; i++)
+    {
+        chain = 0;
+        total = 0;
+        frags = 1 + (int)(test_rand() % 6);
+
+        /* Fragments of odd and even length, starting at any offset.*/
+        for(n = 0; n < frags; n++)
+        {
+            len = (int)(test_rand() % 300);
+            skip = (int)(test_rand() & 3);
+            if(total + len > DATA_MAX)
+                len = DATA_MAX - total;
+
+            fill(data + total, len);
+            nb = fnet_netbuf_new(skip + len, FNET_FALSE);
+            FNET_TEST_CHECK(nb != 0);
+            nb->data_ptr = (unsigned char *)nb->data_ptr + skip;
+            nb->length = nb->total_length = (unsigned long)len;
+            memcpy(nb->data_ptr, data + total, (size_t)len);
+
+            chain = chain ? fnet_netbuf_concat(chain, nb) : nb;
+            total += len;
+        }
+        FNET_TEST_CHECK(chain->total_length == (unsigned long)total);
+
+        /* The whole chain, and a part of it.*/
+        FNET_TEST_CHECK(fnet_checksum(chain, total) == (unsigned short)~ref_sum(data, total));
+        len = total ? (int)(test_rand() % total) : 0;
+        FNET_TEST_CHECK(fnet_checksum(chain, len) == (unsigned short)~ref_sum(data, len));
+
+        fnet_netbuf_free_chain(chain);
+    }
+    fnet_test_pass("net_buf chains with odd fragments");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    FNET_TEST_CHECK(fnet_heap_init(heap, sizeof(heap)) == FNET_OK);
+
+    test_buf();
+    test_copy();
+    test_chain();
+
+    return 0;
+}
@@ -0,0 +1,389 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_http.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief HTTP server request reader test.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+
+#include "fnet.h"
+#include "fnet_http.h"
+#include "fnet_http_post.h"
+#include "fnet_poll.h"
+#include "fnet_fs.h"
+
+#define SOCKET_LISTEN   ((SOCKET)1)
+#define SOCKET_CLIENT   ((SOCKET)2)
+
+#define INDEX_FILE      ((FNET_FS_FILE)1)
+#define BODY_SIZE       (1000)
+
+static unsigned char heap[16 * 1024];
+
+/* The request, rx_avail bytes of it have arrived so far.*/
+static const char   *rx_data;
+static int          rx_len;
+static int          rx_avail;
+static int          rx_pos;
+static int          rx_calls;
+static int          connected;
+static int          closed;
+
+static char         tx_data[4096];
+static int          tx_len;
+
+static fnet_poll_service_t  service;
+static void                 *service_param;
+
+static const char   index_html[] = "<html>index</html>";
+static int          index_pos;
+
+static char         post_data[2 * BODY_SIZE];
+static int          post_len;
+
+/************************************************************************
+* Socket interface, a single client connection.
+*************************************************************************/
+SOCKET socket( fnet_address_family_t family, fnet_socket_type_t type, int protocol )
+{
+    return SOCKET_LISTEN;
+}
+
+int bind( SOCKET s, const struct sockaddr *name, int namelen )
+{
+    return FNET_OK;
+}
+
+int listen( SOCKET s, int backlog )
+{
+    return FNET_OK;
+}
+
+int setsockopt( SOCKET s, int level, int optname, char *optval, int optlen )
+{
+    return FNET_OK;
+}
+
+int getsockopt( SOCKET s, int level, int optname, char *optval, int *optlen )
+{
+    *(unsigned long *)optval = 1024;
+    return FNET_OK;
+}
+
+SOCKET accept( SOCKET s, struct sockaddr *addr, int *addrlen )
+{
+    if(rx_data == 0 || connected)
+        return SOCKET_INVALID;
+
+    fnet_memset_zero(addr, sizeof(*addr));
+    connected = 1;
+    return SOCKET_CLIENT;
+}
+
+int recv( SOCKET s, char *buf, int len, int flags )
+{
+    FNET_TEST_CHECK(s == SOCKET_CLIENT && len > 0);
+
+    rx_calls++;
+    if(len > rx_avail - rx_pos)
+        len = rx_avail - rx_pos;
+    memcpy(buf, rx_data + rx_pos, (size_t)len);
+    rx_pos += len;
+
+    return len;
+}
+
+int send( SOCKET s, char *buf, int len, int flags )
+{
+    FNET_TEST_CHECK(s == SOCKET_CLIENT);
+    FNET_TEST_CHECK(tx_len + len < (int)sizeof(tx_data));
+
+    memcpy(tx_data + tx_len, buf, (size_t)len);
+    tx_len += len;
+    tx_data[tx_len] = 0;
+
+    return len;
+}
+
+int closesocket( SOCKET s )
+{
+    if(s == SOCKET_CLIENT)
+    {
+        connected = 0;
+        closed = 1;
+    }
+    return FNET_OK;
+}
+
+/************************************************************************
+* File system, the index file only.
+*************************************************************************/
+FNET_FS_DIR fnet_fs_opendir( const char *dirname )
+{
+    return (FNET_FS_DIR)1;
+}
+
+int fnet_fs_closedir( FNET_FS_DIR dir )
+{
+    return FNET_OK;
+}
+
+FNET_FS_FILE fnet_fs_fopen_re( const char *filename, const char *mode, FNET_FS_FILE dir )
+{
+    return fnet_strcmp(filename, "index.html") ? 0 : INDEX_FILE;
+}
+
+int fnet_fs_fclose( FNET_FS_FILE file )
+{
+    return FNET_OK;
+}
+
+void fnet_fs_rewind( FNET_FS_FILE file )
+{
+    index_pos = 0;
+}
+
+unsigned long fnet_fs_fread( void *buf, unsigned long size, FNET_FS_FILE file )
+{
+    unsigned long n = sizeof(index_html) - 1 - (unsigned long)index_pos;
+
+    if(n > size)
+        n = size;
+    memcpy(buf, index_html + index_pos, n);
+    index_pos += (int)n;
+
+    return n;
+}
+
+int fnet_fs_finfo( FNET_FS_FILE file, struct fnet_fs_dirent *dirent )
+{
+    fnet_memset_zero(dirent, sizeof(*dirent));
+    dirent->d_size = sizeof(index_html) - 1;
+    return FNET_OK;
+}
+
+/************************************************************************
+* Polling and timers.
+*************************************************************************/
+fnet_poll_desc_t fnet_poll_service_register( fnet_poll_service_t service_fn, void *param )
+{
+    service = service_fn;
+    service_param = param;
+    return 0;
+}
+
+int fnet_poll_service_unregister( fnet_poll_desc_t desc )
+{
+    service = 0;
+    return FNET_OK;
+}
+
+int fnet_poll_service_wait_socket( fnet_poll_desc_t desc, SOCKET s, int events )
+{
+    return FNET_OK;
+}
+
+unsigned long fnet_timer_ticks( void )
+{
+    return 0;
+}
+
+unsigned long fnet_timer_get_interval( unsigned long start, unsigned long end )
+{
+    return end - start;
+}
+
+/************************************************************************
+* POST "upload", keeps the Entity-Body.
+*************************************************************************/
+static int post_receive( char *buffer, unsigned long buffer_size, long *cookie )
+{
+    FNET_TEST_CHECK(post_len + (int)buffer_size <= (int)sizeof(post_data));
+
+    memcpy(post_data + post_len, buffer, buffer_size);
+    post_len += (int)buffer_size;
+
+    return FNET_OK;
+}
+
+static unsigned long post_send( char *buffer, unsigned long buffer_size, char *eof, long *cookie )
+{
+    *eof = 1;
+    return (unsigned long)fnet_snprintf(buffer, buffer_size, "done %d", post_len);
+}
+
+static const struct fnet_http_post post_table[] =
+{
+    {"upload", 0, post_receive, post_send},
+    {0, 0, 0, 0}
+};
+
+/* Serves one request, which arrives 'piece' bytes per poll.*/
+static void serve( const char *request, int len, int piece )
+{
+    int i;
+
+    rx_data = request;
+    rx_len = len;
+    rx_avail = rx_pos = rx_calls = 0;
+    tx_len = post_len = closed = 0;
+    tx_data[0] = 0;
+
+    for(i = 0; (i < 100000) && (closed == 0); i++)
+    {
+        rx_avail = (rx_avail + piece < rx_len) ? (rx_avail + piece) : rx_len;
+        service(service_param);
+    }
+    FNET_TEST_CHECK(closed);
+
+    rx_data = 0;
+}
+
+static int status_is( const char *status )
+{
+    return (fnet_strncmp(tx_data, "HTTP/1.", 7) == 0) && (fnet_strncmp(tx_data + 8, status, fnet_strlen(status)) == 0);
+}
+
+static const char *response_body( void )
+{
+    const char *body = fnet_strstr(tx_data, "\r\n\r\n");
+
+    FNET_TEST_CHECK(body != 0);
+    return body + 4;
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_get( void )
+{
+    static const char request[] = "GET / HTTP/1.1\r\nHost: 10.0.0.1\r\nUser-Agent: test\r\nAccept: */*\r\n\r\n";
+    int len = (int)sizeof(request) - 1;
+    int piece;
+
+    /* Every split, down to one byte per recv().*/
+    for(piece = 1; piece <= len; piece++)
+    {
+        serve(request, len, piece);
+        FNET_TEST_CHECK(status_is(" 200 OK\r\n"));
+        FNET_TEST_CHECK(fnet_strstr(tx_data, "Content-Length: 18\r\n") != 0);
+        FNET_TEST_CHECK(fnet_strcmp(response_body(), index_html) == 0);
+    }
+    fnet_test_pass("GET, request split anywhere");
+
+    /* A request in one segment is read with one recv().*/
+    serve(request, len, len);
+    FNET_TEST_CHECK(rx_calls == 1);
+    fnet_test_pass("GET, one recv() per segment");
+
+    serve("GET /missing.html HTTP/1.0\r\n\r\n", 30, 30);
+    FNET_TEST_CHECK(status_is(" 404 "));
+    fnet_test_pass("GET, not found");
+}
+
+static void test_long_header( void )
+{
+    static char request[1024];
+    static const int pieces[] = {1, 7, 64, 299, 300, 301, 1024};
+    int         len, i;
+
+    /* A header line longer than the buffer is skipped.*/
+    len = fnet_sprintf(request, "GET / HTTP/1.1\r\nCookie: ");
+    for(i = 0; i < 800; i++)
+        request[len++] = (char)('a' + i % 26);
+    len += fnet_sprintf(request + len, "\r\nHost: 10.0.0.1\r\n\r\n");
+
+    for(i = 0; i < (int)(sizeof(pieces) / sizeof(pieces[0])); i++)
+    {
+        serve(request, len, pieces[i]);
+        FNET_TEST_CHECK(status_is(" 200 OK\r\n"));
+        FNET_TEST_CHECK(fnet_strcmp(response_body(), index_html) == 0);
+    }
+    fnet_test_pass("header line longer than the buffer");
+}
+
+static void test_post( void )
+{
+    static char request[2048];
+    static const int pieces[] = {1, 13, 47, 100, 333, 2048};
+    int         len, body, i;
+
+    len = fnet_sprintf(request, "POST /upload HTTP/1.1\r\nHost: 10.0.0.1\r\nContent-Length: %d\r\n\r\n", BODY_SIZE);
+    body = len;
+    for(i = 0; i < BODY_SIZE; i++)
+        request[len++] = (char)(' ' + i % 90);
+    /* A pipelined request, it is not part of the Entity-Body.*/
+    len += fnet_sprintf(request + len, "GET / HTTP/1.1\r\n\r\n");
+
+    for(i = 0; i < (int)(sizeof(pieces) / sizeof(pieces[0])); i++)
+    {
+        serve(request, len, pieces[i]);
+        FNET_TEST_CHECK(post_len == BODY_SIZE);
+        FNET_TEST_CHECK(memcmp(post_data, request + body, BODY_SIZE) == 0);
+        FNET_TEST_CHECK(status_is(" 200 OK\r\n"));
+        FNET_TEST_CHECK(fnet_strcmp(response_body(), "done 1000") == 0);
+    }
+    fnet_test_pass("POST, split anywhere, pipelined data");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    struct fnet_http_params params;
+
+    FNET_TEST_CHECK(fnet_heap_init(heap, sizeof(heap)) == FNET_OK);
+
+    fnet_memset_zero(&params, sizeof(params));
+    params.root_path = "/";
+    params.index_path = "index.html";
+    params.post_table = post_table;
+    FNET_TEST_CHECK(fnet_http_init(&params) != (fnet_http_desc_t)FNET_ERR);
+    FNET_TEST_CHECK(service != 0);
+
+    test_get();
+    test_long_header();
+    test_post();
+
+    return 0;
+}
@@ -0,0 +1,313 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_ip.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief IP input queue test.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+
+#include "fnet.h"
+#include "fnet_ip_prv.h"
+#include "fnet_netif_prv.h"
+#include "fnet_eth_prv.h"
+#include "fnet_ip6_prv.h"
+#include "fnet_nd6.h"
+#include "fnet_prot.h"
+#include "fnet_icmp.h"
+#include "fnet_checksum.h"
+#include "fnet_timer.h"
+
+#define LOCAL_IP        FNET_IP4_ADDR_INIT(10, 0, 0, 1)
+#define PEER_IP         FNET_IP4_ADDR_INIT(10, 0, 0, 2)
+#define TEST_PROTOCOL   (253)           /* Experimental protocol number.*/
+#define RECEIVED_MAX    (64)
+
+static unsigned char heap[32 * 1024];
+
+static fnet_netif_api_t netif_api;
+static fnet_netif_t     netif;
+
+/* Datagrams passed to the protocol, by IP identification.*/
+static unsigned short   received[RECEIVED_MAX];
+static int              received_count;
+static int              requeue;        /* Datagrams the protocol input queues again.*/
+static int              events;         /* FNET_EVENT_IP raised.*/
+
+static fnet_netbuf_t *datagram( unsigned short id, unsigned long length );
+
+/* The FNET_EVENT_IP handler, declared in fnet_ip.c only.*/
+void fnet_ip_input_low( void );
+
+/************************************************************************
+* Stack modules not linked.
+*************************************************************************/
+fnet_timer_desc_t fnet_timer_new( unsigned long period_ticks, void (*handler)( void *cookie ), void *cookie )
+{
+    return (fnet_timer_desc_t)1;
+}
+
+void fnet_timer_free( fnet_timer_desc_t timer )
+{
+}
+
+int fnet_event_init( fnet_event_t event_number, void (*event_handler)( void ) )
+{
+    return FNET_OK;
+}
+
+void fnet_event_raise( fnet_event_t event_number )
+{
+    FNET_TEST_CHECK(event_number == FNET_EVENT_IP);
+    events++;
+}
+
+void fnet_icmp_error( fnet_netif_t *netif_ptr, unsigned char type, unsigned char code, fnet_netbuf_t *nb )
+{
+    fnet_netbuf_free_chain(nb);
+}
+
+void fnet_raw_input_ip4( fnet_netif_t *netif_ptr, fnet_ip4_addr_t src_ip, fnet_ip4_addr_t dest_ip, fnet_netbuf_t *nb, fnet_netbuf_t *ip4_nb )
+{
+}
+
+/************************************************************************
+* Network interface. The driver keeps no statistics, Ethernet and IPv6
+* are linked by the network interface module.
+*************************************************************************/
+static int netif_get_statistics( fnet_netif_t *netif_ptr, struct fnet_netif_statistics *statistics )
+{
+    return FNET_OK;
+}
+
+fnet_netif_t fnet_eth0_if;
+const fnet_ip6_addr_t fnet_ip6_addr_any;
+
+int fnet_eth_init( fnet_netif_t *netif_ptr )
+{
+    return FNET_ERR;
+}
+
+void fnet_ip6_get_solicited_multicast_addr( fnet_ip6_addr_t *ip_addr, fnet_ip6_addr_t *solicited_multicast_addr )
+{
+}
+
+void fnet_nd6_dad_start( struct fnet_netif *netif_ptr, struct fnet_netif_ip6_addr *addr_info )
+{
+}
+
+unsigned long fnet_timer_seconds( void )
+{
+    return 0;
+}
+
+/************************************************************************
+* Transport protocol, keeps the received datagrams.
+*************************************************************************/
+static void test_input( fnet_netif_t *netif_ptr, fnet_ip4_addr_t src_ip, fnet_ip4_addr_t dest_ip, fnet_netbuf_t *nb, fnet_netbuf_t *ip4_nb )
+{
+    fnet_ip_header_t *hdr = ip4_nb->data_ptr;
+
+    FNET_TEST_CHECK((netif_ptr == &netif) && (src_ip == PEER_IP) && (dest_ip == LOCAL_IP));
+    FNET_TEST_CHECK(received_count < RECEIVED_MAX);
+    received[received_count++] = fnet_ntohs(hdr->id);
+
+    /* A datagram received while the queue is processed.*/
+    if(requeue)
+    {
+        requeue--;
+        fnet_ip_input(&netif, datagram((unsigned short)(fnet_ntohs(hdr->id) + 100), 40));
+    }
+
+    fnet_netbuf_free_chain(nb);
+    fnet_netbuf_free_chain(ip4_nb);
+}
+
+static fnet_prot_if_t test_prot;
+
+fnet_prot_if_t *fnet_prot_find( fnet_address_family_t family, fnet_socket_type_t type, int protocol )
+{
+    return (protocol == TEST_PROTOCOL) ? &test_prot : FNET_NULL;
+}
+
+/************************************************************************
+* Datagrams.
+*************************************************************************/
+static fnet_netbuf_t *datagram( unsigned short id, unsigned long length )
+{
+    fnet_netbuf_t       *nb = fnet_netbuf_new((int)length, FNET_TRUE);
+    fnet_ip_header_t    *hdr;
+
+    FNET_TEST_CHECK(nb != 0);
+    hdr = nb->data_ptr;
+    fnet_memset_zero(nb->data_ptr, length);
+    FNET_IP_HEADER_SET_VERSION(hdr, 4);
+    FNET_IP_HEADER_SET_HEADER_LENGTH(hdr, sizeof(fnet_ip_header_t) >> 2);
+    hdr->total_length = fnet_htons((unsigned short)length);
+    hdr->id = fnet_htons(id);
+    hdr->ttl = 64;
+    hdr->protocol = TEST_PROTOCOL;
+    hdr->source_addr = PEER_IP;
+    hdr->desination_addr = LOCAL_IP;
+    hdr->checksum = fnet_checksum(nb, sizeof(fnet_ip_header_t));
+
+    return nb;
+}
+
+static unsigned long queue_drop( void )
+{
+    struct fnet_netif_statistics stat;
+
+    FNET_TEST_CHECK(fnet_netif_get_statistics(&netif, &stat) == FNET_OK);
+    return stat.rx_queue_drop;
+}
+
+static void check_received( unsigned short first, int count )
+{
+    int i;
+
+    FNET_TEST_CHECK(received_count == count);
+    for(i = 0; i < count; i++)
+        FNET_TEST_CHECK(received[i] == (unsigned short)(first + i));
+    received_count = 0;
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_ring_full( void )
+{
+    unsigned long   free_mem = fnet_free_mem_status();
+    unsigned long   drop = queue_drop();
+    int             i;
+
+    /* The ring holds FNET_CFG_IP_QUEUE_SIZE datagrams, the rest are 
+     * counted and freed.*/
+    events = 0;
+    for(i = 0; i < FNET_CFG_IP_QUEUE_SIZE + 3; i++)
+        fnet_ip_input(&netif, datagram((unsigned short)i, 40));
+
+    FNET_TEST_CHECK(events == FNET_CFG_IP_QUEUE_SIZE);
+    FNET_TEST_CHECK(queue_drop() == drop + 3);
+
+    fnet_ip_input_low();
+    check_received(0, FNET_CFG_IP_QUEUE_SIZE);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+
+    /* Room again.*/
+    fnet_ip_input(&netif, datagram(50, 40));
+    fnet_ip_input_low();
+    check_received(50, 1);
+    FNET_TEST_CHECK(queue_drop() == drop + 3);
+    fnet_test_pass("ring full, drops counted");
+}
+
+static void test_bytes_full( void )
+{
+    unsigned long   free_mem = fnet_free_mem_status();
+    unsigned long   drop = queue_drop();
+    unsigned long   length = FNET_IP_QUEUE_COUNT_MAX / 2 - 100;
+
+    /* The queued bytes are limited, before the ring is full.*/
+    fnet_ip_input(&netif, datagram(0, length));
+    fnet_ip_input(&netif, datagram(1, length));
+    fnet_ip_input(&netif, datagram(2, length));
+    fnet_ip_input(&netif, datagram(3, 40));
+    FNET_TEST_CHECK(queue_drop() == drop + 1);
+
+    fnet_ip_input_low();
+    FNET_TEST_CHECK(received_count == 3);
+    FNET_TEST_CHECK((received[0] == 0) && (received[1] == 1) && (received[2] == 3));
+    received_count = 0;
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("queued bytes limited");
+}
+
+static void test_batch( void )
+{
+    unsigned long free_mem = fnet_free_mem_status();
+
+    /* A call processes the datagrams queued when it starts, those 
+     * received meanwhile raise the event for the next call.*/
+    events = 0;
+    fnet_ip_input(&netif, datagram(0, 40));
+    fnet_ip_input(&netif, datagram(1, 40));
+    fnet_ip_input(&netif, datagram(2, 40));
+    requeue = 3;
+
+    fnet_ip_input_low();
+    check_received(0, 3);
+    FNET_TEST_CHECK(events == 6);
+
+    fnet_ip_input_low();
+    check_received(100, 3);
+
+    fnet_ip_input_low();
+    FNET_TEST_CHECK(received_count == 0);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("one batch per call");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    FNET_TEST_CHECK(fnet_heap_init(heap, sizeof(heap)) == FNET_OK);
+
+    test_prot.protocol = TEST_PROTOCOL;
+    test_prot.prot_input_ip4 = test_input;
+    netif_api.type = FNET_NETIF_TYPE_ETHERNET;
+    netif_api.get_statistics = netif_get_statistics;
+    netif.api = &netif_api;
+    netif.ip4_addr.address = LOCAL_IP;
+    netif.ip4_addr.subnetmask = FNET_IP4_ADDR_INIT(255, 255, 255, 0);
+
+    FNET_TEST_CHECK(fnet_ip_init() == FNET_OK);
+
+    test_ring_full();
+    test_bytes_full();
+    test_batch();
+
+    fnet_ip_release();
+
+    return 0;
+}
@@ -0,0 +1,286 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_isr.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Interrupt dispatcher test.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+#include <stdarg.h>
+
+#include "fnet.h"
+#include "LPC17xx.h"
+
+/* The dispatcher source is included, to check its table, map and
+ * pending mask.*/
+#include "fnet_isr.c"
+
+#define EVENT_VECTOR(event)     (FNET_EVENT_VECTOR_NUMBER + (event))
+
+static int  irq_disabled;
+static int  tops;
+static char bottoms[64];
+static int  repend_a;
+
+/************************************************************************
+* CPU, IRQs are only counted.
+*************************************************************************/
+fnet_cpu_irq_desc_t fnet_cpu_irq_disable( void )
+{
+    return (fnet_cpu_irq_desc_t)irq_disabled++;
+}
+
+void fnet_cpu_irq_enable( fnet_cpu_irq_desc_t irq_desc )
+{
+    irq_disabled = (int)irq_desc;
+}
+
+int fnet_cpu_isr_install( unsigned int vector_number, unsigned int priority )
+{
+    return FNET_OK;
+}
+
+/************************************************************************
+* Handlers, the bottom halves append their letter to 'bottoms'.
+*************************************************************************/
+static void bottom( char letter )
+{
+    size_t len = strlen(bottoms);
+
+    FNET_TEST_CHECK(len + 1 < sizeof(bottoms));
+    bottoms[len] = letter;
+    bottoms[len + 1] = 0;
+}
+
+static void top( void )
+{
+    tops++;
+}
+
+static void bottom_u( void ) { bottom('u'); }
+static void bottom_r( void ) { bottom('r'); }
+static void bottom_t( void ) { bottom('t'); }
+static void bottom_e( void ) { bottom('e'); }
+static void bottom_i( void ) { bottom('i'); }
+static void bottom_x( void ) { bottom('x'); }
+
+/* Pends UART0 and itself again, 'repend_a' times.*/
+static void bottom_a( void )
+{
+    bottom('a');
+    if(repend_a)
+    {
+        repend_a--;
+        fnet_isr_handler(UART0_IRQn);
+        fnet_event_raise(FNET_EVENT_ARP);
+    }
+}
+
+static const struct
+{
+    unsigned int    vector_number;
+    char            letter;
+} names[] =
+{
+    {UART0_IRQn, 'u'},
+    {TIMER3_IRQn, 'r'},
+    {TIMER2_IRQn, 't'},
+    {ENET_IRQn, 'e'},
+    {EVENT_VECTOR(FNET_EVENT_IP), 'i'},
+    {EVENT_VECTOR(FNET_EVENT_ARP), 'a'}
+};
+
+/* Checks the map against the table and returns the letters of the 
+ * entries, in table order.*/
+static const char *table( void )
+{
+    static char     letters[FNET_ISR_ENTRY_MAX + 1];
+    unsigned int    entry;
+    int             i, mapped = 0;
+
+    for(i = 0; i < FNET_ISR_INDEX_SIZE; i++)
+        mapped += (fnet_isr_map[i] != 0);
+    FNET_TEST_CHECK(mapped == (int)fnet_isr_count);
+
+    for(entry = 0; entry < fnet_isr_count; entry++)
+    {
+        FNET_TEST_CHECK(fnet_isr_map[fnet_isr_index(fnet_isr_table[entry].vector_number)] == entry + 1);
+        if(entry)
+            FNET_TEST_CHECK(fnet_isr_table[entry - 1].priority >= fnet_isr_table[entry].priority);
+
+        letters[entry] = '?';
+        for(i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+        {
+            if(names[i].vector_number == fnet_isr_table[entry].vector_number)
+                letters[entry] = names[i].letter;
+        }
+    }
+    letters[entry] = 0;
+    FNET_TEST_CHECK(irq_disabled == 0);
+
+    return letters;
+}
+
+/* Pending bits of the entries 'first', 'second', ... up to -1.*/
+static unsigned long pended( int first, ... )
+{
+    unsigned long   mask = 0;
+    int             entry;
+    va_list         ap;
+
+    va_start(ap, first);
+    for(entry = first; entry >= 0; entry = va_arg(ap, int))
+        mask |= FNET_ISR_ENTRY_BIT(entry);
+    va_end(ap);
+
+    return mask;
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_map( void )
+{
+    unsigned int vector_number;
+
+    fnet_isr_init();
+
+    /* Sorted by priority, events last, the same priority in 
+     * registration order.*/
+    FNET_TEST_CHECK(fnet_isr_vector_init(TIMER2_IRQn, top, bottom_t, 3) == FNET_OK);
+    FNET_TEST_CHECK(fnet_event_init(FNET_EVENT_IP, bottom_i) == FNET_OK);
+    FNET_TEST_CHECK(fnet_isr_vector_init(ENET_IRQn, top, bottom_e, 2) == FNET_OK);
+    FNET_TEST_CHECK(fnet_event_init(FNET_EVENT_ARP, bottom_a) == FNET_OK);
+    FNET_TEST_CHECK(fnet_isr_vector_init(TIMER3_IRQn, top, bottom_r, 2) == FNET_OK);
+    FNET_TEST_CHECK(fnet_isr_vector_init(UART0_IRQn, top, bottom_u, 7) == FNET_OK);
+    FNET_TEST_CHECK(strcmp(table(), "uteria") == 0);
+
+    /* Out of the map.*/
+    FNET_TEST_CHECK(fnet_isr_vector_init(FNET_CFG_CPU_VECTOR_NUMBER_MAX, top, bottom_x, 1) == FNET_ERR);
+    FNET_TEST_CHECK(fnet_isr_vector_init(EVENT_VECTOR(FNET_EVENT_NUMBER), top, bottom_x, 1) == FNET_ERR);
+    FNET_TEST_CHECK(strcmp(table(), "uteria") == 0);
+
+    fnet_isr_vector_release(ENET_IRQn);
+    fnet_isr_vector_release(ENET_IRQn);
+    FNET_TEST_CHECK(strcmp(table(), "utria") == 0);
+
+    /* Registered again, with another priority.*/
+    FNET_TEST_CHECK(fnet_isr_vector_init(TIMER3_IRQn, top, bottom_r, 5) == FNET_OK);
+    FNET_TEST_CHECK(strcmp(table(), "urtia") == 0);
+
+    /* A full table.*/
+    for(vector_number = 10; fnet_isr_count < FNET_ISR_ENTRY_MAX; vector_number++)
+        FNET_TEST_CHECK(fnet_isr_vector_init(vector_number, top, bottom_x, 1) == FNET_OK);
+    FNET_TEST_CHECK(fnet_isr_vector_init(vector_number, top, bottom_x, 1) == FNET_ERR);
+    FNET_TEST_CHECK(strlen(table()) == FNET_ISR_ENTRY_MAX);
+    FNET_TEST_CHECK((strncmp(table(), "urt?", 4) == 0) && (strcmp(table() + FNET_ISR_ENTRY_MAX - 3, "?ia") == 0));
+    while(vector_number-- > 10)
+        fnet_isr_vector_release(vector_number);
+    FNET_TEST_CHECK(strcmp(table(), "urtia") == 0);
+
+    fnet_test_pass("vector map, entries by priority");
+}
+
+static void test_pending( void )
+{
+    /* u r t i a */
+    bottoms[0] = 0;
+    tops = 0;
+    fnet_isr_lock();
+    fnet_isr_handler(TIMER2_IRQn);
+    fnet_isr_handler(UART0_IRQn);
+    fnet_event_raise(FNET_EVENT_IP);
+    fnet_isr_handler(TIMER3_IRQn);
+    fnet_isr_handler(TIMER2_IRQn);
+    FNET_TEST_CHECK((tops == 4) && (bottoms[0] == 0));
+    FNET_TEST_CHECK(fnet_isr_pended == pended(0, 1, 2, 3, -1));
+
+    /* The pending bits move with the entries.*/
+    FNET_TEST_CHECK(fnet_isr_vector_init(ENET_IRQn, top, bottom_e, 4) == FNET_OK);
+    FNET_TEST_CHECK(strcmp(table(), "uretia") == 0);
+    FNET_TEST_CHECK(fnet_isr_pended == pended(0, 1, 3, 4, -1));
+    fnet_isr_vector_release(TIMER3_IRQn);
+    FNET_TEST_CHECK(strcmp(table(), "uetia") == 0);
+    FNET_TEST_CHECK(fnet_isr_pended == pended(0, 2, 3, -1));
+
+    fnet_isr_unlock();
+    FNET_TEST_CHECK(strcmp(bottoms, "uti") == 0);
+    FNET_TEST_CHECK((fnet_isr_pended == 0) && (fnet_locked == 0));
+
+    /* Not locked, the bottom half runs at once.*/
+    fnet_isr_handler(ENET_IRQn);
+    fnet_event_raise(FNET_EVENT_ARP);
+    FNET_TEST_CHECK(strcmp(bottoms, "utiea") == 0);
+    FNET_TEST_CHECK(fnet_isr_pended == 0);
+
+    fnet_test_pass("pending mask, run by priority");
+}
+
+static void test_repend( void )
+{
+    /* u e t i a. The last bottom half pends the first one and itself,
+     * twice. Both run again in the same fnet_isr_unlock().*/
+    bottoms[0] = 0;
+    repend_a = 2;
+    fnet_isr_lock();
+    fnet_isr_lock();
+    fnet_event_raise(FNET_EVENT_ARP);
+    fnet_isr_handler(TIMER2_IRQn);
+    fnet_isr_unlock();
+    FNET_TEST_CHECK(bottoms[0] == 0);
+    fnet_isr_unlock();
+    FNET_TEST_CHECK(strcmp(bottoms, "tauaua") == 0);
+    FNET_TEST_CHECK((fnet_isr_pended == 0) && (fnet_locked == 0) && (repend_a == 0));
+
+    fnet_test_pass("re-pended while unlocking");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    test_map();
+    test_pending();
+    test_repend();
+
+    return 0;
+}
@@ -0,0 +1,670 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_lpc_eth.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief LPC17xx EMAC driver test, against a software model of the DMA rings.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+#include <sys/mman.h>
+
+#include "fnet.h"
+#include "LPC17xx.h"
+
+/* The peripheral registers are kept in host memory.*/
+static LPC_EMAC_TypeDef fnet_test_emac;
+static LPC_SC_TypeDef   fnet_test_sc;
+static LPC_TIM_TypeDef  fnet_test_tim3;
+
+#undef LPC_EMAC
+#define LPC_EMAC    (&fnet_test_emac)
+#undef LPC_SC
+#define LPC_SC      (&fnet_test_sc)
+#undef LPC_TIM3
+#define LPC_TIM3    (&fnet_test_tim3)
+
+#include "fnet_lpc_eth.c"
+
+/* The DMA block and the network heap stay at their target addresses,
+ * in the AHB SRAM banks, so that the driver takes the same decisions.*/
+#define AHB_SRAM_START      (0x2007C000)
+#define AHB_SRAM_SIZE       (0x8000)
+
+#define FRAME_MAX           (LPC_ETH_MAX_FRAME_SIZE)
+
+static fnet_netif_t netif;
+static const fnet_mac_addr_t dest_addr = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+static const fnet_mac_addr_t src_addr = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static const unsigned char flash_data[1000] = {1, 2, 3, 4, 5};
+
+/************************************************************************
+* Ethernet layer. The received frames are kept for the test cases.
+*************************************************************************/
+#define RX_FRAMES_MAX       (16)
+
+static fnet_netbuf_t    *rx_nb[RX_FRAMES_MAX];
+static int              rx_frames;
+
+void fnet_eth_prot_input( fnet_netif_t *netif, fnet_netbuf_t *nb, unsigned short protocol, const fnet_mac_addr_t source_addr )
+{
+    FNET_TEST_CHECK(rx_frames < RX_FRAMES_MAX);
+    FNET_TEST_CHECK(protocol == FNET_HTONS(FNET_ETH_TYPE_IP4));
+    FNET_TEST_CHECK(memcmp(source_addr, dest_addr, sizeof(fnet_mac_addr_t)) == 0);
+    rx_nb[rx_frames++] = nb;
+}
+
+void fnet_eth_drain( fnet_netif_t *netif ) {}
+void fnet_eth_change_addr_notify( fnet_netif_t *netif ) {}
+void fnet_eth_output_ip4( fnet_netif_t *netif, fnet_ip4_addr_t dest_ip_addr, fnet_netbuf_t *nb ) {}
+void fnet_eth_ip6_output( fnet_netif_t *netif, fnet_ip6_addr_t *src_ip_addr, fnet_ip6_addr_t *dest_ip_addr, fnet_netbuf_t *nb ) {}
+void fnet_eth_multicast_leave_ip4( fnet_netif_t *netif, fnet_ip4_addr_t multicast_addr ) {}
+void fnet_eth_multicast_join_ip4( fnet_netif_t *netif, fnet_ip4_addr_t multicast_addr ) {}
+void fnet_eth_multicast_leave_ip6( fnet_netif_t *netif, fnet_ip6_addr_t *multicast_addr ) {}
+void fnet_eth_multicast_join_ip6( fnet_netif_t *netif, const fnet_ip6_addr_t *multicast_addr ) {}
+
+/************************************************************************
+* Transmit side of the EMAC: takes the descriptors from TxConsumeIndex
+* and gathers one frame, up to the descriptor with TX_DESCRIPTOR_LAST_FRAME.
+* Returns the frame length, or 0 if the ring is empty.
+*************************************************************************/
+static int emac_tx_frame( unsigned char *frame, int *descriptors )
+{
+    int                         length = 0;
+    unsigned long               control;
+    fnet_lpceth_tx_descriptor   *descriptor;
+
+    *descriptors = 0;
+
+    if(LPC_EMAC->TxConsumeIndex == LPC_EMAC->TxProduceIndex)
+        return 0;
+
+    do
+    {
+        /* A frame never ends past the last descriptor given to the EMAC.*/
+        FNET_TEST_CHECK(LPC_EMAC->TxConsumeIndex != LPC_EMAC->TxProduceIndex);
+
+        descriptor = fnet_lpceth_tx_descriptor_at(LPC_EMAC->TxConsumeIndex);
+        control = descriptor->controlWord;
+
+        FNET_TEST_CHECK(length + (int)(control & TX_DESCRIPTOR_SIZE_BITS) + 1 <= FRAME_MAX);
+        memcpy(frame + length, descriptor->packetPtr, (control & TX_DESCRIPTOR_SIZE_BITS) + 1);
+        length += (control & TX_DESCRIPTOR_SIZE_BITS) + 1;
+        (*descriptors)++;
+
+        /* Read-only for the driver.*/
+        *(volatile uint32_t *)&LPC_EMAC->TxConsumeIndex = 
+            (LPC_EMAC->TxConsumeIndex == LPC_EMAC->TxDescriptorNumber) ? 0 : LPC_EMAC->TxConsumeIndex + 1;
+    }
+    while((control & TX_DESCRIPTOR_LAST_FRAME) == 0);
+
+    return length;
+}
+
+/************************************************************************
+* Receive side of the EMAC: writes one frame from the peer into the 
+* buffer of the descriptor at RxProduceIndex and hands it to the driver.
+* The size field holds the frame length plus one, as the driver reads it.
+*************************************************************************/
+static void fill( unsigned char *data, int length, int seed );
+
+static void emac_rx_frame( int data_length, int seed )
+{
+    unsigned long               index = LPC_EMAC->RxProduceIndex;
+    unsigned long               next = (index == LPC_EMAC->RxDescriptorNumber) ? 0 : index + 1;
+    fnet_lpceth_rx_descriptor   *descriptor = fnet_lpceth_rx_descriptor_at(index);
+    fnet_lpceth_rx_status       *status = (fnet_lpceth_rx_status *)(LPC_EMAC->RxStatus + index * sizeof(fnet_lpceth_rx_status));
+    unsigned char               *frame = descriptor->packetPtr;
+
+    /* The EMAC does not overwrite frames the driver has not consumed.*/
+    FNET_TEST_CHECK(next != LPC_EMAC->RxConsumeIndex);
+
+    memcpy(frame, src_addr, sizeof(fnet_mac_addr_t));
+    memcpy(frame + 6, dest_addr, sizeof(fnet_mac_addr_t));
+    frame[12] = 0x08;
+    frame[13] = 0x00;
+    fill(frame + sizeof(fnet_eth_header_t), data_length, seed);
+    status->statusInfo = (sizeof(fnet_eth_header_t) + data_length + 1) & RX_STATUS_SIZE_BITS;
+
+    /* Read-only for the driver.*/
+    *(volatile uint32_t *)&LPC_EMAC->RxProduceIndex = next;
+}
+
+/************************************************************************
+* Test helpers.
+*************************************************************************/
+static void fill( unsigned char *data, int length, int seed )
+{
+    int i;
+
+    for(i = 0; i < length; i++)
+        data[i] = (unsigned char)(seed * 31 + i * 7);
+}
+
+static fnet_netbuf_t *payload( int headroom, int length, int seed )
+{
+    fnet_netbuf_t *nb = fnet_netbuf_new_headroom(headroom, length, FNET_FALSE);
+
+    FNET_TEST_CHECK(nb != 0);
+    fill((unsigned char *)nb->data_ptr, length, seed);
+    return nb;
+}
+
+/* Checks a transmitted frame against the Ethernet header and the expected payload. */
+static void check_frame( const unsigned char *frame, int length, const unsigned char *data, int data_length )
+{
+    FNET_TEST_CHECK(length == (int)sizeof(fnet_eth_header_t) + data_length);
+    FNET_TEST_CHECK(memcmp(frame, dest_addr, sizeof(fnet_mac_addr_t)) == 0);
+    FNET_TEST_CHECK(memcmp(frame + 6, src_addr, sizeof(fnet_mac_addr_t)) == 0);
+    FNET_TEST_CHECK(frame[12] == 0x08 && frame[13] == 0x00);
+    FNET_TEST_CHECK(memcmp(frame + sizeof(fnet_eth_header_t), data, (unsigned)data_length) == 0);
+}
+
+static void check_payload( const unsigned char *frame, int length, int data_length, int seed )
+{
+    static unsigned char data[FRAME_MAX];
+
+    fill(data, data_length, seed);
+    check_frame(frame, length, data, data_length);
+}
+
+/* Overwrites free heap memory, so that data freed too early shows up in the frames. */
+static void scribble( void )
+{
+    fnet_netbuf_t   *nb[16];
+    int             i;
+
+    for(i = 0; i < 16; i++)
+    {
+        nb[i] = fnet_netbuf_new(256, FNET_FALSE);
+        if(nb[i])
+            memset(nb[i]->data_ptr, 0xEE, 256);
+    }
+    for(i = 0; i < 16; i++)
+    {
+        if(nb[i])
+            fnet_netbuf_free_chain(nb[i]);
+    }
+}
+
+static void tx_done( void )
+{
+    /* TX_DONE interrupt.*/
+    fnet_lpceth_interrupt_handler_bottom();
+}
+
+static void rx_done( void )
+{
+    /* RX_DONE interrupt.*/
+    *(volatile uint32_t *)&LPC_EMAC->IntStatus = ETH_INTSTATUS_RX_DONE;
+    fnet_lpceth_interrupt_handler_top();
+    fnet_lpceth_interrupt_handler_bottom();
+}
+
+/* Checks a received frame, and that it is still intact once the DMA has moved on. */
+static void check_rx( fnet_netbuf_t *nb, int data_length, int seed )
+{
+    static unsigned char data[FRAME_MAX];
+
+    FNET_TEST_CHECK(nb != 0 && nb->next == 0);
+    FNET_TEST_CHECK((int)nb->total_length == data_length);
+    fill(data, data_length, seed);
+    FNET_TEST_CHECK(memcmp(nb->data_ptr, data, (unsigned)data_length) == 0);
+}
+
+static void rx_poll_tick( void )
+{
+    /* TIMER3 match interrupt.*/
+    fnet_lpceth_rx_poll_top();
+    fnet_lpceth_rx_poll_bottom();
+}
+
+/* Checks which RX descriptors raise RX_DONE. */
+static void check_rx_spacing( int spacing )
+{
+    int index;
+
+    for(index = 0; index < NUM_OF_RX_FRAGMENTS; index++)
+    {
+        int enabled = (fnet_lpceth_rx_descriptor_at(index)->controlWord & FNET_LPCETH_RX_DESCRIPTOR_CNTRL_INT_ENABLE) != 0;
+
+        FNET_TEST_CHECK(enabled == ((index % spacing) == (spacing - 1)));
+    }
+}
+
+static int rx_spare_buffers( void )
+{
+    fnet_lpceth_rx_buffer_t *buffer;
+    int                     count = 0;
+
+    for(buffer = rxFreeBuffers; buffer; buffer = buffer->next)
+        count++;
+    return count;
+}
+
+static void rx_free( void )
+{
+    int i;
+
+    for(i = 0; i < rx_frames; i++)
+        fnet_netbuf_free_chain(rx_nb[i]);
+    rx_frames = 0;
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_small_frame_copied( unsigned long heap_free )
+{
+    unsigned char   frame[FRAME_MAX];
+    int             length, descriptors;
+
+    fnet_lpceth_output(&netif, FNET_ETH_TYPE_IP4, dest_addr, payload(0, 40, 1));
+
+    /* Nothing points into the net_buf, so it is freed at once.*/
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+
+    length = emac_tx_frame(frame, &descriptors);
+    FNET_TEST_CHECK(descriptors == 1);
+    check_payload(frame, length, 40, 1);
+    tx_done();
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("small frame is copied");
+}
+
+static void test_large_frame_in_place( unsigned long heap_free )
+{
+    unsigned char               frame[FRAME_MAX];
+    int                         length, descriptors;
+    unsigned long               zero_copy = sentPacketsZeroCopy;
+    fnet_netbuf_t               *nb;
+    fnet_lpceth_tx_descriptor   *descriptor;
+
+    /* With headroom, the Ethernet header is written in front of the data,
+     * and the whole frame is sent from the net_buf.*/
+    nb = payload(FNET_CFG_NETBUF_HEADROOM, 1000, 2);
+    descriptor = fnet_lpceth_tx_descriptor_at(LPC_EMAC->TxProduceIndex);
+    fnet_lpceth_output(&netif, FNET_ETH_TYPE_IP4, dest_addr, nb);
+
+    FNET_TEST_CHECK(sentPacketsZeroCopy == zero_copy + 1);
+    FNET_TEST_CHECK((char *)descriptor->packetPtr == (char *)nb->data_ptr);
+    FNET_TEST_CHECK(descriptor->controlWord & TX_DESCRIPTOR_LAST_FRAME);
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() < heap_free);
+
+    scribble();
+    length = emac_tx_frame(frame, &descriptors);
+    FNET_TEST_CHECK(descriptors == 1);
+    check_payload(frame, length, 1000, 2);
+
+    /* The net_buf is held until the TX_DONE interrupt.*/
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() < heap_free);
+    tx_done();
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+
+    /* Without headroom, the header is copied and the data goes out in place.*/
+    fnet_lpceth_output(&netif, FNET_ETH_TYPE_IP4, dest_addr, payload(0, 1000, 3));
+    scribble();
+    length = emac_tx_frame(frame, &descriptors);
+    FNET_TEST_CHECK(descriptors == 2);
+    check_payload(frame, length, 1000, 3);
+    tx_done();
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("large frame is sent in place");
+}
+
+static void test_fragment_chain( unsigned long heap_free )
+{
+    static const int    sizes[] = {20, 600, 10, 30, 700};
+    unsigned char       frame[FRAME_MAX];
+    unsigned char       data[FRAME_MAX];
+    int                 length, descriptors, i, data_length = 0;
+    fnet_netbuf_t       *nb = 0;
+
+    for(i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        fnet_netbuf_t *fragment = payload(0, sizes[i], 10 + i);
+
+        fill(data + data_length, sizes[i], 10 + i);
+        data_length += sizes[i];
+        nb = nb ? fnet_netbuf_concat(nb, fragment) : fragment;
+    }
+
+    fnet_lpceth_output(&netif, FNET_ETH_TYPE_IP4, dest_addr, nb);
+    scribble();
+    length = emac_tx_frame(frame, &descriptors);
+
+    /* Header and 20 bytes copied, 600 in place, 10 and 30 copied together, 700 in place.*/
+    FNET_TEST_CHECK(descriptors == 4);
+    check_frame(frame, length, data, data_length);
+    tx_done();
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("fragment chain");
+}
+
+static void test_not_dma_accessible( unsigned long heap_free )
+{
+    unsigned char   frame[FRAME_MAX];
+    int             length, descriptors;
+    fnet_netbuf_t   *nb;
+
+    /* Flash and the main SRAM cannot be reached by the EMAC DMA.*/
+    nb = fnet_netbuf_from_const(flash_data, sizeof(flash_data), FNET_FALSE);
+    FNET_TEST_CHECK(nb != 0);
+    fnet_lpceth_output(&netif, FNET_ETH_TYPE_IP4, dest_addr, nb);
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+
+    length = emac_tx_frame(frame, &descriptors);
+    FNET_TEST_CHECK(descriptors == 1);
+    check_frame(frame, length, flash_data, sizeof(flash_data));
+    tx_done();
+    fnet_test_pass("data outside AHB SRAM is copied");
+}
+
+static void test_too_fragmented( unsigned long heap_free )
+{
+    unsigned char   frame[FRAME_MAX];
+    unsigned char   data[FRAME_MAX];
+    int             length, descriptors, i;
+    fnet_netbuf_t   *nb = 0;
+
+    /* More fragments than descriptors in the ring.*/
+    for(i = 0; i < NUM_OF_TX_FRAGMENTS + 2; i++)
+    {
+        fnet_netbuf_t *fragment = payload(0, 70, 20 + i);
+
+        fill(data + i * 70, 70, 20 + i);
+        nb = nb ? fnet_netbuf_concat(nb, fragment) : fragment;
+    }
+
+    fnet_lpceth_output(&netif, FNET_ETH_TYPE_IP4, dest_addr, nb);
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    length = emac_tx_frame(frame, &descriptors);
+    FNET_TEST_CHECK(descriptors == 1);
+    check_frame(frame, length, data, (NUM_OF_TX_FRAGMENTS + 2) * 70);
+    tx_done();
+    fnet_test_pass("too fragmented frame is copied");
+}
+
+static void test_backlog( unsigned long heap_free )
+{
+    unsigned char   frame[FRAME_MAX];
+    int             length, descriptors, i;
+    int             frames = NUM_OF_TX_FRAGMENTS / 2 + 4;
+    unsigned long   backlogged = sentPacketsBacklogged;
+    unsigned long   dropped = sentPacketsDropped;
+
+    /* Two descriptors per frame: the ring fills up and the rest waits in the backlog.*/
+    for(i = 0; i < frames; i++)
+        fnet_lpceth_output(&netif, FNET_ETH_TYPE_IP4, dest_addr, payload(0, 300, 40 + i));
+
+    FNET_TEST_CHECK(sentPacketsBacklogged > backlogged);
+    FNET_TEST_CHECK(sentPacketsDropped == dropped);
+    FNET_TEST_CHECK(txBacklogLength == sentPacketsBacklogged - backlogged);
+    scribble();
+
+    /* The EMAC sends one frame per TX_DONE, the frames leave in order.*/
+    for(i = 0; i < frames; i++)
+    {
+        length = emac_tx_frame(frame, &descriptors);
+        FNET_TEST_CHECK(length != 0);
+        check_payload(frame, length, 300, 40 + i);
+        tx_done();
+        scribble();
+    }
+    FNET_TEST_CHECK(emac_tx_frame(frame, &descriptors) == 0);
+    FNET_TEST_CHECK(txBacklogLength == 0);
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("full ring backlogs frames in order");
+}
+
+static void test_rx_loan( unsigned long heap_free )
+{
+    unsigned long               index = LPC_EMAC->RxProduceIndex;
+    fnet_lpceth_rx_descriptor   *descriptor = fnet_lpceth_rx_descriptor_at(index);
+    unsigned char               *buffer = descriptor->packetPtr;
+    unsigned long               copied = recvPacketsCopied;
+
+    FNET_TEST_CHECK(rx_spare_buffers() == NUM_OF_RX_SPARE_BUFFERS);
+
+    emac_rx_frame(1000, 50);
+    rx_done();
+    FNET_TEST_CHECK(rx_frames == 1);
+
+    /* The frame is lent in place, the descriptor gets a spare buffer.*/
+    FNET_TEST_CHECK((unsigned char *)rx_nb[0]->data_ptr == buffer + sizeof(fnet_eth_header_t));
+    FNET_TEST_CHECK(descriptor->packetPtr != buffer);
+    FNET_TEST_CHECK(rx_spare_buffers() == NUM_OF_RX_SPARE_BUFFERS - 1);
+    FNET_TEST_CHECK(recvPacketsCopied == copied);
+
+    /* Once the ring wraps around, the next frame in this descriptor does not 
+     * touch the lent one.*/
+    while(LPC_EMAC->RxProduceIndex != index)
+    {
+        emac_rx_frame(60, 51);
+        rx_done();
+        fnet_netbuf_free_chain(rx_nb[--rx_frames]);
+    }
+    emac_rx_frame(1000, 52);
+    rx_done();
+    FNET_TEST_CHECK(rx_frames == 2);
+    check_rx(rx_nb[0], 1000, 50);
+    check_rx(rx_nb[1], 1000, 52);
+    FNET_TEST_CHECK(recvPacketsCopied == copied);
+
+    /* Freeing the net_bufs returns the buffers to the spares.*/
+    rx_free();
+    FNET_TEST_CHECK(rx_spare_buffers() == NUM_OF_RX_SPARE_BUFFERS);
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("rx frame is lent in place");
+}
+
+static void test_rx_copy_fallback( unsigned long heap_free )
+{
+    struct fnet_netif_statistics    statistics;
+    unsigned long                   copied = recvPacketsCopied;
+    unsigned char                   *ring_start = rxFragmentPtr;
+    unsigned char                   *ring_end = rxFragmentPtr + NUM_OF_RX_FRAGMENTS * LPC_ETH_MAX_FRAME_SIZE;
+    int                             i;
+
+    /* The stack holds on to every spare: the next frames are copied.*/
+    for(i = 0; i < NUM_OF_RX_SPARE_BUFFERS + 2; i++)
+    {
+        emac_rx_frame(200 + i, 60 + i);
+        rx_done();
+    }
+    FNET_TEST_CHECK(rx_frames == NUM_OF_RX_SPARE_BUFFERS + 2);
+    FNET_TEST_CHECK(rx_spare_buffers() == 0);
+    FNET_TEST_CHECK(recvPacketsCopied == copied + 2);
+
+    for(i = 0; i < rx_frames; i++)
+    {
+        unsigned char *data = (unsigned char *)rx_nb[i]->data_ptr;
+
+        check_rx(rx_nb[i], 200 + i, 60 + i);
+        if(i >= NUM_OF_RX_SPARE_BUFFERS)
+            FNET_TEST_CHECK(data < ring_start || data >= ring_end);
+    }
+
+    FNET_TEST_CHECK(fnet_lpceth_get_statistics(&netif, &statistics) == FNET_OK);
+    FNET_TEST_CHECK(statistics.rx_copied == recvPacketsCopied);
+    FNET_TEST_CHECK(statistics.rx_packet == recvPackets);
+
+    /* Each lent buffer comes back as a spare, the copies go back to the heap.*/
+    fnet_netbuf_free_chain(rx_nb[0]);
+    FNET_TEST_CHECK(rx_spare_buffers() == 1);
+    rx_nb[0] = 0;
+    for(i = 1; i < rx_frames; i++)
+        fnet_netbuf_free_chain(rx_nb[i]);
+    rx_frames = 0;
+    FNET_TEST_CHECK(rx_spare_buffers() == NUM_OF_RX_SPARE_BUFFERS);
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+
+    /* With a spare back, frames are lent again.*/
+    emac_rx_frame(300, 70);
+    rx_done();
+    FNET_TEST_CHECK(recvPacketsCopied == copied + 2);
+    FNET_TEST_CHECK(rx_spare_buffers() == NUM_OF_RX_SPARE_BUFFERS - 1);
+    check_rx(rx_nb[0], 300, 70);
+    rx_free();
+    FNET_TEST_CHECK(rx_spare_buffers() == NUM_OF_RX_SPARE_BUFFERS);
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("rx copies without spare buffers");
+}
+
+/* As many frames as the ring holds.*/
+#define RX_BURST    (NUM_OF_RX_FRAGMENTS - 1)
+
+static void test_rx_coalescing( unsigned long heap_free )
+{
+    struct fnet_netif_statistics    statistics;
+    unsigned long                   interrupts = recvInterrupts;
+    unsigned long                   polls = recvPolls;
+    unsigned long                   entries = recvPollModeEntries;
+    unsigned long                   packets = recvPackets;
+    int                             i;
+
+    FNET_TEST_CHECK(RX_BURST >= FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD);
+    FNET_TEST_CHECK(rxPollMode == 0);
+    check_rx_spacing(1);
+
+    /* Light traffic: one interrupt per frame or per short burst.*/
+    for(i = 0; i < FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD - 1; i++)
+        emac_rx_frame(100, 80 + i);
+    rx_done();
+    FNET_TEST_CHECK(rx_frames == FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD - 1);
+    FNET_TEST_CHECK(rxPollMode == 0);
+    FNET_TEST_CHECK(recvInterrupts == interrupts + 1);
+    rx_free();
+
+    /* A burst reaching the threshold switches to polling: fewer descriptors 
+     * raise RX_DONE and the poll timer runs.*/
+    for(i = 0; i < FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD; i++)
+        emac_rx_frame(100, 90 + i);
+    rx_done();
+    FNET_TEST_CHECK(rx_frames == FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD);
+    FNET_TEST_CHECK(rxPollMode == 1);
+    FNET_TEST_CHECK(recvPollModeEntries == entries + 1);
+    FNET_TEST_CHECK(LPC_TIM3->TCR == 1);
+    check_rx_spacing(FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES);
+    rx_free();
+
+    /* Heavy traffic: each tick drains the whole batch, polling goes on.*/
+    for(i = 0; i < RX_BURST; i++)
+        emac_rx_frame(100, 100 + i);
+    rx_poll_tick();
+    FNET_TEST_CHECK(rx_frames == RX_BURST);
+    for(i = 0; i < rx_frames; i++)
+        check_rx(rx_nb[i], 100, 100 + i);
+    FNET_TEST_CHECK(rxPollMode == 1);
+    FNET_TEST_CHECK(recvPolls == polls + 1);
+    FNET_TEST_CHECK(recvBatchMax == RX_BURST);
+    rx_free();
+
+    /* An RX_DONE from a spaced descriptor in between does not stop polling.*/
+    for(i = 0; i < FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES; i++)
+        emac_rx_frame(100, 110 + i);
+    rx_done();
+    for(i = 0; i < FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD; i++)
+        emac_rx_frame(100, 120 + i);
+    rx_poll_tick();
+    FNET_TEST_CHECK(rx_frames == FNET_CFG_CPU_ETH_RX_COALESCE_FRAMES + FNET_CFG_CPU_ETH_RX_POLL_THRESHOLD);
+    FNET_TEST_CHECK(rxPollMode == 1);
+    rx_free();
+
+    /* Fewer frames than the threshold in a tick: back to interrupts.*/
+    emac_rx_frame(100, 130);
+    rx_poll_tick();
+    FNET_TEST_CHECK(rx_frames == 1);
+    FNET_TEST_CHECK(rxPollMode == 0);
+    FNET_TEST_CHECK(LPC_TIM3->TCR == 0);
+    check_rx_spacing(1);
+    rx_free();
+
+    /* A tick pended before polling stopped leaves the frames to RX_DONE.*/
+    emac_rx_frame(100, 131);
+    rx_poll_tick();
+    FNET_TEST_CHECK(rx_frames == 0);
+    rx_done();
+    FNET_TEST_CHECK(rx_frames == 1);
+    rx_free();
+
+    /* Fewer interrupts than frames, and the counters are reported.*/
+    FNET_TEST_CHECK((recvInterrupts - interrupts) + (recvPolls - polls) < recvPackets - packets);
+    FNET_TEST_CHECK(fnet_lpceth_get_statistics(&netif, &statistics) == FNET_OK);
+    FNET_TEST_CHECK(statistics.rx_interrupts == recvInterrupts);
+    FNET_TEST_CHECK(statistics.rx_polls == recvPolls);
+    FNET_TEST_CHECK(statistics.rx_batch_max == recvBatchMax);
+    FNET_TEST_CHECK(statistics.rx_poll_mode == recvPollModeEntries);
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("rx interrupt coalescing");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    void            *sram;
+    unsigned long   heap_free;
+
+    sram = mmap((void *)AHB_SRAM_START, AHB_SRAM_SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    FNET_TEST_CHECK(sram == (void *)AHB_SRAM_START);
+
+    FNET_TEST_CHECK(fnet_heap_init((unsigned char *)FNET_CFG_CPU_HEAP_ADDR, FNET_CFG_HEAP_SIZE) == FNET_OK);
+
+    netif.mtu = 1500;
+    fnet_lpceth_set_hw_addr(&netif, (unsigned char *)src_addr);
+    fnet_lpceth_init_dma();
+
+    heap_free = fnet_free_mem_status_netbuf();
+
+    test_small_frame_copied(heap_free);
+    test_large_frame_in_place(heap_free);
+    test_fragment_chain(heap_free);
+    test_not_dma_accessible(heap_free);
+    test_too_fragmented(heap_free);
+    test_backlog(heap_free);
+    test_rx_loan(heap_free);
+    test_rx_copy_fallback(heap_free);
+    test_rx_coalescing(heap_free);
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_mempool.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Memory pool test.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+
+#include "fnet.h"
+#include "fnet_mempool.h"
+
+#define SLOTS       (300)
+
+static unsigned char pool[50 * 1024] __attribute__((aligned(8)));
+
+static struct
+{
+    unsigned char   *ptr;
+    unsigned long   size;
+    unsigned char   tag;
+} slot[SLOTS];
+
+static unsigned long seed = 1;
+
+static unsigned long test_rand( void )
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_coalescing( void )
+{
+    fnet_mempool_desc_t mp;
+    unsigned long       max_free, mem_free;
+    void                *a, *b, *c, *d;
+
+    mp = fnet_mempool_init(pool, sizeof(pool), FNET_MEMPOOL_ALIGN_8);
+    FNET_TEST_CHECK(mp != 0);
+    max_free = fnet_mempool_malloc_max(mp);
+    mem_free = fnet_mempool_free_mem_status(mp);
+
+    FNET_TEST_CHECK(fnet_mempool_malloc(mp, sizeof(pool)) == 0);
+
+    a = fnet_mempool_malloc(mp, 100);
+    b = fnet_mempool_malloc(mp, 1000);
+    c = fnet_mempool_malloc(mp, 100);
+    d = fnet_mempool_malloc(mp, 1000);
+    FNET_TEST_CHECK(a && b && c && d);
+
+    /* Free in an order that leaves holes on both sides.*/
+    fnet_mempool_free(mp, b);
+    fnet_mempool_free(mp, d);
+    FNET_TEST_CHECK(fnet_mempool_free_mem_status(mp) < mem_free);
+    fnet_mempool_free(mp, c);
+    fnet_mempool_free(mp, a);
+
+    FNET_TEST_CHECK(fnet_mempool_malloc_max(mp) == max_free);
+    FNET_TEST_CHECK(fnet_mempool_free_mem_status(mp) == mem_free);
+    fnet_mempool_release(mp);
+    fnet_test_pass("freed neighbours are merged");
+}
+
+static void test_free_below_last_block( void )
+{
+    fnet_mempool_desc_t mp;
+    unsigned long       max_free, mem_free;
+    void                *a, *b, *c;
+
+    mp = fnet_mempool_init(pool, sizeof(pool), FNET_MEMPOOL_ALIGN_8);
+    max_free = fnet_mempool_malloc_max(mp);
+    mem_free = fnet_mempool_free_mem_status(mp);
+
+    /* Leave 'a' as the only free block, with 'b' right below it.*/
+    a = fnet_mempool_malloc(mp, 100);
+    b = fnet_mempool_malloc(mp, 100);
+    fnet_mempool_free(mp, a);
+    c = fnet_mempool_malloc(mp, (unsigned)fnet_mempool_malloc_max(mp));
+    FNET_TEST_CHECK(a && b && c);
+
+    fnet_mempool_free(mp, b);
+    fnet_mempool_free(mp, c);
+
+    FNET_TEST_CHECK(fnet_mempool_malloc_max(mp) == max_free);
+    FNET_TEST_CHECK(fnet_mempool_free_mem_status(mp) == mem_free);
+    fnet_mempool_release(mp);
+    fnet_test_pass("free below the only free block");
+}
+
+static void test_random_trace( void )
+{
+    fnet_mempool_desc_t mp;
+    unsigned long       max_free, mem_free;
+    unsigned long       n, k;
+    unsigned char       *p;
+    int                 i;
+    long                it;
+
+    mp = fnet_mempool_init(pool, sizeof(pool), FNET_MEMPOOL_ALIGN_8);
+    max_free = fnet_mempool_malloc_max(mp);
+    mem_free = fnet_mempool_free_mem_status(mp);
+
+    for(it = 0; it < 500000; it++)
+    {
+        i = (int)(test_rand() % SLOTS);
+
+        if(slot[i].ptr)
+        {
+            /* Another block written over this one would show up here.*/
+            for(k = 0; k < slot[i].size; k++)
+                FNET_TEST_CHECK(slot[i].ptr[k] == slot[i].tag);
+
+            fnet_mempool_free(mp, slot[i].ptr);
+            slot[i].ptr = 0;
+        }
+        else
+        {
+            n = ((test_rand() & 3) == 0) ? (test_rand() % 1600) : (test_rand() % 100);
+            p = fnet_mempool_malloc(mp, (unsigned)n);
+            if(p == 0)
+                continue;
+
+            FNET_TEST_CHECK(((unsigned long)p & FNET_MEMPOOL_ALIGN_8) == 0);
+            FNET_TEST_CHECK(p >= pool && p + n <= pool + sizeof(pool));
+
+            slot[i].ptr = p;
+            slot[i].size = n;
+            slot[i].tag = (unsigned char)test_rand();
+            memset(p, slot[i].tag, n);
+        }
+
+        /* The reported maximum can always be allocated.*/
+        if((it % 1000) == 0)
+        {
+            n = fnet_mempool_malloc_max(mp);
+            p = fnet_mempool_malloc(mp, (unsigned)n);
+            FNET_TEST_CHECK(p != 0);
+            fnet_mempool_free(mp, p);
+        }
+    }
+
+    for(i = 0; i < SLOTS; i++)
+    {
+        if(slot[i].ptr)
+        {
+            fnet_mempool_free(mp, slot[i].ptr);
+            slot[i].ptr = 0;
+        }
+    }
+
+    FNET_TEST_CHECK(fnet_mempool_malloc_max(mp) == max_free);
+    FNET_TEST_CHECK(fnet_mempool_free_mem_status(mp) == mem_free);
+    fnet_mempool_release(mp);
+    fnet_test_pass("random alloc/free trace");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    test_coalescing();
+    test_free_below_last_block();
+    test_random_trace();
+
+    return 0;
+}
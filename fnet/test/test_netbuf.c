@@ -0,0 +1,157 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_netbuf.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Net_buf heap and pool test.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include <string.h>
+
+#include "fnet.h"
+#include "fnet_netbuf.h"
+
+static unsigned char heap[50 * 1024];
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_heap_sizes( void )
+{
+    static const unsigned long sizes[] = {2048, 3072, 4096, 6 * 1536, sizeof(heap)};
+    int             i;
+    unsigned long   heap_free;
+    fnet_netbuf_t   *nb;
+
+    /* Heaps too small for the pools still work, the pools are left out.*/
+    for(i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        FNET_TEST_CHECK(fnet_heap_init(heap, sizes[i]) == FNET_OK);
+        heap_free = fnet_free_mem_status_netbuf();
+
+        nb = fnet_netbuf_new((sizes[i] >= 4096) ? 1500 : 600, FNET_FALSE);
+        FNET_TEST_CHECK(nb != 0);
+        memset(nb->data_ptr, 0x5A, nb->length);
+        fnet_netbuf_free_chain(nb);
+
+        FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    }
+    fnet_test_pass("pools fit into any heap size");
+}
+
+static void test_pool_exhaustion( void )
+{
+    fnet_netbuf_t   *nb[64];
+    int             i, n;
+    unsigned long   heap_free;
+
+    FNET_TEST_CHECK(fnet_heap_init(heap, sizeof(heap)) == FNET_OK);
+    heap_free = fnet_free_mem_status_netbuf();
+
+    /* More buffers than the pools hold: the rest comes from the heap.*/
+    for(n = 0; n < 64; n++)
+    {
+        nb[n] = fnet_netbuf_new((n & 1) ? 40 : 600, FNET_FALSE);
+        if(nb[n] == 0)
+            break;
+        memset(nb[n]->data_ptr, n, nb[n]->length);
+    }
+    FNET_TEST_CHECK(n > FNET_CFG_NETBUF_POOL_HEADERS);
+
+    for(i = 0; i < n; i++)
+    {
+        FNET_TEST_CHECK(((unsigned char *)nb[i]->data_ptr)[nb[i]->length - 1] == (unsigned char)i);
+        fnet_netbuf_free_chain(nb[i]);
+    }
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("empty pools fall back to the heap");
+}
+
+static void test_push( void )
+{
+    fnet_netbuf_t   *nb, *head, *copy;
+    unsigned long   heap_free;
+
+    FNET_TEST_CHECK(fnet_heap_init(heap, sizeof(heap)) == FNET_OK);
+    heap_free = fnet_free_mem_status_netbuf();
+
+    /* A header goes into the headroom, without an allocation.*/
+    nb = fnet_netbuf_new_headroom(FNET_CFG_NETBUF_HEADROOM, 100, FNET_FALSE);
+    FNET_TEST_CHECK(nb != 0);
+    memset(nb->data_ptr, 0x5A, 100);
+    FNET_TEST_CHECK(fnet_netbuf_headroom(nb) == FNET_CFG_NETBUF_HEADROOM);
+    head = fnet_netbuf_push(nb, 20, FNET_FALSE);
+    FNET_TEST_CHECK(head == nb);
+    FNET_TEST_CHECK((nb->length == 120) && (nb->total_length == 120));
+    FNET_TEST_CHECK(((unsigned char *)nb->data_ptr)[20] == 0x5A);
+    FNET_TEST_CHECK(fnet_netbuf_headroom(nb) == FNET_CFG_NETBUF_HEADROOM - 20);
+
+    /* A shared data buffer is not written to, a new net_buf is put in 
+     * front, with headroom for the next header.*/
+    copy = fnet_netbuf_copy(nb, 0, FNET_NETBUF_COPYALL, FNET_FALSE);
+    FNET_TEST_CHECK(copy != 0);
+    FNET_TEST_CHECK(fnet_netbuf_headroom(nb) == 0);
+    head = fnet_netbuf_push(copy, 20, FNET_FALSE);
+    FNET_TEST_CHECK((head != copy) && (head->next == copy));
+    FNET_TEST_CHECK((head->length == 20) && (head->total_length == 140));
+    FNET_TEST_CHECK(fnet_netbuf_headroom(head) >= 20);
+    fnet_netbuf_free_chain(head);
+
+    /* Not enough headroom.*/
+    FNET_TEST_CHECK(fnet_netbuf_headroom(nb) == FNET_CFG_NETBUF_HEADROOM - 20);
+    head = fnet_netbuf_push(nb, FNET_CFG_NETBUF_HEADROOM, FNET_FALSE);
+    FNET_TEST_CHECK((head != nb) && (head->next == nb) && (head->total_length == 120 + FNET_CFG_NETBUF_HEADROOM));
+    fnet_netbuf_free_chain(head);
+
+    FNET_TEST_CHECK(fnet_free_mem_status_netbuf() == heap_free);
+    fnet_test_pass("headers pushed in place");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    test_heap_sizes();
+    test_pool_exhaustion();
+    test_push();
+
+    return 0;
+}
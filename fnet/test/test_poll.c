@@ -0,0 +1,346 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_poll.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Polling service scheduler test, over the host link.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include "fnet_test_link.h"
+
+#include "fnet_poll.h"
+#include "fnet_timer.h"
+
+#define BUF_SIZE        (4096)
+
+static unsigned char heap[128 * 1024];
+static char data[1000];
+static char rx_data[BUF_SIZE];
+
+/* A service. It reads everything from its socket and declares, what it 
+ * waits for. With none of them it is called on every pass.*/
+typedef struct
+{
+    fnet_poll_desc_t    desc;
+    int                 calls;
+    SOCKET              s;          /* Waits for FNET_POLLIN, if valid.*/
+    int                 drain;      /* Reads the socket.*/
+    unsigned long       timeout;    /* In ticks, 0 = no timeout.*/
+    int                 signal;     /* Waits for fnet_poll_service_signal().*/
+    int                 received;
+} service_t;
+
+/************************************************************************
+* LPC17xx port. fnet_cpu_idle() counts the calls, the interrupt mask 
+* is a flag.
+*************************************************************************/
+static int idle_calls;
+static int irq_disabled;
+
+fnet_cpu_irq_desc_t fnet_cpu_irq_disable( void )
+{
+    FNET_TEST_CHECK(irq_disabled == 0);
+    irq_disabled = 1;
+    return 0x55;
+}
+
+void fnet_cpu_irq_enable( fnet_cpu_irq_desc_t irq_desc )
+{
+    FNET_TEST_CHECK((irq_desc == 0x55) && irq_disabled);
+    irq_disabled = 0;
+}
+
+void fnet_cpu_idle( void )
+{
+    /* The check and the sleep are not interrupted.*/
+    FNET_TEST_CHECK(irq_disabled);
+    idle_calls++;
+}
+
+/************************************************************************
+* Services.
+*************************************************************************/
+static void service( void *param )
+{
+    service_t   *sv = (service_t *)param;
+    int         res;
+
+    sv->calls++;
+
+    if(sv->s != SOCKET_INVALID)
+    {
+        while(sv->drain && ((res = recv(sv->s, rx_data, sizeof(rx_data), 0)) > 0))
+            sv->received += res;
+        FNET_TEST_CHECK(fnet_poll_service_wait_socket(sv->desc, sv->s, FNET_POLLIN) == FNET_OK);
+    }
+    if(sv->timeout)
+        FNET_TEST_CHECK(fnet_poll_service_wait_timeout(sv->desc, sv->timeout) == FNET_OK);
+    if(sv->signal)
+        FNET_TEST_CHECK(fnet_poll_service_wait_signal(sv->desc) == FNET_OK);
+}
+
+static void service_init( service_t *sv, SOCKET s, unsigned long timeout, int signal )
+{
+    fnet_memset_zero(sv, sizeof(*sv));
+    sv->s = s;
+    sv->drain = 1;
+    sv->timeout = timeout;
+    sv->signal = signal;
+    sv->desc = fnet_poll_service_register(service, sv);
+    FNET_TEST_CHECK(sv->desc != (fnet_poll_desc_t)FNET_ERR);
+}
+
+/* One ms of the link, then one pass of the main loop.*/
+static void passes( int n )
+{
+    while(n--)
+    {
+        fnet_test_link_step();
+        fnet_poll_services();
+    }
+}
+
+/* Passes until the service is called.*/
+static void pass_until_called( service_t *sv )
+{
+    int calls = sv->calls;
+    int ms;
+
+    for(ms = 0; sv->calls == calls; ms++)
+    {
+        FNET_TEST_CHECK(ms < 10000);
+        passes(1);
+    }
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_socket( void )
+{
+    SOCKET      client, server;
+    service_t   sv, always;
+    int         calls;
+
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    service_init(&sv, server, 0, 0);
+    service_init(&always, SOCKET_INVALID, 0, 0);
+
+    /* Nothing declared before the first call.*/
+    fnet_poll_services();
+    FNET_TEST_CHECK((sv.calls == 1) && (always.calls == 1));
+    passes(1000);
+    FNET_TEST_CHECK((sv.calls == 1) && (always.calls == 1001));
+
+    /* The socket callback wakes the service once.*/
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    pass_until_called(&sv);
+    FNET_TEST_CHECK((sv.calls == 2) && (sv.received == 100));
+    passes(1000);
+    FNET_TEST_CHECK(sv.calls == 2);
+    fnet_test_pass("skipped until the socket is ready");
+
+    /* The data is left in the socket, it is ready at every declaration.*/
+    sv.drain = 0;
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    pass_until_called(&sv);
+    passes(10);
+    FNET_TEST_CHECK((sv.calls == 13) && (sv.received == 100));
+    sv.drain = 1;
+    passes(10);
+    FNET_TEST_CHECK((sv.calls == 14) && (sv.received == 200));
+    fnet_test_pass("called while the socket is ready");
+
+    /* Unregistered services are not called.*/
+    calls = always.calls;
+    FNET_TEST_CHECK(fnet_poll_service_unregister(sv.desc) == FNET_OK);
+    FNET_TEST_CHECK(fnet_poll_service_unregister(always.desc) == FNET_OK);
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    passes(1000);
+    FNET_TEST_CHECK((sv.calls == 14) && (always.calls == calls));
+    FNET_TEST_CHECK(closesocket(client) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+    fnet_test_link_run(30000);  /* TIME_WAIT */
+}
+
+static void test_timeout( void )
+{
+    SOCKET          client, server;
+    service_t       sv;
+    unsigned long   start;
+
+    /* Waits for the socket, or 3 ticks.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    service_init(&sv, server, 3, 0);
+    fnet_poll_services();
+    start = fnet_timer_ticks();
+    pass_until_called(&sv);
+    FNET_TEST_CHECK((sv.calls == 2) && (fnet_timer_ticks() - start == 3));
+    fnet_test_pass("timeout wakes the service");
+
+    /* The earliest deadline is kept.*/
+    start = fnet_timer_ticks();
+    FNET_TEST_CHECK(fnet_poll_service_wait_timeout(sv.desc, 10) == FNET_OK);
+    pass_until_called(&sv);
+    FNET_TEST_CHECK(fnet_timer_ticks() - start == 3);
+    start = fnet_timer_ticks();
+    FNET_TEST_CHECK(fnet_poll_service_wait_timeout(sv.desc, 1) == FNET_OK);
+    pass_until_called(&sv);
+    FNET_TEST_CHECK((sv.calls == 4) && (fnet_timer_ticks() - start == 1));
+    fnet_test_pass("earliest deadline is kept");
+
+    /* The socket is ready before the deadline.*/
+    sv.timeout = 50;
+    pass_until_called(&sv);
+    start = fnet_timer_ticks();
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    pass_until_called(&sv);
+    FNET_TEST_CHECK((sv.received == 100) && (fnet_timer_ticks() - start < 50));
+    fnet_test_pass("socket wakes before the deadline");
+
+    FNET_TEST_CHECK(fnet_poll_service_unregister(sv.desc) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(client) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+    fnet_test_link_run(30000);  /* TIME_WAIT */
+}
+
+static void test_signal( void )
+{
+    service_t sv;
+
+    service_init(&sv, SOCKET_INVALID, 0, 1);
+    fnet_poll_services();
+    passes(1000);
+    FNET_TEST_CHECK(sv.calls == 1);
+    fnet_poll_service_signal(sv.desc);
+    fnet_poll_services();
+    FNET_TEST_CHECK(sv.calls == 2);
+    passes(1000);
+    FNET_TEST_CHECK(sv.calls == 2);
+    FNET_TEST_CHECK(fnet_poll_service_unregister(sv.desc) == FNET_OK);
+    fnet_test_pass("signal wakes the service");
+}
+
+static void test_idle( void )
+{
+    SOCKET      client, server;
+    service_t   sv_socket, sv_timeout, sv_signal, always;
+    int         ms;
+
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    service_init(&sv_socket, server, 0, 0);
+    service_init(&sv_timeout, SOCKET_INVALID, 100, 0);
+    service_init(&sv_signal, SOCKET_INVALID, 0, 1);
+
+    /* The services have not declared anything yet.*/
+    idle_calls = 0;
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK(idle_calls == 0);
+
+    /* All of them wait.*/
+    fnet_poll_services();
+    FNET_TEST_CHECK(fnet_poll_services_ready() == FNET_FALSE);
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK((idle_calls == 1) && (irq_disabled == 0));
+    fnet_test_pass("idle while all services wait");
+
+    /* A signal.*/
+    fnet_poll_service_signal(sv_signal.desc);
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK(idle_calls == 1);
+    fnet_poll_services();
+    FNET_TEST_CHECK((sv_signal.calls == 2) && (sv_socket.calls == 1) && (sv_timeout.calls == 1));
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK(idle_calls == 2);
+
+    /* Data arrives.*/
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    for(ms = 0; fnet_poll_services_ready() == FNET_FALSE; ms++)
+    {
+        FNET_TEST_CHECK(ms < 10000);
+        fnet_test_link_step();
+    }
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK(idle_calls == 2);
+    fnet_poll_services();
+    FNET_TEST_CHECK((sv_socket.calls == 2) && (sv_socket.received == 100) && (sv_timeout.calls == 1));
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK(idle_calls == 3);
+
+    /* The deadline passes.*/
+    fnet_test_link_run(100 * FNET_TIMER_PERIOD_MS);
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK(idle_calls == 3);
+    fnet_poll_services();
+    FNET_TEST_CHECK((sv_timeout.calls == 2) && (sv_socket.calls == 2) && (sv_signal.calls == 2));
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK(idle_calls == 4);
+
+    /* A service, that does not declare anything.*/
+    service_init(&always, SOCKET_INVALID, 0, 0);
+    fnet_poll_services_idle();
+    fnet_poll_services();
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK((idle_calls == 4) && (always.calls == 1));
+    FNET_TEST_CHECK(fnet_poll_service_unregister(always.desc) == FNET_OK);
+    fnet_poll_services_idle();
+    FNET_TEST_CHECK(idle_calls == 5);
+    fnet_test_pass("no idle while a service is ready");
+
+    fnet_poll_services_release();
+    FNET_TEST_CHECK(closesocket(client) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+    fnet_test_link_run(30000);  /* TIME_WAIT */
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    fnet_test_link_init(heap, sizeof(heap));
+
+    test_socket();
+    test_timeout();
+    test_signal();
+    test_idle();
+
+    return 0;
+}
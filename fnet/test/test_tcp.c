@@ -0,0 +1,1130 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_tcp.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief TCP test, over the host link.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+#include "fnet_test_link.h"
+#include <string.h>
+
+#include "fnet_tcp.h"
+#include "fnet_ip_prv.h"
+#include "fnet_checksum.h"
+
+#define BUF_SIZE        (4096)
+#define DATA_SIZE       (64 * 1024)
+
+static unsigned char heap[256 * 1024];
+static char data[DATA_SIZE];
+static char rx_data[DATA_SIZE];
+
+static unsigned long seed = 1;
+
+static unsigned long test_rand( void )
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 16) & 0x7FFF;
+}
+
+static fnet_tcp_control_t *tcp_cb( SOCKET s )
+{
+    return (fnet_tcp_control_t *)fnet_test_link_socket(s)->protocol_control;
+}
+
+/* 'a' sends 'len' bytes, 'b' sends them back as soon as they arrive.*/
+static void echo( SOCKET a, SOCKET b, int len )
+{
+    int received, res;
+
+    FNET_TEST_CHECK(send(a, data, len, 0) == len);
+    for(received = 0; received < len; received += res)
+    {
+        fnet_test_link_step();
+        res = recv(b, rx_data + received, len - received, 0);
+        FNET_TEST_CHECK(res >= 0);
+    }
+
+    FNET_TEST_CHECK(send(b, rx_data, len, 0) == len);
+    for(received = 0; received < len; received += res)
+    {
+        fnet_test_link_step();
+        res = recv(a, rx_data + received, len - received, 0);
+        FNET_TEST_CHECK(res >= 0);
+    }
+    FNET_TEST_CHECK(memcmp(rx_data, data, (size_t)len) == 0);
+}
+
+/* 'tx' sends 'len' bytes, which wait in the receive buffer of 'rx'.
+ * Returns when they are acknowledged.*/
+static void deliver( SOCKET tx, SOCKET rx, int len )
+{
+    fnet_socket_t   *sk = fnet_test_link_socket(rx);
+    unsigned long   count = sk->receive_buffer.count + (unsigned long)len;
+    int             ms;
+
+    FNET_TEST_CHECK(send(tx, data, len, 0) == len);
+    for(ms = 0; sk->receive_buffer.count < count; ms++)
+    {
+        FNET_TEST_CHECK(ms < 10000);
+        fnet_test_link_step();
+    }
+    fnet_test_link_run(500);
+}
+
+static void disconnect( SOCKET client, SOCKET server )
+{
+    FNET_TEST_CHECK(closesocket(client) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+    fnet_test_link_run(30000);  /* TIME_WAIT */
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_rtt( void )
+{
+    static const unsigned long delays[] = {1, 20, 150, 1000};
+    SOCKET              client, server;
+    fnet_tcp_control_t  *cb;
+    long                srtt;
+    int                 rto;
+    int                 i, n;
+
+    /* The round trip time is measured in ms, not in slow timer periods.*/
+    for(i = 0; i < (int)(sizeof(delays) / sizeof(delays[0])); i++)
+    {
+        fnet_test_link_delay = delays[i];
+        fnet_test_link_connect(&client, &server, BUF_SIZE);
+        /* The reply carries the ACK, so the samples are not delayed.*/
+        for(n = 0; n < 20; n++)
+            echo(server, client, 100);
+
+        cb = tcp_cb(server);
+        srtt = cb->tcpcb_srtt >> FNET_TCP_RTT_SHIFT;
+        rto = (int)((srtt + cb->tcpcb_rttvar + FNET_TCP_SLOWTIMO - 1) / FNET_TCP_SLOWTIMO);
+        FNET_TEST_CHECK((srtt >= (long)(2 * delays[i])) && (srtt <= (long)(2 * delays[i] + 1)));
+        FNET_TEST_CHECK(cb->tcpcb_rto == ((rto > FNET_TCP_RTO_MIN) ? rto : FNET_TCP_RTO_MIN));
+
+        disconnect(client, server);
+    }
+    fnet_test_link_delay = 20;
+    fnet_test_pass("RTT in ms, from the microsecond clock");
+}
+
+/* Drops the first transmission of every data segment to the server.*/
+static int timer_loss( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    return (dir == FNET_TEST_LINK_TO_SERVER) && (len > 0) && !rexmt;
+}
+
+static void test_timers( void )
+{
+    SOCKET              client, server;
+    fnet_tcp_control_t  *cb, *scb;
+    unsigned long       free_mem = fnet_free_mem_status();
+    unsigned long       start, elapsed, acks;
+    int                 rto, ms;
+
+    /* The retransmission and delayed ACK timers are on the timer wheel,
+     * they only run while they are needed.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    cb = tcp_cb(client);
+    scb = tcp_cb(server);
+    echo(client, server, 100);      /* RTT samples bring RTO down to FNET_TCP_RTO_MIN.*/
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK(!fnet_timer_is_active(cb->tcpcb_rexmt_timer) && !fnet_timer_is_active(cb->tcpcb_delack_timer));
+    FNET_TEST_CHECK(!fnet_timer_is_active(scb->tcpcb_rexmt_timer) && !fnet_timer_is_active(scb->tcpcb_delack_timer));
+
+    /* Sending arms the retransmission timer, it expires after RTO.*/
+    fnet_test_link_loss = timer_loss;
+    fnet_test_link_reset_stat();
+    rto = cb->tcpcb_rto;
+    start = fnet_test_link_now();
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    FNET_TEST_CHECK(fnet_timer_is_active(cb->tcpcb_rexmt_timer));
+    for(ms = 0; fnet_test_link_stat[FNET_TEST_LINK_TO_SERVER].rexmt == 0; ms++)
+    {
+        FNET_TEST_CHECK(ms < 10000);
+        fnet_test_link_step();
+    }
+    elapsed = fnet_test_link_now() - start;
+    FNET_TEST_CHECK(elapsed <= (unsigned long)rto * FNET_TCP_SLOWTIMO);
+    FNET_TEST_CHECK(elapsed > (unsigned long)rto * FNET_TCP_SLOWTIMO - FNET_TIMER_PERIOD_MS);
+    fnet_test_link_loss = 0;
+
+    /* The data is acknowledged with a delay, the ACK cancels the timer.*/
+    acks = fnet_test_link_stat[FNET_TEST_LINK_TO_CLIENT].segments;
+    for(ms = 0; fnet_test_link_socket(server)->receive_buffer.count < 100; ms++)
+    {
+        FNET_TEST_CHECK(ms < 10000);
+        fnet_test_link_step();
+    }
+    FNET_TEST_CHECK(fnet_timer_is_active(scb->tcpcb_delack_timer));
+    FNET_TEST_CHECK(fnet_test_link_stat[FNET_TEST_LINK_TO_CLIENT].segments == acks);
+    fnet_test_link_run(FNET_TCP_FASTTIMO);
+    FNET_TEST_CHECK(!fnet_timer_is_active(scb->tcpcb_delack_timer));
+    FNET_TEST_CHECK(fnet_test_link_stat[FNET_TEST_LINK_TO_CLIENT].segments == acks + 1);
+    fnet_test_link_run(fnet_test_link_delay);
+    FNET_TEST_CHECK(cb->tcpcb_rcvack == cb->tcpcb_sndseq);
+    FNET_TEST_CHECK(!fnet_timer_is_active(cb->tcpcb_rexmt_timer));
+
+    /* A reply carries the ACK, the delayed ACK is not sent.*/
+    acks = fnet_test_link_stat[FNET_TEST_LINK_TO_CLIENT].segments;
+    FNET_TEST_CHECK(recv(server, rx_data, 100, 0) == 100);
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    fnet_test_link_run(fnet_test_link_delay);
+    FNET_TEST_CHECK(fnet_timer_is_active(scb->tcpcb_delack_timer));
+    FNET_TEST_CHECK(send(server, data, 100, 0) == 100);
+    FNET_TEST_CHECK(!fnet_timer_is_active(scb->tcpcb_delack_timer));
+    FNET_TEST_CHECK(fnet_timer_is_active(scb->tcpcb_rexmt_timer));
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK(fnet_test_link_stat[FNET_TEST_LINK_TO_CLIENT].segments == acks + 1);
+
+    /* Closing with data in flight stops the timers, freeing the sockets frees them.*/
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    FNET_TEST_CHECK(fnet_timer_is_active(cb->tcpcb_rexmt_timer));
+    disconnect(client, server);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("rexmt and delayed ACK on the timer wheel");
+}
+
+/* Runs 'rcv_input' when fnet_tcp_rcv() drops the lock to copy the 
+ * net_bufs it has taken from the receive buffer. This is where the 
+ * Ethernet bottom half can run on the target.*/
+static fnet_socket_t    *rcv_sk;
+static unsigned long    rcv_count;
+static void             (*rcv_input)( void );
+static int              rcv_hits;
+static SOCKET           rcv_peer;
+
+static void rcv_hook( void )
+{
+    if(rcv_sk->receive_buffer.count < rcv_count)
+    {
+        rcv_hits++;
+        rcv_input();
+    }
+    else
+        fnet_test_isr_unlock_hook = rcv_hook;    /* Not there yet.*/
+}
+
+static int rcv_unlocked( SOCKET s, int len, void (*input)( void ) )
+{
+    int res;
+
+    rcv_sk = fnet_test_link_socket(s);
+    rcv_count = rcv_sk->receive_buffer.count;
+    rcv_input = input;
+    rcv_hits = 0;
+    fnet_test_isr_unlock_hook = rcv_hook;
+
+    res = recv(s, rx_data, len, 0);
+
+    fnet_test_isr_unlock_hook = 0;
+    FNET_TEST_CHECK(fnet_test_isr_locked == 0);
+    FNET_TEST_CHECK(rcv_hits == 1);
+    return res;
+}
+
+/* More data from the peer.*/
+static void rcv_input_data( void )
+{
+    FNET_TEST_CHECK(send(rcv_peer, data + 3000, 1000, 0) == 1000);
+    fnet_test_link_flush();
+}
+
+/* The peer resets the connection.*/
+static void rcv_input_reset( void )
+{
+    struct linger linger = {1, 0};
+
+    FNET_TEST_CHECK(setsockopt(rcv_peer, SOL_SOCKET, SO_LINGER, (char *)&linger, sizeof(linger)) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(rcv_peer) == FNET_OK);
+    fnet_test_link_flush();
+}
+
+static void test_rcv_unlocked( void )
+{
+    SOCKET          client, server;
+    unsigned long   free_mem = fnet_free_mem_status();
+    int             error, len;
+
+    /* Data arrives while the reader copies, it is appended to what is left.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    deliver(client, server, 3000);
+    rcv_peer = client;
+    FNET_TEST_CHECK(rcv_unlocked(server, 2000, rcv_input_data) == 2000);
+    FNET_TEST_CHECK(memcmp(rx_data, data, 2000) == 0);
+    FNET_TEST_CHECK(fnet_test_link_socket(server)->receive_buffer.count == 2000);
+    FNET_TEST_CHECK(recv(server, rx_data + 2000, 3000, 0) == 2000);
+    FNET_TEST_CHECK(memcmp(rx_data, data, 4000) == 0);
+    echo(client, server, 1000);
+    disconnect(client, server);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("recv() copy, data arrives");
+
+    /* The connection is reset while the reader copies. The copied data
+     * is returned, the next recv() reports the reset.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    deliver(client, server, 3000);
+    rcv_peer = client;
+    FNET_TEST_CHECK(rcv_unlocked(server, 3000, rcv_input_reset) == 3000);
+    FNET_TEST_CHECK(memcmp(rx_data, data, 3000) == 0);
+    FNET_TEST_CHECK(recv(server, rx_data, 3000, 0) == SOCKET_ERROR);
+    len = sizeof(error);
+    FNET_TEST_CHECK(getsockopt(server, SOL_SOCKET, SO_ERROR, (char *)&error, &len) == FNET_OK);
+    FNET_TEST_CHECK(error == FNET_ERR_CONNRESET);
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+    fnet_test_link_run(5000);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("recv() copy, connection reset");
+}
+
+/* TCP puts its header and options into one net_buf in front of the data,
+ * with room for the IP header to be pushed in place.*/
+static int tx_segments;
+static int tx_data_segments;
+
+static void tx_tap( int dir, fnet_netbuf_t *nb )
+{
+    unsigned long header_length = (unsigned long)((((unsigned char *)nb->data_ptr)[12] >> 4) * 4);
+
+    tx_segments++;
+    FNET_TEST_CHECK(nb->length == header_length);
+    FNET_TEST_CHECK(fnet_netbuf_headroom(nb) >= (int)sizeof(fnet_ip_header_t));
+    if(nb->total_length > header_length)
+    {
+        tx_data_segments++;
+        FNET_TEST_CHECK(nb->next != 0);
+    }
+}
+
+/* Loses the second segment, the receiver sends SACK options.*/
+static int tx_loss( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    return (dir == FNET_TEST_LINK_TO_SERVER) && !rexmt && (seq <= 1500) && (seq + len > 1500);
+}
+
+static void test_tx_headers( void )
+{
+    SOCKET          client, server;
+    unsigned long   free_mem = fnet_free_mem_status();
+    int             received, res;
+
+    tx_segments = 0;
+    tx_data_segments = 0;
+    fnet_test_link_tap = tx_tap;
+    fnet_test_link_loss = tx_loss;
+    fnet_test_link_reset_stat();
+
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    deliver(client, server, 4000);
+    for(received = 0; received < 4000; received += res)
+    {
+        res = recv(server, rx_data + received, 4000 - received, 0);
+        FNET_TEST_CHECK(res > 0);
+    }
+    FNET_TEST_CHECK(memcmp(rx_data, data, 4000) == 0);
+    echo(client, server, 3000);
+    disconnect(client, server);
+
+    fnet_test_link_tap = 0;
+    fnet_test_link_loss = 0;
+    FNET_TEST_CHECK(fnet_test_link_stat[FNET_TEST_LINK_TO_SERVER].drops == 1);
+#if FNET_CFG_TCP_SACK
+    FNET_TEST_CHECK(fnet_test_link_stat[FNET_TEST_LINK_TO_CLIENT].sack > 0);
+#endif
+    FNET_TEST_CHECK(tx_data_segments >= 6);
+    FNET_TEST_CHECK(tx_segments > tx_data_segments);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("one header buffer per segment");
+}
+
+/* Reads everything 'rx' gets until 'len' bytes are in rx_data.*/
+static void receive_all( SOCKET rx, int len )
+{
+    int received, res, ms;
+
+    for(received = 0, ms = 0; received < len; received += res, ms++)
+    {
+        FNET_TEST_CHECK(ms < 30000);
+        fnet_test_link_step();
+        res = recv(rx, rx_data + received, len - received, 0);
+        FNET_TEST_CHECK(res >= 0);
+    }
+}
+
+/* Returns a chain of 'len' bytes of 'data' at 'offset', in heap buffers of 'size'.*/
+static fnet_netbuf_t *nb_chain( int offset, int len, int size )
+{
+    fnet_netbuf_t   *chain = 0, *nb;
+    int             n;
+
+    for(; len > 0; offset += n, len -= n)
+    {
+        n = (len < size) ? len : size;
+        nb = fnet_netbuf_new(n, FNET_FALSE);
+        FNET_TEST_CHECK(nb != 0);
+        memcpy(nb->data_ptr, data + offset, (size_t)n);
+        chain = chain ? fnet_netbuf_concat(chain, nb) : nb;
+    }
+    return chain;
+}
+
+/* Retransmitted segments share the data of the chain given to fnet_send_nb().*/
+static void             *nb_data;
+static unsigned long    nb_rexmt;
+
+static void nb_tap( int dir, fnet_netbuf_t *nb )
+{
+    unsigned long header_length = (unsigned long)((((unsigned char *)nb->data_ptr)[12] >> 4) * 4);
+
+    if((dir == FNET_TEST_LINK_TO_SERVER) && (nb->total_length > header_length) 
+        && (fnet_test_link_stat[dir].rexmt > nb_rexmt))
+    {
+        nb_rexmt = fnet_test_link_stat[dir].rexmt;
+        FNET_TEST_CHECK(nb->next->data == nb_data);
+    }
+}
+
+static void test_nb( void )
+{
+    SOCKET              client, server;
+    fnet_socket_t       *sk;
+    unsigned long       free_mem = fnet_free_mem_status();
+    fnet_netbuf_t       *nb;
+    char                *data_ptr;
+    int                 len, ms;
+
+    /* The chain is acknowledged and freed by the socket while a 
+     * retransmission of it is still on the link. The long delay makes
+     * the retransmission timer expire before the ACK arrives.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    sk = fnet_test_link_socket(client);
+    echo(client, server, 100);      /* RTT samples bring RTO down to FNET_TCP_RTO_MIN.*/
+    fnet_test_link_reset_stat();
+    fnet_test_link_delay = 1500;
+    fnet_test_link_tap = nb_tap;
+    nb_rexmt = 0;
+
+    nb = nb_chain(0, 1000, 1000);
+    nb_data = nb->data;
+    data_ptr = (char *)nb->data_ptr;
+    FNET_TEST_CHECK(fnet_send_nb(client, nb, 0, 0, 0) == 1000);
+    for(ms = 0; sk->send_buffer.count; ms++)
+    {
+        FNET_TEST_CHECK(ms < 30000);
+        fnet_test_link_step();
+        FNET_TEST_CHECK(recv(server, rx_data, 1000, 0) >= 0);   /* Drops the reference of the receive buffer.*/
+    }
+    FNET_TEST_CHECK(nb_rexmt > 0);
+    FNET_TEST_CHECK(((int *)nb_data)[0] == 1);     /* Only the retransmission on the link.*/
+    FNET_TEST_CHECK(memcmp(data_ptr, data, 1000) == 0);
+
+    fnet_test_link_run(10000);
+    fnet_test_link_tap = 0;
+    fnet_test_link_delay = 20;
+    FNET_TEST_CHECK(memcmp(rx_data, data, 1000) == 0);
+    echo(client, server, 1000);
+    disconnect(client, server);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("send_nb(), rexmt outlives the chain");
+
+    /* A received chain is freed after both sockets are gone.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    deliver(client, server, 3000);
+    FNET_TEST_CHECK(fnet_recv_nb(server, &nb, 2000, MSG_PEEK, 0, 0) == 2000);
+    fnet_netbuf_free_chain(nb);
+    FNET_TEST_CHECK(fnet_recv_nb(server, &nb, 2000, 0, 0, 0) == 2000);
+    FNET_TEST_CHECK((nb != 0) && (nb->total_length == 2000));
+    FNET_TEST_CHECK(fnet_test_link_socket(server)->receive_buffer.count == 1000);
+    disconnect(client, server);
+    fnet_netbuf_to_buf(nb, 0, 2000, rx_data);
+    FNET_TEST_CHECK(memcmp(rx_data, data, 2000) == 0);
+    fnet_netbuf_free_chain(nb);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("recv_nb() chain freed after close");
+
+    /* A chain that does not fit into the send buffer is left to the 
+     * caller as a whole, send() takes what fits.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    sk = fnet_test_link_socket(client);
+    FNET_TEST_CHECK(send(client, data, 3000, 0) == 3000);
+    nb = nb_chain(10000, 2000, 500);
+    FNET_TEST_CHECK(fnet_send_nb(client, nb, 0, 0, 0) == 0);
+    FNET_TEST_CHECK(sk->send_buffer.count == 3000);
+    len = send(client, data + 3000, 2000, 0);
+    FNET_TEST_CHECK((len > 0) && (len < 2000) && (sk->send_buffer.count == BUF_SIZE));
+    FNET_TEST_CHECK(fnet_send_nb(client, nb, 0, 0, 0) == 0);
+    FNET_TEST_CHECK(nb->total_length == 2000);
+    fnet_netbuf_to_buf(nb, 0, 2000, rx_data);
+    FNET_TEST_CHECK(memcmp(rx_data, data + 10000, 2000) == 0);
+
+    receive_all(server, 3000 + len);
+    FNET_TEST_CHECK(memcmp(rx_data, data, (size_t)(3000 + len)) == 0);
+    for(ms = 0; sk->send_buffer.count + 2000 > BUF_SIZE; ms++)
+    {
+        FNET_TEST_CHECK(ms < 10000);
+        fnet_test_link_step();
+    }
+    FNET_TEST_CHECK(fnet_send_nb(client, nb, 0, 0, 0) == 2000);
+    receive_all(server, 2000);
+    FNET_TEST_CHECK(memcmp(rx_data, data + 10000, 2000) == 0);
+    disconnect(client, server);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("send_nb() with a full send buffer");
+}
+
+/* Small writes are copied into the free space of the last net_buf of
+ * the send buffer, behind the data of the segments in flight.*/
+static int nb_count( fnet_netbuf_t *nb )
+{
+    int count;
+
+    for(count = 0; nb; nb = nb->next)
+        count++;
+    return count;
+}
+
+/* Loses the first transmission of every fourth segment.*/
+static int coalesce_loss( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    return (dir == FNET_TEST_LINK_TO_SERVER) && len && !rexmt && (((seq / 1460) % 4) == 1);
+}
+
+/* A data buffer of the caller, with free space after the data.*/
+static struct
+{
+    fnet_netbuf_ext_t   ext;
+    char                data[200];
+} owned;
+static int owned_freed;
+
+static void owned_free( fnet_netbuf_ext_t *ext )
+{
+    owned_freed++;
+}
+
+static void test_coalesce( void )
+{
+    SOCKET          client, server;
+    fnet_socket_t   *sk;
+    fnet_netbuf_t   *nb;
+    unsigned long   free_mem = fnet_free_mem_status();
+    int             i, n, sent, received, ms;
+
+    /* The first write is sent at once, the others wait for its ACK.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    sk = fnet_test_link_socket(client);
+    for(i = 0; i < 200; i++)
+        FNET_TEST_CHECK(send(client, data + i * 10, 10, 0) == 10);
+    FNET_TEST_CHECK(sk->send_buffer.count == 2000);
+    FNET_TEST_CHECK(nb_count(sk->send_buffer.net_buf_chain) == 2);
+    receive_all(server, 2000);
+    FNET_TEST_CHECK(memcmp(rx_data, data, 2000) == 0);
+    disconnect(client, server);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("200 writes of 10 bytes in 2 net_bufs");
+
+    /* Small writes while earlier segments are in flight or sent again.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    fnet_test_link_reset_stat();
+    fnet_test_link_loss = coalesce_loss;
+    for(sent = 0, received = 0, ms = 0; received < 20000; ms++)
+    {
+        FNET_TEST_CHECK(ms < 60000);
+        n = (int)(test_rand() % 100) + 1;
+        if(n > 20000 - sent)
+            n = 20000 - sent;
+        n = send(client, data + sent, n, 0);
+        FNET_TEST_CHECK(n >= 0);
+        sent += n;
+
+        fnet_test_link_step();
+        n = recv(server, rx_data + received, 20000 - received, 0);
+        FNET_TEST_CHECK(n >= 0);
+        received += n;
+    }
+    FNET_TEST_CHECK(memcmp(rx_data, data, 20000) == 0);
+    FNET_TEST_CHECK((fnet_test_link_stat[FNET_TEST_LINK_TO_SERVER].drops > 0) 
+                    && (fnet_test_link_stat[FNET_TEST_LINK_TO_SERVER].rexmt > 0));
+    fnet_test_link_loss = 0;
+    disconnect(client, server);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("small writes, in flight and lost");
+
+    /* The free space is dropped when a chain of the caller is added, 
+     * the next write gets a new net_buf.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    sk = fnet_test_link_socket(client);
+    FNET_TEST_CHECK(send(client, data, 10, 0) == 10);
+    FNET_TEST_CHECK(sk->send_buffer.net_buf_tail_room > 0);
+
+    memset(owned.data, 0x55, sizeof(owned.data));
+    memcpy(owned.data, data + 10, 100);
+    owned.ext.free = owned_free;
+    owned_freed = 0;
+    nb = fnet_netbuf_from_ext(&owned.ext, owned.data, 100, FNET_FALSE);
+    FNET_TEST_CHECK(nb != 0);
+    FNET_TEST_CHECK(fnet_send_nb(client, nb, 0, 0, 0) == 100);
+    FNET_TEST_CHECK(sk->send_buffer.net_buf_tail_room == 0);
+
+    FNET_TEST_CHECK(send(client, data + 110, 90, 0) == 90);
+    for(i = 100; i < (int)sizeof(owned.data); i++)
+        FNET_TEST_CHECK(owned.data[i] == 0x55);
+    FNET_TEST_CHECK(nb_count(sk->send_buffer.net_buf_chain) == 3);
+
+    receive_all(server, 200);
+    FNET_TEST_CHECK(memcmp(rx_data, data, 200) == 0);
+    disconnect(client, server);
+    FNET_TEST_CHECK(owned_freed == 1);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("caller's net_buf is not written");
+}
+
+/* Readiness of the sockets, and the event callback. The callback is 
+ * called once for every segment or datagram, that leaves one of the 
+ * requested events ready.*/
+static int      cb_calls;
+static int      cb_revents;
+static SOCKET   cb_socket;
+
+static void poll_callback( SOCKET s, int revents, long cookie )
+{
+    FNET_TEST_CHECK(cookie == 7);
+    FNET_TEST_CHECK(fnet_test_isr_locked == 0);
+    cb_calls++;
+    cb_revents = revents;
+    cb_socket = s;
+}
+
+static void poll_watch( SOCKET s, int events )
+{
+    FNET_TEST_CHECK(fnet_socket_set_callback(s, events, poll_callback, 7) == FNET_OK);
+    cb_calls = 0;
+    cb_revents = 0;
+}
+
+/* Steps the link until the callback is called.*/
+static void poll_wait( void )
+{
+    int ms;
+
+    for(ms = 0; cb_calls == 0; ms++)
+    {
+        FNET_TEST_CHECK(ms < 10000);
+        fnet_test_link_step();
+    }
+}
+
+static int poll_one( SOCKET s, int events )
+{
+    struct fnet_pollfd fd;
+
+    fd.fd = s;
+    fd.events = events;
+    FNET_TEST_CHECK(fnet_poll(&fd, 1) == (fd.revents != 0));
+    return fd.revents;
+}
+
+/* Returns the sets, fnet_select() leaves 's' in, as FNET_POLLIN, 
+ * FNET_POLLOUT and FNET_POLLPRI.*/
+static int select_one( SOCKET s )
+{
+    fnet_fd_set read_set, write_set, except_set;
+    int         result = 0, count;
+
+    FNET_FD_ZERO(&read_set);
+    FNET_FD_ZERO(&write_set);
+    FNET_FD_ZERO(&except_set);
+    FNET_FD_SET(s, &read_set);
+    FNET_FD_SET(s, &write_set);
+    FNET_FD_SET(s, &except_set);
+
+    count = fnet_select(s + 1, &read_set, &write_set, &except_set);
+    if(FNET_FD_ISSET(s, &read_set))
+        result |= FNET_POLLIN;
+    if(FNET_FD_ISSET(s, &write_set))
+        result |= FNET_POLLOUT;
+    if(FNET_FD_ISSET(s, &except_set))
+        result |= FNET_POLLPRI;
+    FNET_TEST_CHECK(count == ((result & FNET_POLLIN) != 0) + ((result & FNET_POLLOUT) != 0) + ((result & FNET_POLLPRI) != 0));
+
+    return result;
+}
+
+static void test_poll( void )
+{
+    SOCKET              listener, client, server, peer;
+    struct sockaddr_in  addr;
+    struct fnet_pollfd  fds[2];
+    fnet_fd_set         read_set;
+    struct linger       linger = {1, 0};
+    unsigned long       free_mem = fnet_free_mem_status();
+    int                 bufsize = 1000;
+
+    /* A connection is moved to the incoming list.*/
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    FNET_TEST_CHECK(listener != SOCKET_INVALID);
+    fnet_memset_zero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = FNET_HTONS(FNET_TEST_LINK_SERVER_PORT);
+    addr.sin_addr.s_addr = FNET_TEST_LINK_SERVER_IP;
+    FNET_TEST_CHECK(bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+    FNET_TEST_CHECK(listen(listener, 1) == FNET_OK);
+    poll_watch(listener, FNET_POLLIN);
+    FNET_TEST_CHECK(poll_one(listener, FNET_POLLIN | FNET_POLLOUT) == 0);
+    FNET_TEST_CHECK(select_one(listener) == 0);
+
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    FNET_TEST_CHECK(client != SOCKET_INVALID);
+    FNET_TEST_CHECK(setsockopt(client, SOL_SOCKET, SO_SNDBUF, (char *)&bufsize, sizeof(bufsize)) == FNET_OK);
+    FNET_TEST_CHECK(connect(client, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+    poll_wait();
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK((cb_calls == 1) && (cb_revents == FNET_POLLIN) && (cb_socket == listener));
+    FNET_TEST_CHECK(poll_one(listener, FNET_POLLIN) == FNET_POLLIN);
+    FNET_TEST_CHECK(select_one(listener) == FNET_POLLIN);
+    server = accept(listener, 0, 0);
+    FNET_TEST_CHECK(server != SOCKET_INVALID);
+    FNET_TEST_CHECK(poll_one(listener, FNET_POLLIN) == 0);
+    FNET_TEST_CHECK(closesocket(listener) == FNET_OK);
+    fnet_test_pass("poll, accept");
+
+    /* Data arrives.*/
+    FNET_TEST_CHECK(poll_one(server, FNET_POLLIN | FNET_POLLOUT) == FNET_POLLOUT);
+    FNET_TEST_CHECK(select_one(server) == FNET_POLLOUT);
+    poll_watch(server, FNET_POLLIN);
+    FNET_TEST_CHECK(send(client, data, 100, 0) == 100);
+    poll_wait();
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK((cb_calls == 1) && (cb_revents == FNET_POLLIN) && (cb_socket == server));
+    FNET_TEST_CHECK(poll_one(server, FNET_POLLIN) == FNET_POLLIN);
+    FNET_TEST_CHECK(select_one(server) == (FNET_POLLIN | FNET_POLLOUT));
+    FNET_TEST_CHECK(recv(server, rx_data, 1000, 0) == 100);
+    FNET_TEST_CHECK(poll_one(server, FNET_POLLIN) == 0);
+    FNET_TEST_CHECK(fnet_socket_set_callback(server, 0, 0, 0) == FNET_OK);
+    fnet_test_pass("poll, data arrives");
+
+    /* An ACK frees send space. The full send buffer is in one segment.*/
+    FNET_TEST_CHECK(send(client, data, 1000, 0) == 1000);
+    FNET_TEST_CHECK(send(client, data, 1, 0) == 0);
+    FNET_TEST_CHECK(poll_one(client, FNET_POLLOUT) == 0);
+    FNET_TEST_CHECK(select_one(client) == 0);
+    poll_watch(client, FNET_POLLOUT);
+    poll_wait();
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK((cb_calls == 1) && (cb_revents == FNET_POLLOUT) && (cb_socket == client));
+    FNET_TEST_CHECK(poll_one(client, FNET_POLLIN | FNET_POLLOUT) == FNET_POLLOUT);
+    FNET_TEST_CHECK(select_one(client) == FNET_POLLOUT);
+    FNET_TEST_CHECK(fnet_socket_set_callback(client, 0, 0, 0) == FNET_OK);
+    receive_all(server, 1000);
+    fnet_test_pass("poll, ACK frees send space");
+
+    /* The peer closes.*/
+    poll_watch(server, FNET_POLLIN);
+    FNET_TEST_CHECK(shutdown(client, SD_WRITE) == FNET_OK);
+    poll_wait();
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK((cb_calls == 1) && (cb_revents == FNET_POLLIN));
+    FNET_TEST_CHECK(poll_one(server, FNET_POLLIN) == FNET_POLLIN);
+    FNET_TEST_CHECK(select_one(server) & FNET_POLLIN);
+    fnet_test_pass("poll, peer closes");
+
+    /* The peer resets the connection.*/
+    poll_watch(server, FNET_POLLIN);
+    FNET_TEST_CHECK(setsockopt(client, SOL_SOCKET, SO_LINGER, (char *)&linger, sizeof(linger)) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(client) == FNET_OK);
+    poll_wait();
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK((cb_calls == 1) && (cb_revents & FNET_POLLERR) && (cb_revents & FNET_POLLHUP));
+    FNET_TEST_CHECK(poll_one(server, 0) == (FNET_POLLERR | FNET_POLLHUP));
+    FNET_TEST_CHECK(select_one(server) == (FNET_POLLIN | FNET_POLLOUT | FNET_POLLPRI));
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+
+    /* A closed descriptor.*/
+    fds[0].fd = server;
+    fds[0].events = FNET_POLLIN;
+    fds[1].fd = -1;
+    fds[1].events = FNET_POLLIN;
+    FNET_TEST_CHECK(fnet_poll(fds, 2) == 1);
+    FNET_TEST_CHECK((fds[0].revents == FNET_POLLNVAL) && (fds[1].revents == 0));
+    FNET_FD_ZERO(&read_set);
+    FNET_FD_SET(server, &read_set);
+    FNET_TEST_CHECK(fnet_select(server + 1, &read_set, 0, 0) == SOCKET_ERROR);
+    FNET_TEST_CHECK(fnet_error_get() == FNET_ERR_BAD_DESC);
+    fnet_test_link_run(5000);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("poll, connection reset");
+
+    /* UDP.*/
+    server = socket(AF_INET, SOCK_DGRAM, 0);
+    peer = socket(AF_INET, SOCK_DGRAM, 0);
+    FNET_TEST_CHECK((server != SOCKET_INVALID) && (peer != SOCKET_INVALID));
+    addr.sin_port = FNET_HTONS(53);
+    FNET_TEST_CHECK(bind(server, (struct sockaddr *)&addr, sizeof(addr)) == FNET_OK);
+    FNET_TEST_CHECK(poll_one(server, FNET_POLLIN | FNET_POLLOUT) == FNET_POLLOUT);
+    poll_watch(server, FNET_POLLIN);
+    FNET_TEST_CHECK(sendto(peer, data, 100, 0, (struct sockaddr *)&addr, sizeof(addr)) == 100);
+    FNET_TEST_CHECK(sendto(peer, data, 200, 0, (struct sockaddr *)&addr, sizeof(addr)) == 200);
+    poll_wait();
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK((cb_calls == 2) && (cb_revents == FNET_POLLIN) && (cb_socket == server));
+    FNET_TEST_CHECK(select_one(server) == (FNET_POLLIN | FNET_POLLOUT));
+    FNET_TEST_CHECK(recv(server, rx_data, 1000, 0) == 100);
+    FNET_TEST_CHECK(poll_one(server, FNET_POLLIN) == FNET_POLLIN);
+    FNET_TEST_CHECK(recv(server, rx_data, 1000, 0) == 200);
+    FNET_TEST_CHECK(poll_one(server, FNET_POLLIN) == 0);
+
+    /* Unregistered.*/
+    FNET_TEST_CHECK(fnet_socket_set_callback(server, 0, 0, 0) == FNET_OK);
+    cb_calls = 0;
+    FNET_TEST_CHECK(sendto(peer, data, 100, 0, (struct sockaddr *)&addr, sizeof(addr)) == 100);
+    fnet_test_link_run(1000);
+    FNET_TEST_CHECK((cb_calls == 0) && (poll_one(server, FNET_POLLIN) == FNET_POLLIN));
+    FNET_TEST_CHECK(closesocket(server) == FNET_OK);
+    FNET_TEST_CHECK(closesocket(peer) == FNET_OK);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("poll, UDP datagrams");
+}
+
+#if FNET_CFG_TCP_SACK
+/* SACK blocks of the peer, relative to the first unacknowledged byte.*/
+#define SACK_SENT       (1000)
+
+static unsigned char sack_map[SACK_SENT];
+static int           sack_lost;         /* SACKed data has not fit into the blocks.*/
+
+/* Returns the runs of SACKed data in sack_map.*/
+static int sack_runs( unsigned long (*runs)[2] )
+{
+    unsigned long   i;
+    int             count = 0;
+
+    for(i = 0; i < SACK_SENT; i++)
+    {
+        if(sack_map[i] && (!i || !sack_map[i - 1]))
+            runs[count][0] = i;
+        if(sack_map[i] && ((i == SACK_SENT - 1) || !sack_map[i + 1]))
+            runs[count++][1] = i + 1;
+    }
+    return count;
+}
+
+static int sack_drop( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    return (dir == FNET_TEST_LINK_TO_SERVER) && len;
+}
+
+/* Passes an ACK with 'count' SACK blocks to the client 'sk', as the server 
+ * sends it, and marks the blocks in sack_map. The blocks are taken in 
+ * order, the SACKed data may not fit after any of them.*/
+static void sack_input( fnet_socket_t *sk, const unsigned long (*blocks)[2], int count )
+{
+    fnet_tcp_control_t  *cb = (fnet_tcp_control_t *)sk->protocol_control;
+    int                 length = 20 + 4 + count * 8;
+    fnet_netbuf_t       *nb;
+    unsigned char       *header;
+    unsigned short      checksum;
+    fnet_ip4_addr_t     src_ip = FNET_TEST_LINK_SERVER_IP;
+    fnet_ip4_addr_t     dest_ip = FNET_TEST_LINK_CLIENT_IP;
+    unsigned long       runs[SACK_SENT][2];
+    int                 i;
+
+    nb = fnet_netbuf_new(length, FNET_FALSE);
+    FNET_TEST_CHECK(nb != 0);
+    header = (unsigned char *)nb->data_ptr;
+    fnet_memset_zero(header, (unsigned int)length);
+
+    *(unsigned short *)(header + 0) = sk->foreign_addr.sa_port;
+    *(unsigned short *)(header + 2) = sk->local_addr.sa_port;
+    *(unsigned long *)(header + 4) = fnet_htonl(cb->tcpcb_sndack);
+    *(unsigned long *)(header + 8) = fnet_htonl(cb->tcpcb_rcvack);
+    header[12] = (unsigned char)((length / 4) << 4);
+    header[13] = FNET_TCP_SGT_ACK;
+    *(unsigned short *)(header + 14) = FNET_HTONS(8192);
+
+    header[20] = FNET_TCP_OTYPES_NOP;
+    header[21] = FNET_TCP_OTYPES_NOP;
+    header[22] = FNET_TCP_OTYPES_SACK;
+    header[23] = (unsigned char)(2 + count * 8);
+    for(i = 0; i < count; i++)
+    {
+        *(unsigned long *)(header + 24 + i * 8) = fnet_htonl(cb->tcpcb_rcvack + blocks[i][0]);
+        *(unsigned long *)(header + 28 + i * 8) = fnet_htonl(cb->tcpcb_rcvack + blocks[i][1]);
+        memset(sack_map + blocks[i][0], 1, blocks[i][1] - blocks[i][0]);
+        if(sack_runs(runs) > FNET_CFG_TCP_SACK_BLOCKS)
+            sack_lost = 1;
+    }
+
+    checksum = fnet_checksum_pseudo_start(nb, FNET_HTONS((unsigned short)FNET_IP_PROTOCOL_TCP), (unsigned short)nb->total_length);
+    checksum = fnet_checksum_pseudo_end(checksum, (char *)&src_ip, (char *)&dest_ip, sizeof(fnet_ip4_addr_t));
+    *(unsigned short *)(header + 16) = checksum;
+
+    fnet_test_link_input(src_ip, dest_ip, nb);
+}
+
+/* Checks the SACKed blocks of the client 'cb' against sack_map. They must 
+ * be sorted and apart, and inside the SACKed data. They must be equal to
+ * the SACKed data as long as it has fit into FNET_CFG_TCP_SACK_BLOCKS 
+ * blocks. Returns the number of runs of SACKed data.*/
+static int sack_check( fnet_tcp_control_t *cb )
+{
+    unsigned long   runs[SACK_SENT][2];
+    int             count = sack_runs(runs);
+    unsigned long   i, start, end;
+    int             n;
+
+    FNET_TEST_CHECK((cb->tcpcb_sndsackcount > 0) && (cb->tcpcb_sndsackcount <= FNET_CFG_TCP_SACK_BLOCKS));
+    for(n = 0; n < cb->tcpcb_sndsackcount; n++)
+    {
+        start = cb->tcpcb_sndsack[n].start - cb->tcpcb_rcvack;
+        end = cb->tcpcb_sndsack[n].end - cb->tcpcb_rcvack;
+        FNET_TEST_CHECK((start < end) && (end <= SACK_SENT));
+        if(n)
+            FNET_TEST_CHECK(start > cb->tcpcb_sndsack[n - 1].end - cb->tcpcb_rcvack);
+        for(i = start; i < end; i++)
+            FNET_TEST_CHECK(sack_map[i]);
+        if(!sack_lost)
+            FNET_TEST_CHECK((start == runs[n][0]) && (end == runs[n][1]));
+    }
+    if(!sack_lost)
+        FNET_TEST_CHECK(cb->tcpcb_sndsackcount == count);
+
+    return count;
+}
+
+static void sack_reset( fnet_tcp_control_t *cb )
+{
+    cb->tcpcb_sndsackcount = 0;
+    memset(sack_map, 0, sizeof(sack_map));
+    sack_lost = 0;
+}
+
+static void test_sack_blocks( void )
+{
+    static const unsigned long overlap[][2] = {{100, 200}, {150, 250}, {100, 300}};
+    static const unsigned long twice[][2] = {{100, 200}, {100, 200}};
+    static const unsigned long apart[][2] = {{100, 150}, {200, 250}, {300, 350}, {400, 450}};
+    static const unsigned long across[][2] = {{120, 420}};
+    static const unsigned long adjoin[][2] = {{200, 300}, {100, 200}};
+    unsigned long       blocks[FNET_TCP_SACK_MAX_BLOCKS][2];
+    SOCKET              client, server;
+    fnet_socket_t       *sk;
+    fnet_tcp_control_t  *cb;
+    unsigned long       free_mem = fnet_free_mem_status();
+    int                 i, n, count, lost = 0;
+
+    /* The data of the client does not arrive, the ACKs of the server 
+     * are made up.*/
+    fnet_test_link_connect(&client, &server, BUF_SIZE);
+    sk = fnet_test_link_socket(client);
+    cb = tcp_cb(client);
+    fnet_test_link_loss = sack_drop;
+    FNET_TEST_CHECK(send(client, data, 3000, 0) == 3000);
+    FNET_TEST_CHECK(cb->tcpcb_maxrcvack - cb->tcpcb_rcvack >= SACK_SENT);
+
+    /* Overlapping blocks, in one ACK and one by one.*/
+    sack_reset(cb);
+    sack_input(sk, overlap, 3);
+    FNET_TEST_CHECK(sack_check(cb) == 1);
+    sack_reset(cb);
+    for(i = 0; i < 3; i++)
+        sack_input(sk, overlap + i, 1);
+    FNET_TEST_CHECK(sack_check(cb) == 1);
+
+    /* Repeated blocks.*/
+    sack_reset(cb);
+    sack_input(sk, twice, 2);
+    sack_input(sk, twice, 1);
+    FNET_TEST_CHECK(sack_check(cb) == 1);
+
+    /* One block joins all.*/
+    sack_reset(cb);
+    sack_input(sk, apart, 4);
+    FNET_TEST_CHECK(sack_check(cb) == 4);
+    sack_input(sk, across, 1);
+    FNET_TEST_CHECK(sack_check(cb) == 1);
+
+    /* Adjoining blocks.*/
+    sack_reset(cb);
+    sack_input(sk, adjoin, 2);
+    FNET_TEST_CHECK(sack_check(cb) == 1);
+
+    /* Random blocks on a coarse grid, so that they overlap, adjoin and repeat.*/
+    for(n = 0; n < 2000; n++)
+    {
+        if((n % 8) == 0)
+            sack_reset(cb);
+
+        count = 1 + (int)(test_rand() % FNET_TCP_SACK_MAX_BLOCKS);
+        for(i = 0; i < count; i++)
+        {
+            blocks[i][0] = (test_rand() % 19) * 50;
+            blocks[i][1] = blocks[i][0] + (1 + test_rand() % 4) * 50;
+            if(blocks[i][1] > SACK_SENT)
+                blocks[i][1] = SACK_SENT;
+        }
+        sack_input(sk, (const unsigned long (*)[2])blocks, count);
+        sack_check(cb);
+        lost += sack_lost;
+    }
+    FNET_TEST_CHECK((lost > 0) && (lost < n));
+
+    fnet_test_link_loss = 0;
+    sack_reset(cb);
+    receive_all(server, 3000);
+    FNET_TEST_CHECK(memcmp(rx_data, data, 3000) == 0);
+    disconnect(client, server);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+    fnet_test_pass("SACK blocks overlap, repeat and join");
+}
+#endif /* FNET_CFG_TCP_SACK */
+
+/* Loses every second segment of a window, or 'loss_pct' % of the data
+ * and half as many of the ACKs. The lost data is counted.*/
+static int              loss_pct;
+static unsigned long    loss_data;
+
+static int loss_burst( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    if((dir == FNET_TEST_LINK_TO_SERVER) && len && !rexmt && (seq >= 10001) && (seq < 10001 + 1460 * 5) 
+        && ((((seq - 10001) / 1460) % 2) == 0))
+    {
+        loss_data += len;
+        return 1;
+    }
+    return 0;
+}
+
+static int loss_random( int dir, unsigned long seq, unsigned long len, int rexmt )
+{
+    if((dir == FNET_TEST_LINK_TO_SERVER) && len)
+    {
+        if((int)(test_rand() % 1000) >= loss_pct * 10)
+            return 0;
+
+        loss_data += len;
+        return 1;
+    }
+    return (int)(test_rand() % 1000) < loss_pct * 5;
+}
+
+/* Sends 'len' bytes from the client with 'loss' on the link.*/
+static void transfer( int (*loss)( int dir, unsigned long seq, unsigned long len, int rexmt ), int len )
+{
+    SOCKET          client, server;
+    unsigned long   free_mem = fnet_free_mem_status();
+    unsigned long   start;
+    int             sent = 0, received = 0, res;
+
+    fnet_test_link_connect(&client, &server, 16384);
+    fnet_test_link_reset_stat();
+    fnet_test_link_loss = loss;
+    loss_data = 0;
+    start = fnet_test_link_now();
+
+    while(received < len)
+    {
+        FNET_TEST_CHECK(fnet_test_link_now() - start < 600000);
+        fnet_test_link_step();
+
+        res = send(client, data + sent, len - sent, 0);
+        FNET_TEST_CHECK(res >= 0);
+        sent += res;
+
+        res = recv(server, rx_data + received, len - received, 0);
+        FNET_TEST_CHECK(res >= 0);
+        received += res;
+    }
+    FNET_TEST_CHECK(memcmp(rx_data, data, (size_t)len) == 0);
+
+    fnet_test_link_loss = 0;
+    disconnect(client, server);
+    FNET_TEST_CHECK(fnet_free_mem_status() == free_mem);
+}
+
+static void test_loss( void )
+{
+    fnet_test_link_stat_t *stat = &fnet_test_link_stat[FNET_TEST_LINK_TO_SERVER];
+
+    /* With SACK, only the holes are sent again.*/
+    transfer(loss_burst, 60000);
+    FNET_TEST_CHECK((stat->drops == 3) && (stat->rexmt >= loss_data));
+#if FNET_CFG_TCP_SACK
+    FNET_TEST_CHECK(stat->rexmt == loss_data);
+    FNET_TEST_CHECK(fnet_test_link_stat[FNET_TEST_LINK_TO_CLIENT].sack > 0);
+#endif
+    fnet_test_pass("burst loss");
+
+    loss_pct = 5;
+    transfer(loss_random, DATA_SIZE);
+    FNET_TEST_CHECK((stat->drops > 0) && (stat->rexmt >= loss_data));
+    fnet_test_pass("random loss of data and ACKs");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    int i;
+
+    for(i = 0; i < DATA_SIZE; i++)
+        data[i] = (char)test_rand();
+
+    fnet_test_link_init(heap, sizeof(heap));
+
+    test_rtt();
+    test_timers();
+    test_rcv_unlocked();
+    test_tx_headers();
+    test_nb();
+    test_coalesce();
+    test_poll();
+    test_loss();
+#if FNET_CFG_TCP_SACK
+    test_sack_blocks();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,447 @@
+/**************************************************************************
+*
+* Copyright 2012-2013 by Andrey Butok. FNET Community.
+* Copyright 2005-2011 by Andrey Butok. Freescale Semiconductor, Inc.
+*
+***************************************************************************
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License Version 3 
+* or later (the "LGPL").
+*
+* As a special exception, the copyright holders of the FNET project give you
+* permission to link the FNET sources with independent modules to produce an
+* executable, regardless of the license terms of these independent modules,
+* and to copy and distribute the resulting executable under terms of your 
+* choice, provided that you also meet, for each linked independent module,
+* the terms and conditions of the license of that module.
+* An independent module is a module which is not derived from or based 
+* on this library. 
+* If you modify the FNET sources, you may extend this exception 
+* to your version of the FNET sources, but you are not obligated 
+* to do so. If you do not wish to do so, delete this
+* exception statement from your version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* You should have received a copy of the GNU General Public License
+* and the GNU Lesser General Public License along with this program.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+**********************************************************************//*!
+*
+*
+* @file test_timer.c
+*
+* @date Oct-17-2026
+*
+* @version 0.0.1.0
+*
+* @brief Software timer wheel and LPC17xx microsecond clock test.
+*
+***************************************************************************/
+
+#include "fnet_test.h"
+
+#include "fnet.h"
+#include "fnet_timer_prv.h"
+#include "LPC17xx.h"
+
+/* The peripheral registers are kept in host memory.*/
+static LPC_TIM_TypeDef  fnet_test_tim2;
+static LPC_SC_TypeDef   fnet_test_sc;
+
+#undef LPC_TIM2
+#define LPC_TIM2    (&fnet_test_tim2)
+#undef LPC_SC
+#define LPC_SC      (&fnet_test_sc)
+
+/* The NVIC is not modelled.*/
+#define NVIC_EnableIRQ(irq)     ((void)(irq))
+
+#include "fnet_lpc1768_timer.c"
+
+#define COUNTS_PER_US   (SystemCoreClock / 4 / 1000000)
+
+static unsigned char heap[16 * 1024];
+
+static unsigned long matches;   /* Periods counted by the timer.*/
+
+static unsigned long seed = 1;
+
+static unsigned long test_rand( void )
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/* The counter runs for 'counts', it is reset on the match.*/
+static void timer_run( unsigned long counts )
+{
+    LPC_TIM2->TC += counts;
+    if(LPC_TIM2->TC >= LPC_TIM2->MR0)
+    {
+        LPC_TIM2->TC -= LPC_TIM2->MR0;
+        LPC_TIM2->IR |= 1;
+        matches++;
+    }
+}
+
+/* The match interrupt, if it is pending.*/
+static void timer_interrupt( void )
+{
+    if(LPC_TIM2->IR & 1)
+    {
+        fnet_cpu_timer_handler_top();
+        LPC_TIM2->IR = 0;   /* Writing 1 clears the flag.*/
+    }
+}
+
+/************************************************************************
+* Software timers. A probe records its calls and may change other 
+* timers, or itself, from its handler.
+*************************************************************************/
+#define PROBE_MAX       (16)
+
+typedef enum
+{
+    PROBE_NONE,
+    PROBE_STOP,         /* Stops 'other'.*/
+    PROBE_FREE,         /* Frees 'other'.*/
+    PROBE_FREE_SELF,
+    PROBE_RESTART       /* Restarts itself after 'delay', 'restarts' times.*/
+} probe_action_t;
+
+typedef struct probe
+{
+    fnet_timer_desc_t   timer;
+    probe_action_t      action;
+    struct probe        *other;
+    unsigned long       delay;
+    int                 restarts;
+    int                 count;
+    unsigned long       fired[8];   /* Tick of the first calls.*/
+} probe_t;
+
+static probe_t  probes[PROBE_MAX];
+static probe_t  *fire_log[64];
+static int      fire_count;
+
+static void probe_handler( void *cookie )
+{
+    probe_t *probe = (probe_t *)cookie;
+
+    if(probe->count < (int)(sizeof(probe->fired) / sizeof(probe->fired[0])))
+        probe->fired[probe->count] = fnet_timer_ticks();
+    probe->count++;
+    if(fire_count < (int)(sizeof(fire_log) / sizeof(fire_log[0])))
+        fire_log[fire_count] = probe;
+    fire_count++;
+
+    /* The bottom half runs with the interrupts locked.*/
+    FNET_TEST_CHECK(fnet_test_isr_locked > 0);
+
+    switch(probe->action)
+    {
+        case PROBE_STOP:
+            fnet_timer_stop(probe->other->timer);
+            break;
+        case PROBE_FREE:
+            if(probe->other->timer)
+            {
+                fnet_timer_free(probe->other->timer);
+                probe->other->timer = 0;
+            }
+            break;
+        case PROBE_FREE_SELF:
+            fnet_timer_free(probe->timer);
+            probe->timer = 0;
+            break;
+        case PROBE_RESTART:
+            if(probe->restarts-- > 0)
+                fnet_timer_start(probe->timer, probe->delay);
+            break;
+    }
+}
+
+static probe_t *probe_new( unsigned long delay )
+{
+    probe_t *probe;
+
+    for(probe = probes; probe->timer; probe++)
+        FNET_TEST_CHECK(probe < &probes[PROBE_MAX - 1]);
+
+    fnet_memset_zero(probe, sizeof(*probe));
+    probe->timer = fnet_timer_new_oneshot(probe_handler, probe);
+    FNET_TEST_CHECK(probe->timer != 0);
+    if(delay)
+        fnet_timer_start(probe->timer, delay);
+    return probe;
+}
+
+static void probes_free( void )
+{
+    int i;
+
+    for(i = 0; i < PROBE_MAX; i++)
+    {
+        if(probes[i].timer)
+        {
+            fnet_timer_free(probes[i].timer);
+            probes[i].timer = 0;
+        }
+    }
+    fire_count = 0;
+}
+
+/* Ticks one by one, the bottom half runs after each tick.*/
+static void tick( unsigned long ticks )
+{
+    while(ticks--)
+    {
+        fnet_timer_ticks_inc();
+        fnet_timer_handler_bottom();
+    }
+}
+
+/************************************************************************
+* Test cases.
+*************************************************************************/
+static void test_wheel_delays( unsigned long heap_free )
+{
+    /* First level, second level, past the wheel span, and on the edges.*/
+    static const unsigned long delays[] = {1, 2, 63, 64, 65, 127, 128, 1000, 
+                                           4095, 4096, 4097, 5000, 9000};
+    static const unsigned long offsets[] = {37, 63, 4096 - 1};
+    probe_t         *probe[sizeof(delays) / sizeof(delays[0])];
+    fnet_timer_desc_t periodic;
+    unsigned long   start;
+    int             i, o, n = (int)(sizeof(delays) / sizeof(delays[0]));
+
+    fnet_memset_zero(&probes[PROBE_MAX - 1], sizeof(probe_t));
+    periodic = fnet_timer_new(100, probe_handler, &probes[PROBE_MAX - 1]);
+    probes[PROBE_MAX - 1].timer = periodic;
+
+    for(o = 0; o < (int)(sizeof(offsets) / sizeof(offsets[0])); o++)
+    {
+        /* Start at different positions of the two wheel levels.*/
+        tick((offsets[o] - fnet_timer_ticks()) & 4095);
+        start = fnet_timer_ticks();
+
+        for(i = 0; i < n; i++)
+            probe[i] = probe_new(delays[i]);
+        fnet_timer_start(periodic, 100);
+        probes[PROBE_MAX - 1].count = 0;
+
+        tick(delays[n - 1]);
+
+        for(i = 0; i < n; i++)
+        {
+            FNET_TEST_CHECK(probe[i]->count == 1);
+            FNET_TEST_CHECK(probe[i]->fired[0] == start + delays[i]);
+            fnet_timer_free(probe[i]->timer);
+            probe[i]->timer = 0;
+        }
+        FNET_TEST_CHECK(probes[PROBE_MAX - 1].count == (int)(delays[n - 1] / 100));
+        FNET_TEST_CHECK(probes[PROBE_MAX - 1].fired[0] == start + 100);
+        FNET_TEST_CHECK(probes[PROBE_MAX - 1].fired[7] == start + 800);
+    }
+    probes_free();
+    FNET_TEST_CHECK(fnet_free_mem_status() == heap_free);
+    fnet_test_pass("timers fire on the exact tick");
+}
+
+static void test_wheel_handler_changes( unsigned long heap_free )
+{
+    probe_t         *a, *c, *d, *p, *q, *x, *y, *z, *w, *late, *far;
+    unsigned long   start = fnet_timer_ticks();
+
+    /* Two timers of the same tick stop each other, or free each other:
+     * whichever comes first, only that one is called.*/
+    x = probe_new(10);
+    y = probe_new(10);
+    x->action = y->action = PROBE_STOP;
+    x->other = y;
+    y->other = x;
+    p = probe_new(20);
+    q = probe_new(20);
+    p->action = q->action = PROBE_FREE;
+    p->other = q;
+    q->other = p;
+
+    /* A timer frees itself, the next one of the slot is still called.*/
+    z = probe_new(30);
+    w = probe_new(30);
+    z->action = PROBE_FREE_SELF;
+    c = probe_new(30);
+    c->action = PROBE_FREE_SELF;
+
+    /* Timers of the second level and past the span are stopped and freed.*/
+    late = probe_new(100);
+    far = probe_new(5000);
+    d = probe_new(40);
+    d->action = PROBE_STOP;
+    d->other = late;
+    a = probe_new(41);
+    a->action = PROBE_FREE;
+    a->other = far;
+
+    tick(6000);
+
+    FNET_TEST_CHECK(x->count + y->count == 1);
+    FNET_TEST_CHECK(p->count + q->count == 1);
+    FNET_TEST_CHECK((p->timer == 0) != (q->timer == 0));
+    FNET_TEST_CHECK(z->count == 1 && z->timer == 0);
+    FNET_TEST_CHECK(c->count == 1 && c->timer == 0);
+    FNET_TEST_CHECK(w->count == 1 && w->fired[0] == start + 30);
+    FNET_TEST_CHECK(d->count == 1 && a->count == 1);
+    FNET_TEST_CHECK(late->count == 0 && late->timer != 0);
+    FNET_TEST_CHECK(far->count == 0 && far->timer == 0);
+
+    /* A stopped timer can be started again.*/
+    fnet_timer_start(late->timer, 3);
+    tick(3);
+    FNET_TEST_CHECK(late->count == 1 && late->fired[0] == start + 6003);
+
+    probes_free();
+    FNET_TEST_CHECK(fnet_free_mem_status() == heap_free);
+    fnet_test_pass("handlers stop and free timers");
+}
+
+static void test_wheel_restart( unsigned long heap_free )
+{
+    probe_t         *short_delay, *long_delay, *now;
+    unsigned long   start = fnet_timer_ticks();
+
+    /* Restarted from its own handler, into the first and the second level.*/
+    short_delay = probe_new(3);
+    short_delay->action = PROBE_RESTART;
+    short_delay->delay = 3;
+    short_delay->restarts = 4;
+    long_delay = probe_new(3);
+    long_delay->action = PROBE_RESTART;
+    long_delay->delay = 100;
+    long_delay->restarts = 2;
+    /* A zero delay is one tick: the handler is not called again in the same pass.*/
+    now = probe_new(1);
+    now->action = PROBE_RESTART;
+    now->delay = 0;
+    now->restarts = 3;
+
+    tick(300);
+
+    FNET_TEST_CHECK(short_delay->count == 5);
+    FNET_TEST_CHECK(short_delay->fired[0] == start + 3);
+    FNET_TEST_CHECK(short_delay->fired[4] == start + 15);
+    FNET_TEST_CHECK(long_delay->count == 3);
+    FNET_TEST_CHECK(long_delay->fired[1] == start + 103);
+    FNET_TEST_CHECK(long_delay->fired[2] == start + 203);
+    FNET_TEST_CHECK(now->count == 4);
+    FNET_TEST_CHECK(now->fired[3] == start + 4);
+
+    probes_free();
+    FNET_TEST_CHECK(fnet_free_mem_status() == heap_free);
+    fnet_test_pass("one-shot restarts from its handler");
+}
+
+static void test_wheel_catch_up( unsigned long heap_free )
+{
+    static const unsigned long delays[] = {200, 1, 70, 5, 64};
+    probe_t         *probe[sizeof(delays) / sizeof(delays[0])];
+    probe_t         *restart, *periodic = &probes[PROBE_MAX - 1];
+    unsigned long   start = fnet_timer_ticks();
+    int             i, n = (int)(sizeof(delays) / sizeof(delays[0]));
+
+    for(i = 0; i < n; i++)
+        probe[i] = probe_new(delays[i]);
+    restart = probe_new(2);
+    restart->action = PROBE_RESTART;
+    restart->delay = 1;
+    restart->restarts = 1;
+    fnet_memset_zero(periodic, sizeof(probe_t));
+    periodic->timer = fnet_timer_new(10, probe_handler, periodic);
+
+    /* The bottom half was held off for 300 ticks.*/
+    for(i = 0; i < 300; i++)
+        fnet_timer_ticks_inc();
+    fnet_timer_handler_bottom();
+
+    /* Every timer due is called once, in the order of expiration.*/
+    FNET_TEST_CHECK(fire_count == n + 2);
+    FNET_TEST_CHECK(fire_log[0] == probe[1]);
+    FNET_TEST_CHECK(fire_log[1] == restart);
+    FNET_TEST_CHECK(fire_log[2] == probe[3]);
+    FNET_TEST_CHECK(fire_log[3] == periodic);
+    FNET_TEST_CHECK(fire_log[4] == probe[4]);
+    FNET_TEST_CHECK(fire_log[5] == probe[2]);
+    FNET_TEST_CHECK(fire_log[6] == probe[0]);
+    for(i = 0; i < n; i++)
+        FNET_TEST_CHECK(probe[i]->count == 1 && probe[i]->fired[0] == start + 300);
+
+    /* Timers restarted during the catch-up count from the current time.*/
+    tick(1);
+    FNET_TEST_CHECK(restart->count == 2 && restart->fired[1] == start + 301);
+    tick(9);
+    FNET_TEST_CHECK(periodic->count == 2 && periodic->fired[1] == start + 310);
+
+    probes_free();
+    FNET_TEST_CHECK(fnet_free_mem_status() == heap_free);
+    fnet_test_pass("bottom half catches up ticks");
+}
+
+static void test_clock( void )
+{
+    unsigned long   period = LPC_TIM2->MR0;
+    unsigned long   us, last, start;
+    int             i;
+
+    /* The software timer tests have already counted ticks.*/
+    matches = start = fnet_timer_ticks();
+    last = fnet_timer_us();
+
+    FNET_TEST_CHECK(period == COUNTS_PER_US * FNET_TIMER_PERIOD_MS * 1000);
+
+    for(i = 0; i < 1000000; i++)
+    {
+        /* The interrupt is taken before the next match, 
+         * but not always at once.*/
+        if((LPC_TIM2->IR & 1) && ((test_rand() & 1) || (i & 0x100)))
+            timer_interrupt();
+        timer_run((test_rand() * 8) % (period / 3));
+        if(test_rand() & 1)
+            timer_interrupt();
+
+        us = fnet_timer_us();
+        FNET_TEST_CHECK(us == matches * (FNET_TIMER_PERIOD_MS * 1000) + LPC_TIM2->TC / COUNTS_PER_US);
+        FNET_TEST_CHECK((long)(us - last) >= 0);    /* It wraps after 71 minutes.*/
+        last = us;
+    }
+    FNET_TEST_CHECK(matches - start > 1000);
+    fnet_test_pass("microseconds, match interrupt pending");
+}
+
+/************************************************************************
+* NAME: main
+*************************************************************************/
+int main( void )
+{
+    unsigned long heap_free;
+
+    FNET_TEST_CHECK(fnet_heap_init(heap, sizeof(heap)) == FNET_OK);
+    FNET_TEST_CHECK(fnet_timer_init(FNET_TIMER_PERIOD_MS) == FNET_OK);
+    FNET_TEST_CHECK(LPC_TIM2->TCR == 1);
+
+    heap_free = fnet_free_mem_status();
+
+    test_wheel_delays(heap_free);
+    test_wheel_handler_changes(heap_free);
+    test_wheel_restart(heap_free);
+    test_wheel_catch_up(heap_free);
+    test_clock();
+
+    fnet_timer_release();
+    FNET_TEST_CHECK(LPC_TIM2->TCR == 0);
+
+    return 0;
+}